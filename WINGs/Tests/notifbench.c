@@ -0,0 +1,188 @@
+/*
+ * Measures how long it takes to post notifications to a center that many
+ * windows observe, as in wmaker where each window observes the changes of
+ * the appearance settings and the window list menus observe every window:
+ * a name each window observes from itself, posted by one of them, and a
+ * name the menus observe from any window. It also measures how long it
+ * takes to remove the observers of the windows with
+ * WMRemoveNotificationObserver() and with the handles given for them.
+ *
+ * It first checks which observers the removals remove, and stops if one
+ * is not what it should be.
+ *
+ * usage: notifbench [-n windows] [-p posts]
+ */
+
+#include <WINGs/WINGs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+
+#define APPEARANCE	"WindowAppearanceSettingsChanged"
+#define FOCUS		"WindowChangedFocus"
+#define MENUS		8
+
+static int told;
+
+
+void wAbort()
+{
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void observer(void *self, WMNotification *notif)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) self;
+	(void) notif;
+
+	told++;
+}
+
+static void check(Bool ok, const char *what)
+{
+	if (!ok) {
+		printf("FAILED: %s\n", what);
+		exit(1);
+	}
+}
+
+static void checkRemoval(void)
+{
+	/* the same name as the constant, but another copy of it */
+	char name[] = "NotifBenchName";
+	int a, b;
+	WMHandlerID id;
+
+	told = 0;
+
+	/* names are matched by content, not by pointer */
+	WMAddNotificationObserver(observer, &a, "NotifBenchName", &b);
+	WMRemoveNotificationObserverWithName(&a, name, &b);
+	WMPostNotificationName("NotifBenchName", &b, NULL);
+	check(told == 0, "removing with another copy of the name");
+
+	WMAddNotificationObserver(observer, &a, "NotifBenchName", &b);
+	WMRemoveNotificationObserverWithName(&a, name, &a);
+	WMRemoveNotificationObserverWithName(&a, "NotifBenchOther", &b);
+	WMRemoveNotificationObserverWithName(&b, name, &b);
+	WMPostNotificationName(name, &b, NULL);
+	check(told == 1, "removing with another object, name or observer");
+	WMRemoveNotificationObserver(&a);
+
+	/* a handle removes its own observer only, and nothing once removed */
+	id = WMAddNotificationObserver(observer, &a, name, NULL);
+	WMAddNotificationObserver(observer, &a, name, NULL);
+	WMDeleteNotificationObserver(id);
+	WMPostNotificationName(name, &b, NULL);
+	check(told == 2, "deleting one of two observers");
+
+	WMRemoveNotificationObserver(&a);
+	WMDeleteNotificationObserver(id);
+	WMPostNotificationName(name, &b, NULL);
+	check(told == 2, "deleting an observer already removed");
+
+	printf("removal checks passed\n");
+}
+
+static void measure(int count, int posts)
+{
+	WMHandlerID *ids;
+	double start, add, postOne, postAny, remove, delete;
+	int *windows, menus[MENUS];
+	int i;
+
+	windows = wmalloc(count * sizeof(int));
+	ids = wmalloc(count * sizeof(WMHandlerID));
+
+	for (i = 0; i < MENUS; i++)
+		WMAddNotificationObserver(observer, &menus[i], FOCUS, NULL);
+
+	start = now();
+	for (i = 0; i < count; i++)
+		WMAddNotificationObserver(observer, &windows[i], APPEARANCE, &windows[i]);
+	add = now() - start;
+
+	/* what a window observes from itself, posted by one of them */
+	told = 0;
+	start = now();
+	for (i = 0; i < posts; i++)
+		WMPostNotificationName(APPEARANCE, &windows[i % count], NULL);
+	postOne = now() - start;
+	check(told == posts, "posting to the observer of a window");
+
+	told = 0;
+	start = now();
+	for (i = 0; i < posts; i++)
+		WMPostNotificationName(FOCUS, &windows[i % count], NULL);
+	postAny = now() - start;
+	check(told == posts * MENUS, "posting to the observers of any window");
+
+	start = now();
+	for (i = 0; i < count; i++)
+		WMRemoveNotificationObserver(&windows[i]);
+	remove = now() - start;
+
+	for (i = 0; i < count; i++)
+		ids[i] = WMAddNotificationObserver(observer, &windows[i], APPEARANCE, &windows[i]);
+
+	start = now();
+	for (i = 0; i < count; i++)
+		WMDeleteNotificationObserver(ids[i]);
+	delete = now() - start;
+
+	told = 0;
+	WMPostNotificationName(APPEARANCE, NULL, NULL);
+	check(told == 0, "posting to the removed observers");
+
+	for (i = 0; i < MENUS; i++)
+		WMRemoveNotificationObserver(&menus[i]);
+
+	printf("%d windows  add %6.1f ns  post to one %7.1f ns  to any %6.1f ns"
+	       "  remove %6.1f ns  delete %6.1f ns\n",
+	       count, add / count, postOne / posts, postAny / posts, remove / count, delete / count);
+
+	wfree(windows);
+	wfree(ids);
+}
+
+int main(int argc, char **argv)
+{
+	int windows = 4000, posts = 1000000, ch;
+
+	WMInitializeApplication("notifbench", &argc, argv);
+
+	while ((ch = getopt(argc, argv, "n:p:")) != -1) {
+		switch (ch) {
+		case 'n':
+			windows = atoi(optarg);
+			break;
+		case 'p':
+			posts = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n windows] [-p posts]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if (windows < 1 || posts < 1) {
+		fprintf(stderr, "usage: %s [-n windows] [-p posts]\n", argv[0]);
+		exit(1);
+	}
+
+	checkRemoval();
+	measure(windows, posts);
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Measures how long it takes to describe, save, read back and release
+ * property lists shaped like the big files of wmaker, as they grow:
+ * WMWindowAttributes with a dictionary of attributes per window class, and
+ * WMState with a dock of many applications.
+ *
+ * usage: plbench [-n entries] [-s] [-a]
+ *	-s	write the dictionary keys sorted
+ *	-a	read the files with arenas
+ */
+
+#include <WINGs/WUtil.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+void wAbort()
+{
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void put(WMPropList *dict, const char *key, WMPropList *value)
+{
+	WMPropList *pkey = WMCreatePLString(key);
+
+	WMPutInPLDictionary(dict, pkey, value);
+	WMReleasePropList(pkey);
+	WMReleasePropList(value);
+}
+
+/* like WMWindowAttributes */
+static WMPropList *makeAttributes(int count)
+{
+	WMPropList *dict, *attrs;
+	char name[64];
+	int i;
+
+	dict = WMCreatePLDictionary(NULL, NULL);
+	for (i = 0; i < count; i++) {
+		attrs = WMCreatePLDictionary(NULL, NULL);
+		snprintf(name, sizeof(name), "/usr/share/icons/app%d.png", i);
+		put(attrs, "Icon", WMCreatePLString(name));
+		put(attrs, "NoTitlebar", WMCreatePLString(i % 2 ? "Yes" : "No"));
+		put(attrs, "Omnipresent", WMCreatePLString("No"));
+		put(attrs, "StartWorkspace", WMCreatePLString("2"));
+
+		snprintf(name, sizeof(name), "app%d.App%d", i, i);
+		put(dict, name, attrs);
+	}
+
+	return dict;
+}
+
+/* like the dock of WMState */
+static WMPropList *makeState(int count)
+{
+	WMPropList *state, *apps, *app;
+	char buffer[128];
+	int i;
+
+	apps = WMCreatePLArray(NULL);
+	for (i = 0; i < count; i++) {
+		app = WMCreatePLDictionary(NULL, NULL);
+		snprintf(buffer, sizeof(buffer), "app%d --geometry 640x480+%d+%d", i, i, i);
+		put(app, "Command", WMCreatePLString(buffer));
+		snprintf(buffer, sizeof(buffer), "app%d.App%d", i, i);
+		put(app, "Name", WMCreatePLString(buffer));
+		snprintf(buffer, sizeof(buffer), "%d,%d", i % 10, i / 10);
+		put(app, "Position", WMCreatePLString(buffer));
+		put(app, "AutoLaunch", WMCreatePLString("No"));
+		put(app, "Lock", WMCreatePLString("Yes"));
+		put(app, "Forced", WMCreatePLString("No"));
+		put(app, "BuggyApplication", WMCreatePLString("No"));
+		put(app, "DropCommand", WMCreatePLString("app %d"));
+
+		WMAddToPLArray(apps, app);
+		WMReleasePropList(app);
+	}
+
+	state = WMCreatePLDictionary(NULL, NULL);
+	app = WMCreatePLDictionary(NULL, NULL);
+	put(app, "Applications", apps);
+	put(app, "Position", WMCreatePLString("1216,0"));
+	put(state, "Dock", app);
+
+	return state;
+}
+
+static void measure(const char *what, WMPropList *plist, int entries, const char *file)
+{
+	double start, describe, write, read, release;
+	WMPropList *copy;
+	char *desc;
+	size_t size;
+
+	start = now();
+	desc = WMGetPropListDescription(plist, True);
+	describe = now() - start;
+	size = strlen(desc);
+	wfree(desc);
+
+	start = now();
+	if (!WMWritePropListToFile(plist, file)) {
+		printf("could not write %s\n", file);
+		exit(1);
+	}
+	write = now() - start;
+
+	start = now();
+	copy = WMReadPropListFromFile(file);
+	read = now() - start;
+	if (!copy) {
+		printf("could not read %s\n", file);
+		exit(1);
+	}
+
+	start = now();
+	WMReleasePropList(copy);
+	release = now() - start;
+
+	printf("%-12s %7d entries %9zu bytes  describe %8.2f ms  write %8.2f ms"
+	       "  read %8.2f ms  release %8.2f ms\n",
+	       what, entries, size, describe, write, read, release);
+}
+
+int main(int argc, char **argv)
+{
+	WMPropList *plist;
+	char file[] = "/tmp/plbench.XXXXXX";
+	int entries = 16000, count, fd, ch;
+
+	while ((ch = getopt(argc, argv, "n:sa")) != -1) {
+		switch (ch) {
+		case 'n':
+			entries = atoi(optarg);
+			break;
+		case 's':
+			WMPLSetSortKeys(True);
+			break;
+		case 'a':
+			WMPLSetUseArenas(True);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n entries] [-s] [-a]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	fd = mkstemp(file);
+	if (fd < 0) {
+		perror("mkstemp");
+		exit(1);
+	}
+	close(fd);
+
+	/* WMWritePropListToFile() refuses to write outside of it */
+	setenv("WMAKER_USER_ROOT", "/tmp", 1);
+
+	for (count = entries / 16 > 0 ? entries / 16 : 1; count <= entries; count *= 2) {
+		plist = makeAttributes(count);
+		measure("attributes", plist, count, file);
+		WMReleasePropList(plist);
+
+		plist = makeState(count);
+		measure("state", plist, count, file);
+		WMReleasePropList(plist);
+	}
+
+	unlink(file);
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Measures how long WMText takes to lay out and paint a document as it
+ * grows, line after line, and when it is edited at its beginning.
+ *
+ * usage: textbench [-n lines]
+ */
+
+#include <WINGs/WINGs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+
+void wAbort()
+{
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void report(const char *what, int from, int to, double total, double worst)
+{
+	printf("%-10s %7d-%-7d  avg %8.1f us  max %8.1f us\n",
+	       what, from, to, total / (to - from), worst);
+}
+
+int main(int argc, char **argv)
+{
+	Display *dpy;
+	WMScreen *scr;
+	WMWindow *win;
+	WMText *text;
+	char line[128];
+	double start, elapsed, total, worst;
+	int lines = 100000, step, i, from, ch;
+
+	WMInitializeApplication("TextBench", &argc, argv);
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			lines = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n lines]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if (lines < 10)
+		lines = 10;
+	step = lines / 10;
+
+	dpy = XOpenDisplay("");
+	if (!dpy) {
+		puts("could not open display");
+		exit(1);
+	}
+	scr = WMCreateScreen(dpy, DefaultScreen(dpy));
+
+	win = WMCreateWindow(scr, "textbench");
+	WMResizeWidget(win, 500, 400);
+
+	text = WMCreateText(win);
+	WMResizeWidget(text, 480, 380);
+	WMMoveWidget(text, 10, 10);
+	WMSetTextHasVerticalScroller(text, True);
+	WMSetTextEditable(text, False);
+
+	WMRealizeWidget(win);
+	WMMapSubwidgets(win);
+	WMMapWidget(win);
+	XSync(dpy, False);
+
+	/* append, keeping the end of the document in view like a log viewer */
+	total = worst = 0;
+	from = 0;
+	for (i = 0; i < lines; i++) {
+		snprintf(line, sizeof(line), "line %d: the quick brown fox jumps over the lazy dog\n", i);
+
+		start = now();
+		WMAppendTextStream(text, line);
+		WMScrollText(text, 1 << 30);
+		elapsed = now() - start;
+
+		total += elapsed;
+		if (elapsed > worst)
+			worst = elapsed;
+
+		if ((i + 1) % step == 0) {
+			report("append", from, i + 1, total, worst);
+			total = worst = 0;
+			from = i + 1;
+		}
+	}
+
+	/* edit the beginning, everything after it only moves */
+	WMScrollText(text, -(1 << 30));
+	total = worst = 0;
+	for (i = 0; i < 100; i++) {
+		snprintf(line, sizeof(line), "prepended %d\n", i);
+
+		start = now();
+		WMPrependTextStream(text, line);
+		WMRedisplayWidget(text);
+		elapsed = now() - start;
+
+		total += elapsed;
+		if (elapsed > worst)
+			worst = elapsed;
+	}
+	report("prepend", 0, 100, total, worst);
+
+	/* jump around the document */
+	total = worst = 0;
+	for (i = 0; i < 100; i++) {
+		start = now();
+		WMScrollText(text, (i % 2) ? -(1 << 30) : (1 << 30));
+		elapsed = now() - start;
+
+		total += elapsed;
+		if (elapsed > worst)
+			worst = elapsed;
+	}
+	report("scroll", 0, 100, total, worst);
+
+	XSync(dpy, False);
+
+	return 0;
+}
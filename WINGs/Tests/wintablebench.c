@@ -0,0 +1,216 @@
+/*
+ * Measures how long it takes to find what an X window is, with Xlib's
+ * XFindContext() and with a WMWindowTable, replaying the windows of a
+ * sequence of events.
+ *
+ * The sequence is read from an event trace recorded with
+ * wmaker --record-events, or else made up: a few hundred windows, as many
+ * as a busy window manager has, most events going to a few of them.
+ *
+ * It measures the lookups only. The events are not dispatched and their
+ * handlers are not run; for what the whole dispatch costs, replay the
+ * trace in wmaker with --replay-events.
+ *
+ * usage: wintablebench [-f trace] [-n events] [-w windows]
+ */
+
+#include <WINGs/WINGs.h>
+
+#include <X11/Xresource.h>
+#include <X11/Xutil.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+void wAbort()
+{
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the event traces written by wmaker --record-events, see src/evtrace.c */
+#define TRACE_MAGIC	"WMTRACE1"
+#define TAG_SHIFT	29
+#define TAG_MASK	(3UL << TAG_SHIFT)
+#define TAG_ROOT	(1UL << TAG_SHIFT)
+#define TAG_OWN		(2UL << TAG_SHIFT)
+#define TAG_VALUE(w)	((w) & ~TAG_MASK)
+
+typedef struct {
+	char magic[8];
+	uint32_t eventSize;
+	uint32_t reserved;
+} TraceHeader;
+
+typedef struct {
+	uint64_t time;
+	uint16_t type;
+	uint16_t length;
+	uint32_t reserved;
+} TraceRecord;
+
+/* ids like a server gives: the roots, the windows of wmaker, then of each client */
+static Window untagWindow(Window window)
+{
+	switch (window & TAG_MASK) {
+	case TAG_ROOT:
+		return 0x100 + TAG_VALUE(window);
+	case TAG_OWN:
+		return 0x200000 + TAG_VALUE(window);
+	default:
+		return (TAG_VALUE(window) + 1) * 0x200000 + 1;
+	}
+}
+
+/* the window each event is dispatched on */
+static Window *readTrace(const char *file, int *count)
+{
+	TraceHeader header;
+	TraceRecord rec;
+	XEvent event;
+	FILE *f;
+	Window *trace = NULL;
+	int size = 0;
+
+	f = fopen(file, "rb");
+	if (!f) {
+		perror(file);
+		exit(1);
+	}
+
+	if (fread(&header, sizeof(header), 1, f) != 1
+	    || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+	    || header.eventSize != sizeof(XEvent)) {
+		printf("%s is not an event trace recorded on this kind of system\n", file);
+		exit(1);
+	}
+
+	*count = 0;
+	while (fread(&rec, sizeof(rec), 1, f) == 1 && rec.length <= sizeof(XEvent)) {
+		memset(&event, 0, sizeof(event));
+		if (fread(&event, rec.length, 1, f) != 1)
+			break;
+
+		if (rec.type == GenericEvent || event.xany.window == None)
+			continue;
+
+		if (*count == size) {
+			size = size ? 2 * size : 1024;
+			trace = wrealloc(trace, size * sizeof(Window));
+		}
+		trace[(*count)++] = untagWindow(event.xany.window);
+	}
+	fclose(f);
+
+	return trace;
+}
+
+static Window *makeTrace(int events, int windows)
+{
+	Window *trace = wmalloc(events * sizeof(Window));
+	int i, w;
+
+	srand(1);
+	for (i = 0; i < events; i++) {
+		/* most events go to the few windows being used */
+		if (rand() % 4)
+			w = rand() % 8;
+		else
+			w = rand() % windows;
+
+		/* windows of wmaker and of a couple of clients */
+		trace[i] = ((w % 3) + 1) * 0x200000 + w;
+	}
+
+	return trace;
+}
+
+int main(int argc, char **argv)
+{
+	Display *dpy;
+	XContext context;
+	WMWindowTable *table;
+	Window *trace;
+	XPointer data;
+	double start, xlib, wings;
+	int events = 1000000, windows = 500, xlibFound, wingsFound, i, ch;
+	char *file = NULL;
+
+	while ((ch = getopt(argc, argv, "f:n:w:")) != -1) {
+		switch (ch) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			events = atoi(optarg);
+			break;
+		case 'w':
+			windows = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f trace] [-n events] [-w windows]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	if (file)
+		trace = readTrace(file, &events);
+	else
+		trace = makeTrace(events, windows > 0 ? windows : 1);
+
+	if (events <= 0) {
+		puts("no events to replay");
+		exit(1);
+	}
+
+	/* XFindContext() needs a display, although it does not talk to it */
+	dpy = XOpenDisplay("");
+	if (!dpy) {
+		puts("could not open display");
+		exit(1);
+	}
+
+	context = XUniqueContext();
+	table = WMCreateWindowTable(1);
+	for (i = 0; i < events; i++) {
+		XSaveContext(dpy, trace[i], context, (XPointer) & trace[i]);
+		WMWindowTableInsert(table, trace[i], 0, &trace[i]);
+	}
+
+	xlibFound = 0;
+	start = now();
+	for (i = 0; i < events; i++) {
+		if (XFindContext(dpy, trace[i], context, &data) == 0)
+			xlibFound++;
+	}
+	xlib = now() - start;
+
+	wingsFound = 0;
+	start = now();
+	for (i = 0; i < events; i++) {
+		if (WMWindowTableGet(table, trace[i], 0))
+			wingsFound++;
+	}
+	wings = now() - start;
+
+	printf("%d events\n", events);
+	printf("XFindContext      %8.1f ns/event  %d found\n", xlib / events, xlibFound);
+	printf("WMWindowTableGet  %8.1f ns/event  %d found\n", wings / events, wingsFound);
+
+	WMFreeWindowTable(table);
+	XCloseDisplay(dpy);
+
+	return 0;
+}
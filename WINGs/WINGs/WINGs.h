@@ -488,6 +488,9 @@ typedef void WMEventProc(XEvent *event, void *clientData);
 
 typedef void WMEventHook(XEvent *event);
 
+/* fills event with the next event and returns True, or False at the end */
+typedef Bool WMEventSourceProc(XEvent *event, void *clientData);
+
 /* self is set to the widget from where the callback is being called and
  * clientData to the data set to with WMSetClientData() */
 typedef void WMAction(WMWidget *self, void *clientData);
@@ -500,6 +503,14 @@ typedef void WMAction2(void *self, void *clientData);
 typedef void WMListDrawProc(WMList *lPtr, int index, Drawable d, char *text,
                             int state, WMRect *rect);
 
+/*
+ * Fills item with the contents of row, for lists getting their rows from
+ * a data source. item is zeroed, item->text must be allocated with wmalloc()
+ * or wstrdup() and will be freed by the list.
+ */
+typedef void WMListFillItemProc(WMList *lPtr, int row, WMListItem *item,
+                                void *clientData);
+
 
 /*
 typedef void WMSplitViewResizeSubviewsProc(WMSplitView *sPtr,
@@ -518,6 +529,7 @@ typedef WMWidget* WMMatrixCreateCellProc(WMMatrix *mPtr);
 typedef struct WMBrowserDelegate {
     void *data;
 
+    /* may give the list a data source instead of inserting all its rows */
     void (*createRowsForColumn)(struct WMBrowserDelegate *self,
                                 WMBrowser *sender, int column, WMList *list);
 
@@ -700,6 +712,16 @@ void WMSetApplicationIconWindow(WMScreen *scr, Window window);
 
 WMEventHook* WMHookEventHandler(WMEventHook *handler);
 
+/* recorder is called with each event WMNextEvent()/WMMaskEvent() get from the display */
+WMEventHook* WMHookEventRecorder(WMEventHook *recorder);
+
+/*
+ * Makes WMNextEvent()/WMMaskEvent() take their events from proc instead of
+ * the display, until it returns False. Timers and idle handlers still run
+ * between events. Passing NULL goes back to the display.
+ */
+void WMSetEventSource(WMEventSourceProc *proc, void *clientData);
+
 int WMHandleEvent(XEvent *event);
 
 Bool WMScreenPending(WMScreen *scr);
@@ -722,6 +744,27 @@ void WMSetViewNextResponder(WMView *view, WMView *responder);
 
 void WMRelayToNextResponder(WMView *view, XEvent *event);
 
+/* ---[ WINGs/windowtable.c ]--------------------------------------------- */
+
+/*
+ * Maps X windows to data, faster than XFindContext(). Each window has
+ * roles slots, each role being used like a separate XContext.
+ */
+typedef struct W_WindowTable WMWindowTable;
+
+WMWindowTable* WMCreateWindowTable(int roles);
+
+void WMFreeWindowTable(WMWindowTable *table);
+
+void* WMWindowTableGet(WMWindowTable *table, Window window, int role);
+
+/* Returns the data previously associated to window for role. NULL data
+ * removes the association */
+void* WMWindowTableInsert(WMWindowTable *table, Window window, int role,
+                          void *data);
+
+void* WMWindowTableRemove(WMWindowTable *table, Window window, int role);
+
 
 /* ---[ WINGs/selection.c ]----------------------------------------------- */
 
@@ -818,6 +861,15 @@ void WMDrawImageString(WMScreen *scr, Drawable d, WMColor *color,
 
 int WMWidthOfString(WMFont *font, const char *text, int length);
 
+/* Stores in widths[i] the width of the first i bytes of text, for i from 0
+ * to length, measuring the string once. Inside a multibyte character, it is
+ * the width of what is before the character */
+void WMGetStringPrefixWidths(WMFont *font, const char *text, int length, int *widths);
+
+/* How many times the width or the glyphs of a string were found in the
+ * cache of the font, and how many times they had to be computed */
+void WMGetFontCacheStatistics(WMFont *font, unsigned int *hits, unsigned int *misses);
+
 /* ---[ WINGs/wpixmap.c ]------------------------------------------------- */
 
 WMPixmap* WMRetainPixmap(WMPixmap *pixmap);
@@ -1290,6 +1342,26 @@ Bool WMListAllowsMultipleSelection(WMList *lPtr);
 
 Bool WMListAllowsEmptySelection(WMList *lPtr);
 
+/*
+ * Makes the list get its rowCount rows from proc instead of storing them.
+ * Only the rows being shown are materialized, so the items returned by
+ * WMGetListItem() and WMGetListSelectedItem() are only valid until the
+ * list is scrolled or reloaded. Items can't be inserted or removed, and
+ * WMClearList() makes the list store its items again.
+ */
+void WMSetListDataSource(WMList *lPtr, int rowCount, WMListFillItemProc *proc,
+                         void *clientData);
+
+/* The number of rows or their contents changed in the data source */
+void WMReloadListData(WMList *lPtr, int rowCount);
+
+Bool WMIsListRowSelected(WMList *lPtr, int row);
+
+int WMGetListNumberOfSelectedRows(WMList *lPtr);
+
+/* The selected rows as sorted ranges. don't free the returned data */
+WMRange* WMGetListSelectedRanges(WMList *lPtr, int *count);
+
 
 extern char *WMListDidScrollNotification;
 extern char *WMListSelectionDidChangeNotification;
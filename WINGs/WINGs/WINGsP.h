@@ -462,6 +462,15 @@ typedef struct W_Font {
 #ifdef USE_PANGO
     PangoLayout *layout;
 #endif
+
+    /* strings measured or drawn recently, most recently used first */
+    WMHashTable *textRuns;
+    struct W_TextRun *firstRun;
+    struct W_TextRun *lastRun;
+    int runCount;
+
+    unsigned int runHits;
+    unsigned int runMisses;
 } W_Font;
 
 #define W_FONTID(f)		(f)->font->fid
@@ -24,6 +24,7 @@
 
 #include <X11/Xlib.h>
 #include <limits.h>
+#include <stdio.h>
 #include <sys/types.h>
 
 /* SunOS 4.x Blargh.... */
@@ -217,6 +218,10 @@ typedef void waborthandler(int);
 
 waborthandler* wsetabort(waborthandler* handler);
 
+/* Writes to `file' how many blocks of each size were allocated and freed,
+ * when WUtil was configured with --enable-memory-pools. Nothing otherwise */
+void wmemstats(FILE *file);
+
 /* ---[ WINGs/error.c ]--------------------------------------------------- */
 
 enum {
@@ -246,6 +251,14 @@ char* wfindfileinarray(WMPropList* array, const char *file);
 
 char* wexpandpath(const char *path);
 
+/*
+ * The 3 functions above remember the names present in the directories they
+ * search, changes are noticed with inotify or the modification time of the
+ * directories. This makes them forget it all, for changes that could not be
+ * noticed, like the ones made from another host on a network filesystem.
+ */
+void wfindfileflushcache(void);
+
 int wcopy_file(const char *toPath, const char *srcFile, const char *destFile);
 
 /* don't free the returned string */
@@ -726,16 +739,22 @@ void* WMGetNotificationObject(WMNotification *notification);
 const char* WMGetNotificationName(WMNotification *notification);
 
 
-void WMAddNotificationObserver(WMNotificationObserverAction *observerAction,
-                               void *observer, const char *name, void *object);
+WMHandlerID WMAddNotificationObserver(WMNotificationObserverAction *observerAction,
+                                      void *observer, const char *name, void *object);
 
 void WMPostNotification(WMNotification *notification);
 
+/* Removes the observer added by the WMAddNotificationObserver() call
+ * that returned handlerID, if it was not removed already */
+void WMDeleteNotificationObserver(WMHandlerID handlerID);
+
 void WMRemoveNotificationObserver(void *observer);
 
 void WMRemoveNotificationObserverWithName(void *observer, const char *name,
                                           void *object);
 
+/* The notification only lives as long as it is being posted, and must not
+ * be retained by the observers */
 void WMPostNotificationName(const char *name, void *object, void *clientData);
 
 WMNotificationQueue* WMGetDefaultNotificationQueue(void);
@@ -762,6 +781,20 @@ void WMEnqueueCoalesceNotification(WMNotificationQueue *queue,
 
 void WMPLSetCaseSensitive(Bool caseSensitive);
 
+/*
+ * Makes the property lists read afterwards take their nodes from one block
+ * of memory per file or description, freed at once when the document is
+ * released, instead of allocating each on its own. Nodes put into other
+ * lists are copied out of the block, but any node retained on its own keeps
+ * the whole block, so it is meant to be turned on only around the reading of
+ * documents that are replaced as a whole and whose values are copied when
+ * kept.
+ */
+void WMPLSetUseArenas(Bool flag);
+
+/* Makes descriptions and files list the keys of dictionaries sorted, so they can be compared */
+void WMPLSetSortKeys(Bool sort);
+
 WMPropList* WMCreatePLString(const char *str);
 
 WMPropList* WMCreatePLData(WMData *data);
@@ -860,6 +893,21 @@ WMPropList* WMReadPropListFromPipe(const char *command);
 
 Bool WMWritePropListToFile(WMPropList *plist, const char *path);
 
+/*
+ * Binary caches of property list files, which load much faster than the
+ * files are parsed. The cache of a file is kept next to it, and is only
+ * used as long as the file is not modified.
+ */
+
+/* Returns NULL if file has no cache or it is out of date */
+WMPropList* WMReadPropListCache(const char *file);
+
+/* Caches plist as the contents of file, which must have been written */
+Bool WMWritePropListCache(WMPropList *plist, const char *file);
+
+/* Reads file from its cache if it is up to date, otherwise makes one */
+WMPropList* WMReadPropListFromCachedFile(const char *file);
+
 /* ---[ WINGs/userdefaults.c ]-------------------------------------------- */
 
 /* don't free the returned string */
@@ -33,6 +33,16 @@
 #include <string.h>
 #include <pwd.h>
 #include <limits.h>
+#include <time.h>
+#include <dirent.h>
+
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PATH_MAX
 #define PATH_MAX  1024
@@ -232,6 +242,304 @@ static const char *nextchar(const char *string, char tok)
 	return string;
 }
 
+/*
+ * Index of the search directories
+ *
+ * Finding a file in a list of paths used to mean expanding each of them and
+ * calling access() until it was found, for every icon of every window. The
+ * names present in each directory of the lists are now read once with
+ * readdir and kept in a hash table, so a lookup (found or not) costs no
+ * system call. A directory is read again when inotify reports a change in
+ * it or, for the ones that cannot be watched, when its modification time
+ * changed.
+ *
+ * wmmenugen looks files up from several threads, hence the lock.
+ */
+
+typedef struct W_SearchDir {
+	char *entry;		/* as it appears in the path list */
+	char *path;		/* expanded, NULL if that failed */
+	WMHashTable *names;	/* NULL if not a readable directory */
+	time_t mtime;
+	int watch;		/* inotify watch descriptor, or -1 */
+	Bool stale;
+} W_SearchDir;
+
+static WMHashTable *searchDirs = NULL;
+
+#ifdef HAVE_INOTIFY
+static int searchDirsNotify = -1;
+static Bool searchDirsNotifyFailed = False;
+#endif
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t searchDirsLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_SEARCH_DIRS()	pthread_mutex_lock(&searchDirsLock)
+#define UNLOCK_SEARCH_DIRS()	pthread_mutex_unlock(&searchDirsLock)
+#else
+#define LOCK_SEARCH_DIRS()
+#define UNLOCK_SEARCH_DIRS()
+#endif
+
+
+#ifdef HAVE_INOTIFY
+static void markWatchStale(int watch, Bool removed)
+{
+	WMHashEnumerator e;
+	W_SearchDir *dir;
+
+	e = WMEnumerateHashTable(searchDirs);
+	while ((dir = WMNextHashEnumeratorItem(&e))) {
+		if (watch >= 0 && dir->watch != watch)
+			continue;
+		dir->stale = True;
+		if (removed)
+			dir->watch = -1;
+	}
+}
+
+static void readSearchDirEvents(void)
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	ssize_t len;
+	char *ptr;
+
+	if (searchDirsNotify < 0)
+		return;
+
+	for (;;) {
+		len = read(searchDirsNotify, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+
+		for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event *) ptr;
+
+			if (event->mask & IN_Q_OVERFLOW)
+				markWatchStale(-1, False);
+			else
+				markWatchStale(event->wd, (event->mask & IN_IGNORED) != 0);
+		}
+	}
+}
+
+static void watchSearchDir(W_SearchDir *dir)
+{
+	if (dir->watch >= 0 || searchDirsNotifyFailed)
+		return;
+
+	if (searchDirsNotify < 0) {
+		searchDirsNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (searchDirsNotify < 0) {
+			searchDirsNotifyFailed = True;
+			return;
+		}
+	}
+
+	dir->watch = inotify_add_watch(searchDirsNotify, dir->path,
+	                               IN_ONLYDIR | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+	                               IN_DELETE_SELF | IN_MOVE_SELF);
+}
+#endif
+
+static void readSearchDir(W_SearchDir *dir)
+{
+	struct stat st;
+	struct dirent *dentry;
+	DIR *d;
+
+	if (dir->names) {
+		WMFreeHashTable(dir->names);
+		dir->names = NULL;
+	}
+
+	if (stat(dir->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		dir->mtime = 0;
+		dir->stale = False;
+		return;
+	}
+
+#ifdef HAVE_INOTIFY
+	/* before reading, so no change can be missed in between */
+	watchSearchDir(dir);
+#endif
+
+	d = opendir(dir->path);
+	if (!d) {
+		dir->mtime = 0;
+		dir->stale = False;
+		return;
+	}
+
+	dir->names = WMCreateHashTable(WMStringHashCallbacks);
+	while ((dentry = readdir(d))) {
+#ifdef DT_UNKNOWN
+		/* access() follows links, dangling ones were never found */
+		if (dentry->d_type == DT_LNK || dentry->d_type == DT_UNKNOWN) {
+#else
+		{
+#endif
+			char *path = wstrconcat(dir->path, "/");
+			Bool exists;
+
+			path = wstrappend(path, dentry->d_name);
+			exists = (access(path, F_OK) == 0);
+			wfree(path);
+			if (!exists)
+				continue;
+		}
+		WMHashInsert(dir->names, dentry->d_name, dir);
+	}
+	closedir(d);
+
+	/* a change within the same second would not change the time */
+	dir->mtime = st.st_mtime;
+	dir->stale = (st.st_mtime >= time(NULL));
+}
+
+/* take the changes reported since the last lookup into account */
+static void updateSearchDirs(void)
+{
+#ifdef HAVE_INOTIFY
+	LOCK_SEARCH_DIRS();
+	readSearchDirEvents();
+	UNLOCK_SEARCH_DIRS();
+#endif
+}
+
+static W_SearchDir *getSearchDir(const char *entry)
+{
+	W_SearchDir *dir;
+	struct stat st;
+
+	if (!searchDirs)
+		searchDirs = WMCreateHashTable(WMStringPointerHashCallbacks);
+
+	dir = WMHashGet(searchDirs, entry);
+	if (!dir) {
+		dir = wmalloc(sizeof(W_SearchDir));
+		dir->entry = wstrdup(entry);
+		dir->path = wexpandpath(entry);
+		dir->watch = -1;
+		dir->stale = True;
+		WMHashInsert(searchDirs, dir->entry, dir);
+	}
+
+	/* relative paths depend on the current directory, they are not indexed */
+	if (!dir->path || dir->path[0] != '/')
+		return dir;
+
+	if (!dir->stale && dir->watch < 0) {
+		if (stat(dir->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+			if (dir->names)
+				dir->stale = True;
+		} else if (st.st_mtime != dir->mtime) {
+			dir->stale = True;
+		}
+	}
+
+	if (dir->stale)
+		readSearchDir(dir);
+
+	return dir;
+}
+
+/*
+ * Looks for `file' in the directory `entry' (not expanded) of a search path,
+ * returns its complete path or NULL. The lock must be held.
+ */
+static char *findInSearchDir(const char *entry, const char *file)
+{
+	W_SearchDir *dir;
+	Bool indexed;
+	char *fullpath;
+	int len;
+
+	dir = getSearchDir(entry);
+	if (!dir->path)
+		return NULL;
+
+	indexed = (dir->path[0] == '/');
+	if (indexed && (!dir->names || !WMHashGet(dir->names, file)))
+		return NULL;
+
+	len = strlen(dir->path);
+	fullpath = wmalloc(len + strlen(file) + 2);
+	strcpy(fullpath, dir->path);
+	if (len == 0 || fullpath[len - 1] != '/')
+		strcat(fullpath, "/");
+	strcat(fullpath, file);
+
+	if (!indexed && access(fullpath, F_OK) != 0) {
+		wfree(fullpath);
+		return NULL;
+	}
+
+	return fullpath;
+}
+
+/*
+ * Names with a / or a $ in them are expanded along with the directory,
+ * they are looked up the old way.
+ */
+static char *findInPath(const char *entry, const char *file)
+{
+	char *path, *fullpath;
+
+	if (!strchr(file, '/') && !strchr(file, '$')) {
+		LOCK_SEARCH_DIRS();
+		fullpath = findInSearchDir(entry, file);
+		UNLOCK_SEARCH_DIRS();
+		return fullpath;
+	}
+
+	path = wstrconcat(entry, "/");
+	path = wstrappend(path, file);
+	fullpath = wexpandpath(path);
+	wfree(path);
+
+	if (fullpath && access(fullpath, F_OK) != 0) {
+		wfree(fullpath);
+		return NULL;
+	}
+
+	return fullpath;
+}
+
+static char *findAbsoluteFile(const char *file)
+{
+	char *fullpath;
+
+	if (access(file, F_OK) == 0)
+		return wstrdup(file);
+
+	fullpath = wexpandpath(file);
+	if (!fullpath)
+		return NULL;
+
+	if (access(fullpath, F_OK) < 0) {
+		wfree(fullpath);
+		return NULL;
+	}
+
+	return fullpath;
+}
+
+void wfindfileflushcache(void)
+{
+	WMHashEnumerator e;
+	W_SearchDir *dir;
+
+	LOCK_SEARCH_DIRS();
+	if (searchDirs) {
+		e = WMEnumerateHashTable(searchDirs);
+		while ((dir = WMNextHashEnumeratorItem(&e)))
+			dir->stale = True;
+	}
+	UNLOCK_SEARCH_DIRS();
+}
+
 /*
  *----------------------------------------------------------------------
  * findfile--
@@ -249,32 +557,19 @@ static const char *nextchar(const char *string, char tok)
  */
 char *wfindfile(const char *paths, const char *file)
 {
-	char *path;
+	char path[PATH_MAX + 1];
 	const char *tmp, *tmp2;
-	int len, flen;
+	int len;
 	char *fullpath;
 
 	if (!file)
 		return NULL;
 
-	if (*file == '/' || *file == '~' || *file == '$' || !paths || *paths == 0) {
-		if (access(file, F_OK) < 0) {
-			fullpath = wexpandpath(file);
-			if (!fullpath)
-				return NULL;
+	if (*file == '/' || *file == '~' || *file == '$' || !paths || *paths == 0)
+		return findAbsoluteFile(file);
 
-			if (access(fullpath, F_OK) < 0) {
-				wfree(fullpath);
-				return NULL;
-			} else {
-				return fullpath;
-			}
-		} else {
-			return wstrdup(file);
-		}
-	}
+	updateSearchDirs();
 
-	flen = strlen(file);
 	tmp = paths;
 	while (*tmp) {
 		tmp = skipchar(tmp, ':');
@@ -282,29 +577,15 @@ char *wfindfile(const char *paths, const char *file)
 			break;
 		tmp2 = nextchar(tmp, ':');
 		len = tmp2 - tmp;
-		path = wmalloc(len + flen + 2);
-		path = memcpy(path, tmp, len);
-		path[len] = 0;
-		if (path[len - 1] != '/' &&
-		    wstrlcat(path, "/", len + flen + 2) >= len + flen + 2) {
-			wfree(path);
+		if (len > PATH_MAX)
 			return NULL;
-		}
-
-		if (wstrlcat(path, file, len + flen + 2) >= len + flen + 2) {
-			wfree(path);
-			return NULL;
-		}
+		memcpy(path, tmp, len);
+		path[len] = 0;
 
-		fullpath = wexpandpath(path);
-		wfree(path);
+		fullpath = findInPath(path, file);
+		if (fullpath)
+			return fullpath;
 
-		if (fullpath) {
-			if (access(fullpath, F_OK) == 0) {
-				return fullpath;
-			}
-			wfree(fullpath);
-		}
 		tmp = tmp2;
 	}
 
@@ -314,51 +595,20 @@ char *wfindfile(const char *paths, const char *file)
 char *wfindfileinlist(char *const *path_list, const char *file)
 {
 	int i;
-	char *path;
-	int len, flen;
 	char *fullpath;
 
 	if (!file)
 		return NULL;
 
-	if (*file == '/' || *file == '~' || !path_list) {
-		if (access(file, F_OK) < 0) {
-			fullpath = wexpandpath(file);
-			if (!fullpath)
-				return NULL;
+	if (*file == '/' || *file == '~' || !path_list)
+		return findAbsoluteFile(file);
 
-			if (access(fullpath, F_OK) < 0) {
-				wfree(fullpath);
-				return NULL;
-			} else {
-				return fullpath;
-			}
-		} else {
-			return wstrdup(file);
-		}
-	}
+	updateSearchDirs();
 
-	flen = strlen(file);
 	for (i = 0; path_list[i] != NULL; i++) {
-		len = strlen(path_list[i]);
-		path = wmalloc(len + flen + 2);
-		path = memcpy(path, path_list[i], len);
-		path[len] = 0;
-		if (wstrlcat(path, "/", len + flen + 2) >= len + flen + 2 ||
-		    wstrlcat(path, file, len + flen + 2) >= len + flen + 2) {
-			wfree(path);
-			return NULL;
-		}
-		/* expand tilde */
-		fullpath = wexpandpath(path);
-		wfree(path);
-		if (fullpath) {
-			/* check if file exists */
-			if (access(fullpath, F_OK) == 0) {
-				return fullpath;
-			}
-			wfree(fullpath);
-		}
+		fullpath = findInPath(path_list[i], file);
+		if (fullpath)
+			return fullpath;
 	}
 
 	return NULL;
@@ -367,59 +617,26 @@ char *wfindfileinlist(char *const *path_list, const char *file)
 char *wfindfileinarray(WMPropList *array, const char *file)
 {
 	int i;
-	char *path;
-	int len, flen;
 	char *fullpath;
 
 	if (!file)
 		return NULL;
 
-	if (*file == '/' || *file == '~' || !array) {
-		if (access(file, F_OK) < 0) {
-			fullpath = wexpandpath(file);
-			if (!fullpath)
-				return NULL;
+	if (*file == '/' || *file == '~' || !array)
+		return findAbsoluteFile(file);
 
-			if (access(fullpath, F_OK) < 0) {
-				wfree(fullpath);
-				return NULL;
-			} else {
-				return fullpath;
-			}
-		} else {
-			return wstrdup(file);
-		}
-	}
+	updateSearchDirs();
 
-	flen = strlen(file);
 	for (i = 0; i < WMGetPropListItemCount(array); i++) {
 		WMPropList *prop;
-		char *p;
 
 		prop = WMGetFromPLArray(array, i);
-		if (!prop)
+		if (!prop || !WMIsPLString(prop))
 			continue;
-		p = WMGetFromPLString(prop);
 
-		len = strlen(p);
-		path = wmalloc(len + flen + 2);
-		path = memcpy(path, p, len);
-		path[len] = 0;
-		if (wstrlcat(path, "/", len + flen + 2) >= len + flen + 2 ||
-		    wstrlcat(path, file, len + flen + 2) >= len + flen + 2) {
-			wfree(path);
-			return NULL;
-		}
-		/* expand tilde */
-		fullpath = wexpandpath(path);
-		wfree(path);
-		if (fullpath) {
-			/* check if file exists */
-			if (access(fullpath, F_OK) == 0) {
-				return fullpath;
-			}
-			wfree(fullpath);
-		}
+		fullpath = findInPath(WMGetFromPLString(prop), file);
+		if (fullpath)
+			return fullpath;
 	}
 	return NULL;
 }
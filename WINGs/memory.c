@@ -30,6 +30,12 @@
 #include <assert.h>
 #include <signal.h>
 
+#ifdef USE_MEMORY_POOLS
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#endif
+
 #ifdef HAVE_STDNORETURN
 #include <stdnoreturn.h>
 #endif
@@ -77,12 +83,362 @@ static int Aborting = 0;	/* if we're in the middle of an emergency exit */
 
 static WMHashTable *table = NULL;
 
+#ifdef USE_MEMORY_POOLS
+/*
+ * The small blocks are handed out from pools of blocks of the same size,
+ * one set of pools per thread, so that the many little objects made and
+ * dropped all the time (hash items, timers, notifications, strings...)
+ * cost a few instructions instead of a trip through malloc(). The pools
+ * carve their blocks out of slabs taken from one big mapping, so telling
+ * whether wfree() got one of them is a comparison.
+ *
+ * A block freed by another thread than the one owning its slab is given
+ * back to the owner under its lock, and the pools of a thread that exited
+ * are adopted by the next thread that needs some. Slabs are never given
+ * back to the system.
+ *
+ * Setting WMALLOC_DEBUG in the environment bypasses the pools, so that
+ * every block comes from malloc() like before, for valgrind and the like.
+ */
+
+#define POOL_CLASSES	12
+#define POOL_MAX_SIZE	256
+
+#define SLAB_SHIFT	16
+#define SLAB_SIZE	(1 << SLAB_SHIFT)
+#define REGION_SIZE	((size_t)64 << 20)
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS	MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+# define MAP_NORESERVE	0
+#endif
+
+static const unsigned short classSizes[POOL_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256
+};
+
+typedef struct PoolBlock {
+	struct PoolBlock *next;
+} PoolBlock;
+
+typedef struct {
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long long bytes;	/* asked for */
+} PoolStats;
+
+typedef struct PoolCache {
+	struct PoolCache *next;		/* in the list of all the pools */
+	Bool orphan;			/* its thread exited */
+
+	PoolBlock *free[POOL_CLASSES];
+	char *carve[POOL_CLASSES];	/* what is left of the last slab */
+	char *end[POOL_CLASSES];
+
+	pthread_mutex_t lock;
+	PoolBlock *remote[POOL_CLASSES];	/* freed by other threads */
+
+	PoolStats stats[POOL_CLASSES + 1];	/* the last one for larger blocks */
+} PoolCache;
+
+typedef struct {
+	PoolCache *owner;
+	int sizeClass;
+} SlabInfo;
+
+static char *region = NULL;
+static size_t regionUsed = 0;
+static SlabInfo slabs[REGION_SIZE >> SLAB_SHIFT];
+static PoolCache *caches = NULL;
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t poolKey;
+
+static __thread PoolCache *threadCache = NULL;
+static __thread Bool threadChecked = False;
+
+static inline int sizeClass(size_t size)
+{
+	/* wmalloc(0) still returns a block of its own, of the smallest class */
+	if (size == 0)
+		return 0;
+
+	if (size <= 128)
+		return (size - 1) >> 4;
+
+	return 8 + ((size - 129) >> 5);
+}
+
+static inline Bool isPoolBlock(void *ptr)
+{
+	return region && (uintptr_t)((char *)ptr - region) < REGION_SIZE;
+}
+
+static inline SlabInfo *slabOf(void *ptr)
+{
+	return &slabs[((char *)ptr - region) >> SLAB_SHIFT];
+}
+
+static void orphanCache(void *data)
+{
+	PoolCache *cache = data;
+
+	/* what the thread still does on its way out goes to malloc() */
+	threadCache = NULL;
+
+	pthread_mutex_lock(&poolLock);
+	cache->orphan = True;
+	pthread_mutex_unlock(&poolLock);
+}
+
+/*
+ * A child made by fork() while another thread held one of the locks would
+ * find it locked forever, so they are all held across fork(), as malloc()
+ * does with its own. In the child, the pools of the threads that did not
+ * follow are left for the taking.
+ */
+static void forkPrepare(void)
+{
+	PoolCache *cache;
+
+	pthread_mutex_lock(&poolLock);
+	for (cache = caches; cache; cache = cache->next)
+		pthread_mutex_lock(&cache->lock);
+}
+
+static void forkParent(void)
+{
+	PoolCache *cache;
+
+	for (cache = caches; cache; cache = cache->next)
+		pthread_mutex_unlock(&cache->lock);
+	pthread_mutex_unlock(&poolLock);
+}
+
+static void forkChild(void)
+{
+	PoolCache *cache;
+
+	for (cache = caches; cache; cache = cache->next) {
+		pthread_mutex_unlock(&cache->lock);
+		if (cache != threadCache)
+			cache->orphan = True;
+	}
+	pthread_mutex_unlock(&poolLock);
+}
+
+static void initPools(void)
+{
+	void *map;
+
+	if (getenv("WMALLOC_DEBUG"))
+		return;
+
+	map = mmap(NULL, REGION_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (map == MAP_FAILED)
+		return;
+
+	if (pthread_key_create(&poolKey, orphanCache) != 0) {
+		munmap(map, REGION_SIZE);
+		return;
+	}
+
+	if (pthread_atfork(forkPrepare, forkParent, forkChild) != 0) {
+		pthread_key_delete(poolKey);
+		munmap(map, REGION_SIZE);
+		return;
+	}
+
+	region = map;
+}
+
+static PoolCache *getCache(void)
+{
+	PoolCache *cache;
+
+	if (threadChecked)
+		return threadCache;
+	threadChecked = True;
+
+	pthread_once(&poolOnce, initPools);
+	if (!region)
+		return NULL;
+
+	pthread_mutex_lock(&poolLock);
+	for (cache = caches; cache; cache = cache->next) {
+		if (cache->orphan) {
+			cache->orphan = False;
+			break;
+		}
+	}
+	if (!cache) {
+		cache = calloc(1, sizeof(PoolCache));
+		if (cache) {
+			pthread_mutex_init(&cache->lock, NULL);
+			cache->next = caches;
+			caches = cache;
+		}
+	}
+	pthread_mutex_unlock(&poolLock);
+
+	if (cache)
+		pthread_setspecific(poolKey, cache);
+
+	threadCache = cache;
+
+	return cache;
+}
+
+static Bool newSlab(PoolCache *cache, int class)
+{
+	char *slab = NULL;
+
+	pthread_mutex_lock(&poolLock);
+	if (regionUsed < REGION_SIZE) {
+		slab = region + regionUsed;
+		slabs[regionUsed >> SLAB_SHIFT].owner = cache;
+		slabs[regionUsed >> SLAB_SHIFT].sizeClass = class;
+		regionUsed += SLAB_SIZE;
+	}
+	pthread_mutex_unlock(&poolLock);
+
+	if (!slab)
+		return False;
+
+	cache->carve[class] = slab;
+	cache->end[class] = slab + SLAB_SIZE;
+
+	return True;
+}
+
+static PoolBlock *refill(PoolCache *cache, int class)
+{
+	PoolBlock *block;
+
+	if (cache->end[class] - cache->carve[class] < classSizes[class]) {
+		pthread_mutex_lock(&cache->lock);
+		block = cache->remote[class];
+		cache->remote[class] = NULL;
+		pthread_mutex_unlock(&cache->lock);
+
+		if (block) {
+			cache->free[class] = block->next;
+			return block;
+		}
+
+		if (!newSlab(cache, class))
+			return NULL;
+	}
+
+	block = (PoolBlock *)cache->carve[class];
+	cache->carve[class] += classSizes[class];
+
+	return block;
+}
+
+/* Returns NULL for what must come from malloc() */
+static void *poolAlloc(size_t size)
+{
+	PoolCache *cache = getCache();
+	PoolBlock *block;
+	int class;
+
+	if (!cache)
+		return NULL;
+
+	if (size > POOL_MAX_SIZE)
+		class = POOL_CLASSES;
+	else
+		class = sizeClass(size);
+
+	cache->stats[class].allocs++;
+	cache->stats[class].bytes += size;
+
+	if (class == POOL_CLASSES)
+		return NULL;
+
+	block = cache->free[class];
+	if (block) {
+		cache->free[class] = block->next;
+	} else {
+		block = refill(cache, class);
+		if (!block) {
+			/* the region is full, it will be counted as larger when freed */
+			cache->stats[class].allocs--;
+			cache->stats[class].bytes -= size;
+			cache->stats[POOL_CLASSES].allocs++;
+			cache->stats[POOL_CLASSES].bytes += size;
+			return NULL;
+		}
+	}
+
+	memset(block, 0, size);
+
+	return block;
+}
+
+/* Returns False for what must go to free() */
+static Bool poolFree(void *ptr)
+{
+	PoolCache *cache = getCache();
+	PoolBlock *block = ptr;
+	SlabInfo *slab;
+
+	if (!isPoolBlock(ptr)) {
+		if (cache)
+			cache->stats[POOL_CLASSES].frees++;
+		return False;
+	}
+
+	slab = slabOf(ptr);
+	if (cache)
+		cache->stats[slab->sizeClass].frees++;
+
+	if (slab->owner == cache) {
+		block->next = cache->free[slab->sizeClass];
+		cache->free[slab->sizeClass] = block;
+	} else {
+		pthread_mutex_lock(&slab->owner->lock);
+		block->next = slab->owner->remote[slab->sizeClass];
+		slab->owner->remote[slab->sizeClass] = block;
+		pthread_mutex_unlock(&slab->owner->lock);
+	}
+
+	return True;
+}
+
+static void *poolRealloc(void *ptr, size_t newsize)
+{
+	size_t size = classSizes[slabOf(ptr)->sizeClass];
+	void *nptr;
+
+	if (newsize <= size)
+		return ptr;
+
+	nptr = wmalloc(newsize);
+	memcpy(nptr, ptr, size);
+	poolFree(ptr);
+
+	return nptr;
+}
+#endif /* USE_MEMORY_POOLS */
+
 void *wmalloc(size_t size)
 {
 	void *tmp;
 
 	assert(size > 0);
 
+#ifdef USE_MEMORY_POOLS
+	tmp = poolAlloc(size);
+	if (tmp)
+		return tmp;
+#endif
+
 #ifdef USE_BOEHM_GC
 	tmp = GC_MALLOC(size);
 #else
@@ -120,6 +476,10 @@ void *wrealloc(void *ptr, size_t newsize)
 	} else if (newsize == 0) {
 		wfree(ptr);
 		nptr = NULL;
+#ifdef USE_MEMORY_POOLS
+	} else if (isPoolBlock(ptr)) {
+		nptr = poolRealloc(ptr, newsize);
+#endif
 	} else {
 #ifdef USE_BOEHM_GC
 		nptr = GC_REALLOC(ptr, newsize);
@@ -177,6 +537,11 @@ void *wretain(void *ptr)
 
 void wfree(void *ptr)
 {
+#ifdef USE_MEMORY_POOLS
+	if (ptr && poolFree(ptr))
+		return;
+#endif
+
 	if (ptr)
 #ifdef USE_BOEHM_GC
 		/* This should eventually be removed, once the criss-cross
@@ -220,3 +585,53 @@ void wrelease(void *ptr)
 #endif
 	}
 }
+
+void wmemstats(FILE *file)
+{
+#ifdef USE_MEMORY_POOLS
+	PoolStats total[POOL_CLASSES + 1];
+	PoolCache *cache;
+	int i, threads = 0;
+
+	getCache();
+	if (!region) {
+		fprintf(file, "memory pools not in use\n\n");
+		return;
+	}
+
+	memset(total, 0, sizeof(total));
+
+	pthread_mutex_lock(&poolLock);
+	for (cache = caches; cache; cache = cache->next) {
+		for (i = 0; i <= POOL_CLASSES; i++) {
+			total[i].allocs += cache->stats[i].allocs;
+			total[i].frees += cache->stats[i].frees;
+			total[i].bytes += cache->stats[i].bytes;
+		}
+		threads++;
+	}
+	fprintf(file, "memory pools of %d threads, %lu KiB in %lu slabs\n",
+		threads, (unsigned long)(regionUsed >> 10), (unsigned long)(regionUsed >> SLAB_SHIFT));
+	pthread_mutex_unlock(&poolLock);
+
+	fprintf(file, "%-10s %12s %12s %10s %10s\n", "size", "allocs", "frees", "live", "avg asked");
+	for (i = 0; i <= POOL_CLASSES; i++) {
+		if (total[i].allocs == 0 && total[i].frees == 0)
+			continue;
+
+		if (i < POOL_CLASSES)
+			fprintf(file, "%-10u ", classSizes[i]);
+		else
+			fprintf(file, "> %-8u ", POOL_MAX_SIZE);
+
+		/* the larger ones include what came from malloc() and went to wfree() */
+		fprintf(file, "%12lu %12lu %10ld %10.1f\n", total[i].allocs, total[i].frees,
+			(long)(total[i].allocs - total[i].frees),
+			total[i].allocs ? (double)total[i].bytes / total[i].allocs : 0.0);
+	}
+	fputc('\n', file);
+#else
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) file;
+#endif
+}
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "WUtil.h"
 #include "WINGsP.h"
@@ -62,36 +63,109 @@ WMNotification *WMRetainNotification(WMNotification * notification)
 
 /***************** Notification Center *****************/
 
+/*
+ * The names are interned, and the observers kept in buckets for each pair
+ * of name and object, so a post only looks at the observers it concerns:
+ * those of the name and object posted, of the name from any object, of
+ * any name from the object, and of everything. A name is looked up by
+ * pointer first, as it is normally the same constant when observed and
+ * posted, and only hashed when it is another copy of the string.
+ *
+ * The observers removed while a notification is being delivered are only
+ * marked, and freed once the outermost post is over.
+ *
+ * The handles given for the observers are numbers looked up in a table, and
+ * never given again, so that one can still be passed once the observer was
+ * removed in another way.
+ */
+
+typedef struct NotificationName {
+	const char *name;	/* the string it was interned with */
+	unsigned id;
+	struct ObserverBucket *buckets;	/* of all the objects, for the posts from none */
+} NotificationName;
+
+typedef struct {
+	unsigned name;		/* 0 for any name */
+	void *object;		/* NULL for any object */
+} BucketKey;
+
+typedef struct ObserverBucket {
+	BucketKey key;
+	NotificationName *name;
+	struct NotificationObserver *observers;
+
+	struct ObserverBucket *prev;	/* in the buckets of the name */
+	struct ObserverBucket *next;
+} ObserverBucket;
+
 typedef struct NotificationObserver {
 	WMNotificationObserverAction *observerAction;
 	void *observer;
+	uintptr_t id;		/* the handle given for it */
 
 	const char *name;
 	void *object;
 
-	struct NotificationObserver *prev;	/* for tables */
+	ObserverBucket *bucket;
+	struct NotificationObserver *prev;	/* in the bucket */
 	struct NotificationObserver *next;
-	struct NotificationObserver *nextAction;	/* for observerTable */
+	struct NotificationObserver *prevAction;	/* for observerTable */
+	struct NotificationObserver *nextAction;
+	struct NotificationObserver *nextRemoved;	/* while posting */
 } NotificationObserver;
 
 typedef struct W_NotificationCenter {
-	WMHashTable *nameTable;	/* names -> observer lists */
-	WMHashTable *objectTable;	/* object -> observer lists */
-	NotificationObserver *nilList;	/* obervers that catch everything */
+	WMHashTable *nameTable;	/* name strings -> NotificationName */
+	WMHashTable *namePointers;	/* the interned strings -> NotificationName */
+	WMHashTable *bucketTable;	/* (name id, object) -> ObserverBucket */
+	unsigned lastNameID;
 
 	WMHashTable *observerTable;	/* observer -> NotificationObserver */
+	WMHashTable *idTable;	/* handle -> NotificationObserver */
+	uintptr_t lastID;
+
+	int posting;		/* how deep posts are nested */
+	NotificationObserver *removed;	/* while posting, to free afterwards */
 } NotificationCenter;
 
 /* default (and only) center */
 static NotificationCenter *notificationCenter = NULL;
 
+static unsigned hashBucketKey(const void *param)
+{
+	const BucketKey *key = param;
+
+	return key->name * 31 + (unsigned)((size_t)key->object >> 3);
+}
+
+static Bool isEqualBucketKey(const void *param1, const void *param2)
+{
+	const BucketKey *key1 = param1;
+	const BucketKey *key2 = param2;
+
+	return key1->name == key2->name && key1->object == key2->object;
+}
+
+static const WMHashTableCallbacks BucketKeyHashCallbacks = {
+	hashBucketKey,
+	isEqualBucketKey,
+	NULL,
+	NULL
+};
+
 void W_InitNotificationCenter(void)
 {
 	notificationCenter = wmalloc(sizeof(NotificationCenter));
 	notificationCenter->nameTable = WMCreateHashTable(WMStringPointerHashCallbacks);
-	notificationCenter->objectTable = WMCreateHashTable(WMIntHashCallbacks);
-	notificationCenter->nilList = NULL;
+	notificationCenter->namePointers = WMCreateHashTable(WMIntHashCallbacks);
+	notificationCenter->bucketTable = WMCreateHashTable(BucketKeyHashCallbacks);
+	notificationCenter->lastNameID = 0;
 	notificationCenter->observerTable = WMCreateHashTable(WMIntHashCallbacks);
+	notificationCenter->idTable = WMCreateHashTable(WMIntHashCallbacks);
+	notificationCenter->lastID = 0;
+	notificationCenter->posting = 0;
+	notificationCenter->removed = NULL;
 }
 
 void W_ReleaseNotificationCenter(void)
@@ -99,256 +173,291 @@ void W_ReleaseNotificationCenter(void)
 	if (notificationCenter) {
 		if (notificationCenter->nameTable)
 			WMFreeHashTable(notificationCenter->nameTable);
-		if (notificationCenter->objectTable)
-			WMFreeHashTable(notificationCenter->objectTable);
+		if (notificationCenter->namePointers)
+			WMFreeHashTable(notificationCenter->namePointers);
+		if (notificationCenter->bucketTable)
+			WMFreeHashTable(notificationCenter->bucketTable);
 		if (notificationCenter->observerTable)
 			WMFreeHashTable(notificationCenter->observerTable);
+		if (notificationCenter->idTable)
+			WMFreeHashTable(notificationCenter->idTable);
 
 		wfree(notificationCenter);
 		notificationCenter = NULL;
 	}
 }
 
-void
+static NotificationName *getName(const char *name, Bool create)
+{
+	NotificationName *nPtr;
+
+	nPtr = WMHashGet(notificationCenter->namePointers, name);
+	if (nPtr)
+		return nPtr;
+
+	nPtr = WMHashGet(notificationCenter->nameTable, name);
+	if (nPtr || !create)
+		return nPtr;
+
+	nPtr = wmalloc(sizeof(NotificationName));
+	nPtr->name = name;
+	nPtr->id = ++notificationCenter->lastNameID;
+	WMHashInsert(notificationCenter->nameTable, nPtr->name, nPtr);
+	WMHashInsert(notificationCenter->namePointers, nPtr->name, nPtr);
+
+	return nPtr;
+}
+
+static ObserverBucket *getBucket(unsigned name, void *object)
+{
+	BucketKey key;
+
+	key.name = name;
+	key.object = object;
+
+	return WMHashGet(notificationCenter->bucketTable, &key);
+}
+
+static ObserverBucket *createBucket(NotificationName *name, void *object)
+{
+	ObserverBucket *bucket;
+
+	bucket = wmalloc(sizeof(ObserverBucket));
+	bucket->key.name = name ? name->id : 0;
+	bucket->key.object = object;
+	bucket->name = name;
+	WMHashInsert(notificationCenter->bucketTable, &bucket->key, bucket);
+
+	if (name) {
+		bucket->next = name->buckets;
+		if (name->buckets)
+			name->buckets->prev = bucket;
+		name->buckets = bucket;
+	}
+
+	return bucket;
+}
+
+static void freeBucket(ObserverBucket *bucket)
+{
+	NotificationName *name = bucket->name;
+
+	WMHashRemove(notificationCenter->bucketTable, &bucket->key);
+
+	if (name) {
+		if (bucket->prev)
+			bucket->prev->next = bucket->next;
+		else
+			name->buckets = bucket->next;
+		if (bucket->next)
+			bucket->next->prev = bucket->prev;
+
+		/* the string may not outlive its last observer */
+		if (!name->buckets) {
+			WMHashRemove(notificationCenter->nameTable, name->name);
+			WMHashRemove(notificationCenter->namePointers, name->name);
+			wfree(name);
+		}
+	}
+
+	wfree(bucket);
+}
+
+static void freeObserver(NotificationObserver *orec)
+{
+	ObserverBucket *bucket = orec->bucket;
+
+	if (orec->prev)
+		orec->prev->next = orec->next;
+	else
+		bucket->observers = orec->next;
+	if (orec->next)
+		orec->next->prev = orec->prev;
+
+	if (!bucket->observers)
+		freeBucket(bucket);
+
+	wfree(orec);
+}
+
+static void removeObserver(NotificationObserver *orec)
+{
+	/* take it out of the list of actions of the observer */
+	if (orec->prevAction) {
+		orec->prevAction->nextAction = orec->nextAction;
+	} else if (orec->nextAction) {
+		WMHashInsert(notificationCenter->observerTable, orec->observer, orec->nextAction);
+	} else {
+		WMHashRemove(notificationCenter->observerTable, orec->observer);
+	}
+	if (orec->nextAction)
+		orec->nextAction->prevAction = orec->prevAction;
+
+	WMHashRemove(notificationCenter->idTable, (void *)orec->id);
+
+	if (notificationCenter->posting > 0) {
+		/* it may be the next one to be told, leave it in its bucket */
+		orec->observerAction = NULL;
+		orec->nextRemoved = notificationCenter->removed;
+		notificationCenter->removed = orec;
+	} else {
+		freeObserver(orec);
+	}
+}
+
+WMHandlerID
 WMAddNotificationObserver(WMNotificationObserverAction * observerAction,
 			  void *observer, const char *name, void *object)
 {
 	NotificationObserver *oRec, *rec;
+	NotificationName *nPtr = NULL;
+	ObserverBucket *bucket;
 
 	oRec = wmalloc(sizeof(NotificationObserver));
 	oRec->observerAction = observerAction;
 	oRec->observer = observer;
 	oRec->name = name;
 	oRec->object = object;
-	oRec->next = NULL;
-	oRec->prev = NULL;
+
+	/* 0 is no handle */
+	if (++notificationCenter->lastID == 0)
+		++notificationCenter->lastID;
+	oRec->id = notificationCenter->lastID;
+	WMHashInsert(notificationCenter->idTable, (void *)oRec->id, oRec);
 
 	/* put this action in the list of actions for this observer */
 	rec = (NotificationObserver *) WMHashInsert(notificationCenter->observerTable, observer, oRec);
+	oRec->nextAction = rec;
+	if (rec)
+		rec->prevAction = oRec;
 
-	if (rec) {
-		/* if this is not the first action for the observer */
-		oRec->nextAction = rec;
-	} else {
-		oRec->nextAction = NULL;
-	}
+	if (name)
+		nPtr = getName(name, True);
 
-	if (!name && !object) {
-		/* catch-all */
-		oRec->next = notificationCenter->nilList;
-		if (notificationCenter->nilList) {
-			notificationCenter->nilList->prev = oRec;
-		}
-		notificationCenter->nilList = oRec;
-	} else if (!name) {
-		/* any message coming from object */
-		rec = (NotificationObserver *) WMHashInsert(notificationCenter->objectTable, object, oRec);
-		oRec->next = rec;
-		if (rec) {
-			rec->prev = oRec;
-		}
-	} else {
-		/* name && (object || !object) */
-		rec = (NotificationObserver *) WMHashInsert(notificationCenter->nameTable, name, oRec);
-		oRec->next = rec;
-		if (rec) {
-			rec->prev = oRec;
-		}
+	bucket = getBucket(nPtr ? nPtr->id : 0, object);
+	if (!bucket)
+		bucket = createBucket(nPtr, object);
+
+	oRec->bucket = bucket;
+	oRec->next = bucket->observers;
+	if (bucket->observers)
+		bucket->observers->prev = oRec;
+	bucket->observers = oRec;
+
+	return (WMHandlerID)oRec->id;
+}
+
+static void notifyBucket(ObserverBucket *bucket, WMNotification *notification)
+{
+	NotificationObserver *orec;
+
+	if (!bucket)
+		return;
+
+	/* the removed observers stay in the bucket until the post is over */
+	for (orec = bucket->observers; orec; orec = orec->next) {
+		if (orec->observerAction)
+			(*orec->observerAction) (orec->observer, notification);
 	}
 }
 
 void WMPostNotification(WMNotification * notification)
 {
-	NotificationObserver *orec, *tmp;
+	NotificationObserver *orec;
+	NotificationName *name;
+	ObserverBucket *bucket;
 
 	WMRetainNotification(notification);
+	notificationCenter->posting++;
 
 	/* tell the observers that want to know about a particular message */
-	orec = (NotificationObserver *) WMHashGet(notificationCenter->nameTable, notification->name);
-
-	while (orec) {
-		tmp = orec->next;
-
-		if (!orec->object || !notification->object || orec->object == notification->object) {
-			/* tell the observer */
-			if (orec->observerAction) {
-				(*orec->observerAction) (orec->observer, notification);
-			}
-		}
-
-		orec = tmp;
+	name = notification->name ? getName(notification->name, False) : NULL;
+	if (name && notification->object) {
+		notifyBucket(getBucket(name->id, notification->object), notification);
+		notifyBucket(getBucket(name->id, NULL), notification);
+	} else if (name) {
+		/* from no object in particular, for the observers of any object */
+		for (bucket = name->buckets; bucket; bucket = bucket->next)
+			notifyBucket(bucket, notification);
 	}
 
 	/* tell the observers that want to know about an object */
-	orec = (NotificationObserver *) WMHashGet(notificationCenter->objectTable, notification->object);
-
-	while (orec) {
-		tmp = orec->next;
-
-		/* tell the observer */
-		if (orec->observerAction) {
-			(*orec->observerAction) (orec->observer, notification);
-		}
-		orec = tmp;
-	}
+	if (notification->object)
+		notifyBucket(getBucket(0, notification->object), notification);
 
 	/* tell the catch all observers */
-	orec = notificationCenter->nilList;
-	while (orec) {
-		tmp = orec->next;
-
-		/* tell the observer */
-		if (orec->observerAction) {
-			(*orec->observerAction) (orec->observer, notification);
+	notifyBucket(getBucket(0, NULL), notification);
+
+	notificationCenter->posting--;
+	if (notificationCenter->posting == 0) {
+		while (notificationCenter->removed) {
+			orec = notificationCenter->removed;
+			notificationCenter->removed = orec->nextRemoved;
+			freeObserver(orec);
 		}
-		orec = tmp;
 	}
 
 	WMReleaseNotification(notification);
 }
 
+void WMDeleteNotificationObserver(WMHandlerID handlerID)
+{
+	NotificationObserver *orec;
+
+	/* nothing if it was already removed */
+	orec = (NotificationObserver *) WMHashGet(notificationCenter->idTable, handlerID);
+	if (orec)
+		removeObserver(orec);
+}
+
 void WMRemoveNotificationObserver(void *observer)
 {
-	NotificationObserver *orec, *tmp, *rec;
+	NotificationObserver *orec;
 
 	/* get the list of actions the observer is doing */
 	orec = (NotificationObserver *) WMHashGet(notificationCenter->observerTable, observer);
 
-	/*
-	 * FOREACH orec IN actionlist for observer
-	 * DO
-	 *   remove from respective lists/tables
-	 *   free
-	 * END
-	 */
 	while (orec) {
-		tmp = orec->nextAction;
-
-		if (!orec->name && !orec->object) {
-			/* catch-all */
-			if (notificationCenter->nilList == orec)
-				notificationCenter->nilList = orec->next;
-		} else if (!orec->name) {
-			/* any message coming from object */
-			rec = (NotificationObserver *) WMHashGet(notificationCenter->objectTable, orec->object);
-			if (rec == orec) {
-				/* replace table entry */
-				if (orec->next) {
-					WMHashInsert(notificationCenter->objectTable, orec->object, orec->next);
-				} else {
-					WMHashRemove(notificationCenter->objectTable, orec->object);
-				}
-			}
-		} else {
-			/* name && (object || !object) */
-			rec = (NotificationObserver *) WMHashGet(notificationCenter->nameTable, orec->name);
-			if (rec == orec) {
-				/* replace table entry */
-				if (orec->next) {
-					WMHashInsert(notificationCenter->nameTable, orec->name, orec->next);
-				} else {
-					WMHashRemove(notificationCenter->nameTable, orec->name);
-				}
-			}
-		}
-		if (orec->prev)
-			orec->prev->next = orec->next;
-		if (orec->next)
-			orec->next->prev = orec->prev;
-
-		wfree(orec);
-
-		orec = tmp;
+		removeObserver(orec);
+		orec = (NotificationObserver *) WMHashGet(notificationCenter->observerTable, observer);
 	}
-
-	WMHashRemove(notificationCenter->observerTable, observer);
 }
 
 void WMRemoveNotificationObserverWithName(void *observer, const char *name, void *object)
 {
-	NotificationObserver *orec, *tmp, *rec;
-	NotificationObserver *newList = NULL;
+	NotificationObserver *orec, *tmp;
+	NotificationName *nPtr = NULL;
+
+	if (name) {
+		nPtr = getName(name, False);
+		if (!nPtr)
+			return;
+	}
 
 	/* get the list of actions the observer is doing */
 	orec = (NotificationObserver *) WMHashGet(notificationCenter->observerTable, observer);
 
-	WMHashRemove(notificationCenter->observerTable, observer);
-
-	/* rebuild the list of actions for the observer */
-
 	while (orec) {
 		tmp = orec->nextAction;
-		if (orec->name == name && orec->object == object) {
-			if (!name && !object) {
-				if (notificationCenter->nilList == orec)
-					notificationCenter->nilList = orec->next;
-			} else if (!name) {
-				rec =
-				    (NotificationObserver *) WMHashGet(notificationCenter->objectTable,
-								       orec->object);
-				if (rec == orec) {
-					assert(rec->prev == NULL);
-					/* replace table entry */
-					if (orec->next) {
-						WMHashInsert(notificationCenter->objectTable,
-							     orec->object, orec->next);
-					} else {
-						WMHashRemove(notificationCenter->objectTable, orec->object);
-					}
-				}
-			} else {
-				rec = (NotificationObserver *) WMHashGet(notificationCenter->nameTable,
-									 orec->name);
-				if (rec == orec) {
-					assert(rec->prev == NULL);
-					/* replace table entry */
-					if (orec->next) {
-						WMHashInsert(notificationCenter->nameTable,
-							     orec->name, orec->next);
-					} else {
-						WMHashRemove(notificationCenter->nameTable, orec->name);
-					}
-				}
-			}
-
-			if (orec->prev)
-				orec->prev->next = orec->next;
-			if (orec->next)
-				orec->next->prev = orec->prev;
-			wfree(orec);
-		} else {
-			/* append this action in the new action list */
-			orec->nextAction = NULL;
-			if (!newList) {
-				newList = orec;
-			} else {
-				NotificationObserver *p;
-
-				p = newList;
-				while (p->nextAction) {
-					p = p->nextAction;
-				}
-				p->nextAction = orec;
-			}
-		}
-		orec = tmp;
-	}
 
-	/* reinsert the list to the table */
-	if (newList) {
-		WMHashInsert(notificationCenter->observerTable, observer, newList);
+		if (orec->bucket->name == nPtr && orec->object == object)
+			removeObserver(orec);
+
+		orec = tmp;
 	}
 }
 
 void WMPostNotificationName(const char *name, void *object, void *clientData)
 {
-	WMNotification *notification;
-
-	notification = WMCreateNotification(name, object, clientData);
+	Notification notification;
 
-	WMPostNotification(notification);
+	/* the observers do not keep it, so it can live on the stack */
+	notification.name = name;
+	notification.object = object;
+	notification.clientData = clientData;
+	notification.refCount = 1;
 
-	WMReleaseNotification(notification);
+	WMPostNotification(&notification);
 }
 
 /**************** Notification Queues ****************/
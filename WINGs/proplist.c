@@ -4,17 +4,24 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <ftw.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "WUtil.h"
 #include "wconfig.h"
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 typedef enum {
 	WPLString = 0x57504c01,
 	WPLData = 0x57504c02,
@@ -22,6 +29,43 @@ typedef enum {
 	WPLDictionary = 0x57504c04
 } WPLType;
 
+/*
+ * Memory the nodes and strings of a document are taken from, when it is
+ * read with arenas on. The nodes are not freed one by one when they are
+ * released, but all at once with the arena when the last one is.
+ *
+ * Nothing of another arena is put in a container of the document, it is
+ * copied instead, so the document only holds its own nodes unless a
+ * container of the heap was put in it. When its root is released for the
+ * last time while no other node is retained from the outside, nothing can
+ * reach the document anymore: the storage of its arrays, dictionaries and
+ * data is freed in one pass, with the arena, instead of walking the tree.
+ */
+typedef struct PLArenaBlock {
+	struct PLArenaBlock *next;
+	size_t used;
+	size_t size;
+} PLArenaBlock;
+
+/* the nodes of an arena holding memory of the heap */
+typedef struct PLArenaOwner {
+	struct W_PropList *plist;
+	struct PLArenaOwner *next;
+} PLArenaOwner;
+
+typedef struct PLArena {
+	PLArenaBlock *blocks;
+	unsigned live;		/* nodes not released yet, and the reader */
+
+	struct W_PropList *root;	/* the document, once it was read */
+	unsigned pins;		/* retains of its other nodes from the outside */
+	Bool mixed;		/* holds containers of the heap */
+	PLArenaOwner *owners;
+} PLArena;
+
+#define ARENA_BLOCK_SIZE	(32 * 1024)
+#define ARENA_ALIGN(size)	(((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
 typedef struct W_PropList {
 	WPLType type;
 
@@ -33,6 +77,8 @@ typedef struct W_PropList {
 	} d;
 
 	int retainCount;
+
+	PLArena *arena;		/* NULL if it is allocated on its own */
 } W_PropList;
 
 typedef struct PLData {
@@ -40,6 +86,7 @@ typedef struct PLData {
 	int pos;
 	const char *filename;
 	int lineNumber;
+	PLArena *arena;
 } PLData;
 
 typedef struct StringBuffer {
@@ -47,7 +94,17 @@ typedef struct StringBuffer {
 	int size;
 } StringBuffer;
 
+/* where descriptions are written, in one pass */
+typedef struct PLWriter {
+	FILE *file;		/* if NULL, into str */
+	char *str;
+	size_t length;
+	size_t size;
+	Bool failed;
+} PLWriter;
+
 static unsigned hashPropList(const void *param);
+static WMPropList *retainPropListByCount(WMPropList * plist, int count);
 static WMPropList *getPLString(PLData * pldata);
 static WMPropList *getPLQString(PLData * pldata);
 static WMPropList *getPLData(PLData * pldata);
@@ -66,6 +123,10 @@ static const WMHashTableCallbacks WMPropListHashCallbacks = {
 
 static Bool caseSensitive = True;
 
+static Bool sortKeys = False;
+
+static Bool useArenas = False;
+
 #define BUFFERSIZE           8192
 #define BUFFERSIZE_INCREMENT 1024
 
@@ -139,6 +200,210 @@ static unsigned hashPropList(const void *param)
 	return ret;
 }
 
+static PLArena *createArena(void)
+{
+	PLArena *arena;
+
+	if (!useArenas)
+		return NULL;
+
+	arena = wmalloc(sizeof(PLArena));
+	arena->live = 1;
+
+	return arena;
+}
+
+static void *arenaAlloc(PLArena * arena, size_t size)
+{
+	PLArenaBlock *block = arena->blocks;
+	void *ptr;
+
+	size = ARENA_ALIGN(size);
+
+	if (!block || block->size - block->used < size) {
+		size_t blockSize = ARENA_ALIGN(sizeof(PLArenaBlock)) + WMAX(size, ARENA_BLOCK_SIZE);
+
+		block = wmalloc(blockSize);
+		block->used = ARENA_ALIGN(sizeof(PLArenaBlock));
+		block->size = blockSize;
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	ptr = (char *)block + block->used;
+	block->used += size;
+
+	return ptr;
+}
+
+static void destroyArena(PLArena * arena)
+{
+	PLArenaBlock *block, *next;
+
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		wfree(block);
+	}
+	wfree(arena);
+}
+
+static void releaseArena(PLArena * arena)
+{
+	if (arena && --arena->live == 0)
+		destroyArena(arena);
+}
+
+/* for the readers, once they are done with the document */
+static void closeArena(PLArena * arena, WMPropList * root)
+{
+	if (arena && root)
+		arena->root = root;
+	releaseArena(arena);
+}
+
+/* when nothing but the root of the document could reach its nodes */
+static void releaseArenaDocument(PLArena * arena)
+{
+	PLArenaOwner *owner;
+	WMPropList *plist;
+
+	for (owner = arena->owners; owner; owner = owner->next) {
+		plist = owner->plist;
+		/* the ones released already were freed then */
+		if (plist->retainCount < 1)
+			continue;
+
+		switch (plist->type) {
+		case WPLData:
+			WMReleaseData(plist->d.data);
+			break;
+		case WPLArray:
+			WMFreeArray(plist->d.array);
+			break;
+		case WPLDictionary:
+			WMFreeHashTable(plist->d.dict);
+			break;
+		default:
+			break;
+		}
+	}
+
+	destroyArena(arena);
+}
+
+static WMPropList *createPropList(PLArena * arena, WPLType type)
+{
+	WMPropList *plist;
+
+	if (arena) {
+		plist = arenaAlloc(arena, sizeof(W_PropList));
+		memset(plist, 0, sizeof(W_PropList));
+		plist->arena = arena;
+		arena->live++;
+
+		if (type != WPLString) {
+			PLArenaOwner *owner = arenaAlloc(arena, sizeof(PLArenaOwner));
+
+			owner->plist = plist;
+			owner->next = arena->owners;
+			arena->owners = owner;
+		}
+	} else {
+		plist = wmalloc(sizeof(W_PropList));
+	}
+	plist->type = type;
+	plist->retainCount = 1;
+
+	return plist;
+}
+
+static WMPropList *createPLString(PLArena * arena, const char *str)
+{
+	WMPropList *plist;
+	size_t length;
+
+	plist = createPropList(arena, WPLString);
+	if (arena) {
+		length = strlen(str) + 1;
+		plist->d.string = memcpy(arenaAlloc(arena, length), str, length);
+	} else {
+		plist->d.string = wstrdup(str);
+	}
+
+	return plist;
+}
+
+/* for the nodes that are released, after what they hold was */
+static void freePropList(WMPropList * plist)
+{
+	if (plist->arena) {
+		releaseArena(plist->arena);
+		return;
+	}
+
+	if (plist->type == WPLString)
+		wfree(plist->d.string);
+	wfree(plist);
+}
+
+/* a copy of the tree in the arena, with all of its nodes retained `count' times */
+static WMPropList *copyPropList(PLArena * arena, WMPropList * plist, int count)
+{
+	WMPropList *copy, *key, *value;
+	WMHashEnumerator e;
+	int i;
+
+	switch (plist->type) {
+	case WPLString:
+		copy = createPLString(arena, plist->d.string);
+		break;
+	case WPLData:
+		copy = createPropList(arena, WPLData);
+		copy->d.data = WMRetainData(plist->d.data);
+		break;
+	case WPLArray:
+		copy = createPropList(arena, WPLArray);
+		copy->d.array = WMCreateArray(WMGetArrayItemCount(plist->d.array));
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++)
+			WMAddToArray(copy->d.array, copyPropList(arena, WMGetFromArray(plist->d.array, i), count));
+		break;
+	case WPLDictionary:
+		copy = createPropList(arena, WPLDictionary);
+		copy->d.dict = WMCreateHashTable(WMPropListHashCallbacks);
+		e = WMEnumerateHashTable(plist->d.dict);
+		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key))
+			WMHashInsert(copy->d.dict, copyPropList(arena, key, count), copyPropList(arena, value, count));
+		break;
+	default:
+		wwarning(_("Used proplist functions on non-WMPropLists objects"));
+		wassertrv(False, NULL);
+		break;
+	}
+	copy->retainCount = count;
+
+	return copy;
+}
+
+/*
+ * Returns what a container must hold to have `item' retained `count'
+ * times. What comes from another arena is copied, so that no document
+ * keeps the arena of another one alive, and so are the strings and data
+ * put in a document. Arrays and dictionaries of the heap are kept as they
+ * are, so they can still be changed through `item', but the document they
+ * are put in is then released node by node.
+ */
+static WMPropList *adoptPropList(WMPropList * container, WMPropList * item, int count)
+{
+	if (item->arena != container->arena) {
+		if (item->arena || item->type == WPLString || item->type == WPLData)
+			return copyPropList(container->arena, item, count);
+
+		container->arena->mixed = True;
+	}
+
+	return retainPropListByCount(item, count);
+}
+
 static WMPropList *retainPropListByCount(WMPropList * plist, int count)
 {
 	WMPropList *key, *value;
@@ -182,15 +447,13 @@ static void releasePropListByCount(WMPropList * plist, int count)
 
 	switch (plist->type) {
 	case WPLString:
-		if (plist->retainCount < 1) {
-			wfree(plist->d.string);
-			wfree(plist);
-		}
+		if (plist->retainCount < 1)
+			freePropList(plist);
 		break;
 	case WPLData:
 		if (plist->retainCount < 1) {
 			WMReleaseData(plist->d.data);
-			wfree(plist);
+			freePropList(plist);
 		}
 		break;
 	case WPLArray:
@@ -199,7 +462,7 @@ static void releasePropListByCount(WMPropList * plist, int count)
 		}
 		if (plist->retainCount < 1) {
 			WMFreeArray(plist->d.array);
-			wfree(plist);
+			freePropList(plist);
 		}
 		break;
 	case WPLDictionary:
@@ -210,7 +473,7 @@ static void releasePropListByCount(WMPropList * plist, int count)
 		}
 		if (plist->retainCount < 1) {
 			WMFreeHashTable(plist->d.dict);
-			wfree(plist);
+			freePropList(plist);
 		}
 		break;
 	default:
@@ -220,51 +483,86 @@ static void releasePropListByCount(WMPropList * plist, int count)
 	}
 }
 
-static char *dataDescription(WMPropList * plist)
+/* width up to which arrays are written on a single line */
+#define DESCRIPTION_WIDTH	77
+
+static void writeChars(PLWriter * writer, const char *chars, size_t length)
+{
+	if (writer->file) {
+		if (fwrite(chars, 1, length, writer->file) != length)
+			writer->failed = True;
+		return;
+	}
+
+	if (writer->length + length >= writer->size) {
+		writer->size = 2 * (writer->length + length) + 64;
+		writer->str = wrealloc(writer->str, writer->size);
+	}
+	memcpy(writer->str + writer->length, chars, length);
+	writer->length += length;
+}
+
+static inline void writeString(PLWriter * writer, const char *str)
+{
+	writeChars(writer, str, strlen(str));
+}
+
+static void writeIndent(PLWriter * writer, int count)
+{
+	static const char spaces[] = "                                ";
+
+	while (count > 0) {
+		int n = count < sizeof(spaces) - 1 ? count : sizeof(spaces) - 1;
+
+		writeChars(writer, spaces, n);
+		count -= n;
+	}
+}
+
+static int dataDescriptionLength(WMPropList * plist)
+{
+	int length = WMGetDataLength(plist->d.data);
+
+	/* 2 digits a byte, a space between 32-bit ints and the <> */
+	return 2 * length + (length > 0 ? (length - 1) / 4 : 0) + 2;
+}
+
+static void writeDataDescription(PLWriter * writer, WMPropList * plist)
 {
 	const unsigned char *data;
-	char *retVal;
+	char buffer[64];
 	int i, j, length;
 
 	data = WMDataBytes(plist->d.data);
 	length = WMGetDataLength(plist->d.data);
 
-	retVal = (char *)wmalloc(2 * length + length / 4 + 3);
-
-	retVal[0] = '<';
+	buffer[0] = '<';
 	for (i = 0, j = 1; i < length; i++) {
-		retVal[j++] = num2char((data[i] >> 4) & 0x0f);
-		retVal[j++] = num2char(data[i] & 0x0f);
+		buffer[j++] = num2char((data[i] >> 4) & 0x0f);
+		buffer[j++] = num2char(data[i] & 0x0f);
 		if ((i & 0x03) == 3 && i != length - 1) {
 			/* if we've just finished a 32-bit int, add a space */
-			retVal[j++] = ' ';
+			buffer[j++] = ' ';
+		}
+		if (j > sizeof(buffer) - 4) {
+			writeChars(writer, buffer, j);
+			j = 0;
 		}
 	}
-	retVal[j++] = '>';
-	retVal[j] = '\0';
-
-	return retVal;
+	buffer[j++] = '>';
+	writeChars(writer, buffer, j);
 }
 
-static char *stringDescription(WMPropList * plist)
+/* stops counting once past limit */
+static int stringDescriptionLength(const char *str, int limit)
 {
-	const char *str;
-	char *retVal, *sPtr, *dPtr;
-	int len, quote;
 	unsigned char ch;
+	int len = 0, quote = 0;
 
-	str = plist->d.string;
-
-	if (strlen(str) == 0) {
-		return wstrdup("\"\"");
-	}
-
-	/* FIXME: make this work with unichars. */
+	if (*str == 0)
+		return 2;
 
-	quote = 0;
-	sPtr = (char *)str;
-	len = 0;
-	while ((ch = *sPtr)) {
+	while ((ch = *str++) && len <= limit) {
 		if (!noquote(ch)) {
 			quote = 1;
 			if (charesc(ch))
@@ -272,195 +570,260 @@ static char *stringDescription(WMPropList * plist)
 			else if (numesc(ch))
 				len += 3;
 		}
-		sPtr++;
 		len++;
 	}
 
-	if (quote)
-		len += 2;
+	return quote ? len + 2 : len;
+}
+
+static void writeStringDescription(PLWriter * writer, WMPropList * plist)
+{
+	const unsigned char *str, *sPtr;
+	char buffer[64];
+	int len, quote;
+	unsigned char ch;
 
-	retVal = (char *)wmalloc(len + 1);
+	str = (const unsigned char *)plist->d.string;
 
-	sPtr = (char *)str;
-	dPtr = retVal;
+	if (*str == 0) {
+		writeChars(writer, "\"\"", 2);
+		return;
+	}
 
-	if (quote)
-		*dPtr++ = '"';
+	/* FIXME: make this work with unichars. */
+
+	quote = 0;
+	for (sPtr = str; *sPtr; sPtr++) {
+		if (!noquote(*sPtr)) {
+			quote = 1;
+			break;
+		}
+	}
+
+	if (!quote) {
+		writeChars(writer, (const char *)str, strlen((const char *)str));
+		return;
+	}
+
+	len = 0;
+	buffer[len++] = '"';
+
+	for (sPtr = str; (ch = *sPtr); sPtr++) {
+		if (len > sizeof(buffer) - 5) {
+			writeChars(writer, buffer, len);
+			len = 0;
+		}
 
-	while ((ch = *sPtr)) {
 		if (charesc(ch)) {
-			*(dPtr++) = '\\';
+			buffer[len++] = '\\';
 			switch (ch) {
 			case '\a':
-				*dPtr = 'a';
+				buffer[len++] = 'a';
 				break;
 			case '\b':
-				*dPtr = 'b';
+				buffer[len++] = 'b';
 				break;
 			case '\t':
-				*dPtr = 't';
+				buffer[len++] = 't';
 				break;
 			case '\n':
-				*dPtr = 'n';
+				buffer[len++] = 'n';
 				break;
 			case '\v':
-				*dPtr = 'v';
+				buffer[len++] = 'v';
 				break;
 			case '\f':
-				*dPtr = 'f';
+				buffer[len++] = 'f';
 				break;
 			default:
-				*dPtr = ch;	/* " or \ */
+				buffer[len++] = ch;	/* " or \ */
 			}
 		} else if (numesc(ch)) {
-			*(dPtr++) = '\\';
-			*(dPtr++) = '0' + ((ch >> 6) & 07);
-			*(dPtr++) = '0' + ((ch >> 3) & 07);
-			*dPtr = '0' + (ch & 07);
+			buffer[len++] = '\\';
+			buffer[len++] = '0' + ((ch >> 6) & 07);
+			buffer[len++] = '0' + ((ch >> 3) & 07);
+			buffer[len++] = '0' + (ch & 07);
 		} else {
-			*dPtr = ch;
+			buffer[len++] = ch;
 		}
-		sPtr++;
-		dPtr++;
 	}
 
-	if (quote)
-		*dPtr++ = '"';
+	buffer[len++] = '"';
+	writeChars(writer, buffer, len);
+}
+
+static int compareKeys(const void *a, const void *b)
+{
+	const W_PropList *k1 = ((const WMPropList **)a)[0];
+	const W_PropList *k2 = ((const WMPropList **)b)[0];
+
+	/* keys other than strings are unusual, they go after the strings */
+	if (k1->type != k2->type)
+		return (k1->type < k2->type) ? -1 : 1;
 
-	*dPtr = '\0';
+	if (k1->type == WPLString)
+		return strcmp(k1->d.string, k2->d.string);
 
-	return retVal;
+	return 0;
 }
 
-static char *description(WMPropList * plist)
+/*
+ * The entries of a dictionary in the order they are to be written, as
+ * key and value pairs.
+ */
+static WMPropList **dictionaryEntries(WMPropList * plist, int *count)
+{
+	WMPropList **entries, *key, *val;
+	WMHashEnumerator e;
+	int i = 0;
+
+	*count = WMCountHashTable(plist->d.dict);
+	entries = wmalloc((2 * *count + 1) * sizeof(WMPropList *));
+
+	e = WMEnumerateHashTable(plist->d.dict);
+	while (i < *count && WMNextHashEnumeratorItemAndKey(&e, (void **)&val, (void **)&key)) {
+		entries[2 * i] = key;
+		entries[2 * i + 1] = val;
+		i++;
+	}
+	*count = i;
+
+	if (sortKeys)
+		qsort(entries, i, 2 * sizeof(WMPropList *), compareKeys);
+
+	return entries;
+}
+
+/*
+ * Takes the length of the single line description of plist from *room,
+ * returning False as soon as it does not fit.
+ */
+static Bool descriptionFits(WMPropList * plist, int *room)
 {
 	WMPropList *key, *val;
-	char *retstr = NULL;
-	char *str, *tmp, *skey, *sval;
 	WMHashEnumerator e;
-	int i;
+	int i, count;
 
 	switch (plist->type) {
 	case WPLString:
-		retstr = stringDescription(plist);
+		*room -= stringDescriptionLength(plist->d.string, *room);
 		break;
 	case WPLData:
-		retstr = dataDescription(plist);
+		*room -= dataDescriptionLength(plist);
 		break;
 	case WPLArray:
-		retstr = wstrdup("(");
-		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++) {
-			str = description(WMGetFromArray(plist->d.array, i));
-			if (i == 0) {
-				retstr = wstrappend(retstr, str);
-			} else {
-				tmp = (char *)wmalloc(strlen(retstr) + strlen(str) + 3);
-				sprintf(tmp, "%s, %s", retstr, str);
-				wfree(retstr);
-				retstr = tmp;
-			}
-			wfree(str);
+		count = WMGetArrayItemCount(plist->d.array);
+		*room -= 2 + (count > 0 ? 2 * (count - 1) : 0);
+		for (i = 0; i < count && *room >= 0; i++) {
+			if (!descriptionFits(WMGetFromArray(plist->d.array, i), room))
+				return False;
 		}
-		retstr = wstrappend(retstr, ")");
 		break;
 	case WPLDictionary:
-		retstr = wstrdup("{");
+		*room -= 2;
 		e = WMEnumerateHashTable(plist->d.dict);
-		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&val, (void **)&key)) {
-			skey = description(key);
-			sval = description(val);
-			tmp = (char *)wmalloc(strlen(retstr) + strlen(skey) + strlen(sval) + 5);
-			sprintf(tmp, "%s%s = %s;", retstr, skey, sval);
-			wfree(skey);
-			wfree(sval);
-			wfree(retstr);
-			retstr = tmp;
-		}
-		retstr = wstrappend(retstr, "}");
-		break;
-	default:
-		wwarning(_("Used proplist functions on non-WMPropLists objects"));
-		wassertrv(False, NULL);
+		while (*room >= 0 && WMNextHashEnumeratorItemAndKey(&e, (void **)&val, (void **)&key)) {
+			*room -= 4;
+			if (!descriptionFits(key, room) || !descriptionFits(val, room))
+				return False;
+		}
 		break;
 	}
 
-	return retstr;
+	return *room >= 0;
 }
 
-static char *indentedDescription(WMPropList * plist, int level)
+static void writeDescription(PLWriter * writer, WMPropList * plist)
 {
-	WMPropList *key, *val;
-	char *retstr = NULL;
-	char *str, *tmp, *skey, *sval;
-	WMHashEnumerator e;
-	int i;
+	WMPropList **entries;
+	int i, count;
 
-	if (plist->type == WPLArray /* || plist->type==WPLDictionary */ ) {
-		retstr = description(plist);
-
-		if (retstr && ((2 * (level + 1) + strlen(retstr)) <= 77)) {
-			return retstr;
-		} else if (retstr) {
-			wfree(retstr);
-			retstr = NULL;
+	switch (plist->type) {
+	case WPLString:
+		writeStringDescription(writer, plist);
+		break;
+	case WPLData:
+		writeDataDescription(writer, plist);
+		break;
+	case WPLArray:
+		writeChars(writer, "(", 1);
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++) {
+			if (i > 0)
+				writeChars(writer, ", ", 2);
+			writeDescription(writer, WMGetFromArray(plist->d.array, i));
+		}
+		writeChars(writer, ")", 1);
+		break;
+	case WPLDictionary:
+		writeChars(writer, "{", 1);
+		entries = dictionaryEntries(plist, &count);
+		for (i = 0; i < count; i++) {
+			writeDescription(writer, entries[2 * i]);
+			writeChars(writer, " = ", 3);
+			writeDescription(writer, entries[2 * i + 1]);
+			writeChars(writer, ";", 1);
 		}
+		wfree(entries);
+		writeChars(writer, "}", 1);
+		break;
+	default:
+		wwarning(_("Used proplist functions on non-WMPropLists objects"));
+		writer->failed = True;
+		wassertr(False);
+		break;
 	}
+}
+
+static void writeIndentedDescription(PLWriter * writer, WMPropList * plist, int level)
+{
+	WMPropList **entries;
+	int i, count, room;
 
 	switch (plist->type) {
 	case WPLString:
-		retstr = stringDescription(plist);
+		writeStringDescription(writer, plist);
 		break;
 	case WPLData:
-		retstr = dataDescription(plist);
+		writeDataDescription(writer, plist);
 		break;
 	case WPLArray:
-		retstr = wstrdup("(\n");
+		room = DESCRIPTION_WIDTH - 2 * (level + 1);
+		if (room >= 0 && descriptionFits(plist, &room)) {
+			writeDescription(writer, plist);
+			break;
+		}
+
+		writeChars(writer, "(\n", 2);
 		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++) {
-			str = indentedDescription(WMGetFromArray(plist->d.array, i), level + 1);
-			if (i == 0) {
-				tmp = (char *)wmalloc(2 * (level + 1) + strlen(retstr) + strlen(str) + 1);
-				sprintf(tmp, "%s%*s%s", retstr, 2 * (level + 1), "", str);
-				wfree(retstr);
-				retstr = tmp;
-			} else {
-				tmp = (char *)wmalloc(2 * (level + 1) + strlen(retstr) + strlen(str) + 3);
-				sprintf(tmp, "%s,\n%*s%s", retstr, 2 * (level + 1), "", str);
-				wfree(retstr);
-				retstr = tmp;
-			}
-			wfree(str);
+			if (i > 0)
+				writeChars(writer, ",\n", 2);
+			writeIndent(writer, 2 * (level + 1));
+			writeIndentedDescription(writer, WMGetFromArray(plist->d.array, i), level + 1);
 		}
-		tmp = (char *)wmalloc(strlen(retstr) + 2 * level + 3);
-		sprintf(tmp, "%s\n%*s)", retstr, 2 * level, "");
-		wfree(retstr);
-		retstr = tmp;
+		writeChars(writer, "\n", 1);
+		writeIndent(writer, 2 * level);
+		writeChars(writer, ")", 1);
 		break;
 	case WPLDictionary:
-		retstr = wstrdup("{\n");
-		e = WMEnumerateHashTable(plist->d.dict);
-		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&val, (void **)&key)) {
-			skey = indentedDescription(key, level + 1);
-			sval = indentedDescription(val, level + 1);
-			tmp = (char *)wmalloc(2 * (level + 1) + strlen(retstr) + strlen(skey)
-					      + strlen(sval) + 6);
-			sprintf(tmp, "%s%*s%s = %s;\n", retstr, 2 * (level + 1), "", skey, sval);
-			wfree(skey);
-			wfree(sval);
-			wfree(retstr);
-			retstr = tmp;
-		}
-		tmp = (char *)wmalloc(strlen(retstr) + 2 * level + 2);
-		sprintf(tmp, "%s%*s}", retstr, 2 * level, "");
-		wfree(retstr);
-		retstr = tmp;
+		writeChars(writer, "{\n", 2);
+		entries = dictionaryEntries(plist, &count);
+		for (i = 0; i < count; i++) {
+			writeIndent(writer, 2 * (level + 1));
+			writeIndentedDescription(writer, entries[2 * i], level + 1);
+			writeChars(writer, " = ", 3);
+			writeIndentedDescription(writer, entries[2 * i + 1], level + 1);
+			writeChars(writer, ";\n", 2);
+		}
+		wfree(entries);
+		writeIndent(writer, 2 * level);
+		writeChars(writer, "}", 1);
 		break;
 	default:
 		wwarning(_("Used proplist functions on non-WMPropLists objects"));
-		wassertrv(False, NULL);
+		writer->failed = True;
+		wassertr(False);
 		break;
 	}
-
-	return retstr;
 }
 
 static inline int getChar(PLData * pldata)
@@ -597,7 +960,7 @@ static WMPropList *getPLString(PLData * pldata)
 		plist = NULL;
 	} else {
 		char *tmp = unescapestr(sBuf.str);
-		plist = WMCreatePLString(tmp);
+		plist = createPLString(pldata->arena, tmp);
 		wfree(tmp);
 	}
 
@@ -647,7 +1010,7 @@ static WMPropList *getPLQString(PLData * pldata)
 		plist = NULL;
 	} else {
 		char *tmp = unescapestr(sBuf.str);
-		plist = WMCreatePLString(tmp);
+		plist = createPLString(pldata->arena, tmp);
 		wfree(tmp);
 	}
 
@@ -709,8 +1072,8 @@ static WMPropList *getPLData(PLData * pldata)
 	if (len > 0)
 		WMAppendDataBytes(data, buf, len);
 
-	plist = WMCreatePLData(data);
-	WMReleaseData(data);
+	plist = createPropList(pldata->arena, WPLData);
+	plist->d.data = data;
 
 	return plist;
 }
@@ -722,7 +1085,8 @@ static WMPropList *getPLArray(PLData * pldata)
 	int c;
 	WMPropList *array, *obj;
 
-	array = WMCreatePLArray(NULL);
+	array = createPropList(pldata->arena, WPLArray);
+	array->d.array = WMCreateArray(4);
 
 	while (1) {
 		c = getNonSpaceChar(pldata);
@@ -750,11 +1114,11 @@ static WMPropList *getPLArray(PLData * pldata)
 			break;
 		}
 		WMAddToPLArray(array, obj);
-		WMReleasePropList(obj);
+		releasePropListByCount(obj, 1);
 	}
 
 	if (!ok) {
-		WMReleasePropList(array);
+		releasePropListByCount(array, 1);
 		array = NULL;
 	}
 
@@ -767,7 +1131,8 @@ static WMPropList *getPLDictionary(PLData * pldata)
 	int c;
 	WMPropList *dict, *key, *value;
 
-	dict = WMCreatePLDictionary(NULL, NULL);
+	dict = createPropList(pldata->arena, WPLDictionary);
+	dict->d.dict = WMCreateHashTable(WMPropListHashCallbacks);
 
 	while (1) {
 		c = getNonSpaceChar(pldata);
@@ -806,7 +1171,7 @@ static WMPropList *getPLDictionary(PLData * pldata)
 
 		c = getNonSpaceChar(pldata);
 		if (c != '=') {
-			WMReleasePropList(key);
+			releasePropListByCount(key, 1);
 			COMPLAIN(pldata, _("missing = in PropList dictionary entry"));
 			ok = 0;
 			break;
@@ -816,7 +1181,7 @@ static WMPropList *getPLDictionary(PLData * pldata)
 		value = getPropList(pldata);
 		if (!value) {
 			COMPLAIN(pldata, _("error parsing PropList dictionary entry value"));
-			WMReleasePropList(key);
+			releasePropListByCount(key, 1);
 			ok = 0;
 			break;
 		}
@@ -824,19 +1189,19 @@ static WMPropList *getPLDictionary(PLData * pldata)
 		c = getNonSpaceChar(pldata);
 		if (c != ';') {
 			COMPLAIN(pldata, _("missing ; in PropList dictionary entry"));
-			WMReleasePropList(key);
-			WMReleasePropList(value);
+			releasePropListByCount(key, 1);
+			releasePropListByCount(value, 1);
 			ok = 0;
 			break;
 		}
 
 		WMPutInPLDictionary(dict, key, value);
-		WMReleasePropList(key);
-		WMReleasePropList(value);
+		releasePropListByCount(key, 1);
+		releasePropListByCount(value, 1);
 	}
 
 	if (!ok) {
-		WMReleasePropList(dict);
+		releasePropListByCount(dict, 1);
 		dict = NULL;
 	}
 
@@ -895,11 +1260,21 @@ static WMPropList *getPropList(PLData * pldata)
 	return plist;
 }
 
+void WMPLSetSortKeys(Bool sort)
+{
+	sortKeys = sort;
+}
+
 void WMPLSetCaseSensitive(Bool caseSensitiveness)
 {
 	caseSensitive = caseSensitiveness;
 }
 
+void WMPLSetUseArenas(Bool flag)
+{
+	useArenas = flag;
+}
+
 WMPropList *WMCreatePLString(const char *str)
 {
 	WMPropList *plist;
@@ -969,7 +1344,7 @@ WMPropList *WMCreatePLArray(WMPropList * elem, ...)
 	if (!elem)
 		return plist;
 
-	WMAddToArray(plist->d.array, WMRetainPropList(elem));
+	WMAddToArray(plist->d.array, adoptPropList(plist, elem, 1));
 
 	va_start(ap, elem);
 
@@ -979,7 +1354,7 @@ WMPropList *WMCreatePLArray(WMPropList * elem, ...)
 			va_end(ap);
 			return plist;
 		}
-		WMAddToArray(plist->d.array, WMRetainPropList(nelem));
+		WMAddToArray(plist->d.array, adoptPropList(plist, nelem, 1));
 	}
 }
 
@@ -996,7 +1371,7 @@ WMPropList *WMCreatePLDictionary(WMPropList * key, WMPropList * value, ...)
 	if (!key || !value)
 		return plist;
 
-	WMHashInsert(plist->d.dict, WMRetainPropList(key), WMRetainPropList(value));
+	WMHashInsert(plist->d.dict, adoptPropList(plist, key, 1), adoptPropList(plist, value, 1));
 
 	va_start(ap, value);
 
@@ -1013,108 +1388,51 @@ WMPropList *WMCreatePLDictionary(WMPropList * key, WMPropList * value, ...)
 		}
 		if (WMHashGetItemAndKey(plist->d.dict, nkey, (void **)&v, (void **)&k)) {
 			WMHashRemove(plist->d.dict, k);
-			WMReleasePropList(k);
-			WMReleasePropList(v);
+			releasePropListByCount(k, 1);
+			releasePropListByCount(v, 1);
 		}
-		WMHashInsert(plist->d.dict, WMRetainPropList(nkey), WMRetainPropList(nvalue));
+		WMHashInsert(plist->d.dict, adoptPropList(plist, nkey, 1), adoptPropList(plist, nvalue, 1));
 	}
 }
 
 WMPropList *WMRetainPropList(WMPropList * plist)
 {
-	WMPropList *key, *value;
-	WMHashEnumerator e;
-	int i;
-
-	plist->retainCount++;
+	/* a node kept from the outside keeps its whole document */
+	if (plist->arena && plist != plist->arena->root)
+		plist->arena->pins++;
 
-	switch (plist->type) {
-	case WPLString:
-	case WPLData:
-		break;
-	case WPLArray:
-		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++) {
-			WMRetainPropList(WMGetFromArray(plist->d.array, i));
-		}
-		break;
-	case WPLDictionary:
-		e = WMEnumerateHashTable(plist->d.dict);
-		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key)) {
-			WMRetainPropList(key);
-			WMRetainPropList(value);
-		}
-		break;
-	default:
-		wwarning(_("Used proplist functions on non-WMPropLists objects"));
-		wassertrv(False, NULL);
-		break;
-	}
-
-	return plist;
+	return retainPropListByCount(plist, 1);
 }
 
 void WMReleasePropList(WMPropList * plist)
 {
-	WMPropList *key, *value;
-	WMHashEnumerator e;
-	int i;
-
-	plist->retainCount--;
-
-	switch (plist->type) {
-	case WPLString:
-		if (plist->retainCount < 1) {
-			wfree(plist->d.string);
-			wfree(plist);
-		}
-		break;
-	case WPLData:
-		if (plist->retainCount < 1) {
-			WMReleaseData(plist->d.data);
-			wfree(plist);
-		}
-		break;
-	case WPLArray:
-		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++) {
-			WMReleasePropList(WMGetFromArray(plist->d.array, i));
-		}
-		if (plist->retainCount < 1) {
-			WMFreeArray(plist->d.array);
-			wfree(plist);
-		}
-		break;
-	case WPLDictionary:
-		e = WMEnumerateHashTable(plist->d.dict);
-		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key)) {
-			WMReleasePropList(key);
-			WMReleasePropList(value);
+	PLArena *arena = plist->arena;
+
+	if (arena) {
+		if (plist != arena->root) {
+			if (arena->pins > 0)
+				arena->pins--;
+		} else if (plist->retainCount == 1 && arena->pins == 0 && !arena->mixed) {
+			releaseArenaDocument(arena);
+			return;
 		}
-		if (plist->retainCount < 1) {
-			WMFreeHashTable(plist->d.dict);
-			wfree(plist);
-		}
-		break;
-	default:
-		wwarning(_("Used proplist functions on non-WMPropLists objects"));
-		wassertr(False);
-		break;
 	}
+
+	releasePropListByCount(plist, 1);
 }
 
 void WMInsertInPLArray(WMPropList * plist, int index, WMPropList * item)
 {
 	wassertr(plist->type == WPLArray);
 
-	retainPropListByCount(item, plist->retainCount);
-	WMInsertInArray(plist->d.array, index, item);
+	WMInsertInArray(plist->d.array, index, adoptPropList(plist, item, plist->retainCount));
 }
 
 void WMAddToPLArray(WMPropList * plist, WMPropList * item)
 {
 	wassertr(plist->type == WPLArray);
 
-	retainPropListByCount(item, plist->retainCount);
-	WMAddToArray(plist->d.array, item);
+	WMAddToArray(plist->d.array, adoptPropList(plist, item, plist->retainCount));
 }
 
 void WMDeleteFromPLArray(WMPropList * plist, int index)
@@ -1153,8 +1471,8 @@ void WMPutInPLDictionary(WMPropList * plist, WMPropList * key, WMPropList * valu
 
 	/*WMRetainPropList(key); */
 	WMRemoveFromPLDictionary(plist, key);
-	retainPropListByCount(key, plist->retainCount);
-	retainPropListByCount(value, plist->retainCount);
+	key = adoptPropList(plist, key, plist->retainCount);
+	value = adoptPropList(plist, value, plist->retainCount);
 	WMHashInsert(plist->d.dict, key, value);
 	/*WMReleasePropList(key); */
 }
@@ -1387,7 +1705,7 @@ WMPropList *WMGetPLDictionaryKeys(WMPropList * plist)
 
 	enumerator = WMEnumerateHashTable(plist->d.dict);
 	while ((key = WMNextHashEnumeratorKey(&enumerator))) {
-		WMAddToArray(array->d.array, WMRetainPropList(key));
+		WMAddToArray(array->d.array, adoptPropList(array, key, 1));
 	}
 
 	return array;
@@ -1413,11 +1731,11 @@ WMPropList *WMShallowCopyPropList(WMPropList * plist)
 	case WPLArray:
 		ret = (WMPropList *) wmalloc(sizeof(W_PropList));
 		ret->type = WPLArray;
-		ret->d.array = WMCreateArrayWithArray(plist->d.array);
+		ret->d.array = WMCreateArray(WMGetArrayItemCount(plist->d.array));
 		ret->retainCount = 1;
 
-		for (i = 0; i < WMGetArrayItemCount(ret->d.array); i++)
-			WMRetainPropList(WMGetFromArray(ret->d.array, i));
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++)
+			WMAddToArray(ret->d.array, adoptPropList(ret, WMGetFromArray(plist->d.array, i), 1));
 
 		break;
 	case WPLDictionary:
@@ -1488,6 +1806,7 @@ WMPropList *WMCreatePropListFromDescription(const char *desc)
 	pldata = (PLData *) wmalloc(sizeof(PLData));
 	pldata->ptr = desc;
 	pldata->lineNumber = 1;
+	pldata->arena = createArena();
 
 	plist = getPropList(pldata);
 
@@ -1499,10 +1818,11 @@ WMPropList *WMCreatePropListFromDescription(const char *desc)
 		 * the "garbage" can be the real data and the real garbage is in
 		 * fact in the beginning of the file (which is now inside plist)
 		 */
-		WMReleasePropList(plist);
+		releasePropListByCount(plist, 1);
 		plist = NULL;
 	}
 
+	closeArena(pldata->arena, plist);
 	wfree(pldata);
 
 	return plist;
@@ -1510,7 +1830,17 @@ WMPropList *WMCreatePropListFromDescription(const char *desc)
 
 char *WMGetPropListDescription(WMPropList * plist, Bool indented)
 {
-	return (indented ? indentedDescription(plist, 0) : description(plist));
+	PLWriter writer;
+
+	memset(&writer, 0, sizeof(writer));
+	if (indented)
+		writeIndentedDescription(&writer, plist, 0);
+	else
+		writeDescription(&writer, plist);
+
+	writeChars(&writer, "", 1);
+
+	return writer.str;
 }
 
 WMPropList *WMReadPropListFromFile(const char *file)
@@ -1553,6 +1883,7 @@ WMPropList *WMReadPropListFromFile(const char *file)
 	pldata->ptr = read_buf;
 	pldata->filename = file;
 	pldata->lineNumber = 1;
+	pldata->arena = createArena();
 
 	plist = getPropList(pldata);
 
@@ -1564,11 +1895,12 @@ WMPropList *WMReadPropListFromFile(const char *file)
 		 * the "garbage" can be the real data and the real garbage is in
 		 * fact in the beginning of the file (which is now inside plist)
 		 */
-		WMReleasePropList(plist);
+		releasePropListByCount(plist, 1);
 		plist = NULL;
 	}
 
 	wfree(read_buf);
+	closeArena(pldata->arena, plist);
 	wfree(pldata);
 
 	return plist;
@@ -1617,6 +1949,7 @@ WMPropList *WMReadPropListFromPipe(const char *command)
 	pldata->ptr = read_buf;
 	pldata->filename = command;
 	pldata->lineNumber = 1;
+	pldata->arena = createArena();
 
 	plist = getPropList(pldata);
 
@@ -1628,22 +1961,33 @@ WMPropList *WMReadPropListFromPipe(const char *command)
 		 * the "garbage" can be the real data and the real garbage is in
 		 * fact in the beginning of the file (which is now inside plist)
 		 */
-		WMReleasePropList(plist);
+		releasePropListByCount(plist, 1);
 		plist = NULL;
 	}
 
 	wfree(read_buf);
+	closeArena(pldata->arena, plist);
 	wfree(pldata);
 
 	return plist;
 }
 
+static void writeTextFile(PLWriter * writer, WMPropList * plist, const void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	writeIndentedDescription(writer, plist, 0);
+	writeChars(writer, "\n", 1);
+}
+
 /* TODO: review this function's code */
 
-Bool WMWritePropListToFile(WMPropList * plist, const char *path)
+static Bool writePropListFile(WMPropList * plist, const char *path,
+			      void (*writeProc) (PLWriter *, WMPropList *, const void *), const void *data)
 {
 	char *thePath = NULL;
-	char *desc;
+	PLWriter writer;
 	FILE *theFile;
 #ifdef	HAVE_MKSTEMP
 	int fd, mask;
@@ -1690,16 +2034,17 @@ Bool WMWritePropListToFile(WMPropList * plist, const char *path)
 		goto failure;
 	}
 
-	desc = indentedDescription(plist, 0);
+	/* straight to the file, there is no need to have it all in memory */
+	memset(&writer, 0, sizeof(writer));
+	writer.file = theFile;
+	(*writeProc) (&writer, plist, data);
 
-	if (fprintf(theFile, "%s\n", desc) != strlen(desc) + 1) {
+	if (writer.failed) {
 		werror(_("writing to file: %s failed"), thePath);
-		wfree(desc);
+		fclose(theFile);
 		goto failure;
 	}
 
-	wfree(desc);
-
 	(void)fsync(fileno(theFile));
 	if (fclose(theFile) != 0) {
 		werror(_("fclose (%s) failed"), thePath);
@@ -1723,6 +2068,438 @@ Bool WMWritePropListToFile(WMPropList * plist, const char *path)
 	return False;
 }
 
+Bool WMWritePropListToFile(WMPropList * plist, const char *path)
+{
+	return writePropListFile(plist, path, writeTextFile, NULL);
+}
+
+/*
+ * Binary caches of property list files
+ *
+ * A cache holds the property list of a file with each string stored once,
+ * in a table, and everything else in length prefixed records, so loading
+ * it is a walk over the mapped file with no parsing at all. It is only
+ * used while the file has the size, date and inode it was made from. All
+ * the numbers are 32 bit little endian:
+ *
+ *	"WMPLBIN1"
+ *	stamp of the file: mtime, its nanoseconds, size, inode (2 numbers each)
+ *	number of strings, size of the string table, size of the tree
+ *	strings: length, bytes, '\0' for each
+ *	tree: 'S' index | 'D' length bytes | 'A' count items | 'Y' count key value...
+ */
+
+#define CACHE_MAGIC		"WMPLBIN1"
+#define CACHE_MAGIC_SIZE	8
+#define CACHE_STAMP_SIZE	4
+#define CACHE_HEADER_SIZE	(CACHE_MAGIC_SIZE + 4 * (2 * CACHE_STAMP_SIZE + 3))
+
+typedef struct {
+	uint64_t value[CACHE_STAMP_SIZE];
+} CacheStamp;
+
+typedef struct {
+	WMHashTable *index;	/* string -> its index + 1 */
+	WMArray *strings;
+	uint32_t size;		/* of the table in the file */
+} StringTable;
+
+typedef struct {
+	const unsigned char *ptr;
+	const unsigned char *end;
+	const char **strings;
+	uint32_t count;
+	PLArena *arena;
+} CacheReader;
+
+static char *cachePathForFile(const char *file)
+{
+	const char *name;
+	char *path;
+
+	name = strrchr(file, '/');
+	name = name ? name + 1 : file;
+
+	/* hidden, next to the file */
+	path = wmalloc(strlen(file) + 8);
+	sprintf(path, "%.*s.%s.cache", (int)(name - file), file, name);
+
+	return path;
+}
+
+static Bool getCacheStamp(const char *file, CacheStamp * stamp)
+{
+	struct stat stbuf;
+
+	if (stat(file, &stbuf) < 0)
+		return False;
+
+	stamp->value[0] = stbuf.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	stamp->value[1] = stbuf.st_mtim.tv_nsec;
+#else
+	stamp->value[1] = 0;
+#endif
+	stamp->value[2] = stbuf.st_size;
+	stamp->value[3] = stbuf.st_ino;
+
+	return True;
+}
+
+static void writeU32(PLWriter * writer, uint32_t value)
+{
+	char bytes[4];
+
+	bytes[0] = value & 0xff;
+	bytes[1] = (value >> 8) & 0xff;
+	bytes[2] = (value >> 16) & 0xff;
+	bytes[3] = (value >> 24) & 0xff;
+
+	writeChars(writer, bytes, 4);
+}
+
+static void internStrings(StringTable * table, WMPropList * plist)
+{
+	WMHashEnumerator e;
+	WMPropList *key, *value;
+	int i;
+
+	switch (plist->type) {
+	case WPLString:
+		if (!WMHashGet(table->index, plist->d.string)) {
+			WMAddToArray(table->strings, plist->d.string);
+			WMHashInsert(table->index, plist->d.string,
+				     (void *)(uintptr_t) WMGetArrayItemCount(table->strings));
+			table->size += 4 + strlen(plist->d.string) + 1;
+		}
+		break;
+	case WPLData:
+		break;
+	case WPLArray:
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++)
+			internStrings(table, WMGetFromArray(plist->d.array, i));
+		break;
+	case WPLDictionary:
+		e = WMEnumerateHashTable(plist->d.dict);
+		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key)) {
+			internStrings(table, key);
+			internStrings(table, value);
+		}
+		break;
+	}
+}
+
+static uint32_t binaryTreeSize(WMPropList * plist)
+{
+	WMHashEnumerator e;
+	WMPropList *key, *value;
+	uint32_t size = 5;
+	int i;
+
+	switch (plist->type) {
+	case WPLString:
+		break;
+	case WPLData:
+		size += WMGetDataLength(plist->d.data);
+		break;
+	case WPLArray:
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++)
+			size += binaryTreeSize(WMGetFromArray(plist->d.array, i));
+		break;
+	case WPLDictionary:
+		e = WMEnumerateHashTable(plist->d.dict);
+		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key))
+			size += binaryTreeSize(key) + binaryTreeSize(value);
+		break;
+	}
+
+	return size;
+}
+
+static void writeBinaryTree(PLWriter * writer, StringTable * table, WMPropList * plist)
+{
+	WMHashEnumerator e;
+	WMPropList *key, *value;
+	int i;
+
+	switch (plist->type) {
+	case WPLString:
+		writeChars(writer, "S", 1);
+		writeU32(writer, (uintptr_t) WMHashGet(table->index, plist->d.string) - 1);
+		break;
+	case WPLData:
+		writeChars(writer, "D", 1);
+		writeU32(writer, WMGetDataLength(plist->d.data));
+		writeChars(writer, WMDataBytes(plist->d.data), WMGetDataLength(plist->d.data));
+		break;
+	case WPLArray:
+		writeChars(writer, "A", 1);
+		writeU32(writer, WMGetArrayItemCount(plist->d.array));
+		for (i = 0; i < WMGetArrayItemCount(plist->d.array); i++)
+			writeBinaryTree(writer, table, WMGetFromArray(plist->d.array, i));
+		break;
+	case WPLDictionary:
+		writeChars(writer, "Y", 1);
+		writeU32(writer, WMCountHashTable(plist->d.dict));
+		e = WMEnumerateHashTable(plist->d.dict);
+		while (WMNextHashEnumeratorItemAndKey(&e, (void **)&value, (void **)&key)) {
+			writeBinaryTree(writer, table, key);
+			writeBinaryTree(writer, table, value);
+		}
+		break;
+	}
+}
+
+static void writeBinaryFile(PLWriter * writer, WMPropList * plist, const void *data)
+{
+	const CacheStamp *stamp = data;
+	StringTable table;
+	char *str;
+	int i;
+
+	table.index = WMCreateHashTable(WMStringPointerHashCallbacks);
+	table.strings = WMCreateArray(64);
+	table.size = 0;
+	internStrings(&table, plist);
+
+	writeChars(writer, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+	for (i = 0; i < CACHE_STAMP_SIZE; i++) {
+		writeU32(writer, stamp->value[i] & 0xffffffff);
+		writeU32(writer, stamp->value[i] >> 32);
+	}
+	writeU32(writer, WMGetArrayItemCount(table.strings));
+	writeU32(writer, table.size);
+	writeU32(writer, binaryTreeSize(plist));
+
+	for (i = 0; i < WMGetArrayItemCount(table.strings); i++) {
+		str = WMGetFromArray(table.strings, i);
+		writeU32(writer, strlen(str));
+		writeChars(writer, str, strlen(str) + 1);
+	}
+
+	writeBinaryTree(writer, &table, plist);
+
+	WMFreeHashTable(table.index);
+	WMFreeArray(table.strings);
+}
+
+static Bool readU32(CacheReader * reader, uint32_t * value)
+{
+	const unsigned char *p = reader->ptr;
+
+	if (reader->end - p < 4)
+		return False;
+
+	*value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+	reader->ptr += 4;
+
+	return True;
+}
+
+static WMPropList *readBinaryTree(CacheReader * reader)
+{
+	WMPropList *plist, *key, *value;
+	uint32_t count, i;
+	char tag;
+
+	if (reader->ptr >= reader->end)
+		return NULL;
+	tag = *reader->ptr++;
+	if (!readU32(reader, &count))
+		return NULL;
+
+	switch (tag) {
+	case 'S':
+		if (count >= reader->count)
+			return NULL;
+		return createPLString(reader->arena, reader->strings[count]);
+
+	case 'D':
+		if ((size_t) (reader->end - reader->ptr) < count)
+			return NULL;
+		plist = createPropList(reader->arena, WPLData);
+		plist->d.data = WMCreateDataWithBytes(reader->ptr, count);
+		reader->ptr += count;
+		return plist;
+
+	case 'A':
+		/* items are at least 5 bytes, do not trust the count more than that */
+		if ((size_t) (reader->end - reader->ptr) / 5 < count)
+			return NULL;
+		plist = createPropList(reader->arena, WPLArray);
+		plist->d.array = WMCreateArray(count);
+		for (i = 0; i < count; i++) {
+			value = readBinaryTree(reader);
+			if (!value) {
+				releasePropListByCount(plist, 1);
+				return NULL;
+			}
+			WMAddToArray(plist->d.array, value);
+		}
+		return plist;
+
+	case 'Y':
+		if ((size_t) (reader->end - reader->ptr) / 10 < count)
+			return NULL;
+		plist = createPropList(reader->arena, WPLDictionary);
+		plist->d.dict = WMCreateHashTable(WMPropListHashCallbacks);
+		for (i = 0; i < count; i++) {
+			key = readBinaryTree(reader);
+			value = key ? readBinaryTree(reader) : NULL;
+			if (!value || WMHashGet(plist->d.dict, key)) {
+				if (key)
+					releasePropListByCount(key, 1);
+				if (value)
+					releasePropListByCount(value, 1);
+				releasePropListByCount(plist, 1);
+				return NULL;
+			}
+			WMHashInsert(plist->d.dict, key, value);
+		}
+		return plist;
+	}
+
+	return NULL;
+}
+
+static WMPropList *readBinaryCache(const unsigned char *bytes, size_t length, const CacheStamp * stamp)
+{
+	CacheReader reader;
+	WMPropList *plist = NULL;
+	uint32_t lo, hi, tableSize, treeSize, size, i;
+
+	reader.ptr = bytes;
+	reader.end = bytes + length;
+	reader.strings = NULL;
+	reader.arena = NULL;
+
+	if (length < CACHE_HEADER_SIZE || memcmp(bytes, CACHE_MAGIC, CACHE_MAGIC_SIZE) != 0)
+		return NULL;
+	reader.ptr += CACHE_MAGIC_SIZE;
+
+	for (i = 0; i < CACHE_STAMP_SIZE; i++) {
+		if (!readU32(&reader, &lo) || !readU32(&reader, &hi))
+			return NULL;
+		if ((((uint64_t) hi << 32) | lo) != stamp->value[i])
+			return NULL;
+	}
+	if (!readU32(&reader, &reader.count) || !readU32(&reader, &tableSize) || !readU32(&reader, &treeSize))
+		return NULL;
+	if ((size_t) (reader.end - reader.ptr) != (size_t) tableSize + treeSize || tableSize / 5 < reader.count)
+		return NULL;
+
+	reader.strings = wmalloc((reader.count + 1) * sizeof(char *));
+	for (i = 0; i < reader.count; i++) {
+		if (!readU32(&reader, &size) || (size_t) (reader.end - reader.ptr) <= size || reader.ptr[size] != 0)
+			goto out;
+		reader.strings[i] = (const char *)reader.ptr;
+		reader.ptr += size + 1;
+	}
+
+	reader.arena = createArena();
+	plist = readBinaryTree(&reader);
+	if (plist && reader.ptr != reader.end) {
+		releasePropListByCount(plist, 1);
+		plist = NULL;
+	}
+
+ out:
+	wfree(reader.strings);
+	closeArena(reader.arena, plist);
+
+	return plist;
+}
+
+static WMPropList *readCacheFile(const char *path, const CacheStamp * stamp)
+{
+	WMPropList *plist = NULL;
+	struct stat stbuf;
+	unsigned char *bytes;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &stbuf) < 0 || stbuf.st_size < CACHE_HEADER_SIZE) {
+		close(fd);
+		return NULL;
+	}
+
+#ifdef HAVE_MMAP
+	/* the caches are replaced with rename(), never changed in place, so this is safe */
+	bytes = mmap(NULL, stbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (bytes != MAP_FAILED) {
+		plist = readBinaryCache(bytes, stbuf.st_size, stamp);
+		munmap(bytes, stbuf.st_size);
+		close(fd);
+		return plist;
+	}
+#endif
+
+	bytes = wmalloc(stbuf.st_size);
+	if (read(fd, bytes, stbuf.st_size) == stbuf.st_size)
+		plist = readBinaryCache(bytes, stbuf.st_size, stamp);
+	wfree(bytes);
+	close(fd);
+
+	return plist;
+}
+
+WMPropList *WMReadPropListCache(const char *file)
+{
+	WMPropList *plist;
+	CacheStamp stamp;
+	char *path;
+
+	if (!getCacheStamp(file, &stamp))
+		return NULL;
+
+	path = cachePathForFile(file);
+	plist = readCacheFile(path, &stamp);
+	wfree(path);
+
+	return plist;
+}
+
+Bool WMWritePropListCache(WMPropList * plist, const char *file)
+{
+	CacheStamp stamp;
+	char *path;
+	Bool result;
+
+	if (!getCacheStamp(file, &stamp))
+		return False;
+
+	/*
+	 * Where the dates are only to the second, a change made in the same
+	 * second as the file was written would go unnoticed.
+	 */
+	if (stamp.value[1] == 0 && (time_t) stamp.value[0] >= time(NULL) - 1)
+		return False;
+
+	path = cachePathForFile(file);
+	result = writePropListFile(plist, path, writeBinaryFile, &stamp);
+	wfree(path);
+
+	return result;
+}
+
+WMPropList *WMReadPropListFromCachedFile(const char *file)
+{
+	WMPropList *plist;
+
+	plist = WMReadPropListCache(file);
+	if (plist)
+		return plist;
+
+	plist = WMReadPropListFromFile(file);
+	if (plist)
+		WMWritePropListCache(plist, file);
+
+	return plist;
+}
+
 /*
  * create a directory hierarchy
  *
@@ -79,6 +79,21 @@ static char *createTruncatedString(WMFont * font, const char *text, int *textLen
 
 static void willResizeBrowser(W_ViewDelegate *, WMView *, unsigned int *, unsigned int *);
 
+/* the selection of the last click, to know if the next one changes it */
+static struct {
+	WMList *list;
+	WMListItem *item;
+	int row;
+	int selNo;
+} lastClick;
+
+/* the rows of list were changed, a click on the same row may be another item */
+static void forgetLastClick(WMList * list)
+{
+	if (list == NULL || list == lastClick.list)
+		lastClick.list = NULL;
+}
+
 W_ViewDelegate _BrowserViewDelegate = {
 	NULL,
 	NULL,
@@ -307,6 +322,7 @@ static void removeColumn(WMBrowser * bPtr, int column)
 			wfree(bPtr->titles[i]);
 			bPtr->titles[i] = NULL;
 		}
+		forgetLastClick(bPtr->columns[i]);
 		WMClearList(bPtr->columns[i]);
 	}
 	for (; i < destroyEnd; i++) {
@@ -315,6 +331,7 @@ static void removeColumn(WMBrowser * bPtr, int column)
 			bPtr->titles[i] = NULL;
 		}
 		WMRemoveNotificationObserverWithName(bPtr, WMListSelectionDidChangeNotification, bPtr->columns[i]);
+		forgetLastClick(bPtr->columns[i]);
 		WMDestroyWidget(bPtr->columns[i]);
 		bPtr->columns[i] = NULL;
 	}
@@ -404,11 +421,13 @@ void WMSetBrowserTitled(WMBrowser * bPtr, Bool flag)
 
 void WMSortBrowserColumn(WMBrowser * bPtr, int column)
 {
+	forgetLastClick(bPtr->columns[column]);
 	WMSortListItems(bPtr->columns[column]);
 }
 
 void WMSortBrowserColumnWithComparer(WMBrowser * bPtr, int column, WMCompareDataProc * func)
 {
+	forgetLastClick(bPtr->columns[column]);
 	WMSortListItemsWithComparer(bPtr->columns[column], func);
 }
 
@@ -419,8 +438,10 @@ WMListItem *WMInsertBrowserItem(WMBrowser * bPtr, int column, int row, const cha
 	if (column < 0 || column >= bPtr->columnCount)
 		return NULL;
 
+	forgetLastClick(bPtr->columns[column]);
 	item = WMInsertListItem(bPtr->columns[column], row, text);
-	item->isBranch = isBranch;
+	if (item)
+		item->isBranch = isBranch;
 
 	return item;
 }
@@ -633,6 +654,7 @@ char *WMSetBrowserPath(WMBrowser * bPtr, char *path)
 	}
 
 	removeColumn(bPtr, 1);
+	forgetLastClick(NULL);
 
 	WMSelectListItem(bPtr->columns[0], -1);
 	WMSetListPosition(bPtr->columns[0], 0);
@@ -812,6 +834,8 @@ static void loadColumn(WMBrowser * bPtr, int column)
 	assert(bPtr->delegate);
 	assert(bPtr->delegate->createRowsForColumn);
 
+	forgetLastClick(bPtr->columns[column]);
+
 	bPtr->flags.loadingColumn = 1;
 	(*bPtr->delegate->createRowsForColumn) (bPtr->delegate, bPtr, column, bPtr->columns[column]);
 	bPtr->flags.loadingColumn = 0;
@@ -924,14 +948,18 @@ static void listCallback(void *self, void *clientData)
 	WMBrowser *bPtr = (WMBrowser *) clientData;
 	WMList *lPtr = (WMList *) self;
 	WMListItem *item;
-	int i, selNo;
-	static WMListItem *oldItem = NULL;
-	static int oldSelNo = 0;
+	int i, row, selNo;
 
+	/*
+	 * The rows are compared too, as the items of lists with a data source
+	 * are cached ones that can be reused for another row.
+	 */
 	item = WMGetListSelectedItem(lPtr);
-	selNo = WMGetArrayItemCount(WMGetListSelectedItems(lPtr));
+	row = WMGetListSelectedItemRow(lPtr);
+	selNo = WMGetListNumberOfSelectedRows(lPtr);
 
-	if (oldItem == NULL || oldItem != item || oldSelNo != selNo) {
+	if (item == NULL || lastClick.list != lPtr || lastClick.item != item
+	    || lastClick.row != row || lastClick.selNo != selNo) {
 		for (i = 0; i < bPtr->columnCount; i++) {
 			if (lPtr == bPtr->columns[i])
 				break;
@@ -960,8 +988,10 @@ static void listCallback(void *self, void *clientData)
 	if (bPtr->action)
 		(*bPtr->action) (bPtr, bPtr->clientData);
 
-	oldItem = item;
-	oldSelNo = selNo;
+	lastClick.list = lPtr;
+	lastClick.item = item;
+	lastClick.row = row;
+	lastClick.selNo = selNo;
 }
 
 static void listDoubleCallback(void *self, void *clientData)
@@ -1031,7 +1061,7 @@ static void listSelectionObserver(void *observerData, WMNotification * notificat
 		return;
 	}
 
-	if (WMGetArrayItemCount(WMGetListSelectedItems(lPtr)) == 0)
+	if (WMGetListNumberOfSelectedRows(lPtr) == 0)
 		column--;
 
 	bPtr->selectedColumn = column;
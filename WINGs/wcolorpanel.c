@@ -29,6 +29,7 @@
 
 #include <errno.h>
 #include <math.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <fcntl.h>
@@ -113,6 +114,7 @@ typedef struct CPColor {
 typedef struct WheelMatrix {
 	unsigned int width, height;	/* Size of the colorwheel */
 	unsigned char *data[3];	/* Wheel data (R,G,B) */
+	unsigned char *inside;	/* Whether the pixel is part of the wheel */
 	unsigned char values[256];	/* Precalculated values R,G & B = 0-255 */
 } wheelMatrix;
 
@@ -209,6 +211,8 @@ typedef struct W_ColorPanel {
 
 	/* Look-Up Tables and Images */
 	wheelMatrix *wheelMtrx;
+	RXImage *wheelXImg;	/* For direct rendering on TrueColor */
+	WMHandlerID wheelRedrawTimer;	/* Pending brightness change */
 	Pixmap wheelImg;
 	Pixmap selectionImg;
 	Pixmap selectionBackImg;
@@ -259,6 +263,10 @@ enum {
 #define	SPECTRUM_WIDTH          511
 #define	SPECTRUM_HEIGHT         360
 
+/* Delay used to coalesce brightness changes of the color wheel, so it is
+ * not rendered more often than the display can show it (in ms) */
+#define	WHEEL_REDRAW_DELAY      16
+
 #define	COLORWHEEL_PART         1
 #define	CUSTOMPALETTE_PART      2
 
@@ -293,7 +301,9 @@ static void wheelPaint(W_ColorPanel * panel);
 static void wheelHandleEvents(XEvent * event, void *data);
 static void wheelHandleActionEvents(XEvent * event, void *data);
 static void wheelBrightnessSliderCallback(WMWidget * w, void *data);
+static void wheelRedrawTimeout(void *data);
 static void wheelUpdateSelection(W_ColorPanel * panel);
+static void wheelDrawSelection(W_ColorPanel * panel);
 static void wheelUndrawSelection(W_ColorPanel * panel);
 
 static void wheelPositionSelection(W_ColorPanel * panel, int x, int y);
@@ -1103,7 +1113,11 @@ void WMFreeColorPanel(WMColorPanel * panel)
 	WMReleaseFont(panel->font12);
 
 	/* pixmaps */
+	if (panel->wheelRedrawTimer)
+		WMDeleteTimerHandler(panel->wheelRedrawTimer);
 	wheelDestroyMatrix(panel->wheelMtrx);
+	if (panel->wheelXImg)
+		RDestroyXImage(scr->rcontext, panel->wheelXImg);
 	if (panel->wheelImg)
 		XFreePixmap(scr->display, panel->wheelImg);
 	if (panel->selectionImg)
@@ -1869,6 +1883,7 @@ static wheelMatrix *wheelCreateMatrix(unsigned int width, unsigned int height)
 	for (i = 0; i < 3; i++) {
 		matrix->data[i] = wmalloc(width * height * sizeof(unsigned char));
 	}
+	matrix->inside = wmalloc(width * height * sizeof(unsigned char));
 
 	return matrix;
 }
@@ -1884,6 +1899,8 @@ static void wheelDestroyMatrix(wheelMatrix * matrix)
 		if (matrix->data[i])
 			wfree(matrix->data[i]);
 	}
+	if (matrix->inside)
+		wfree(matrix->inside);
 	wfree(matrix);
 }
 
@@ -1982,6 +1999,12 @@ static void wheelInitMatrix(W_ColorPanel * panel)
 		ofs[0] += 2 * y + 1;
 		ofs[1] += 1 - (colorWheelSize + 4) * (colorWheelSize + 4 - 1 - 2 * y);
 	}
+
+	/* The shape of the wheel does not depend on the brightness */
+	for (i = 0; i < panel->wheelMtrx->width * panel->wheelMtrx->height; i++)
+		panel->wheelMtrx->inside[i] = ((panel->wheelMtrx->data[0][i] != 0) &&
+					       (panel->wheelMtrx->data[1][i] != 0) &&
+					       (panel->wheelMtrx->data[2][i] != 0));
 }
 
 static void wheelCalculateValues(W_ColorPanel * panel, int maxvalue)
@@ -1998,6 +2021,105 @@ static void wheelCalculateValues(W_ColorPanel * panel, int maxvalue)
 	}
 }
 
+/*
+ * Give the contribution of an 8 bits component value to a TrueColor pixel
+ */
+static unsigned long wheelPixelComponent(unsigned long mask, unsigned long value)
+{
+	int shift, bits;
+
+	for (shift = 0; mask && !(mask & 1); shift++)
+		mask >>= 1;
+	for (bits = 0; mask & 1; bits++)
+		mask >>= 1;
+
+	if (bits <= 8)
+		value >>= 8 - bits;
+	else
+		value = (value << (bits - 8)) | (value >> (16 - bits));
+
+	return value << shift;
+}
+
+/*
+ * Build the table giving, for each value of a component in the matrix, its
+ * contribution to the pixel once scaled by the current brightness
+ */
+static void wheelMakeComponentTable(W_ColorPanel * panel, unsigned long mask, unsigned long *table)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		table[i] = wheelPixelComponent(mask, panel->wheelMtrx->values[i]);
+}
+
+/*
+ * Render the wheel directly into an XImage, without going through the
+ * generic image conversion which dithers and allocates on every call.
+ * Only possible on TrueColor, returns False otherwise.
+ */
+static Bool wheelRenderDirect(W_ColorPanel * panel)
+{
+	W_Screen *scr = WMWidgetScreen(panel->win);
+	wheelMatrix *mtrx = panel->wheelMtrx;
+	unsigned long rtable[256], gtable[256], btable[256];
+	unsigned long grayPixel, pixel;
+	unsigned int x, y, ofs;
+	XImage *ximg;
+	const int one = 1;
+	Bool native32;
+
+	if (scr->rcontext->vclass != TrueColor)
+		return False;
+
+	if (!panel->wheelXImg) {
+		panel->wheelXImg = RCreateXImage(scr->rcontext, scr->depth, mtrx->width, mtrx->height);
+		if (!panel->wheelXImg)
+			return False;
+	}
+	if (!panel->wheelImg)
+		panel->wheelImg = XCreatePixmap(scr->display, W_VIEW(panel->wheelFrm)->window,
+						mtrx->width, mtrx->height, scr->depth);
+
+	ximg = panel->wheelXImg->image;
+
+	wheelMakeComponentTable(panel, ximg->red_mask, rtable);
+	wheelMakeComponentTable(panel, ximg->green_mask, gtable);
+	wheelMakeComponentTable(panel, ximg->blue_mask, btable);
+
+	/* TODO Make this transparent istead of gray */
+	grayPixel = (wheelPixelComponent(ximg->red_mask, 0xae) |
+		     wheelPixelComponent(ximg->green_mask, 0xaa) |
+		     wheelPixelComponent(ximg->blue_mask, 0xae));
+
+	native32 = (ximg->bits_per_pixel == 32 &&
+		    ximg->byte_order == (*(const char *)&one ? LSBFirst : MSBFirst));
+
+	ofs = 0;
+	for (y = 0; y < mtrx->height; y++) {
+		uint32_t *line = (uint32_t *) (ximg->data + y * ximg->bytes_per_line);
+
+		for (x = 0; x < mtrx->width; x++, ofs++) {
+			if (mtrx->inside[ofs])
+				pixel = (rtable[mtrx->data[0][ofs]] |
+					 gtable[mtrx->data[1][ofs]] |
+					 btable[mtrx->data[2][ofs]]);
+			else
+				pixel = grayPixel;
+
+			if (native32)
+				line[x] = pixel;
+			else
+				XPutPixel(ximg, x, y, pixel);
+		}
+	}
+
+	RPutXImage(scr->rcontext, panel->wheelImg, scr->copyGC, panel->wheelXImg,
+		   0, 0, 0, 0, mtrx->width, mtrx->height);
+
+	return True;
+}
+
 static void wheelRender(W_ColorPanel * panel)
 {
 	W_Screen *scr = WMWidgetScreen(panel->win);
@@ -2008,6 +2130,9 @@ static void wheelRender(W_ColorPanel * panel)
 	unsigned long ofs = 0;
 	/*unsigned char     shift = getShift(sizeof(unsigned char)); */
 
+	if (wheelRenderDirect(panel))
+		goto done;
+
 	image = RCreateImage(colorWheelSize + 4, colorWheelSize + 4, True);
 	if (!image) {
 		wwarning(_("Color Panel: Could not allocate memory"));
@@ -2046,6 +2171,7 @@ static void wheelRender(W_ColorPanel * panel)
 	RConvertImage(scr->rcontext, image, &panel->wheelImg);
 	RReleaseImage(image);
 
+ done:
 	/* Check if backimage exists. If it doesn't, allocate and fill it */
 	if (!panel->selectionBackImg) {
 		panel->selectionBackImg = XCreatePixmap(scr->display,
@@ -2058,8 +2184,7 @@ static void wheelRender(W_ColorPanel * panel)
 
 static Bool wheelInsideColorWheel(W_ColorPanel * panel, unsigned long ofs)
 {
-	return ((panel->wheelMtrx->data[0][ofs] != 0) &&
-		(panel->wheelMtrx->data[1][ofs] != 0) && (panel->wheelMtrx->data[2][ofs] != 0));
+	return panel->wheelMtrx->inside[ofs];
 }
 
 static void wheelPaint(W_ColorPanel * panel)
@@ -2148,6 +2273,17 @@ static int getPickerPart(W_ColorPanel * panel, int x, int y)
 	return 0;
 }
 
+static void wheelRedrawTimeout(void *data)
+{
+	W_ColorPanel *panel = (W_ColorPanel *) data;
+
+	panel->wheelRedrawTimer = NULL;
+
+	wheelRender(panel);
+	wheelPaint(panel);
+	wheelDrawSelection(panel);
+}
+
 static void wheelBrightnessSliderCallback(WMWidget * w, void *data)
 {
 	int value;
@@ -2159,8 +2295,6 @@ static void wheelBrightnessSliderCallback(WMWidget * w, void *data)
 
 	value = 255 - WMGetSliderValue(panel->wheelBrightnessS);
 
-	wheelCalculateValues(panel, value);
-
 	if (panel->color.set == cpRGB) {
 		convertCPColor(&panel->color);
 		panel->color.set = cpHSV;
@@ -2168,18 +2302,27 @@ static void wheelBrightnessSliderCallback(WMWidget * w, void *data)
 
 	panel->color.hsv.value = value;
 
-	wheelRender(panel);
-	wheelPaint(panel);
-	wheelUpdateSelection(panel);
+	wheelCalculateValues(panel, value);
+	updateSwatch(panel, panel->color);
+	panel->lastChanged = WMWheelModeColorPanel;
+
+	/* The slider may move much faster than the wheel can be redrawn */
+	if (!panel->wheelRedrawTimer)
+		panel->wheelRedrawTimer = WMAddTimerHandler(WHEEL_REDRAW_DELAY, wheelRedrawTimeout, panel);
 }
 
 static void wheelUpdateSelection(W_ColorPanel * panel)
 {
-	W_Screen *scr = WMWidgetScreen(panel->win);
-
 	updateSwatch(panel, panel->color);
 	panel->lastChanged = WMWheelModeColorPanel;
 
+	wheelDrawSelection(panel);
+}
+
+static void wheelDrawSelection(W_ColorPanel * panel)
+{
+	W_Screen *scr = WMWidgetScreen(panel->win);
+
 	/* Redraw color selector (and make a backup of the part it will cover) */
 	XCopyArea(scr->display, panel->wheelImg, panel->selectionBackImg,
 		  scr->copyGC, panel->colx - 2, panel->coly - 2, 4, 4, 0, 0);
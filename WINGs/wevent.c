@@ -49,6 +49,22 @@ static const unsigned long eventMasks[] = {
 /* hook for other toolkits or wmaker process their events */
 static WMEventHook *extraEventHandler = NULL;
 
+/* hook that sees the events as they are taken from the display */
+static WMEventHook *eventRecorder = NULL;
+
+/*
+ * Source of events to use instead of the display, and the events it gave
+ * that a WMMaskEvent() was not waiting for, kept for the next calls.
+ */
+static struct {
+	WMEventSourceProc *proc;
+	void *clientData;
+
+	XEvent *pending;
+	int pendingCount;
+	int pendingSize;
+} eventSource;
+
 /*
  * WMCreateEventHandler--
  * 	Create an event handler and put it in the event handler list for the
@@ -364,8 +380,58 @@ static Bool waitForEvent(Display * dpy, unsigned long xeventmask, Bool waitForIn
 	return W_HandleInputEvents(waitForInput, ConnectionNumber(dpy));
 }
 
+static Bool eventMatches(XEvent * event, long mask)
+{
+	if (event->type < 0 || event->type >= wlengthof(eventMasks))
+		return False;
+
+	return (eventMasks[event->type] & mask) != 0;
+}
+
+/* mask 0 takes any event */
+static Bool nextSourceEvent(long mask, XEvent * event)
+{
+	int i;
+
+	/* as if there was a moment without events between each of them */
+	W_CheckTimerHandlers();
+	W_CheckIdleHandlers();
+
+	for (i = 0; i < eventSource.pendingCount; i++) {
+		if (mask == 0 || eventMatches(&eventSource.pending[i], mask)) {
+			*event = eventSource.pending[i];
+			eventSource.pendingCount--;
+			memmove(&eventSource.pending[i], &eventSource.pending[i + 1],
+				(eventSource.pendingCount - i) * sizeof(XEvent));
+			return True;
+		}
+	}
+
+	while (eventSource.proc) {
+		if (!(*eventSource.proc) (event, eventSource.clientData)) {
+			eventSource.proc = NULL;
+			break;
+		}
+
+		if (mask == 0 || eventMatches(event, mask))
+			return True;
+
+		if (eventSource.pendingCount == eventSource.pendingSize) {
+			eventSource.pendingSize = eventSource.pendingSize ? 2 * eventSource.pendingSize : 16;
+			eventSource.pending = wrealloc(eventSource.pending,
+						       eventSource.pendingSize * sizeof(XEvent));
+		}
+		eventSource.pending[eventSource.pendingCount++] = *event;
+	}
+
+	return False;
+}
+
 void WMNextEvent(Display * dpy, XEvent * event)
 {
+	if ((eventSource.proc || eventSource.pendingCount > 0) && nextSourceEvent(0, event))
+		return;
+
 	/* Check any expired timers */
 	W_CheckTimerHandlers();
 
@@ -389,10 +455,16 @@ void WMNextEvent(Display * dpy, XEvent * event)
 	}
 
 	XNextEvent(dpy, event);
+
+	if (eventRecorder)
+		(*eventRecorder) (event);
 }
 
 void WMMaskEvent(Display * dpy, long mask, XEvent * event)
 {
+	if ((eventSource.proc || eventSource.pendingCount > 0) && nextSourceEvent(mask, event))
+		return;
+
 	/* Check any expired timers */
 	W_CheckTimerHandlers();
 
@@ -403,7 +475,7 @@ void WMMaskEvent(Display * dpy, long mask, XEvent * event)
 		}
 
 		if (XCheckMaskEvent(dpy, mask, event))
-			return;
+			break;
 
 		/* Wait for input on the X connection socket or another input handler */
 		waitForEvent(dpy, mask, True);
@@ -411,6 +483,9 @@ void WMMaskEvent(Display * dpy, long mask, XEvent * event)
 		/* Check any expired timers */
 		W_CheckTimerHandlers();
 	}
+
+	if (eventRecorder)
+		(*eventRecorder) (event);
 }
 
 Bool WMScreenPending(WMScreen * scr)
@@ -429,3 +504,18 @@ WMEventHook *WMHookEventHandler(WMEventHook * handler)
 
 	return oldHandler;
 }
+
+WMEventHook *WMHookEventRecorder(WMEventHook * recorder)
+{
+	WMEventHook *oldRecorder = eventRecorder;
+
+	eventRecorder = recorder;
+
+	return oldRecorder;
+}
+
+void WMSetEventSource(WMEventSourceProc * proc, void *clientData)
+{
+	eventSource.proc = proc;
+	eventSource.clientData = clientData;
+}
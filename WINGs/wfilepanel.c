@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <limits.h>
 #include <errno.h>
@@ -11,10 +12,40 @@
 #include "WINGsP.h"
 #include "wconfig.h"
 
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
 #ifndef PATH_MAX
 #define PATH_MAX 1024
 #endif
 
+/* number of entries read at a time when a directory is listed in the
+ * background, and number of directory listings remembered */
+#define DIR_CHUNK_SIZE		256
+#define DIR_CACHE_SIZE		32
+
+typedef struct W_DirEntry {
+	char *name;
+	Bool isDirectory;
+} W_DirEntry;
+
+typedef struct W_DirListing {
+	char *path;
+	WMArray *entries;	/* of W_DirEntry, sorted when complete */
+	time_t mtime;
+	int watch;		/* inotify watch descriptor, or -1 */
+	Bool valid;
+} W_DirListing;
+
+typedef struct W_DirLoader {
+	struct W_FilePanel *panel;
+	int column;
+	DIR *dir;
+	W_DirListing *listing;
+	WMHandlerID handler;
+} W_DirLoader;
+
 typedef struct W_FilePanel {
 	WMWindow *win;
 
@@ -41,6 +72,8 @@ typedef struct W_FilePanel {
 
 	char **fileTypes;
 
+	WMArray *loaders;	/* directories being listed in the background */
+
 	struct {
 		unsigned int canExit:1;
 		unsigned int canceled:1;	/* clicked on cancel */
@@ -52,6 +85,7 @@ typedef struct W_FilePanel {
 		unsigned int canFreeFileTypes:1;
 		unsigned int fileMustExist:1;
 		unsigned int panelType:1;
+		unsigned int loadSynchronously:1;
 	} flags;
 } W_FilePanel;
 
@@ -63,6 +97,8 @@ typedef struct W_FilePanel {
 #define PHEIGHT 	360
 
 static void listDirectoryOnColumn(WMFilePanel * panel, int column, const char *path);
+static void cancelDirectoryLoaders(WMFilePanel * panel, int column);
+static void invalidateDirectoryListing(const char *path);
 static void browserClick(WMWidget *widget, void *p_panel);
 static void browserDClick(WMWidget *widget, void *p_panel);
 
@@ -81,6 +117,11 @@ static char *getCurrentFileName(WMFilePanel * panel);
 
 static void handleEvents(XEvent * event, void *data);
 
+#ifdef HAVE_INOTIFY
+/* all the file panels, to list their directories again when events were lost */
+static WMArray *filePanels = NULL;
+#endif
+
 static WMBrowserDelegate browserDelegate = {
 	NULL,			/* data */
 	fillColumn,		/* createRowsForColumn */
@@ -168,6 +209,13 @@ static WMFilePanel *makeFilePanel(WMScreen * scrPtr, const char *name, const cha
 	WMPixmap *icon;
 
 	fPtr = wmalloc(sizeof(WMFilePanel));
+	fPtr->loaders = WMCreateArray(2);
+
+#ifdef HAVE_INOTIFY
+	if (!filePanels)
+		filePanels = WMCreateArray(2);
+	WMAddToArray(filePanels, fPtr);
+#endif
 
 	fPtr->win = WMCreateWindowWithStyle(scrPtr, name, WMTitledWindowMask | WMResizableWindowMask);
 	WMResizeWidget(fPtr->win, PWIDTH, PHEIGHT);
@@ -283,7 +331,9 @@ static WMFilePanel *makeFilePanel(WMScreen * scrPtr, const char *name, const cha
 	WMSetFocusToWidget(fPtr->fileField);
 	WMSetTextFieldCursorPosition(fPtr->fileField, 0);
 
+	fPtr->flags.loadSynchronously = 1;
 	WMLoadBrowserColumnZero(fPtr->browser);
+	fPtr->flags.loadSynchronously = 0;
 
 	WMSetWindowInitialPosition(fPtr->win,
 				   (scrPtr->rootView->size.width - WMWidgetWidth(fPtr->win)) / 2,
@@ -337,6 +387,11 @@ void WMFreeFilePanel(WMFilePanel * panel)
 		WMWidgetScreen(panel->win)->sharedOpenPanel = NULL;
 	}
 	WMRemoveNotificationObserver(panel);
+	cancelDirectoryLoaders(panel, 0);
+#ifdef HAVE_INOTIFY
+	WMRemoveFromArray(filePanels, panel);
+#endif
+	WMFreeArray(panel->loaders);
 	WMUnmapWidget(panel->win);
 	WMDestroyWidget(panel->win);
 	wfree(panel);
@@ -394,7 +449,10 @@ void WMSetFilePanelDirectory(WMFilePanel * panel, char *path)
 	int col;
 	char *rest;
 
+	/* the columns must be complete for the path to be selected in them */
+	panel->flags.loadSynchronously = 1;
 	rest = WMSetBrowserPath(panel->browser, path);
+	panel->flags.loadSynchronously = 0;
 	if (strcmp(path, "/") == 0)
 		rest = NULL;
 
@@ -482,23 +540,373 @@ static int comparer(const void *a, const void *b)
 
 #undef CAST
 
-static void listDirectoryOnColumn(WMFilePanel * panel, int column, const char *path)
+/*
+ * Directory listings are kept in a small cache, most recently used last, so
+ * that going back and forth between directories does not read them again.
+ * A listing is dropped when inotify reports a change in the directory or,
+ * without inotify, when the modification time of the directory changed.
+ */
+static WMArray *dirCache = NULL;
+
+#ifdef HAVE_INOTIFY
+static int dirNotifyFD = -1;
+
+static void reloadFilePanels(void)
+{
+	WMFilePanel *panel;
+	WMArrayIterator iter;
+	char *path, *text;
+
+	WM_ITERATE_ARRAY(filePanels, panel, iter) {
+		if (!WMWidgetIsMapped(panel->win))
+			continue;
+
+		path = WMGetBrowserPath(panel->browser);
+		text = WMGetTextFieldText(panel->fileField);
+
+		WMLoadBrowserColumnZero(panel->browser);
+		WMSetFilePanelDirectory(panel, path);
+		WMSetTextFieldText(panel->fileField, text);
+
+		wfree(path);
+		wfree(text);
+	}
+}
+
+static void handleDirectoryNotify(int fd, int mask, void *clientData)
+{
+	char buf[(sizeof(struct inotify_event) + NAME_MAX + 1) * 8];
+	struct inotify_event *event;
+	W_DirListing *listing;
+	WMArrayIterator iter;
+	ssize_t len, i;
+	Bool overflow = False;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) mask;
+	(void) clientData;
+
+	len = read(fd, buf, sizeof(buf));
+	for (i = 0; i < len; i += sizeof(struct inotify_event) + event->len) {
+		event = (struct inotify_event *)&buf[i];
+
+		/* events were lost, so nothing in the cache can be trusted */
+		if (event->mask & IN_Q_OVERFLOW)
+			overflow = True;
+
+		WM_ITERATE_ARRAY(dirCache, listing, iter) {
+			if (overflow || listing->watch == event->wd)
+				listing->valid = False;
+		}
+	}
+
+	if (overflow)
+		reloadFilePanels();
+}
+#endif
+
+static char *directoryKey(const char *path)
+{
+	char *key;
+	int len;
+
+	key = wstrdup(path);
+	len = strlen(key);
+	while (len > 1 && key[len - 1] == '/')
+		key[--len] = '\0';
+
+	return key;
+}
+
+static void freeDirectoryListing(W_DirListing *listing)
+{
+	W_DirEntry *entry;
+	WMArrayIterator iter;
+
+#ifdef HAVE_INOTIFY
+	if (listing->watch >= 0) {
+		W_DirListing *other;
+		Bool shared = False;
+
+		/* the same directory may be reached through different paths */
+		if (dirCache) {
+			WM_ITERATE_ARRAY(dirCache, other, iter) {
+				if (other != listing && other->watch == listing->watch)
+					shared = True;
+			}
+		}
+		if (!shared)
+			inotify_rm_watch(dirNotifyFD, listing->watch);
+	}
+#endif
+
+	WM_ITERATE_ARRAY(listing->entries, entry, iter) {
+		wfree(entry->name);
+		wfree(entry);
+	}
+	WMFreeArray(listing->entries);
+	wfree(listing->path);
+	wfree(listing);
+}
+
+static W_DirListing *createDirectoryListing(const char *path)
+{
+	W_DirListing *listing;
+	struct stat stat_buf;
+
+	listing = wmalloc(sizeof(W_DirListing));
+	listing->path = directoryKey(path);
+	listing->entries = WMCreateArray(64);
+	listing->watch = -1;
+	listing->valid = True;
+
+	if (stat(path, &stat_buf) == 0)
+		listing->mtime = stat_buf.st_mtime;
+
+	return listing;
+}
+
+static void removeDirectoryListing(W_DirListing *listing)
+{
+	WMRemoveFromArray(dirCache, listing);
+	freeDirectoryListing(listing);
+}
+
+static W_DirListing *findDirectoryListing(const char *path)
+{
+	W_DirListing *listing;
+	WMArrayIterator iter;
+	char *key;
+
+	if (!dirCache)
+		return NULL;
+
+	key = directoryKey(path);
+	WM_ITERATE_ARRAY(dirCache, listing, iter) {
+		if (strcmp(listing->path, key) == 0)
+			break;
+	}
+	wfree(key);
+
+	if (!listing)
+		return NULL;
+
+#ifndef HAVE_INOTIFY
+	if (listing->valid) {
+		struct stat stat_buf;
+
+		if (stat(listing->path, &stat_buf) != 0 || stat_buf.st_mtime != listing->mtime)
+			listing->valid = False;
+	}
+#endif
+
+	if (!listing->valid) {
+		removeDirectoryListing(listing);
+		return NULL;
+	}
+
+	/* move it at the end, as the most recently used */
+	WMRemoveFromArray(dirCache, listing);
+	WMAddToArray(dirCache, listing);
+
+	return listing;
+}
+
+static void invalidateDirectoryListing(const char *path)
+{
+	W_DirListing *listing;
+	WMArrayIterator iter;
+	char *key;
+
+	if (!dirCache)
+		return;
+
+	key = directoryKey(path);
+	WM_ITERATE_ARRAY(dirCache, listing, iter) {
+		if (strcmp(listing->path, key) == 0) {
+			removeDirectoryListing(listing);
+			break;
+		}
+	}
+	wfree(key);
+}
+
+#define CAST(item) (*((W_DirEntry**)item))
+static int entryComparer(const void *a, const void *b)
+{
+	if (CAST(a)->isDirectory == CAST(b)->isDirectory)
+		return (strcmp(CAST(a)->name, CAST(b)->name));
+	if (CAST(a)->isDirectory)
+		return (-1);
+	return (1);
+}
+
+#undef CAST
+
+static void storeDirectoryListing(W_DirListing *listing)
+{
+	WMSortArray(listing->entries, entryComparer);
+
+	if (!dirCache)
+		dirCache = WMCreateArray(DIR_CACHE_SIZE);
+
+	invalidateDirectoryListing(listing->path);
+
+#ifdef HAVE_INOTIFY
+	if (dirNotifyFD < 0) {
+		dirNotifyFD = inotify_init();
+		if (dirNotifyFD >= 0) {
+			fcntl(dirNotifyFD, F_SETFD, FD_CLOEXEC);
+			WMAddInputHandler(dirNotifyFD, WIReadMask, handleDirectoryNotify, NULL);
+		}
+	}
+	if (dirNotifyFD >= 0)
+		listing->watch = inotify_add_watch(dirNotifyFD, listing->path,
+						   IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+						   | IN_DELETE_SELF | IN_MOVE_SELF);
+	/* without a watch, there would be no way to know when it changes */
+	if (listing->watch < 0) {
+		freeDirectoryListing(listing);
+		return;
+	}
+#endif
+
+	if (WMGetArrayItemCount(dirCache) >= DIR_CACHE_SIZE)
+		removeDirectoryListing(WMGetFromArray(dirCache, 0));
+
+	WMAddToArray(dirCache, listing);
+}
+
+/*
+ * Read up to `count' entries of `dir' (all of them if `count' is negative)
+ * into the listing and the browser column. The type of the entries is
+ * taken from readdir when the filesystem provides it, otherwise they have
+ * to be stat'ed. Returns True when the whole directory was read.
+ */
+static Bool readDirectoryEntries(WMBrowser * bPtr, int column, W_DirListing * listing, DIR * dir, int count)
 {
-	WMBrowser *bPtr = panel->browser;
 	struct dirent *dentry;
-	DIR *dir;
 	struct stat stat_buf;
 	char pbuf[PATH_MAX + 16];
+	W_DirEntry *entry;
+	int isDirectory;
+
+	while (count != 0 && (dentry = readdir(dir))) {
+		if (strcmp(dentry->d_name, ".") == 0 || strcmp(dentry->d_name, "..") == 0)
+			continue;
+
+#ifdef DT_UNKNOWN
+		if (dentry->d_type != DT_UNKNOWN && dentry->d_type != DT_LNK) {
+			isDirectory = (dentry->d_type == DT_DIR);
+		} else
+#endif
+		{
+			if (wstrlcpy(pbuf, listing->path, sizeof(pbuf)) >= sizeof(pbuf))
+				continue;
+			if (strcmp(listing->path, "/") != 0 &&
+			    wstrlcat(pbuf, "/", sizeof(pbuf)) >= sizeof(pbuf))
+				continue;
+			if (wstrlcat(pbuf, dentry->d_name, sizeof(pbuf)) >= sizeof(pbuf))
+				continue;
+
+			if (stat(pbuf, &stat_buf) != 0) {
+#ifdef VERBOSE
+				printf(_("WINGs: could not stat %s\n"), pbuf);
+#endif
+				continue;
+			}
+			isDirectory = S_ISDIR(stat_buf.st_mode);
+		}
+
+		entry = wmalloc(sizeof(W_DirEntry));
+		entry->name = wstrdup(dentry->d_name);
+		entry->isDirectory = isDirectory;
+		WMAddToArray(listing->entries, entry);
+
+		WMInsertBrowserItem(bPtr, column, -1, dentry->d_name, isDirectory);
+
+		if (count > 0)
+			count--;
+	}
+
+	return (count != 0);
+}
+
+static void freeDirectoryLoader(W_DirLoader *loader)
+{
+	WMRemoveFromArray(loader->panel->loaders, loader);
+	if (loader->handler)
+		WMDeleteIdleHandler(loader->handler);
+	closedir(loader->dir);
+	wfree(loader);
+}
+
+static void cancelDirectoryLoaders(WMFilePanel * panel, int column)
+{
+	W_DirLoader *loader;
+	int i;
+
+	for (i = WMGetArrayItemCount(panel->loaders) - 1; i >= 0; i--) {
+		loader = WMGetFromArray(panel->loaders, i);
+		if (loader->column >= column) {
+			freeDirectoryListing(loader->listing);
+			freeDirectoryLoader(loader);
+		}
+	}
+}
+
+static void loadDirectoryChunk(void *data)
+{
+	W_DirLoader *loader = (W_DirLoader *) data;
+	WMBrowser *bPtr = loader->panel->browser;
+
+	loader->handler = NULL;
+
+	/* the column went away in the meantime */
+	if (loader->column >= WMGetBrowserNumberOfColumns(bPtr)) {
+		freeDirectoryListing(loader->listing);
+		freeDirectoryLoader(loader);
+		return;
+	}
+
+	if (readDirectoryEntries(bPtr, loader->column, loader->listing, loader->dir, DIR_CHUNK_SIZE)) {
+		WMSortBrowserColumnWithComparer(bPtr, loader->column, comparer);
+		storeDirectoryListing(loader->listing);
+		freeDirectoryLoader(loader);
+		return;
+	}
+
+	WMSortBrowserColumnWithComparer(bPtr, loader->column, comparer);
+	loader->handler = WMAddIdleHandler(loadDirectoryChunk, loader);
+}
+
+static void listDirectoryOnColumn(WMFilePanel * panel, int column, const char *path)
+{
+	WMBrowser *bPtr = panel->browser;
+	W_DirListing *listing;
+	W_DirLoader *loader;
+	W_DirEntry *entry;
+	WMArrayIterator iter;
+	DIR *dir;
 	char *name;
 
 	assert(column >= 0);
 	assert(path != NULL);
 
+	cancelDirectoryLoaders(panel, column);
+
 	/* put directory name in the title */
 	name = get_name_from_path(path);
 	WMSetBrowserColumnTitle(bPtr, column, name);
 	wfree(name);
 
+	listing = findDirectoryListing(path);
+	if (listing) {
+		WM_ITERATE_ARRAY(listing->entries, entry, iter)
+			WMInsertBrowserItem(bPtr, column, -1, entry->name, entry->isDirectory);
+		return;
+	}
+
 	dir = opendir(path);
 
 	if (!dir) {
@@ -508,35 +916,28 @@ static void listDirectoryOnColumn(WMFilePanel * panel, int column, const char *p
 		return;
 	}
 
-	/* list contents in the column */
-	while ((dentry = readdir(dir))) {
-		if (strcmp(dentry->d_name, ".") == 0 || strcmp(dentry->d_name, "..") == 0)
-			continue;
-
-		if (wstrlcpy(pbuf, path, sizeof(pbuf)) >= sizeof(pbuf))
-			goto out;
-		if (strcmp(path, "/") != 0 &&
-		    wstrlcat(pbuf, "/", sizeof(pbuf)) >= sizeof(pbuf))
-			goto out;
-		if (wstrlcat(pbuf, dentry->d_name, sizeof(pbuf)) >= sizeof(pbuf))
-			goto out;
-
-		if (stat(pbuf, &stat_buf) != 0) {
-#ifdef VERBOSE
-			printf(_("WINGs: could not stat %s\n"), pbuf);
-#endif
-			continue;
-		} else {
-			int isDirectory;
+	/* list contents in the column, small directories are read at once while
+	 * the others are completed in the background to not freeze the panel */
+	listing = createDirectoryListing(path);
 
-			isDirectory = S_ISDIR(stat_buf.st_mode);
-			WMInsertBrowserItem(bPtr, column, -1, dentry->d_name, isDirectory);
-		}
+	if (panel->flags.loadSynchronously || column == 0 ||
+	    readDirectoryEntries(bPtr, column, listing, dir, DIR_CHUNK_SIZE)) {
+		readDirectoryEntries(bPtr, column, listing, dir, -1);
+		WMSortBrowserColumnWithComparer(bPtr, column, comparer);
+		storeDirectoryListing(listing);
+		closedir(dir);
+		return;
 	}
+
 	WMSortBrowserColumnWithComparer(bPtr, column, comparer);
 
-out:
-	closedir(dir);
+	loader = wmalloc(sizeof(W_DirLoader));
+	loader->panel = panel;
+	loader->column = column;
+	loader->dir = dir;
+	loader->listing = listing;
+	loader->handler = WMAddIdleHandler(loadDirectoryChunk, loader);
+	WMAddToArray(panel->loaders, loader);
 }
 
 static void fillColumn(WMBrowserDelegate * self, WMBrowser * bPtr, int column, WMList * list)
@@ -641,6 +1042,13 @@ static void createDir(WMWidget *widget, void *p_panel)
 		wfree(buffer);
 #undef __msgbufsize__
 	} else {
+		char *s = strrchr(file, '/');
+
+		if (s) {
+			*s = '\0';
+			invalidateDirectoryListing(s == file ? "/" : file);
+			*s = '/';
+		}
 		WMSetFilePanelDirectory(panel, file);
 	}
 
@@ -723,6 +1131,7 @@ static void deleteFile(WMWidget *widget, void *p_panel)
 			char *s = strrchr(file, '/');
 			if (s)
 				s[0] = 0;
+			invalidateDirectoryListing(file[0] ? file : "/");
 			WMSetFilePanelDirectory(panel, file);
 		}
 
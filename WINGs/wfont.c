@@ -22,6 +22,179 @@
 
 #define DEFAULT_SIZE WINGsConfiguration.defaultFontSize
 
+/* Number of strings of which each font remembers the glyphs and width */
+#define TEXT_RUN_CACHE_SIZE 256
+
+/* Longer strings are not cached, they are seldom measured twice */
+#define TEXT_RUN_MAX_LENGTH 256
+
+/*
+ * The glyphs of a string and its width, as computed by Xft or Pango.
+ * Titles, menu entries and list rows are measured and drawn again and
+ * again, each font keeps the most recent ones to avoid shaping them
+ * each time.
+ */
+typedef struct W_TextRun {
+	char *text;		/* key, not nul terminated */
+	int length;
+
+	int width;
+#ifdef USE_PANGO
+	PangoLayout *layout;
+#else
+	FT_UInt *glyphs;
+	int nglyphs;
+#endif
+
+	struct W_TextRun *prev;
+	struct W_TextRun *next;
+} W_TextRun;
+
+static unsigned hashTextRun(const void *key)
+{
+	const W_TextRun *run = key;
+	unsigned hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < run->length; i++) {
+		hash ^= (unsigned char)run->text[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static Bool compareTextRuns(const void *key1, const void *key2)
+{
+	const W_TextRun *run1 = key1;
+	const W_TextRun *run2 = key2;
+
+	return run1->length == run2->length && memcmp(run1->text, run2->text, run1->length) == 0;
+}
+
+static const WMHashTableCallbacks textRunCallbacks = {
+	hashTextRun,
+	compareTextRuns,
+	NULL,
+	NULL
+};
+
+static void unlinkTextRun(WMFont *font, W_TextRun *run)
+{
+	if (run->prev)
+		run->prev->next = run->next;
+	else
+		font->firstRun = run->next;
+
+	if (run->next)
+		run->next->prev = run->prev;
+	else
+		font->lastRun = run->prev;
+}
+
+static void linkTextRunFirst(WMFont *font, W_TextRun *run)
+{
+	run->prev = NULL;
+	run->next = font->firstRun;
+	if (font->firstRun)
+		font->firstRun->prev = run;
+	font->firstRun = run;
+	if (!font->lastRun)
+		font->lastRun = run;
+}
+
+static void freeTextRun(WMFont *font, W_TextRun *run)
+{
+	WMHashRemove(font->textRuns, run);
+	unlinkTextRun(font, run);
+	font->runCount--;
+
+#ifdef USE_PANGO
+	g_object_unref(run->layout);
+#else
+	if (run->glyphs)
+		wfree(run->glyphs);
+#endif
+	wfree(run->text);
+	wfree(run);
+}
+
+static void freeTextRuns(WMFont *font)
+{
+	while (font->firstRun)
+		freeTextRun(font, font->firstRun);
+
+	WMFreeHashTable(font->textRuns);
+	font->textRuns = NULL;
+}
+
+/*
+ * Returns the glyphs and width of the string from the cache of the font,
+ * computing them if needed, or NULL if the string is too long to be kept.
+ */
+static W_TextRun *getTextRun(WMFont *font, const char *text, int length)
+{
+	W_TextRun key, *run;
+#ifndef USE_PANGO
+	XGlyphInfo extents;
+	FcChar32 ucs4;
+	int size, max;
+#endif
+
+	key.text = (char *)text;
+	key.length = length;
+	run = WMHashGet(font->textRuns, &key);
+	if (run) {
+		font->runHits++;
+		if (run != font->firstRun) {
+			unlinkTextRun(font, run);
+			linkTextRunFirst(font, run);
+		}
+		return run;
+	}
+
+	font->runMisses++;
+	if (length > TEXT_RUN_MAX_LENGTH)
+		return NULL;
+
+	while (font->runCount >= TEXT_RUN_CACHE_SIZE)
+		freeTextRun(font, font->lastRun);
+
+	run = wmalloc(sizeof(W_TextRun));
+	run->text = wmalloc(length + 1);
+	memcpy(run->text, text, length);
+	run->length = length;
+
+#ifdef USE_PANGO
+	run->layout = pango_layout_copy(font->layout);
+	pango_layout_set_text(run->layout, text, length);
+	pango_layout_get_pixel_size(run->layout, &run->width, NULL);
+#else
+	/* same as XftTextExtentsUtf8 and XftDrawStringUtf8 do */
+	max = 0;
+	while (length > 0 && (size = FcUtf8ToUcs4((const FcChar8 *)text, &ucs4, length)) > 0) {
+		if (run->nglyphs == max) {
+			max = max ? max * 2 : 16;
+			run->glyphs = wrealloc(run->glyphs, max * sizeof(FT_UInt));
+		}
+		run->glyphs[run->nglyphs++] = XftCharIndex(font->screen->display, font->font, ucs4);
+		text += size;
+		length -= size;
+	}
+
+	if (run->nglyphs > 0) {
+		XftGlyphExtents(font->screen->display, font->font, run->glyphs, run->nglyphs, &extents);
+		run->width = extents.xOff;	/* don't ask :P */
+	}
+#endif
+
+	WMHashInsert(font->textRuns, run, run);
+	linkTextRunFirst(font, run);
+	font->runCount++;
+
+	return run;
+}
+
 static FcPattern *xlfdToFcPattern(const char *xlfd)
 {
 	FcPattern *pattern;
@@ -170,6 +343,8 @@ WMFont *WMCreateFont(WMScreen * scrPtr, const char *fontName)
 
 	font->name = fname;
 
+	font->textRuns = WMCreateHashTable(textRunCallbacks);
+
 #ifdef USE_PANGO
 	fontmap = pango_xft_get_font_map(scrPtr->display, scrPtr->screen);
 	context = pango_font_map_create_context(fontmap);
@@ -209,6 +384,7 @@ void WMReleaseFont(WMFont * font)
 
 	font->refCount--;
 	if (font->refCount < 1) {
+		freeTextRuns(font);
 		XftFontClose(font->screen->display, font->font);
 		if (font->name) {
 			WMHashRemove(font->screen->fontCache, font->name);
@@ -295,6 +471,7 @@ WMFont *WMBoldSystemFontOfSize(WMScreen * scrPtr, int size)
 
 int WMWidthOfString(WMFont * font, const char *text, int length)
 {
+	W_TextRun *run;
 #ifdef USE_PANGO
 	const char *previous_text;
 	int width;
@@ -303,6 +480,11 @@ int WMWidthOfString(WMFont * font, const char *text, int length)
 #endif
 
 	wassertrv(font != NULL && text != NULL, 0);
+
+	run = getTextRun(font, text, length);
+	if (run)
+		return run->width;
+
 #ifdef USE_PANGO
 	previous_text = pango_layout_get_text(font->layout);
 	if ((previous_text == NULL) || (strncmp(text, previous_text, length) != 0) || previous_text[length] != '\0')
@@ -317,13 +499,105 @@ int WMWidthOfString(WMFont * font, const char *text, int length)
 #endif
 }
 
-void WMDrawString(WMScreen * scr, Drawable d, WMColor * color, WMFont * font, int x, int y, const char *text, int length)
+void WMGetStringPrefixWidths(WMFont *font, const char *text, int length, int *widths)
 {
-	XftColor xftcolor;
+	int i = 0, k, size;
+#ifdef USE_PANGO
+	PangoRectangle rect;
+#else
+	FcChar32 ucs4;
+	FT_UInt glyph;
+	XGlyphInfo extents;
+	int width = 0;
+#endif
+
+	wassertr(font != NULL && text != NULL && widths != NULL);
+
+	widths[0] = 0;
+
+#ifdef USE_PANGO
+	pango_layout_set_text(font->layout, text, length);
+
+	while (i < length) {
+		size = 1;
+		while (i + size < length && (text[i + size] & 0xc0) == 0x80)
+			size++;
+
+		for (k = 1; k < size; k++)
+			widths[i + k] = widths[i];
+		i += size;
+
+		if (i < length) {
+			pango_layout_index_to_pos(font->layout, i, &rect);
+			widths[i] = PANGO_PIXELS(rect.x);
+		} else {
+			pango_layout_get_pixel_size(font->layout, &widths[i], NULL);
+		}
+	}
+#else
+	/* the glyphs are not kerned, what Xft measures is the sum of their advances */
+	while (i < length) {
+		size = FcUtf8ToUcs4((const FcChar8 *) text + i, &ucs4, length - i);
+		if (size <= 0)
+			break;
+
+		glyph = XftCharIndex(font->screen->display, font->font, ucs4);
+		XftGlyphExtents(font->screen->display, font->font, &glyph, 1, &extents);
+		width += extents.xOff;
+
+		for (k = 1; k < size; k++)
+			widths[i + k] = widths[i];
+		i += size;
+		widths[i] = width;
+	}
+
+	/* like XftTextExtentsUtf8(), stop at what is not UTF-8 */
+	for (; i < length; i++)
+		widths[i + 1] = width;
+#endif
+}
+
+void WMGetFontCacheStatistics(WMFont *font, unsigned int *hits, unsigned int *misses)
+{
+	wassertr(font != NULL);
+
+	if (hits)
+		*hits = font->runHits;
+	if (misses)
+		*misses = font->runMisses;
+}
+
+static void drawText(WMScreen * scr, XftColor * color, WMFont * font, int x, int y, const char *text, int length)
+{
+	W_TextRun *run;
 #ifdef USE_PANGO
 	const char *previous_text;
 #endif
 
+	run = getTextRun(font, text, length);
+
+#ifdef USE_PANGO
+	if (run) {
+		pango_xft_render_layout(scr->xftdraw, color, run->layout, x * PANGO_SCALE, y * PANGO_SCALE);
+		return;
+	}
+
+	previous_text = pango_layout_get_text(font->layout);
+	if ((previous_text == NULL) || (strncmp(text, previous_text, length) != 0) || previous_text[length] != '\0')
+		pango_layout_set_text(font->layout, text, length);
+	pango_xft_render_layout(scr->xftdraw, color, font->layout, x * PANGO_SCALE, y * PANGO_SCALE);
+#else
+	if (run)
+		XftDrawGlyphs(scr->xftdraw, color, font->font, x, y + font->y, run->glyphs, run->nglyphs);
+	else
+		XftDrawStringUtf8(scr->xftdraw, color, font->font, x, y + font->y, (XftChar8 *) text, length);
+#endif
+}
+
+void WMDrawString(WMScreen * scr, Drawable d, WMColor * color, WMFont * font, int x, int y, const char *text, int length)
+{
+	XftColor xftcolor;
+
 	wassertr(font != NULL);
 
 	xftcolor.color.red = color->color.red;
@@ -334,14 +608,7 @@ void WMDrawString(WMScreen * scr, Drawable d, WMColor * color, WMFont * font, in
 
 	XftDrawChange(scr->xftdraw, d);
 
-#ifdef USE_PANGO
-	previous_text = pango_layout_get_text(font->layout);
-	if ((previous_text == NULL) || (strcmp(text, previous_text) != 0))
-		pango_layout_set_text(font->layout, text, length);
-	pango_xft_render_layout(scr->xftdraw, &xftcolor, font->layout, x * PANGO_SCALE, y * PANGO_SCALE);
-#else
-	XftDrawStringUtf8(scr->xftdraw, &xftcolor, font->font, x, y + font->y, (XftChar8 *) text, length);
-#endif
+	drawText(scr, &xftcolor, font, x, y, text, length);
 }
 
 void
@@ -350,9 +617,6 @@ WMDrawImageString(WMScreen * scr, Drawable d, WMColor * color, WMColor * backgro
 {
 	XftColor textColor;
 	XftColor bgColor;
-#ifdef USE_PANGO
-	const char *previous_text;
-#endif
 
 	wassertr(font != NULL);
 
@@ -372,14 +636,7 @@ WMDrawImageString(WMScreen * scr, Drawable d, WMColor * color, WMColor * backgro
 
 	XftDrawRect(scr->xftdraw, &bgColor, x, y, WMWidthOfString(font, text, length), font->height);
 
-#ifdef USE_PANGO
-	previous_text = pango_layout_get_text(font->layout);
-	if ((previous_text == NULL) || (strcmp(text, previous_text) != 0))
-		pango_layout_set_text(font->layout, text, length);
-	pango_xft_render_layout(scr->xftdraw, &textColor, font->layout, x * PANGO_SCALE, y * PANGO_SCALE);
-#else
-	XftDrawStringUtf8(scr->xftdraw, &textColor, font->font, x, y + font->y, (XftChar8 *) text, length);
-#endif
+	drawText(scr, &textColor, font, x, y, text, length);
 }
 
 WMFont *WMCopyFontWithStyle(WMScreen * scrPtr, WMFont * font, WMFontStyle style)
@@ -7,6 +7,10 @@
 #include <string.h>
 #include <strings.h>
 #include <stdint.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include <X11/Xft/Xft.h>
 #include <fontconfig/fontconfig.h>
@@ -38,6 +42,8 @@ typedef struct W_FontPanel {
 	WMButton *setB;
 
 	WMPropList *fdb;
+
+	char *pendingFont;	/* to select once the fonts are known */
 } FontPanel;
 
 #define MIN_UPPER_HEIGHT	20
@@ -69,6 +75,39 @@ static const int scalableFontSizes[] = {
 	64
 };
 
+typedef struct {
+	char *typeface;
+	WMArray *sizes;
+} Typeface;
+
+typedef struct {
+	char *name;		/* gotta love simplicity */
+	WMArray *typefaces;
+} Family;
+
+/*
+ * The families of the fonts known to fontconfig are indexed once for all
+ * the panels, in the background when threads are available. The index is
+ * made again only when the fontconfig configuration or font directories
+ * changed since.
+ */
+typedef struct {
+	Family **families;	/* sorted by name */
+	int count;
+} FontIndex;
+
+static FontIndex *fontIndex = NULL;
+static Bool fontIndexBuilding = False;
+
+static char *FontIndexDidChangeNotification = "_WINGS_FontIndexDidChangeNotification";
+
+#ifdef HAVE_PTHREAD
+static pthread_t fontIndexThread;
+static int fontIndexPipe[2];
+static FontIndex *builtFontIndex;
+static WMHandlerID fontIndexHandler;
+#endif
+
 static void setFontPanelFontName(FontPanel * panel, const char *family, const char *style, double size);
 
 static int isXLFD(const char *font, int *length_ret);
@@ -81,6 +120,9 @@ static void sizeClick(WMWidget *, void *);
 
 static void listFamilies(WMScreen * scr, WMFontPanel * panel);
 
+static Bool updateFontIndex(void);
+static void fontIndexObserver(void *self, WMNotification * notif);
+
 static void splitViewConstrainCallback(WMSplitView * sPtr, int indView, int *min, int *max)
 {
 	/* Parameter not used, but tell the compiler that it is ok */
@@ -293,8 +335,10 @@ WMFontPanel *WMGetFontPanel(WMScreen * scr)
 				  WMViewSizeDidChangeNotification, WMWidgetView(panel->upperF));
 	WMAddNotificationObserver(notificationObserver, panel,
 				  WMViewSizeDidChangeNotification, WMWidgetView(panel->lowerF));
+	WMAddNotificationObserver(fontIndexObserver, panel, FontIndexDidChangeNotification, NULL);
 
-	listFamilies(scr, panel);
+	if (!updateFontIndex())
+		listFamilies(scr, panel);
 
 	return panel;
 }
@@ -307,11 +351,15 @@ void WMFreeFontPanel(WMFontPanel * panel)
 	WMRemoveNotificationObserver(panel);
 	WMUnmapWidget(panel->win);
 	WMDestroyWidget(panel->win);
+	if (panel->pendingFont)
+		wfree(panel->pendingFont);
 	wfree(panel);
 }
 
 void WMShowFontPanel(WMFontPanel * panel)
 {
+	updateFontIndex();
+
 	WMMapWidget(panel->win);
 }
 
@@ -344,6 +392,17 @@ void WMSetFontPanelFont(WMFontPanel * panel, const char *fontName)
 	if (!pattern)
 		return;
 
+	if (!fontIndex) {
+		/* still being indexed, otherwise there is nothing to select it in */
+		if (fontIndexBuilding) {
+			if (panel->pendingFont)
+				wfree(panel->pendingFont);
+			panel->pendingFont = wstrdup(fontName);
+		}
+		FcPatternDestroy(pattern);
+		return;
+	}
+
 	if (FcPatternGetString(pattern, FC_FAMILY, 0, &family) == FcResultMatch)
 		if (FcPatternGetString(pattern, FC_STYLE, 0, &style) == FcResultMatch)
 			if (FcPatternGetDouble(pattern, "pixelsize", 0, &size) == FcResultMatch)
@@ -412,16 +471,6 @@ static int isXLFD(const char *font, int *length_ret)
 	return c == NUM_FIELDS;
 }
 
-typedef struct {
-	char *typeface;
-	WMArray *sizes;
-} Typeface;
-
-typedef struct {
-	char *name;		/* gotta love simplicity */
-	WMArray *typefaces;
-} Family;
-
 static int compare_int(const void *a, const void *b)
 {
 	int i1 = *(int *)a;
@@ -481,119 +530,272 @@ static void addTypefaceToXftFamily(Family * fam, const char *style)
 	WMAddToArray(fam->typefaces, face);
 }
 
-/*
- * families (same family name) (Hashtable of family -> array)
- * 	registries (same family but different registries)
- *
- */
-static void addFontToXftFamily(WMHashTable * families, const char *name, const char *style)
+static void getSelectedFont(FontPanel * panel, char buffer[], int bufsize)
 {
-	WMArrayIterator i;
-	WMArray *array;
-	Family *fam;
-
-	array = WMHashGet(families, name);
-	if (array) {
-		WM_ITERATE_ARRAY(array, fam, i) {
-			if (strcmp(fam->name, name) == 0)
-				addTypefaceToXftFamily(fam, style);
-			return;
-		}
-	}
+	WMListItem *item;
+	Family *family;
+	Typeface *face;
+	char *size;
 
-	array = WMCreateArray(8);
+	item = WMGetListSelectedItem(panel->famLs);
+	if (!item)
+		return;
+	family = (Family *) item->clientData;
 
-	fam = wmalloc(sizeof(Family));
+	item = WMGetListSelectedItem(panel->typLs);
+	if (!item)
+		return;
+	face = (Typeface *) item->clientData;
 
-	fam->name = wstrdup(name);
+	size = WMGetTextFieldText(panel->sizT);
 
-	addTypefaceToXftFamily(fam, style);
+	snprintf(buffer, bufsize, "%s:style=%s:pixelsize=%s", family->name, face->typeface, size);
 
-	WMAddToArray(array, fam);
+	wfree(size);
+}
 
-	WMHashInsert(families, fam->name, array);
+static int compare_family(const void *a, const void *b)
+{
+	return strcmp((*(Family **) a)->name, (*(Family **) b)->name);
 }
 
-static void listFamilies(WMScreen * scr, WMFontPanel * panel)
+static FontIndex *buildFontIndex(void)
 {
 	FcObjectSet *os = 0;
 	FcFontSet *fs;
 	FcPattern *pat;
 	WMHashTable *families;
 	WMHashEnumerator enumer;
-	WMArray *array;
+	FontIndex *index;
+	Family *fam;
 	int i;
 
 	pat = FcPatternCreate();
 	os = FcObjectSetBuild(FC_FAMILY, FC_STYLE, NULL);
 	fs = FcFontList(0, pat, os);
-	if (!fs) {
-		WMRunAlertPanel(scr, panel->win, _("Error"),
-				_("Could not init font config library\n"), _("OK"), NULL, NULL);
-		return;
-	}
 	if (pat)
 		FcPatternDestroy(pat);
+	if (os)
+		FcObjectSetDestroy(os);
+	if (!fs)
+		return NULL;
 
 	families = WMCreateHashTable(WMStringPointerHashCallbacks);
 
-	if (fs) {
-		for (i = 0; i < fs->nfont; i++) {
-			FcChar8 *family;
-			FcChar8 *style;
+	for (i = 0; i < fs->nfont; i++) {
+		FcChar8 *family;
+		FcChar8 *style;
+
+		if (FcPatternGetString(fs->fonts[i], FC_FAMILY, 0, &family) != FcResultMatch)
+			continue;
+		if (FcPatternGetString(fs->fonts[i], FC_STYLE, 0, &style) != FcResultMatch)
+			continue;
 
-			if (FcPatternGetString(fs->fonts[i], FC_FAMILY, 0, &family) == FcResultMatch)
-				if (FcPatternGetString(fs->fonts[i], FC_STYLE, 0, &style) == FcResultMatch)
-					addFontToXftFamily(families, (char *)family, (char *)style);
+		fam = WMHashGet(families, family);
+		if (!fam) {
+			fam = wmalloc(sizeof(Family));
+			fam->name = wstrdup((char *)family);
+			WMHashInsert(families, fam->name, fam);
 		}
-		FcFontSetDestroy(fs);
+		addTypefaceToXftFamily(fam, (char *)style);
 	}
+	FcFontSetDestroy(fs);
+
+	index = wmalloc(sizeof(FontIndex));
+	index->families = wmalloc(sizeof(Family *) * (WMCountHashTable(families) + 1));
 
 	enumer = WMEnumerateHashTable(families);
+	while ((fam = WMNextHashEnumeratorItem(&enumer)))
+		index->families[index->count++] = fam;
+	WMFreeHashTable(families);
 
-	while ((array = WMNextHashEnumeratorItem(&enumer))) {
-		WMArrayIterator i;
-		Family *fam;
-		char buffer[256];
-		WMListItem *item;
+	qsort(index->families, index->count, sizeof(Family *), compare_family);
 
-		WM_ITERATE_ARRAY(array, fam, i) {
-			wstrlcpy(buffer, fam->name, sizeof(buffer));
-			item = WMAddListItem(panel->famLs, buffer);
+	return index;
+}
 
-			item->clientData = fam;
-		}
+static void freeFontIndex(FontIndex * index)
+{
+	WMArrayIterator iter;
+	Typeface *face;
+	int i;
 
-		WMFreeArray(array);
+	if (!index)
+		return;
+
+	for (i = 0; i < index->count; i++) {
+		WM_ITERATE_ARRAY(index->families[i]->typefaces, face, iter) {
+			wfree(face->typeface);
+			WMFreeArray(face->sizes);
+			wfree(face);
+		}
+		WMFreeArray(index->families[i]->typefaces);
+		wfree(index->families[i]->name);
+		wfree(index->families[i]);
 	}
+	wfree(index->families);
+	wfree(index);
+}
 
-	WMSortListItems(panel->famLs);
+static void installFontIndex(FontIndex * index)
+{
+	FontIndex *old = fontIndex;
 
-	WMFreeHashTable(families);
+	/* keep the fonts known so far if they could not be listed again */
+	if (index)
+		fontIndex = index;
+	else
+		old = NULL;
+	fontIndexBuilding = False;
+
+	/* the panels stop using the old index when notified */
+	WMPostNotificationName(FontIndexDidChangeNotification, NULL, NULL);
+
+	freeFontIndex(old);
 }
 
-static void getSelectedFont(FontPanel * panel, char buffer[], int bufsize)
+#ifdef HAVE_PTHREAD
+static void *fontIndexThreadProc(void *data)
 {
-	WMListItem *item;
-	Family *family;
-	Typeface *face;
-	char *size;
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
 
-	item = WMGetListSelectedItem(panel->famLs);
-	if (!item)
-		return;
-	family = (Family *) item->clientData;
+	builtFontIndex = buildFontIndex();
 
-	item = WMGetListSelectedItem(panel->typLs);
-	if (!item)
+	if (write(fontIndexPipe[1], "", 1) < 0)
+		werror("could not notify that the font index is ready");
+
+	return NULL;
+}
+
+static void fontIndexReady(int fd, int mask, void *data)
+{
+	char c;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) mask;
+	(void) data;
+
+	if (read(fd, &c, 1) < 0)
 		return;
-	face = (Typeface *) item->clientData;
 
-	size = WMGetTextFieldText(panel->sizT);
+	WMDeleteInputHandler(fontIndexHandler);
+	fontIndexHandler = NULL;
+	pthread_join(fontIndexThread, NULL);
+	close(fontIndexPipe[0]);
+	close(fontIndexPipe[1]);
 
-	snprintf(buffer, bufsize, "%s:style=%s:pixelsize=%s", family->name, face->typeface, size);
+	/* try again from here, like when there are no threads */
+	if (!builtFontIndex)
+		builtFontIndex = buildFontIndex();
 
-	wfree(size);
+	installFontIndex(builtFontIndex);
+	builtFontIndex = NULL;
+}
+#endif
+
+/*
+ * Makes the font index if there is none yet or if fontconfig changed.
+ * Returns True if it is being made, the panels will be notified once it
+ * is ready, which may have already happened when it returns.
+ */
+static Bool updateFontIndex(void)
+{
+	if (fontIndexBuilding)
+		return True;
+
+	if (fontIndex) {
+		if (FcConfigUptoDate(NULL))
+			return False;
+		FcInitBringUptoDate();
+	}
+
+	fontIndexBuilding = True;
+
+#ifdef HAVE_PTHREAD
+	if (pipe(fontIndexPipe) == 0) {
+		if (pthread_create(&fontIndexThread, NULL, fontIndexThreadProc, NULL) == 0) {
+			fontIndexHandler = WMAddInputHandler(fontIndexPipe[0], WIReadMask, fontIndexReady, NULL);
+			return True;
+		}
+		close(fontIndexPipe[0]);
+		close(fontIndexPipe[1]);
+	}
+#endif
+
+	installFontIndex(buildFontIndex());
+
+	return True;
+}
+
+static int findFamilyRow(const char *name)
+{
+	int low = 0, high = fontIndex ? fontIndex->count : 0, mid, cmp;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		cmp = strcmp(fontIndex->families[mid]->name, name);
+		if (cmp == 0)
+			return mid;
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return -1;
+}
+
+static void fillFamilyItem(WMList * lPtr, int row, WMListItem * item, void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) lPtr;
+	(void) data;
+
+	item->text = wstrdup(fontIndex->families[row]->name);
+	item->clientData = fontIndex->families[row];
+}
+
+/* show the families of the index, keeping the font selected if possible */
+static void listFamilies(WMScreen * scr, WMFontPanel * panel)
+{
+	char *font = panel->pendingFont;
+
+	panel->pendingFont = NULL;
+	if (!font && WMGetListSelectedItem(panel->typLs)) {
+		char buffer[512];
+
+		buffer[0] = 0;
+		getSelectedFont(panel, buffer, sizeof(buffer));
+		font = wstrdup(buffer);
+	}
+
+	WMClearList(panel->typLs);
+	WMClearList(panel->sizLs);
+
+	if (!fontIndex) {
+		WMClearList(panel->famLs);
+		WMRunAlertPanel(scr, panel->win, _("Error"),
+				_("Could not init font config library\n"), _("OK"), NULL, NULL);
+	} else {
+		/* the list only makes the items of the families shown */
+		WMSetListDataSource(panel->famLs, fontIndex->count, fillFamilyItem, panel);
+		if (font)
+			WMSetFontPanelFont(panel, font);
+	}
+
+	if (font)
+		wfree(font);
+}
+
+static void fontIndexObserver(void *self, WMNotification * notif)
+{
+	WMFontPanel *panel = (WMFontPanel *) self;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) notif;
+
+	listFamilies(WMWidgetScreen(panel->win), panel);
 }
 
 static void preview(FontPanel * panel)
@@ -755,7 +957,7 @@ static void setFontPanelFontName(FontPanel * panel, const char *family, const ch
 	Typeface *face;
 	WMArrayIterator i;
 
-	famrow = WMFindRowOfListItemWithTitle(panel->famLs, family);
+	famrow = findFamilyRow(family);
 	if (famrow < 0) {
 		famrow = 0;
 		return;
@@ -0,0 +1,190 @@
+/*
+ * Table of the data associated to X windows
+ *
+ * Open addressed, with linear probing, so a lookup is a couple of memory
+ * accesses instead of going through Xlib's context manager, which locks
+ * the display and hashes into a small table of chained buckets. Each
+ * window has a slot per role, so the same window can be looked up for
+ * different purposes, like with different XContexts.
+ */
+
+#include "WINGsP.h"
+
+#include <string.h>
+
+#define INITIAL_SIZE	64	/* must be a power of 2 */
+
+
+struct W_WindowTable {
+	unsigned roles;
+	unsigned size;		/* no of entries, a power of 2 */
+	unsigned count;		/* no of entries in use */
+
+	Window *windows;	/* None for unused entries */
+	void **data;		/* roles slots per entry */
+};
+
+
+static unsigned hashWindow(Window window)
+{
+	unsigned long h = window;
+
+	/* XIDs are mostly sequential, with the client id in the high bits */
+	h ^= h >> 16;
+	h *= 0x45d9f3bUL;
+	h ^= h >> 16;
+
+	return (unsigned)h;
+}
+
+static unsigned findEntry(WMWindowTable * table, Window window)
+{
+	unsigned mask = table->size - 1;
+	unsigned i = hashWindow(window) & mask;
+
+	while (table->windows[i] != None && table->windows[i] != window)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+static void grow(WMWindowTable * table)
+{
+	Window *windows = table->windows;
+	void **data = table->data;
+	unsigned i, j, size = table->size;
+
+	table->size *= 2;
+	table->windows = wmalloc(table->size * sizeof(Window));
+	table->data = wmalloc(table->size * table->roles * sizeof(void *));
+
+	for (i = 0; i < size; i++) {
+		if (windows[i] == None)
+			continue;
+
+		j = findEntry(table, windows[i]);
+		table->windows[j] = windows[i];
+		memcpy(&table->data[j * table->roles], &data[i * table->roles], table->roles * sizeof(void *));
+	}
+
+	wfree(windows);
+	wfree(data);
+}
+
+/* free the entry i, moving back the entries that probed past it */
+static void removeEntry(WMWindowTable * table, unsigned i)
+{
+	unsigned mask = table->size - 1;
+	unsigned j = i, k;
+
+	for (;;) {
+		j = (j + 1) & mask;
+		if (table->windows[j] == None)
+			break;
+
+		k = hashWindow(table->windows[j]) & mask;
+		/* the entry can be moved to i if its home is not in ]i, j] */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		table->windows[i] = table->windows[j];
+		memcpy(&table->data[i * table->roles], &table->data[j * table->roles],
+		       table->roles * sizeof(void *));
+		i = j;
+	}
+
+	table->windows[i] = None;
+	memset(&table->data[i * table->roles], 0, table->roles * sizeof(void *));
+	table->count--;
+}
+
+WMWindowTable *WMCreateWindowTable(int roles)
+{
+	WMWindowTable *table;
+
+	wassertrv(roles > 0, NULL);
+
+	table = wmalloc(sizeof(WMWindowTable));
+	table->roles = roles;
+	table->size = INITIAL_SIZE;
+	table->windows = wmalloc(table->size * sizeof(Window));
+	table->data = wmalloc(table->size * table->roles * sizeof(void *));
+
+	return table;
+}
+
+void WMFreeWindowTable(WMWindowTable * table)
+{
+	wfree(table->windows);
+	wfree(table->data);
+	wfree(table);
+}
+
+void *WMWindowTableGet(WMWindowTable * table, Window window, int role)
+{
+	unsigned i;
+
+	if (window == None)
+		return NULL;
+
+	i = findEntry(table, window);
+	if (table->windows[i] == None)
+		return NULL;
+
+	return table->data[i * table->roles + role];
+}
+
+void *WMWindowTableInsert(WMWindowTable * table, Window window, int role, void *data)
+{
+	void *old;
+	unsigned i;
+
+	wassertrv(role >= 0 && role < table->roles, NULL);
+
+	if (window == None)
+		return NULL;
+
+	if (!data)
+		return WMWindowTableRemove(table, window, role);
+
+	/* keep the table at most half full, for short probes */
+	if (2 * (table->count + 1) > table->size)
+		grow(table);
+
+	i = findEntry(table, window);
+	if (table->windows[i] == None) {
+		table->windows[i] = window;
+		table->count++;
+	}
+
+	old = table->data[i * table->roles + role];
+	table->data[i * table->roles + role] = data;
+
+	return old;
+}
+
+void *WMWindowTableRemove(WMWindowTable * table, Window window, int role)
+{
+	void *old;
+	unsigned i, r;
+
+	wassertrv(role >= 0 && role < table->roles, NULL);
+
+	if (window == None)
+		return NULL;
+
+	i = findEntry(table, window);
+	if (table->windows[i] == None)
+		return NULL;
+
+	old = table->data[i * table->roles + role];
+	table->data[i * table->roles + role] = NULL;
+
+	for (r = 0; r < table->roles; r++) {
+		if (table->data[i * table->roles + r])
+			return old;
+	}
+	removeEntry(table, i);
+
+	return old;
+}
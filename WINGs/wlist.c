@@ -1,15 +1,39 @@
 
 #include "WINGsP.h"
 
+#include <stdint.h>
+
 char *WMListDidScrollNotification = "WMListDidScrollNotification";
 char *WMListSelectionDidChangeNotification = "WMListSelectionDidChangeNotification";
 
+/* a row materialized for a list whose rows come from a data source */
+typedef struct W_ListRow {
+	int row;
+	WMListItem *item;
+} ListRow;
+
 typedef struct W_List {
 	W_Class widgetClass;
 	W_View *view;
 
 	WMArray *items;		/* list of WMListItem */
-	WMArray *selectedItems;	/* list of selected WMListItems */
+	WMArray *selectedItems;	/* list of selected WMListItems, made on demand */
+
+	WMRange *selection;	/* selected rows, as sorted disjoint ranges */
+	int selectionCount;	/* no of ranges in selection */
+	int selectionSize;
+	int selectedRows;	/* no of rows selected */
+	int anchorRow;		/* row where the current selection started */
+	int firstRow;		/* the first row selected of those still selected,
+				 * or the lowest one once it is unselected */
+
+	WMHashTable *titleIndex;	/* title -> first row with it + 1 */
+
+	int rowCount;		/* no of rows, when they come from fillItem */
+	WMListFillItemProc *fillItem;
+	void *fillData;
+	ListRow *rowCache;	/* materialized rows, indexed by row % rowCacheSize */
+	int rowCacheSize;
 
 	short itemHeight;
 
@@ -41,6 +65,8 @@ typedef struct W_List {
 		unsigned int redrawPending:1;
 		unsigned int buttonPressed:1;
 		unsigned int buttonWasPressed:1;
+		unsigned int virtual:1;	/* rows come from fillItem */
+		unsigned int selectedItemsValid:1;
 	} flags;
 } List;
 
@@ -49,6 +75,9 @@ typedef struct W_List {
 
 #define SCROLL_DELAY    100
 
+/* lists with less rows than this are searched by title without an index */
+#define TITLE_INDEX_THRESHOLD	64
+
 static void destroyList(List * lPtr);
 static void paintList(List * lPtr);
 
@@ -66,7 +95,7 @@ static void toggleItemSelection(WMList * lPtr, int index);
 static void updateGeometry(WMList * lPtr);
 static void didResizeList(W_ViewDelegate * self, WMView * view);
 
-static void unselectAllListItems(WMList * lPtr, WMListItem * exceptThis);
+static void unselectAllListItems(WMList * lPtr, int exceptRow);
 
 static W_ViewDelegate _ListViewDelegate = {
 	NULL,
@@ -107,6 +136,326 @@ static void releaseItem(void *data)
 	wfree(item);
 }
 
+static int numberOfRows(List * lPtr)
+{
+	if (lPtr->flags.virtual)
+		return lPtr->rowCount;
+
+	return WMGetArrayItemCount(lPtr->items);
+}
+
+/* index of the first selected range ending after row */
+static int findSelectedRange(List * lPtr, int row)
+{
+	int low = 0, high = lPtr->selectionCount, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (lPtr->selection[mid].position + lPtr->selection[mid].count <= row)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static Bool isRowSelected(List * lPtr, int row)
+{
+	int i = findSelectedRange(lPtr, row);
+
+	return (i < lPtr->selectionCount && lPtr->selection[i].position <= row);
+}
+
+static void fillRow(List * lPtr, int row, WMListItem * item)
+{
+	memset(item, 0, sizeof(WMListItem));
+
+	(*lPtr->fillItem) (lPtr, row, item, lPtr->fillData);
+	if (!item->text)
+		item->text = wstrdup("");
+
+	item->selected = isRowSelected(lPtr, row);
+}
+
+static void forgetRowCache(List * lPtr)
+{
+	int i;
+
+	for (i = 0; i < lPtr->rowCacheSize; i++) {
+		if (lPtr->rowCache[i].item)
+			releaseItem(lPtr->rowCache[i].item);
+	}
+	if (lPtr->rowCache)
+		wfree(lPtr->rowCache);
+	lPtr->rowCache = NULL;
+	lPtr->rowCacheSize = 0;
+}
+
+/*
+ * Returns the item of row, materializing it if the rows come from a
+ * data source. Materialized rows are kept in a cache big enough for all
+ * the visible rows not to evict each other.
+ */
+static WMListItem *itemAtRow(List * lPtr, int row)
+{
+	ListRow *slot;
+	int size;
+
+	if (!lPtr->flags.virtual)
+		return WMGetFromArray(lPtr->items, row);
+
+	if (row < 0 || row >= lPtr->rowCount)
+		return NULL;
+
+	size = 2 * (lPtr->fullFitLines + 2);
+	if (size < 32)
+		size = 32;
+	if (lPtr->rowCacheSize < size) {
+		forgetRowCache(lPtr);
+		lPtr->rowCache = wmalloc(size * sizeof(ListRow));
+		lPtr->rowCacheSize = size;
+	}
+
+	slot = &lPtr->rowCache[row % lPtr->rowCacheSize];
+	if (slot->item) {
+		if (slot->row == row)
+			return slot->item;
+		releaseItem(slot->item);
+	}
+
+	slot->item = wmalloc(sizeof(WMListItem));
+	slot->row = row;
+	fillRow(lPtr, slot->row, slot->item);
+
+	return slot->item;
+}
+
+static void paintItem(List * lPtr, int index);
+
+/* the selection state of count rows from first became `selected' */
+static void selectionChanged(List * lPtr, int first, int count, Bool selected)
+{
+	WMListItem *item;
+	int i, last = first + count;
+
+	lPtr->selectedRows += selected ? count : -count;
+	lPtr->flags.selectedItemsValid = 0;
+
+	if (lPtr->flags.virtual) {
+		for (i = 0; i < lPtr->rowCacheSize; i++) {
+			if (lPtr->rowCache[i].item && lPtr->rowCache[i].row >= first && lPtr->rowCache[i].row < last)
+				lPtr->rowCache[i].item->selected = selected;
+		}
+	} else {
+		for (i = first; i < last; i++) {
+			item = WMGetFromArray(lPtr->items, i);
+			item->selected = selected;
+		}
+	}
+
+	if (!lPtr->view->flags.mapped)
+		return;
+
+	if (first < lPtr->topItem)
+		first = lPtr->topItem;
+	if (last > lPtr->topItem + lPtr->fullFitLines + 1)
+		last = lPtr->topItem + lPtr->fullFitLines + 1;
+	if (last > numberOfRows(lPtr))
+		last = numberOfRows(lPtr);
+	for (i = first; i < last; i++)
+		paintItem(lPtr, i);
+}
+
+static void replaceSelectedRanges(List * lPtr, int from, int to, WMRange * ranges, int count)
+{
+	int needed = lPtr->selectionCount - (to - from) + count;
+
+	if (needed > lPtr->selectionSize) {
+		lPtr->selectionSize = needed + 8;
+		lPtr->selection = wrealloc(lPtr->selection, lPtr->selectionSize * sizeof(WMRange));
+	}
+
+	memmove(&lPtr->selection[from + count], &lPtr->selection[to],
+		(lPtr->selectionCount - to) * sizeof(WMRange));
+	memcpy(&lPtr->selection[from], ranges, count * sizeof(WMRange));
+	lPtr->selectionCount = needed;
+}
+
+/* select rows, returns whether any of them was not selected */
+static Bool selectRows(List * lPtr, int first, int count)
+{
+	WMRange merged;
+	int i, j, end, last = first + count;
+	Bool changed = False;
+
+	if (count <= 0)
+		return False;
+
+	if (lPtr->selectedRows == 0)
+		lPtr->firstRow = first;
+
+	/* ranges touching the new one are merged into it */
+	i = findSelectedRange(lPtr, first - 1);
+	merged.position = first;
+	end = last;
+	for (j = i; j < lPtr->selectionCount && lPtr->selection[j].position <= last; j++) {
+		WMRange *r = &lPtr->selection[j];
+
+		if (r->position > first) {
+			selectionChanged(lPtr, first, r->position - first, True);
+			changed = True;
+		}
+		if (r->position < merged.position)
+			merged.position = r->position;
+		if (r->position + r->count > first)
+			first = r->position + r->count;
+		if (r->position + r->count > end)
+			end = r->position + r->count;
+	}
+	if (first < last) {
+		selectionChanged(lPtr, first, last - first, True);
+		changed = True;
+	}
+	merged.count = end - merged.position;
+
+	replaceSelectedRanges(lPtr, i, j, &merged, 1);
+
+	return changed;
+}
+
+/* unselect rows, returns whether any of them was selected */
+static Bool unselectRows(List * lPtr, int first, int count)
+{
+	WMRange pieces[2];
+	int i, j, n = 0, from, to, last = first + count;
+	Bool changed = False;
+
+	if (count <= 0)
+		return False;
+
+	i = findSelectedRange(lPtr, first);
+	for (j = i; j < lPtr->selectionCount && lPtr->selection[j].position < last; j++) {
+		WMRange *r = &lPtr->selection[j];
+
+		from = WMAX(r->position, first);
+		to = WMIN(r->position + r->count, last);
+		selectionChanged(lPtr, from, to - from, False);
+		changed = True;
+
+		if (r->position < first)
+			pieces[n++] = wmkrange(r->position, first - r->position);
+		if (r->position + r->count > last)
+			pieces[n++] = wmkrange(last, r->position + r->count - last);
+	}
+
+	if (changed)
+		replaceSelectedRanges(lPtr, i, j, pieces, n);
+
+	if (lPtr->firstRow >= first && lPtr->firstRow < last)
+		lPtr->firstRow = (lPtr->selectionCount > 0 ? lPtr->selection[0].position : -1);
+
+	return changed;
+}
+
+/* count rows were inserted at row, or removed from it if count < 0 */
+static void shiftSelection(List * lPtr, int row, int count)
+{
+	WMRange pieces[2];
+	int i;
+
+	if (count < 0)
+		unselectRows(lPtr, row, -count);
+
+	i = findSelectedRange(lPtr, row);
+	if (count > 0 && i < lPtr->selectionCount && lPtr->selection[i].position < row) {
+		/* inserted in the middle of a range, split it */
+		pieces[0] = wmkrange(lPtr->selection[i].position, row - lPtr->selection[i].position);
+		pieces[1] = wmkrange(row, lPtr->selection[i].count - pieces[0].count);
+		replaceSelectedRanges(lPtr, i, i + 1, pieces, 2);
+		i++;
+	}
+	for (; i < lPtr->selectionCount; i++)
+		lPtr->selection[i].position += count;
+
+	/* ranges on both sides of removed rows may now touch */
+	i = findSelectedRange(lPtr, row - 1);
+	if (count < 0 && i + 1 < lPtr->selectionCount
+	    && lPtr->selection[i].position + lPtr->selection[i].count == lPtr->selection[i + 1].position) {
+		pieces[0] = wmkrange(lPtr->selection[i].position,
+				     lPtr->selection[i].count + lPtr->selection[i + 1].count);
+		replaceSelectedRanges(lPtr, i, i + 2, pieces, 1);
+	}
+
+	if (lPtr->anchorRow >= row)
+		lPtr->anchorRow += count;
+	if (lPtr->firstRow >= row)
+		lPtr->firstRow += count;
+	lPtr->flags.selectedItemsValid = 0;
+}
+
+/* make the selection match the selected flag of the items, after they moved */
+static void rebuildSelection(List * lPtr)
+{
+	WMListItem *item;
+	int i, count = WMGetArrayItemCount(lPtr->items);
+
+	lPtr->selectionCount = 0;
+	lPtr->selectedRows = 0;
+	for (i = 0; i < count; i++) {
+		item = WMGetFromArray(lPtr->items, i);
+		if (!item->selected)
+			continue;
+
+		if (lPtr->selectionCount > 0
+		    && lPtr->selection[lPtr->selectionCount - 1].position
+		       + lPtr->selection[lPtr->selectionCount - 1].count == i) {
+			lPtr->selection[lPtr->selectionCount - 1].count++;
+		} else {
+			WMRange range = wmkrange(i, 1);
+
+			replaceSelectedRanges(lPtr, lPtr->selectionCount, lPtr->selectionCount, &range, 1);
+		}
+		lPtr->selectedRows++;
+	}
+	lPtr->anchorRow = (lPtr->selectionCount > 0 ? lPtr->selection[0].position : -1);
+	lPtr->firstRow = lPtr->anchorRow;
+	lPtr->flags.selectedItemsValid = 0;
+}
+
+static void forgetTitleIndex(List * lPtr)
+{
+	if (lPtr->titleIndex) {
+		WMFreeHashTable(lPtr->titleIndex);
+		lPtr->titleIndex = NULL;
+	}
+}
+
+static void indexTitle(List * lPtr, const char *title, int row)
+{
+	if (!WMHashGet(lPtr->titleIndex, title))
+		WMHashInsert(lPtr->titleIndex, title, (void *)(intptr_t) (row + 1));
+}
+
+static void buildTitleIndex(List * lPtr)
+{
+	WMListItem *item, tmp;
+	int i, count = numberOfRows(lPtr);
+
+	lPtr->titleIndex = WMCreateHashTable(WMStringHashCallbacks);
+
+	for (i = 0; i < count; i++) {
+		if (lPtr->flags.virtual) {
+			fillRow(lPtr, i, &tmp);
+			indexTitle(lPtr, tmp.text, i);
+			wfree(tmp.text);
+		} else {
+			item = WMGetFromArray(lPtr->items, i);
+			indexTitle(lPtr, item->text, i);
+		}
+	}
+}
+
 WMList *WMCreateList(WMWidget * parent)
 {
 	List *lPtr;
@@ -135,6 +484,9 @@ WMList *WMCreateList(WMWidget * parent)
 
 	lPtr->items = WMCreateArrayWithDestructor(4, releaseItem);
 	lPtr->selectedItems = WMCreateArray(4);
+	lPtr->flags.selectedItemsValid = 1;
+	lPtr->anchorRow = -1;
+	lPtr->firstRow = -1;
 
 	/* create the vertical scroller */
 	lPtr->vScroller = WMCreateScroller(lPtr);
@@ -170,15 +522,28 @@ static int comparator(const void *a, const void *b)
 
 void WMSortListItems(WMList * lPtr)
 {
-	WMSortArray(lPtr->items, comparator);
-
-	paintList(lPtr);
+	WMSortListItemsWithComparer(lPtr, comparator);
 }
 
 void WMSortListItemsWithComparer(WMList * lPtr, WMCompareDataProc * func)
 {
+	WMListItem *first;
+
+	/* the data source decides of the order of its rows */
+	if (lPtr->flags.virtual)
+		return;
+
+	first = (lPtr->firstRow >= 0 ? WMGetFromArray(lPtr->items, lPtr->firstRow) : NULL);
+
 	WMSortArray(lPtr->items, func);
 
+	forgetTitleIndex(lPtr);
+	rebuildSelection(lPtr);
+
+	/* the first selected item moved with the others */
+	if (first)
+		lPtr->firstRow = WMGetFirstInArray(lPtr->items, first);
+
 	paintList(lPtr);
 }
 
@@ -187,16 +552,23 @@ WMListItem *WMInsertListItem(WMList * lPtr, int row, const char *text)
 	WMListItem *item;
 
 	CHECK_CLASS(lPtr, WC_List);
+	wassertrv(!lPtr->flags.virtual, NULL);
 
 	item = wmalloc(sizeof(WMListItem));
 	item->text = wstrdup(text);
 
 	row = WMIN(row, WMGetArrayItemCount(lPtr->items));
 
-	if (row < 0)
+	if (row < 0 || row == WMGetArrayItemCount(lPtr->items)) {
+		/* appending is the common case, it keeps the title index valid */
+		if (lPtr->titleIndex)
+			indexTitle(lPtr, item->text, WMGetArrayItemCount(lPtr->items));
 		WMAddToArray(lPtr->items, item);
-	else
+	} else {
+		forgetTitleIndex(lPtr);
+		shiftSelection(lPtr, row, 1);
 		WMInsertInArray(lPtr->items, row, item);
+	}
 
 	/* update the scroller when idle, so that we don't waste time
 	 * updating it when another item is going to be added later */
@@ -209,21 +581,20 @@ WMListItem *WMInsertListItem(WMList * lPtr, int row, const char *text)
 
 void WMRemoveListItem(WMList * lPtr, int row)
 {
-	WMListItem *item;
 	int topItem = lPtr->topItem;
 	int selNotify = 0;
 
 	CHECK_CLASS(lPtr, WC_List);
+	wassertr(!lPtr->flags.virtual);
 
 	/*wassertr(row>=0 && row<WMGetArrayItemCount(lPtr->items)); */
 	if (row < 0 || row >= WMGetArrayItemCount(lPtr->items))
 		return;
 
-	item = WMGetFromArray(lPtr->items, row);
-	if (item->selected) {
-		WMRemoveFromArray(lPtr->selectedItems, item);
+	if (isRowSelected(lPtr, row))
 		selNotify = 1;
-	}
+	shiftSelection(lPtr, row, -1);
+	forgetTitleIndex(lPtr);
 
 	if (row <= lPtr->topItem + lPtr->fullFitLines + lPtr->flags.dontFitAll)
 		lPtr->topItem--;
@@ -245,7 +616,7 @@ void WMRemoveListItem(WMList * lPtr, int row)
 
 WMListItem *WMGetListItem(WMList * lPtr, int row)
 {
-	return WMGetFromArray(lPtr->items, row);
+	return itemAtRow(lPtr, row);
 }
 
 WMArray *WMGetListItems(WMList * lPtr)
@@ -273,11 +644,27 @@ void WMSetListUserDrawItemHeight(WMList * lPtr, unsigned short height)
 
 void WMClearList(WMList * lPtr)
 {
-	int selNo = WMGetArrayItemCount(lPtr->selectedItems);
+	int selNo = lPtr->selectedRows;
 
+	if (lPtr->flags.virtual) {
+		forgetRowCache(lPtr);
+		WMFreeArray(lPtr->selectedItems);
+		lPtr->selectedItems = WMCreateArray(4);
+		lPtr->flags.virtual = 0;
+		lPtr->rowCount = 0;
+		lPtr->fillItem = NULL;
+		lPtr->fillData = NULL;
+	}
 	WMEmptyArray(lPtr->selectedItems);
 	WMEmptyArray(lPtr->items);
 
+	lPtr->selectionCount = 0;
+	lPtr->selectedRows = 0;
+	lPtr->anchorRow = -1;
+	lPtr->firstRow = -1;
+	lPtr->flags.selectedItemsValid = 1;
+	forgetTitleIndex(lPtr);
+
 	lPtr->topItem = 0;
 
 	if (!lPtr->idleID) {
@@ -308,21 +695,105 @@ void WMSetListDoubleAction(WMList * lPtr, WMAction * action, void *clientData)
 	lPtr->doubleClientData = clientData;
 }
 
+void WMSetListDataSource(WMList * lPtr, int rowCount, WMListFillItemProc * proc, void *clientData)
+{
+	CHECK_CLASS(lPtr, WC_List);
+	wassertr(proc != NULL);
+
+	if (!lPtr->flags.virtual) {
+		WMClearList(lPtr);
+		WMFreeArray(lPtr->selectedItems);
+		lPtr->selectedItems = WMCreateArrayWithDestructor(4, releaseItem);
+		lPtr->flags.virtual = 1;
+	}
+	lPtr->fillItem = proc;
+	lPtr->fillData = clientData;
+
+	WMReloadListData(lPtr, rowCount);
+}
+
+void WMReloadListData(WMList * lPtr, int rowCount)
+{
+	int selNo = lPtr->selectedRows;
+
+	if (!lPtr->flags.virtual)
+		return;
+
+	forgetRowCache(lPtr);
+	forgetTitleIndex(lPtr);
+
+	if (rowCount < 0)
+		rowCount = 0;
+	if (rowCount < lPtr->rowCount)
+		unselectRows(lPtr, rowCount, lPtr->rowCount - rowCount);
+	lPtr->rowCount = rowCount;
+	lPtr->flags.selectedItemsValid = 0;
+
+	if (lPtr->topItem + lPtr->fullFitLines > rowCount)
+		lPtr->topItem = WMAX(0, rowCount - lPtr->fullFitLines);
+
+	if (!lPtr->idleID) {
+		lPtr->idleID = WMAddIdleHandler((WMCallback *) updateScroller, lPtr);
+	}
+	if (selNo != lPtr->selectedRows) {
+		WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
+	}
+}
+
 WMArray *WMGetListSelectedItems(WMList * lPtr)
 {
+	WMListItem *item;
+	int i, row;
+
+	if (lPtr->flags.selectedItemsValid)
+		return lPtr->selectedItems;
+
+	WMEmptyArray(lPtr->selectedItems);
+	for (i = 0; i < lPtr->selectionCount; i++) {
+		for (row = lPtr->selection[i].position;
+		     row < lPtr->selection[i].position + lPtr->selection[i].count; row++) {
+			if (lPtr->flags.virtual) {
+				/* own copies, cached rows do not live long enough */
+				item = wmalloc(sizeof(WMListItem));
+				fillRow(lPtr, row, item);
+			} else {
+				item = WMGetFromArray(lPtr->items, row);
+			}
+			WMAddToArray(lPtr->selectedItems, item);
+		}
+	}
+	lPtr->flags.selectedItemsValid = 1;
+
 	return lPtr->selectedItems;
 }
 
 WMListItem *WMGetListSelectedItem(WMList * lPtr)
 {
-	return WMGetFromArray(lPtr->selectedItems, 0);
+	int row = WMGetListSelectedItemRow(lPtr);
+
+	return (row != WLNotFound ? itemAtRow(lPtr, row) : NULL);
 }
 
 int WMGetListSelectedItemRow(WMList * lPtr)
 {
-	WMListItem *item = WMGetFromArray(lPtr->selectedItems, 0);
+	return (lPtr->selectedRows > 0 ? lPtr->firstRow : WLNotFound);
+}
+
+int WMGetListNumberOfSelectedRows(WMList * lPtr)
+{
+	return lPtr->selectedRows;
+}
 
-	return (item != NULL ? WMGetFirstInArray(lPtr->items, item) : WLNotFound);
+WMRange *WMGetListSelectedRanges(WMList * lPtr, int *count)
+{
+	*count = lPtr->selectionCount;
+
+	return lPtr->selection;
+}
+
+Bool WMIsListRowSelected(WMList * lPtr, int row)
+{
+	return isRowSelected(lPtr, row);
 }
 
 int WMGetListItemHeight(WMList * lPtr)
@@ -333,8 +804,8 @@ int WMGetListItemHeight(WMList * lPtr)
 void WMSetListPosition(WMList * lPtr, int row)
 {
 	lPtr->topItem = row;
-	if (lPtr->topItem + lPtr->fullFitLines > WMGetArrayItemCount(lPtr->items))
-		lPtr->topItem = WMGetArrayItemCount(lPtr->items) - lPtr->fullFitLines;
+	if (lPtr->topItem + lPtr->fullFitLines > numberOfRows(lPtr))
+		lPtr->topItem = numberOfRows(lPtr) - lPtr->fullFitLines;
 
 	if (lPtr->topItem < 0)
 		lPtr->topItem = 0;
@@ -345,7 +816,7 @@ void WMSetListPosition(WMList * lPtr, int row)
 
 void WMSetListBottomPosition(WMList * lPtr, int row)
 {
-	if (WMGetArrayItemCount(lPtr->items) > lPtr->fullFitLines) {
+	if (numberOfRows(lPtr) > lPtr->fullFitLines) {
 		lPtr->topItem = row - lPtr->fullFitLines;
 		if (lPtr->topItem < 0)
 			lPtr->topItem = 0;
@@ -356,7 +827,7 @@ void WMSetListBottomPosition(WMList * lPtr, int row)
 
 int WMGetListNumberOfRows(WMList * lPtr)
 {
-	return WMGetArrayItemCount(lPtr->items);
+	return numberOfRows(lPtr);
 }
 
 int WMGetListPosition(WMList * lPtr)
@@ -376,7 +847,7 @@ Bool WMListAllowsEmptySelection(WMList * lPtr)
 
 static void scrollByAmount(WMList * lPtr, int amount)
 {
-	int itemCount = WMGetArrayItemCount(lPtr->items);
+	int itemCount = numberOfRows(lPtr);
 
 	if ((amount < 0 && lPtr->topItem > 0) || (amount > 0 && (lPtr->topItem + lPtr->fullFitLines < itemCount))) {
 
@@ -394,7 +865,7 @@ static void vScrollCallBack(WMWidget * scroller, void *self)
 {
 	WMList *lPtr = (WMList *) self;
 	int oldTopItem = lPtr->topItem;
-	int itemCount = WMGetArrayItemCount(lPtr->items);
+	int itemCount = numberOfRows(lPtr);
 
 	switch (WMGetScrollerHitPart((WMScroller *) scroller)) {
 	case WSDecrementLine:
@@ -448,7 +919,7 @@ static void paintItem(List * lPtr, int index)
 	WMListItem *itemPtr;
 	Drawable d = lPtr->doubleBuffer;
 
-	itemPtr = WMGetFromArray(lPtr->items, index);
+	itemPtr = itemAtRow(lPtr, index);
 
 	width = lPtr->view->size.width - 2 - 19;
 	height = lPtr->itemHeight;
@@ -500,10 +971,10 @@ static void paintList(List * lPtr)
 	if (!lPtr->view->flags.mapped)
 		return;
 
-	if (WMGetArrayItemCount(lPtr->items) > 0) {
-		if (lPtr->topItem + lPtr->fullFitLines + lPtr->flags.dontFitAll > WMGetArrayItemCount(lPtr->items)) {
+	if (numberOfRows(lPtr) > 0) {
+		if (lPtr->topItem + lPtr->fullFitLines + lPtr->flags.dontFitAll > numberOfRows(lPtr)) {
 
-			lim = WMGetArrayItemCount(lPtr->items) - lPtr->topItem;
+			lim = numberOfRows(lPtr) - lPtr->topItem;
 			XClearArea(scrPtr->display, lPtr->view->window, 19,
 				   2 + lim * lPtr->itemHeight, lPtr->view->size.width - 21,
 				   lPtr->view->size.height - lim * lPtr->itemHeight - 3, False);
@@ -531,7 +1002,7 @@ static void updateScroller(void *data)
 	List *lPtr = (List *) data;
 
 	float knobProportion, floatValue, tmp;
-	int count = WMGetArrayItemCount(lPtr->items);
+	int count = numberOfRows(lPtr);
 
 	if (lPtr->idleID)
 		WMDeleteIdleHandler(lPtr->idleID);
@@ -558,7 +1029,7 @@ static void scrollForwardSelecting(void *data)
 
 	lastSelected = lPtr->topItem + lPtr->fullFitLines + lPtr->flags.dontFitAll - 1;
 
-	if (lastSelected >= WMGetArrayItemCount(lPtr->items) - 1) {
+	if (lastSelected >= numberOfRows(lPtr) - 1) {
 		lPtr->selectID = NULL;
 		if (lPtr->flags.dontFitAll)
 			scrollByAmount(lPtr, 1);
@@ -567,11 +1038,9 @@ static void scrollForwardSelecting(void *data)
 
 	/* selecting NEEDS to be done before scrolling to avoid flickering */
 	if (lPtr->flags.allowMultipleSelection) {
-		WMListItem *item;
 		WMRange range;
 
-		item = WMGetFromArray(lPtr->selectedItems, 0);
-		range.position = WMGetFirstInArray(lPtr->items, item);
+		range.position = lPtr->anchorRow;
 		if (lastSelected + 1 >= range.position) {
 			range.count = lastSelected - range.position + 2;
 		} else {
@@ -597,11 +1066,9 @@ static void scrollBackwardSelecting(void *data)
 
 	/* selecting NEEDS to be done before scrolling to avoid flickering */
 	if (lPtr->flags.allowMultipleSelection) {
-		WMListItem *item;
 		WMRange range;
 
-		item = WMGetFromArray(lPtr->selectedItems, 0);
-		range.position = WMGetFirstInArray(lPtr->items, item);
+		range.position = lPtr->anchorRow;
 		if (lPtr->topItem - 1 >= range.position) {
 			range.count = lPtr->topItem - range.position;
 		} else {
@@ -646,20 +1113,39 @@ static int matchTitle(const void *item, const void *title)
 
 int WMFindRowOfListItemWithTitle(WMList * lPtr, const char *title)
 {
-	/*
-	 * We explicitely discard the 'const' attribute here because the
-	 * call-back function handler must not be made with a const
-	 * attribute, but our local call-back function (above) does have
-	 * it properly set, so we're consistent
-	 */
-	return WMFindInArray(lPtr->items, matchTitle, (char *) title);
+	WMListItem *item;
+	int row;
+
+	if (!lPtr->flags.virtual && WMGetArrayItemCount(lPtr->items) < TITLE_INDEX_THRESHOLD) {
+		/*
+		 * We explicitely discard the 'const' attribute here because the
+		 * call-back function handler must not be made with a const
+		 * attribute, but our local call-back function (above) does have
+		 * it properly set, so we're consistent
+		 */
+		return WMFindInArray(lPtr->items, matchTitle, (char *) title);
+	}
+
+	if (!lPtr->titleIndex)
+		buildTitleIndex(lPtr);
+
+	row = (int)(intptr_t) WMHashGet(lPtr->titleIndex, title) - 1;
+	if (row < 0 || lPtr->flags.virtual)
+		return (row < 0 ? WLNotFound : row);
+
+	/* the text of an item may have been changed behind our back */
+	item = WMGetFromArray(lPtr->items, row);
+	if (strcmp(item->text, title) != 0) {
+		forgetTitleIndex(lPtr);
+		return WMFindInArray(lPtr->items, matchTitle, (char *) title);
+	}
+
+	return row;
 }
 
 void WMSelectListItem(WMList * lPtr, int row)
 {
-	WMListItem *item;
-
-	if (row >= WMGetArrayItemCount(lPtr->items))
+	if (row >= numberOfRows(lPtr))
 		return;
 
 	if (row < 0) {
@@ -669,52 +1155,40 @@ void WMSelectListItem(WMList * lPtr, int row)
 		return;
 	}
 
-	item = WMGetFromArray(lPtr->items, row);
-	if (item->selected)
+	if (isRowSelected(lPtr, row))
 		return;		/* Return if already selected */
 
 	if (!lPtr->flags.allowMultipleSelection) {
 		/* unselect previous selected items */
-		unselectAllListItems(lPtr, NULL);
+		unselectAllListItems(lPtr, -1);
 	}
+	if (lPtr->selectedRows == 0)
+		lPtr->anchorRow = row;
 
 	/* select item */
-	item->selected = 1;
-	WMAddToArray(lPtr->selectedItems, item);
-
-	if (lPtr->view->flags.mapped && row >= lPtr->topItem && row <= lPtr->topItem + lPtr->fullFitLines) {
-		paintItem(lPtr, row);
-	}
+	selectRows(lPtr, row, 1);
 
 	WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
 }
 
 void WMUnselectListItem(WMList * lPtr, int row)
 {
-	WMListItem *item = WMGetFromArray(lPtr->items, row);
-
-	if (!item || !item->selected)
+	if (!isRowSelected(lPtr, row))
 		return;
 
-	if (!lPtr->flags.allowEmptySelection && WMGetArrayItemCount(lPtr->selectedItems) <= 1) {
+	if (!lPtr->flags.allowEmptySelection && lPtr->selectedRows <= 1) {
 		return;
 	}
 
-	item->selected = 0;
-	WMRemoveFromArray(lPtr->selectedItems, item);
-
-	if (lPtr->view->flags.mapped && row >= lPtr->topItem && row <= lPtr->topItem + lPtr->fullFitLines) {
-		paintItem(lPtr, row);
-	}
+	unselectRows(lPtr, row, 1);
 
 	WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
 }
 
 void WMSelectListItemsInRange(WMList * lPtr, WMRange range)
 {
-	WMListItem *item;
-	int position = range.position, k = 1, notify = 0;
-	int total = WMGetArrayItemCount(lPtr->items);
+	int total = numberOfRows(lPtr);
+	int start = range.position, wasEmpty = (lPtr->selectedRows == 0);
 
 	if (!lPtr->flags.allowMultipleSelection)
 		return;
@@ -723,34 +1197,30 @@ void WMSelectListItemsInRange(WMList * lPtr, WMRange range)
 
 	if (range.count < 0) {
 		range.count = -range.count;
-		k = -1;
+		range.position = range.position - range.count + 1;
 	}
-
-	for (; range.count > 0 && position >= 0 && position < total; range.count--) {
-		item = WMGetFromArray(lPtr->items, position);
-		if (!item->selected) {
-			item->selected = 1;
-			WMAddToArray(lPtr->selectedItems, item);
-			if (lPtr->view->flags.mapped && position >= lPtr->topItem
-			    && position <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, position);
-			}
-			notify = 1;
-		}
-		position += k;
+	if (range.position < 0) {
+		range.count += range.position;
+		range.position = 0;
 	}
+	if (range.position + range.count > total)
+		range.count = total - range.position;
 
-	if (notify) {
+	if (lPtr->selectedRows == 0)
+		lPtr->anchorRow = range.position;
+
+	if (selectRows(lPtr, range.position, range.count)) {
+		/* they are selected from where the range starts */
+		if (wasEmpty)
+			lPtr->firstRow = WMIN(WMAX(start, range.position), range.position + range.count - 1);
 		WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
 	}
 }
 
 void WMSetListSelectionToRange(WMList * lPtr, WMRange range)
 {
-	WMListItem *item;
-	int mark1, mark2, i, k;
-	int position = range.position, notify = 0;
-	int total = WMGetArrayItemCount(lPtr->items);
+	int mark1, mark2, notify = 0;
+	int total = numberOfRows(lPtr);
 
 	if (!lPtr->flags.allowMultipleSelection)
 		return;
@@ -763,55 +1233,26 @@ void WMSetListSelectionToRange(WMList * lPtr, WMRange range)
 	if (range.count < 0) {
 		mark1 = range.position + range.count + 1;
 		mark2 = range.position + 1;
-		range.count = -range.count;
-		k = -1;
 	} else {
 		mark1 = range.position;
 		mark2 = range.position + range.count;
-		k = 1;
 	}
-	if (mark1 > total)
-		mark1 = total;
-	if (mark2 < 0)
-		mark2 = 0;
+	if (mark1 < 0)
+		mark1 = 0;
+	if (mark2 > total)
+		mark2 = total;
+	if (mark2 < mark1)
+		mark2 = mark1;
 
-	WMEmptyArray(lPtr->selectedItems);
+	lPtr->anchorRow = range.position;
 
-	for (i = 0; i < mark1; i++) {
-		item = WMGetFromArray(lPtr->items, i);
-		if (item->selected) {
-			item->selected = 0;
-			if (lPtr->view->flags.mapped && i >= lPtr->topItem
-			    && i <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, i);
-			}
-			notify = 1;
-		}
-	}
-	for (; range.count > 0 && position >= 0 && position < total; range.count--) {
-		item = WMGetFromArray(lPtr->items, position);
-		if (!item->selected) {
-			item->selected = 1;
-			if (lPtr->view->flags.mapped && position >= lPtr->topItem
-			    && position <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, position);
-			}
-			notify = 1;
-		}
-		WMAddToArray(lPtr->selectedItems, item);
-		position += k;
-	}
-	for (i = mark2; i < total; i++) {
-		item = WMGetFromArray(lPtr->items, i);
-		if (item->selected) {
-			item->selected = 0;
-			if (lPtr->view->flags.mapped && i >= lPtr->topItem
-			    && i <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, i);
-			}
-			notify = 1;
-		}
-	}
+	notify |= unselectRows(lPtr, 0, mark1);
+	notify |= selectRows(lPtr, mark1, mark2 - mark1);
+	notify |= unselectRows(lPtr, mark2, total - mark2);
+
+	/* they are selected from where the range starts */
+	if (mark2 > mark1)
+		lPtr->firstRow = WMIN(WMAX(range.position, mark1), mark2 - 1);
 
 	if (notify) {
 		WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
@@ -820,29 +1261,17 @@ void WMSetListSelectionToRange(WMList * lPtr, WMRange range)
 
 void WMSelectAllListItems(WMList * lPtr)
 {
-	int i;
-	WMListItem *item;
-
 	if (!lPtr->flags.allowMultipleSelection)
 		return;
 
-	if (WMGetArrayItemCount(lPtr->items) == WMGetArrayItemCount(lPtr->selectedItems)) {
+	if (numberOfRows(lPtr) == lPtr->selectedRows) {
 		return;		/* All items are selected already */
 	}
 
-	WMFreeArray(lPtr->selectedItems);
-	lPtr->selectedItems = WMCreateArrayWithArray(lPtr->items);
+	if (lPtr->selectedRows == 0)
+		lPtr->anchorRow = 0;
 
-	for (i = 0; i < WMGetArrayItemCount(lPtr->items); i++) {
-		item = WMGetFromArray(lPtr->items, i);
-		if (!item->selected) {
-			item->selected = 1;
-			if (lPtr->view->flags.mapped && i >= lPtr->topItem
-			    && i <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, i);
-			}
-		}
-	}
+	selectRows(lPtr, 0, numberOfRows(lPtr));
 
 	WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
 }
@@ -852,47 +1281,37 @@ void WMSelectAllListItems(WMList * lPtr)
  * allowEmptySelection flag and doesn't send a notification about selection
  * change! You need to manage these in the functions from where you call it.
  *
- * This will unselect all items if exceptThis is NULL, else will keep
- * exceptThis selected.
- * Make sure that exceptThis is one of the already selected items if not NULL!
+ * This will unselect all items if exceptRow is -1, else will keep
+ * exceptRow selected.
+ * Make sure that exceptRow is one of the already selected rows if not -1!
  *
  */
-static void unselectAllListItems(WMList * lPtr, WMListItem * exceptThis)
+static void unselectAllListItems(WMList * lPtr, int exceptRow)
 {
-	int i;
-	WMListItem *item;
+	WMRange *range;
 
-	for (i = 0; i < WMGetArrayItemCount(lPtr->items); i++) {
-		item = WMGetFromArray(lPtr->items, i);
-		if (item != exceptThis && item->selected) {
-			item->selected = 0;
-			if (lPtr->view->flags.mapped && i >= lPtr->topItem
-			    && i <= lPtr->topItem + lPtr->fullFitLines) {
-				paintItem(lPtr, i);
-			}
-		}
+	/* only the selected rows are visited */
+	while (lPtr->selectionCount > 0) {
+		range = &lPtr->selection[lPtr->selectionCount - 1];
+		unselectRows(lPtr, range->position, range->count);
 	}
 
-	WMEmptyArray(lPtr->selectedItems);
-	if (exceptThis != NULL) {
-		exceptThis->selected = 1;
-		WMAddToArray(lPtr->selectedItems, exceptThis);
+	if (exceptRow >= 0) {
+		selectRows(lPtr, exceptRow, 1);
+		lPtr->anchorRow = exceptRow;
 	}
 }
 
 void WMUnselectAllListItems(WMList * lPtr)
 {
 	int keep;
-	WMListItem *keepItem;
 
 	keep = lPtr->flags.allowEmptySelection ? 0 : 1;
 
-	if (WMGetArrayItemCount(lPtr->selectedItems) == keep)
+	if (lPtr->selectedRows == keep)
 		return;
 
-	keepItem = (keep == 1 ? WMGetFromArray(lPtr->selectedItems, 0) : NULL);
-
-	unselectAllListItems(lPtr, keepItem);
+	unselectAllListItems(lPtr, keep == 1 ? WMGetListSelectedItemRow(lPtr) : -1);
 
 	WMPostNotificationName(WMListSelectionDidChangeNotification, lPtr, NULL);
 }
@@ -903,7 +1322,7 @@ static int getItemIndexAt(List * lPtr, int clickY)
 
 	index = (clickY - 2) / lPtr->itemHeight + lPtr->topItem;
 
-	if (index < 0 || index >= WMGetArrayItemCount(lPtr->items))
+	if (index < 0 || index >= numberOfRows(lPtr))
 		return -1;
 
 	return index;
@@ -911,9 +1330,7 @@ static int getItemIndexAt(List * lPtr, int clickY)
 
 static void toggleItemSelection(WMList * lPtr, int index)
 {
-	WMListItem *item = WMGetFromArray(lPtr->items, index);
-
-	if (item && item->selected) {
+	if (isRowSelected(lPtr, index)) {
 		WMUnselectListItem(lPtr, index);
 	} else {
 		WMSelectListItem(lPtr, index);
@@ -1012,16 +1429,14 @@ static void handleActionEvents(XEvent * event, void *data)
 					}
 				} else {
 					WMRange range;
-					WMListItem *lastSel;
 
 					if (event->xbutton.state & ControlMask) {
 						toggleItemSelection(lPtr, tmp);
 					} else if (event->xbutton.state & ShiftMask) {
-						if (WMGetArrayItemCount(lPtr->selectedItems) == 0) {
+						if (lPtr->selectedRows == 0) {
 							WMSelectListItem(lPtr, tmp);
 						} else {
-							lastSel = WMGetFromArray(lPtr->items, lastClicked);
-							range.position = WMGetFirstInArray(lPtr->items, lastSel);
+							range.position = lastClicked;
 							if (tmp >= range.position)
 								range.count = tmp - range.position + 1;
 							else
@@ -1090,8 +1505,8 @@ static void updateGeometry(WMList * lPtr)
 		lPtr->flags.dontFitAll = 0;
 	}
 
-	if (WMGetArrayItemCount(lPtr->items) - lPtr->topItem <= lPtr->fullFitLines) {
-		lPtr->topItem = WMGetArrayItemCount(lPtr->items) - lPtr->fullFitLines;
+	if (numberOfRows(lPtr) - lPtr->topItem <= lPtr->fullFitLines) {
+		lPtr->topItem = numberOfRows(lPtr) - lPtr->fullFitLines;
 		if (lPtr->topItem < 0)
 			lPtr->topItem = 0;
 	}
@@ -1126,6 +1541,12 @@ static void destroyList(List * lPtr)
 	if (lPtr->selectedItems)
 		WMFreeArray(lPtr->selectedItems);
 
+	if (lPtr->selection)
+		wfree(lPtr->selection);
+
+	forgetTitleIndex(lPtr);
+	forgetRowCache(lPtr);
+
 	if (lPtr->items)
 		WMFreeArray(lPtr->items);
 
@@ -75,7 +75,8 @@ typedef struct _TextBlock {
 	int script:8;		/* script in points: negative for subscript */
 	unsigned int marginN:8;	/* which of the margins in the tPtr to use */
 	unsigned int nClicks:2;	/* single, double, triple clicks */
-	unsigned int RESERVED:7;
+	unsigned int laidOut:1;	/* sections are up to date */
+	unsigned int RESERVED:6;
 } TextBlock;
 
 /* I'm lazy: visible.h vs. visible.size.height :-) */
@@ -122,6 +123,11 @@ typedef struct W_Text {
 	TextBlock *lastTextBlock;
 	TextBlock *currentTextBlock;
 
+	TextBlock **blockIndex;	/* all the TextBlocks, in order, to find the visible ones */
+	unsigned int nIndexed;
+	unsigned int indexSize;
+	unsigned int unlaidBlocks;	/* how many TextBlocks wait for layOut */
+
 	WMArray *gfxItems;	/* a nice array of graphic items */
 
 #if DO_BLINK
@@ -159,6 +165,7 @@ typedef struct W_Text {
 		WMReliefType relief:3;	/* the relief to display with */
 		unsigned int isOverGraphic:2;	/* the mouse is over a graphic */
 		unsigned int first:1;	/* for plain text parsing, newline? */
+		unsigned int indexValid:1;	/* blockIndex matches the TextBlocks */
 		/* unsigned int RESERVED:1; */
 	} flags;
 
@@ -266,6 +273,92 @@ static int newMargin(Text * tPtr, WMRulerMargins * margins)
 	return n;
 }
 
+/* the TextBlock changed, it must be laid out again */
+static void blockChanged(Text * tPtr, TextBlock * tb)
+{
+	if (tb->laidOut) {
+		tb->laidOut = 0;
+		tPtr->unlaidBlocks++;
+	}
+}
+
+/*
+ * blockIndex holds all the TextBlocks in document order. Their sections
+ * are sorted vertically, so the ones to paint are found with a binary
+ * search instead of walking the list. Appending keeps it up to date,
+ * other changes to the list have it rebuilt when it is next needed.
+ */
+static void indexAddedBlock(Text * tPtr, TextBlock * tb)
+{
+	if (!tPtr->flags.indexValid)
+		return;
+
+	if (tb->next || (tb->prior && (tPtr->nIndexed == 0 || tPtr->blockIndex[tPtr->nIndexed - 1] != tb->prior))) {
+		tPtr->flags.indexValid = False;
+		return;
+	}
+
+	if (tPtr->nIndexed == tPtr->indexSize) {
+		tPtr->indexSize = tPtr->indexSize ? tPtr->indexSize * 2 : 64;
+		tPtr->blockIndex = wrealloc(tPtr->blockIndex, tPtr->indexSize * sizeof(TextBlock *));
+	}
+	tPtr->blockIndex[tPtr->nIndexed++] = tb;
+}
+
+static void indexRemovedBlock(Text * tPtr, TextBlock * tb)
+{
+	if (tPtr->flags.indexValid && tPtr->nIndexed > 0 && tPtr->blockIndex[tPtr->nIndexed - 1] == tb)
+		tPtr->nIndexed--;
+	else
+		tPtr->flags.indexValid = False;
+}
+
+static void rebuildBlockIndex(Text * tPtr)
+{
+	TextBlock *tb;
+
+	tPtr->nIndexed = 0;
+	for (tb = tPtr->firstTextBlock; tb; tb = tb->next) {
+		if (tPtr->nIndexed == tPtr->indexSize) {
+			tPtr->indexSize = tPtr->indexSize ? tPtr->indexSize * 2 : 64;
+			tPtr->blockIndex = wrealloc(tPtr->blockIndex, tPtr->indexSize * sizeof(TextBlock *));
+		}
+		tPtr->blockIndex[tPtr->nIndexed++] = tb;
+	}
+	tPtr->flags.indexValid = True;
+}
+
+/* the first TextBlock that ends below the vertical position y */
+static TextBlock *findBlockAt(Text * tPtr, unsigned int y)
+{
+	unsigned int lo, hi, mid, i;
+	Section *last;
+
+	if (!tPtr->flags.indexValid)
+		rebuildBlockIndex(tPtr);
+
+	lo = 0;
+	hi = tPtr->nIndexed;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+
+		/* graphics have no sections with monoFont */
+		for (i = mid; i < hi && tPtr->blockIndex[i]->nsections < 1; i++) ;
+		if (i == hi) {
+			hi = mid;
+			continue;
+		}
+
+		last = &tPtr->blockIndex[i]->sections[tPtr->blockIndex[i]->nsections - 1];
+		if (last->_y + last->h < y)
+			lo = i + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo < tPtr->nIndexed ? tPtr->blockIndex[lo] : NULL);
+}
+
 static Bool sectionWasSelected(Text * tPtr, TextBlock * tb, XRectangle * rect, int s)
 {
 	unsigned short i, w, lw, selected = False, extend = False;
@@ -536,6 +629,7 @@ static Bool removeSelection(Text * tPtr)
 				tb->used -= (tb->s_end - tb->s_begin);
 				tb->selected = False;
 				tPtr->tpos = tb->s_begin;
+				blockChanged(tPtr, tb);
 			}
 
 		}
@@ -617,7 +711,7 @@ static void paintText(Text * tPtr)
 	TextBlock *tb;
 	WMFont *font;
 	const char *text;
-	int len, y, c, s, done = False, dir /* 1 = down */ ;
+	int len, y, c, s, done = False;
 	WMScreen *scr = tPtr->view->screen;
 	Display *dpy = tPtr->view->screen->display;
 	Window win = tPtr->view->window;
@@ -634,46 +728,14 @@ static void paintText(Text * tPtr)
 			     (tPtr->visible.h - tPtr->visible.y - tPtr->bgPixmap->height) / 2);
 	}
 
-	if (!(tb = tPtr->currentTextBlock)) {
-		if (!(tb = tPtr->firstTextBlock)) {
-			goto _copy_area;
-		}
-	}
-
-	done = False;
-
-	/* first, which direction? Don't waste time looking all over,
-	   since the parts to be drawn will most likely be near what
-	   was previously drawn */
-	if (!updateStartForCurrentTextBlock(tPtr, 0, tPtr->vpos, &dir, tb))
+	if (!tPtr->firstTextBlock)
 		goto _copy_area;
 
-	while (tb) {
-
-		if (tb->graphic && tPtr->flags.monoFont)
-			goto _getSibling;
-
-		if (dir) {
-			if (tPtr->vpos <= tb->sections[tb->nsections - 1]._y + tb->sections[tb->nsections - 1].h)
-				break;
-		} else {
-			if (tPtr->vpos >= tb->sections[tb->nsections - 1]._y + tb->sections[tb->nsections - 1].h)
-				break;
-		}
+	if (tPtr->unlaidBlocks > 0)
+		layOutDocument(tPtr);
 
- _getSibling:
-		if (dir) {
-			if (tb->next)
-				tb = tb->next;
-			else
-				break;
-		} else {
-			if (tb->prior)
-				tb = tb->prior;
-			else
-				break;
-		}
-	}
+	done = False;
+	tb = findBlockAt(tPtr, tPtr->vpos);
 
 	/* first, place all text that can be viewed */
 	while (!done && tb) {
@@ -1448,33 +1510,67 @@ static int layOutLine(Text * tPtr, myLineItems * items, int nitems, int x, int y
 
 }
 
+/* move the sections of tb and of all the TextBlocks after it */
+static void shiftBlocks(TextBlock * tb, int delta)
+{
+	int s;
+
+	for (; tb; tb = tb->next) {
+		for (s = 0; s < tb->nsections; s++) {
+			tb->sections[s].y += delta;
+			tb->sections[s]._y += delta;
+		}
+	}
+}
+
+/*
+ * When the TextBlocks were laid out before, only the ones from the line
+ * of the currentTextBlock are laid out again, until a paragraph past the
+ * edited ones is reached with nothing left waiting for layOut: paragraphs
+ * are laid out independently, so from there on the lines are the same,
+ * at most moved up or down.
+ */
 static void layOutDocument(Text * tPtr)
 {
-	TextBlock *tb;
+	TextBlock *tb, *edited;
 	myLineItems *items = NULL;
 	unsigned int itemsSize = 0, nitems = 0, begin, end;
 	WMFont *font;
 	unsigned int x, y = 0, lw = 0, width = 0, bmargin;
+	unsigned int oldDocWidth = tPtr->docWidth;
 	const char *start = NULL, *mark = NULL;
+	Bool partial, passedEdited = False, stopped = False;
 
 	if (tPtr->flags.frozen || (!(tb = tPtr->firstTextBlock)))
 		return;
 
 	assert(tPtr->visible.w > 20);
 
+ _restart:
+	tb = tPtr->firstTextBlock;
 	tPtr->docWidth = tPtr->visible.w;
 	x = tPtr->margins[tb->marginN].first;
 	bmargin = tPtr->margins[tb->marginN].body;
+	y = 0;
+	nitems = 0;
+	lw = 0;
 
 	/* only partial layOut needed: re-Lay only affected textblocks  */
-	if (tPtr->flags.laidOut) {
+	partial = tPtr->flags.laidOut && tPtr->currentTextBlock;
+	edited = tPtr->currentTextBlock;
+	if (partial) {
 		tb = tPtr->currentTextBlock;
 
+		/* new textblocks are laid out with the ones before them */
+		while (tb->prior && !tb->laidOut)
+			tb = tb->prior;
+
 		/* search backwards for textblocks on same line */
 		while (tb->prior) {
-			if (!tb->sections || tb->nsections < 1) {
+			if (!tb->sections || tb->nsections < 1 || !tb->laidOut) {
 				tb = tPtr->firstTextBlock;
 				tPtr->flags.laidOut = False;
+				partial = False;
 				y = 0;
 				goto _layOut;
 			}
@@ -1482,6 +1578,7 @@ static void layOutDocument(Text * tPtr)
 			if (!tb->prior->sections || tb->prior->nsections < 1) {
 				tb = tPtr->firstTextBlock;
 				tPtr->flags.laidOut = False;
+				partial = False;
 				y = 0;
 				goto _layOut;
 			}
@@ -1504,12 +1601,6 @@ static void layOutDocument(Text * tPtr)
  _layOut:
 	while (tb) {
 
-		if (tb->sections && tb->nsections > 0) {
-			wfree(tb->sections);
-			tb->sections = NULL;
-			tb->nsections = 0;
-		}
-
 		if (tb->first && tb->blank && tb->next && !tb->next->first) {
 			TextBlock *next = tb->next;
 			tPtr->currentTextBlock = tb;
@@ -1525,6 +1616,29 @@ static void layOutDocument(Text * tPtr)
 			bmargin = tPtr->margins[tb->marginN].body;
 			nitems = 0;
 			lw = 0;
+
+			if (partial && passedEdited && tPtr->unlaidBlocks == 0
+			    && tb->laidOut && tb->sections && tb->nsections > 0) {
+				int delta = (int)y - (int)(tb->sections[0]._y - tb->sections[0].max_d);
+
+				if (delta != 0)
+					shiftBlocks(tb, delta);
+				y = tPtr->docHeight - 10 + delta;
+				stopped = True;
+				break;
+			}
+		}
+
+		if (tb->sections && tb->nsections > 0) {
+			wfree(tb->sections);
+			tb->sections = NULL;
+			tb->nsections = 0;
+		}
+
+		if (!tb->laidOut) {
+			tb->laidOut = 1;
+			if (tPtr->unlaidBlocks > 0)
+				tPtr->unlaidBlocks--;
 		}
 
 		if (tb->graphic) {
@@ -1612,35 +1726,8 @@ static void layOutDocument(Text * tPtr)
 			}
 		}
 
-		/* not yet fully ready. but is already VERY FAST for a 3Mbyte file ;-) */
-		if (0 && tPtr->flags.laidOut
-		    && tb->next && tb->next->sections && tb->next->nsections > 0
-		    && (tPtr->vpos + tPtr->visible.h < tb->next->sections[0]._y)) {
-			if (tPtr->lastTextBlock->sections && tPtr->lastTextBlock->nsections > 0) {
-				TextBlock *ltb = tPtr->lastTextBlock;
-				int ly = ltb->sections[ltb->nsections - 1]._y;
-				int lh = ltb->sections[ltb->nsections - 1].h;
-				int ss, sd;
-
-				lh += 1 + tPtr->visible.y + ltb->sections[ltb->nsections - 1].max_d;
-				printf("it's %d\n", tPtr->visible.y + ltb->sections[ltb->nsections - 1].max_d);
-
-				y += layOutLine(tPtr, items, nitems, x, y);
-				ss = ly + lh - y;
-				sd = tPtr->docHeight - y;
-
-				printf("dif %d-%d: %d\n", ss, sd, ss - sd);
-				y += tb->next->sections[0]._y - y;
-				nitems = 0;
-				printf("nitems%d\n", nitems);
-				if (ss - sd != 0)
-					y = tPtr->docHeight + ss - sd;
-
-				break;
-			} else {
-				tPtr->flags.laidOut = False;
-			}
-		}
+		if (tb == edited)
+			passedEdited = True;
 
 		tb = tb->next;
 	}
@@ -1648,6 +1735,20 @@ static void layOutDocument(Text * tPtr)
 	if (nitems > 0)
 		y += layOutLine(tPtr, items, nitems, x, y);
 
+	if (!partial)
+		tPtr->unlaidBlocks = 0;
+
+	/* something changed before where the layOut started */
+	if (partial && tPtr->unlaidBlocks > 0) {
+		tPtr->flags.laidOut = False;
+		passedEdited = stopped = False;
+		goto _restart;
+	}
+
+	/* the widths of the graphics further down are not known */
+	if (stopped && oldDocWidth > tPtr->docWidth)
+		tPtr->docWidth = oldDocWidth;
+
 	if (tPtr->docHeight != y + 10) {
 		tPtr->docHeight = y + 10;
 		updateScrollers(tPtr);
@@ -1764,6 +1865,9 @@ static void clearText(Text * tPtr)
 	tPtr->firstTextBlock = NULL;
 	tPtr->currentTextBlock = NULL;
 	tPtr->lastTextBlock = NULL;
+	tPtr->nIndexed = 0;
+	tPtr->unlaidBlocks = 0;
+	tPtr->flags.indexValid = True;
 	WMEmptyArray(tPtr->gfxItems);
 }
 
@@ -2636,6 +2740,8 @@ static void handleEvents(XEvent * event, void *data)
 		WMFreeArray(tPtr->xdndSourceTypes);
 		WMFreeArray(tPtr->xdndDestinationTypes);
 
+		if (tPtr->blockIndex)
+			wfree(tPtr->blockIndex);
 		wfree(tPtr);
 
 		break;
@@ -3035,6 +3141,11 @@ WMText *WMCreateTextForDocumentType(WMWidget * parent, WMAction * parser, WMActi
 	tPtr->currentTextBlock = NULL;
 	tPtr->tpos = 0;
 
+	tPtr->blockIndex = NULL;
+	tPtr->nIndexed = tPtr->indexSize = 0;
+	tPtr->unlaidBlocks = 0;
+	tPtr->flags.indexValid = True;
+
 	tPtr->gfxItems = WMCreateArray(4);
 
 	tPtr->parser = parser;
@@ -3301,6 +3412,7 @@ WMSetTextBlockProperties(WMText * tPtr, void *vtb, unsigned int first,
 	tb->underlined = underlined;
 	tb->script = script;
 	tb->marginN = newMargin(tPtr, margins);
+	blockChanged(tPtr, tb);
 }
 
 void
@@ -3325,6 +3437,9 @@ WMGetTextBlockProperties(WMText * tPtr, void *vtb, unsigned int *first,
 
 static int prepareTextBlock(WMText *tPtr, TextBlock *tb)
 {
+	tb->laidOut = 0;
+	tPtr->unlaidBlocks++;
+
 	if (tb->graphic) {
 		if (tb->object) {
 			WMWidget *w = tb->d.widget;
@@ -3344,6 +3459,7 @@ static int prepareTextBlock(WMText *tPtr, TextBlock *tb)
 		tb->next = tb->prior = NULL;
 		tb->first = True;
 		tPtr->lastTextBlock = tPtr->firstTextBlock = tPtr->currentTextBlock = tb;
+		indexAddedBlock(tPtr, tb);
 		return 0;
 	}
 
@@ -3372,6 +3488,7 @@ void WMPrependTextBlock(WMText *tPtr, void *vtb)
 		tPtr->firstTextBlock = tb;
 
 	tPtr->currentTextBlock = tb;
+	indexAddedBlock(tPtr, tb);
 }
 
 void WMAppendTextBlock(WMText *tPtr, void *vtb)
@@ -3392,6 +3509,7 @@ void WMAppendTextBlock(WMText *tPtr, void *vtb)
 		tPtr->lastTextBlock = tb;
 
 	tPtr->currentTextBlock = tb;
+	indexAddedBlock(tPtr, tb);
 }
 
 void *WMRemoveTextBlock(WMText * tPtr)
@@ -3403,6 +3521,12 @@ void *WMRemoveTextBlock(WMText * tPtr)
 	}
 
 	tb = tPtr->currentTextBlock;
+	indexRemovedBlock(tPtr, tb);
+	if (tb->laidOut)
+		tb->laidOut = 0;
+	else if (tPtr->unlaidBlocks > 0)
+		tPtr->unlaidBlocks--;
+
 	if (tb->graphic) {
 		WMRemoveFromArray(tPtr->gfxItems, (void *)tb);
 
@@ -33,16 +33,46 @@ static const XSetWindowAttributes defAtts = {
 	None			/* cursor */
 };
 
-static XContext ViewContext = 0;	/* context for views */
+/* windows of different displays can have the same id, so each has a table */
+typedef struct DisplayViews {
+	Display *display;
+	WMWindowTable *table;	/* window -> view */
 
-W_View *W_GetViewForXWindow(Display * display, Window window)
+	struct DisplayViews *next;
+} DisplayViews;
+
+static DisplayViews *viewTables = NULL;
+
+static WMWindowTable *getViewTable(Display * display, Bool create)
 {
-	W_View *view;
+	DisplayViews *views;
 
-	if (XFindContext(display, window, ViewContext, (XPointer *) & view) == 0) {
-		return view;
+	for (views = viewTables; views != NULL; views = views->next) {
+		if (views->display == display)
+			return views->table;
 	}
-	return NULL;
+
+	if (!create)
+		return NULL;
+
+	views = wmalloc(sizeof(DisplayViews));
+	views->display = display;
+	views->table = WMCreateWindowTable(1);
+	views->next = viewTables;
+	viewTables = views;
+
+	return views->table;
+}
+
+W_View *W_GetViewForXWindow(Display * display, Window window)
+{
+	WMWindowTable *table;
+
+	table = getViewTable(display, False);
+	if (!table)
+		return NULL;
+
+	return WMWindowTableGet(table, window, 0);
 }
 
 static void unparentView(W_View * view)
@@ -89,9 +119,6 @@ static W_View *createView(W_Screen * screen, W_View * parent)
 {
 	W_View *view;
 
-	if (ViewContext == 0)
-		ViewContext = XUniqueContext();
-
 	view = wmalloc(sizeof(W_View));
 	view->screen = screen;
 
@@ -201,7 +228,7 @@ void W_RealizeView(W_View * view)
 					     view->screen->depth, InputOutput,
 					     view->screen->visual, view->attribFlags, &view->attribs);
 
-		XSaveContext(dpy, view->window, ViewContext, (XPointer) view);
+		WMWindowTableInsert(getViewTable(dpy, True), view->window, 0, view);
 
 		view->flags.realized = 1;
 
@@ -380,7 +407,7 @@ static void destroyView(W_View * view)
 	W_CallDestroyHandlers(view);
 
 	if (view->flags.realized) {
-		XDeleteContext(view->screen->display, view->window, ViewContext);
+		WMWindowTableRemove(getViewTable(view->screen->display, True), view->window, 0);
 
 		/* if parent is being destroyed, it will die naturaly */
 		if (!view->flags.parentDying || view->flags.topLevel)
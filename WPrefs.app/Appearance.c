@@ -195,6 +195,9 @@ typedef struct _Panel {
 
 	TexturePanel *texturePanel;
 
+	WMHandlerID previewHandler;	/* renders the previews of the texture list */
+	int previewRow;			/* where to look for the next one */
+
 	WMPixmap *onLed;
 	WMPixmap *offLed;
 	WMPixmap *hand;
@@ -226,6 +229,7 @@ typedef struct {
 	char selectedFor;
 	unsigned current:1;
 	unsigned ispixmap:1;
+	unsigned pending:1;	/* preview not made yet */
 } TextureListItem;
 
 enum {
@@ -1002,7 +1006,9 @@ static void okEditTexture(void *data)
 	wfree(titem->texture);
 	titem->texture = str;
 
-	XFreePixmap(WMScreenDisplay(WMWidgetScreen(panel->texLs)), titem->preview);
+	if (titem->preview)
+		XFreePixmap(WMScreenDisplay(WMWidgetScreen(panel->texLs)), titem->preview);
+	titem->pending = 0;
 	titem->preview = renderTexture(WMWidgetScreen(panel->texLs), titem->prop,
 				       TEXPREV_WIDTH, TEXPREV_HEIGHT, titem->path, 0);
 
@@ -1342,13 +1348,47 @@ static Pixmap loadRImage(WMScreen * scr, const char *path)
 	return pixmap;
 }
 
-static void fillTextureList(WMList * lPtr)
+/* makes the preview of one texture of the list at a time, while idle */
+static void makePendingPreview(void *data)
+{
+	_Panel *panel = (_Panel *) data;
+	WMScreen *scr = WMWidgetScreen(panel->texLs);
+	TextureListItem *titem = NULL;
+	int i, count;
+
+	panel->previewHandler = NULL;
+
+	/*
+	 * Go on from the last one made, and look at the rows before it only
+	 * when there is nothing left after it, in case some were removed.
+	 */
+	count = WMGetListNumberOfRows(panel->texLs);
+	for (i = 0; i < count; i++) {
+		titem = (TextureListItem *) WMGetListItem(panel->texLs, (panel->previewRow + i) % count)->clientData;
+		if (titem && titem->pending)
+			break;
+	}
+	if (i == count)
+		return;
+
+	panel->previewRow = (panel->previewRow + i + 1) % count;
+
+	titem->pending = 0;
+	titem->preview = loadRImage(scr, titem->path);
+	if (!titem->preview) {
+		titem->preview = renderTexture(scr, titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, NULL, 0);
+	}
+	WMRedisplayWidget(panel->texLs);
+
+	panel->previewHandler = WMAddIdleHandler(makePendingPreview, panel);
+}
+
+static void fillTextureList(_Panel * panel)
 {
 	WMPropList *textureList;
 	WMPropList *texture;
 	WMUserDefaults *udb = WMGetStandardUserDefaults();
 	TextureListItem *titem;
-	WMScreen *scr = WMWidgetScreen(lPtr);
 	int i;
 
 	textureList = WMGetUDObjectForKey(udb, "TextureList");
@@ -1368,13 +1408,15 @@ static void fillTextureList(WMList * lPtr)
 		titem->selectedFor = 0;
 		titem->path = wstrdup(WMGetFromPLString(WMGetFromPLArray(texture, 2)));
 
-		titem->preview = loadRImage(scr, titem->path);
-		if (!titem->preview) {
-			titem->preview = renderTexture(scr, titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, NULL, 0);
-		}
-		item = WMAddListItem(lPtr, "");
+		/* the previews are put in the list as they are made */
+		titem->pending = 1;
+
+		item = WMAddListItem(panel->texLs, "");
 		item->clientData = titem;
 	}
+
+	if (!panel->previewHandler)
+		panel->previewHandler = WMAddIdleHandler(makePendingPreview, panel);
 }
 
 static void fillColorList(_Panel * panel)
@@ -2081,7 +2123,7 @@ static void createPanel(Panel * p)
 
 	changePage(panel->secP, panel);
 
-	fillTextureList(panel->texLs);
+	fillTextureList(panel);
 
 	fillColorList(panel);
 
@@ -65,8 +65,14 @@ static char *WindowMakerDBPath = NULL;
 
 static Bool TIFFOK = False;
 
+/* waits for the answer of wmaker --version */
+static WMHandlerID versionHandler = NULL;
+static FILE *versionFile = NULL;
+static FILE *globalPathFile = NULL;
+
 #define INITIALIZED_PANEL	(1<<0)
 
+static void startWMakerQueries(void);
 static void loadConfigurations(WMScreen * scr, WMWindow * mainw);
 
 static void savePanelData(Panel * panel);
@@ -517,6 +523,8 @@ void Initialize(WMScreen * scr)
 	int i;
 	char *path;
 
+	startWMakerQueries();
+
 	list = RSupportedFileFormats();
 	for (i = 0; list[i] != NULL; i++) {
 		if (strcmp(list[i], "TIFF") == 0) {
@@ -596,41 +604,12 @@ WMWindow *GetWindow(void)
 	return WPrefs.win;
 }
 
-static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
+static void checkVersion(WMScreen *scr, WMWindow *mainw, FILE *file)
 {
-	WMPropList *db, *gdb;
-	char *path;
-	FILE *file;
 	char buffer[1024];
 	char mbuf[1069]; /* Size of buffer and extra characters for the sprintfs */
 	int v1, v2, v3;
 
-	path = wdefaultspathfordomain("WindowMaker");
-	WindowMakerDBPath = path;
-
-	db = WMReadPropListFromFile(path);
-	if (db) {
-		if (!WMIsPLDictionary(db)) {
-			WMReleasePropList(db);
-			db = NULL;
-			sprintf(mbuf, _("Window Maker domain (%s) is corrupted!"), path);
-			WMRunAlertPanel(scr, mainw, _("Error"), mbuf, _("OK"), NULL, NULL);
-		}
-	} else {
-		sprintf(mbuf, _("Could not load Window Maker domain (%s) from defaults database."), path);
-		WMRunAlertPanel(scr, mainw, _("Error"), mbuf, _("OK"), NULL, NULL);
-	}
-
-	path = getenv("WMAKER_BIN_NAME");
-	if (!path)
-		path = "wmaker";
-	{
-		char *command;
-
-		command = wstrconcat(path, " --version");
-		file = popen(command, "r");
-		wfree(command);
-	}
 	if (!file || !fgets(buffer, 1023, file)) {
 		werror(_("could not extract version information from Window Maker"));
 		wfatal(_("Make sure wmaker is in your search path."));
@@ -667,16 +646,91 @@ static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
 			v1, v2, v3);
 		WMRunAlertPanel(scr, mainw, _("Warning"), mbuf, _("OK"), NULL, NULL);
 	}
+}
 
-	{
-		char *command;
+static void versionReady(int fd, int mask, void *data)
+{
+	FILE *file = (FILE *) data;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) fd;
+	(void) mask;
 
-		command = wstrconcat(path, " --global_defaults_path");
-		file = popen(command, "r");
-		wfree(command);
+	WMDeleteInputHandler(versionHandler);
+	versionHandler = NULL;
+
+	checkVersion(WMWidgetScreen(WPrefs.win), WPrefs.win, file);
+}
+
+static const char *wmakerBinName(void)
+{
+	const char *path;
+
+	path = getenv("WMAKER_BIN_NAME");
+	if (!path)
+		path = "wmaker";
+
+	return path;
+}
+
+/*
+ * The panels are made from the global defaults as soon as they are loaded,
+ * so their path has to be waited for, but wmaker is asked for it before
+ * the main window is made so that both are done at the same time.
+ */
+static void startWMakerQueries(void)
+{
+	char *command;
+
+	command = wstrconcat(wmakerBinName(), " --version");
+	versionFile = popen(command, "r");
+	wfree(command);
+
+	command = wstrconcat(wmakerBinName(), " --global_defaults_path");
+	globalPathFile = popen(command, "r");
+	wfree(command);
+}
+
+static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
+{
+	WMPropList *db, *gdb;
+	char *path;
+	const char *bin;
+	FILE *file;
+	char buffer[1024];
+	char mbuf[1069]; /* Size of buffer and extra characters for the sprintfs */
+
+	path = wdefaultspathfordomain("WindowMaker");
+	WindowMakerDBPath = path;
+
+	db = WMReadPropListFromFile(path);
+	if (db) {
+		if (!WMIsPLDictionary(db)) {
+			WMReleasePropList(db);
+			db = NULL;
+			sprintf(mbuf, _("Window Maker domain (%s) is corrupted!"), path);
+			WMRunAlertPanel(scr, mainw, _("Error"), mbuf, _("OK"), NULL, NULL);
+		}
+	} else {
+		sprintf(mbuf, _("Could not load Window Maker domain (%s) from defaults database."), path);
+		WMRunAlertPanel(scr, mainw, _("Error"), mbuf, _("OK"), NULL, NULL);
 	}
+
+	bin = wmakerBinName();
+
+	/*
+	 * The version is only checked once wmaker answered, so that the panels
+	 * can be used meanwhile.
+	 */
+	if (versionFile)
+		versionHandler = WMAddInputHandler(fileno(versionFile), WIReadMask, versionReady, versionFile);
+	else
+		checkVersion(scr, mainw, NULL);
+
+	file = globalPathFile;
+	globalPathFile = NULL;
 	if (!file || !fgets(buffer, 1023, file)) {
-		werror(_("could not run \"%s --global_defaults_path\"."), path);
+		werror(_("could not run \"%s --global_defaults_path\"."), bin);
 		exit(1);
 	} else {
 		char *ptr;
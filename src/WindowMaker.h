@@ -666,6 +666,15 @@ extern struct WPreferences {
 	int switch_panel_icon_size;   /* icon size in switch panel */
 } wPreferences;
 
+/* Roles windows are looked up for in w_global.windows */
+enum {
+	WT_DESCRIPTOR,		/* WObjDescriptor of any window we made or manage */
+	WT_APPLICATION,		/* WApplication of its group leader */
+	WT_STACK,		/* WCoreWindow of a frame, for the stacking order */
+
+	WT_ROLES
+};
+
 /****** Global Variables  ******/
 extern Display	*dpy;
 
@@ -767,12 +776,8 @@ extern struct wmaker_global_variables {
 
 	} atom;
 
-	/* X Contexts */
-	struct {
-		XContext client_win;
-		XContext app_win;
-		XContext stack;
-	} context;
+	/* What windows are, looked up with the WT_* roles */
+	WMWindowTable *windows;
 
 	/* X Extensions */
 	struct {
@@ -375,8 +375,7 @@ static void wAppIcon_map(WAppIcon *aicon)
 
 	map_icon_image(icon);
 
-	WMAddNotificationObserver(icon_appearanceObserver, icon, WNIconAppearanceSettingsChanged, icon);
-	WMAddNotificationObserver(icon_tileObserver, icon, WNIconTileSettingsChanged, icon);
+	icon_observe_settings(icon);
 
 #ifdef USE_DOCK_XDND
 	wXDNDMakeAwareness(aicon->icon->core->window);
@@ -709,8 +708,7 @@ void appicon_map(WAppIcon *aicon)
 
 	map_icon_image(icon);
 
-	WMAddNotificationObserver(icon_appearanceObserver, aicon->icon, WNIconAppearanceSettingsChanged, icon);
-	WMAddNotificationObserver(icon_tileObserver, aicon->icon, WNIconTileSettingsChanged, icon);
+	icon_observe_settings(icon);
 
 #ifdef USE_DOCK_XDND
 	wXDNDMakeAwareness(wcore->window);
@@ -72,7 +72,7 @@ WApplication *wApplicationOf(Window window)
 	if (window == None)
 		return NULL;
 
-	if (XFindContext(dpy, window, w_global.context.app_win, (XPointer *) & wapp) != XCSUCCESS)
+	if ((wapp = WMWindowTableGet(w_global.windows, window, WT_APPLICATION)) == NULL)
 		return NULL;
 
 	return wapp;
@@ -133,7 +133,7 @@ WApplication *wApplicationCreate(WWindow *wwin)
 	wapp->flags.emulated = WFLAGP(wapp->main_window_desc, emulate_appicon);
 
 	/* application descriptor */
-	XSaveContext(dpy, main_window, w_global.context.app_win, (XPointer) wapp);
+	WMWindowTableInsert(w_global.windows, main_window, WT_APPLICATION, wapp);
 
 	create_appicon_for_application(wapp, wwin);
 
@@ -167,7 +167,7 @@ void wApplicationDestroy(WApplication *wapp)
 	if (wapp->prev)
 		wapp->prev->next = wapp->next;
 
-	XDeleteContext(dpy, wapp->main_window, w_global.context.app_win);
+	WMWindowTableRemove(w_global.windows, wapp->main_window, WT_APPLICATION);
 	destroy_app_menu(wapp);
 #ifdef USER_MENU
 	destroy_user_menu(wapp);
@@ -182,7 +182,7 @@ void wApplicationDestroy(WApplication *wapp)
 	if (wwin) {
 		/* undelete client window context that was deleted in
 		 * wWindowDestroy */
-		XSaveContext(dpy, wwin->client_win, w_global.context.client_win, (XPointer) & wwin->client_descriptor);
+		WMWindowTableInsert(w_global.windows, wwin->client_win, WT_DESCRIPTOR, &wwin->client_descriptor);
 	}
 	wfree(wapp);
 }
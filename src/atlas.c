@@ -0,0 +1,230 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The atlas keeps the shared pixmaps with a reference count, so that the
+ * last frame or icon releasing one frees it. The textures and tiles they
+ * are made from are forgotten when they are destroyed, as another one could
+ * then be allocated at the same address, but the pixmaps made from them
+ * stay until they are released.
+ *
+ * The lookups are counted as atlas in the profile. Without sharing, the
+ * pixmaps are still counted, but none is found for another user.
+ */
+
+#include "wconfig.h"
+
+#include <X11/Xlib.h>
+
+#include <stdint.h>
+
+#include "WindowMaker.h"
+#include "screen.h"
+#include "profile.h"
+#include "atlas.h"
+
+
+typedef struct AtlasEntry {
+	WAtlasKey key;
+	Pixmap pixmap;
+	int refs;
+	Bool keyed;		/* can still be found by its key */
+	unsigned long size;	/* bytes it takes in the server */
+} AtlasEntry;
+
+typedef struct WAtlas {
+	WMHashTable *keys;	/* WAtlasKey -> AtlasEntry */
+	WMHashTable *pixmaps;	/* Pixmap -> AtlasEntry */
+
+	unsigned long bytes;	/* taken by the pixmaps */
+	unsigned long uses;	/* references to them */
+	unsigned long usedBytes; /* what they would take without sharing */
+} WAtlas;
+
+
+Bool wAtlasSharing = True;
+
+
+static unsigned hashKey(const void *param)
+{
+	const WAtlasKey *key = param;
+	unsigned hash;
+
+	hash = (unsigned)((uintptr_t)key->source >> 3);
+	hash = hash * 31 + key->kind;
+	hash = hash * 31 + key->width;
+	hash = hash * 31 + key->height;
+	hash = hash * 31 + key->span;
+	hash = hash * 31 + key->variant;
+
+	return hash;
+}
+
+static Bool isEqualKey(const void *param1, const void *param2)
+{
+	const WAtlasKey *key1 = param1;
+	const WAtlasKey *key2 = param2;
+
+	return key1->source == key2->source && key1->kind == key2->kind &&
+		key1->width == key2->width && key1->height == key2->height &&
+		key1->span == key2->span && key1->variant == key2->variant;
+}
+
+static const WMHashTableCallbacks AtlasKeyHashCallbacks = {
+	hashKey,
+	isEqualKey,
+	NULL,
+	NULL
+};
+
+static WAtlas *getAtlas(WScreen *scr)
+{
+	if (!scr->atlas) {
+		scr->atlas = wmalloc(sizeof(WAtlas));
+		scr->atlas->keys = WMCreateHashTable(AtlasKeyHashCallbacks);
+		scr->atlas->pixmaps = WMCreateHashTable(WMIntHashCallbacks);
+	}
+
+	return scr->atlas;
+}
+
+Pixmap wAtlasGet(WScreen *scr, const WAtlasKey *key)
+{
+	WAtlas *atlas = getAtlas(scr);
+	AtlasEntry *entry;
+
+	entry = wAtlasSharing ? WMHashGet(atlas->keys, key) : NULL;
+	wProfileHit(atlas, entry != NULL);
+	if (!entry)
+		return None;
+
+	entry->refs++;
+	atlas->uses++;
+	atlas->usedBytes += entry->size;
+
+	return entry->pixmap;
+}
+
+void wAtlasPut(WScreen *scr, const WAtlasKey *key, Pixmap pixmap)
+{
+	WAtlas *atlas = getAtlas(scr);
+	AtlasEntry *entry;
+	int bpp;
+
+	if (pixmap == None)
+		return;
+
+	/* what servers usually take for a pixel */
+	bpp = scr->w_depth > 16 ? 4 : (scr->w_depth > 8 ? 2 : 1);
+
+	entry = wmalloc(sizeof(AtlasEntry));
+	entry->key = *key;
+	entry->pixmap = pixmap;
+	entry->refs = 1;
+	entry->size = (unsigned long)key->width * key->height * bpp;
+
+	/* it was looked up before it was made, unless made twice in a row */
+	if (!WMHashGet(atlas->keys, &entry->key)) {
+		WMHashInsert(atlas->keys, &entry->key, entry);
+		entry->keyed = True;
+	}
+	WMHashInsert(atlas->pixmaps, (void *)(uintptr_t) pixmap, entry);
+
+	atlas->bytes += entry->size;
+	atlas->uses++;
+	atlas->usedBytes += entry->size;
+}
+
+void wAtlasRelease(WScreen *scr, Pixmap *pixmap)
+{
+	WAtlas *atlas = getAtlas(scr);
+	AtlasEntry *entry;
+
+	if (*pixmap == None)
+		return;
+
+	entry = WMHashGet(atlas->pixmaps, (void *)(uintptr_t) *pixmap);
+	*pixmap = None;
+	if (!entry) {
+		wwarning("released a pixmap that is not in the atlas");
+		return;
+	}
+
+	atlas->uses--;
+	atlas->usedBytes -= entry->size;
+	if (--entry->refs > 0)
+		return;
+
+	if (entry->keyed)
+		WMHashRemove(atlas->keys, &entry->key);
+	WMHashRemove(atlas->pixmaps, (void *)(uintptr_t) entry->pixmap);
+	XFreePixmap(dpy, entry->pixmap);
+	atlas->bytes -= entry->size;
+	wfree(entry);
+}
+
+static void forgetSource(WAtlas *atlas, const void *source)
+{
+	WMHashEnumerator enumerator;
+	WMArray *forgotten;
+	AtlasEntry *entry;
+	int i;
+
+	forgotten = WMCreateArray(8);
+
+	enumerator = WMEnumerateHashTable(atlas->keys);
+	while ((entry = WMNextHashEnumeratorItem(&enumerator)) != NULL) {
+		if (entry->key.source == source)
+			WMAddToArray(forgotten, entry);
+	}
+
+	for (i = 0; i < WMGetArrayItemCount(forgotten); i++) {
+		entry = WMGetFromArray(forgotten, i);
+		WMHashRemove(atlas->keys, &entry->key);
+		entry->keyed = False;
+	}
+
+	WMFreeArray(forgotten);
+}
+
+void wAtlasForget(const void *source)
+{
+	WScreen *scr;
+	int i;
+
+	/* the tiles are the same for all the screens */
+	for (i = 0; i < w_global.screen_count; i++) {
+		scr = w_global.vscreens[i]->screen_ptr;
+		if (scr && scr->atlas)
+			forgetSource(scr->atlas, source);
+	}
+}
+
+void wAtlasWriteStats(WScreen *scr, FILE *file)
+{
+	WAtlas *atlas = scr->atlas;
+
+	if (!atlas)
+		return;
+
+	fprintf(file, "shared pixmaps of screen %i: %u pixmaps taking %lu KiB, used %lu times,"
+		" %lu KiB without sharing\n", scr->screen, WMCountHashTable(atlas->pixmaps),
+		atlas->bytes / 1024, atlas->uses, atlas->usedBytes / 1024);
+}
@@ -0,0 +1,73 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WMATLAS_H_
+#define WMATLAS_H_
+
+#include <stdio.h>
+
+#include "screen.h"
+
+/*
+ * Pixmaps rendered once per screen and shared by all the frames and icons
+ * that would have each made the same one: the backgrounds of the titlebar
+ * buttons, of the titlebars and resizebars of the same width, and the icon
+ * tiles with nothing on them. The pixmaps cannot be packed in a bigger one,
+ * as a window background can only be a whole pixmap. The icons keep the
+ * pixmaps of their own image there too, to be counted with the others.
+ */
+
+typedef struct WAtlasKey {
+	const void *source;	/* texture or image it is rendered from */
+	int kind;
+	int width, height;	/* of the pixmap */
+	int span;		/* width of what the source was rendered for,
+				 * or 0 if the pixmap does not depend on it */
+	int variant;		/* where it was taken from, or whatever else
+				 * makes it different */
+} WAtlasKey;
+
+enum {
+	WATLAS_TITLEBAR,
+	WATLAS_BUTTON,
+	WATLAS_RESIZEBAR,
+	WATLAS_ICON_TILE,
+	WATLAS_ICON
+};
+
+/* False to find no pixmap made for another frame or icon, to compare (--no-shared-pixmaps) */
+extern Bool wAtlasSharing;
+
+/* The pixmap made for `key', with a reference, or None if there is none */
+Pixmap wAtlasGet(WScreen *scr, const WAtlasKey *key);
+
+/* Gives `pixmap', just made for `key', to the atlas. The caller has the first reference */
+void wAtlasPut(WScreen *scr, const WAtlasKey *key, Pixmap pixmap);
+
+/* Drops the reference to `*pixmap', which is freed with the last one, and sets it to None */
+void wAtlasRelease(WScreen *scr, Pixmap *pixmap);
+
+/* The pixmaps made from `source', which is going away, are not given anymore */
+void wAtlasForget(const void *source);
+
+/* Writes how much the server memory pixmaps take, and would without sharing */
+void wAtlasWriteStats(WScreen *scr, FILE *file);
+
+#endif
@@ -160,7 +160,7 @@ void wClientConfigure(WWindow *wwin, XConfigureRequestEvent *xcre)
 		WWindow *sibling;
 
 		if ((xcre->value_mask & CWSibling) &&
-		    (XFindContext(dpy, xcre->above, w_global.context.client_win, (XPointer *) & desc) == XCSUCCESS)
+		    ((desc = WMWindowTableGet(w_global.windows, xcre->above, WT_DESCRIPTOR)) != NULL)
 		    && (desc->parent_type == WCLASS_WINDOW)) {
 			sibling = desc->parent;
 			xwc.sibling = sibling->frame->core->window;
@@ -65,8 +65,11 @@
 #include "workspace.h"
 #include "properties.h"
 #include "misc.h"
+#include "wdefaults.h"
 #include "winmenu.h"
 #include "miniwindow.h"
+#include "profile.h"
+#include "atlas.h"
 
 typedef struct _WDefaultEntry  WDefaultEntry;
 typedef int (WDECallbackConvert) (WDefaultEntry *entry, WMPropList *plvalue, void *addr);
@@ -1246,6 +1249,22 @@ static void init_defaults(void)
 	}
 }
 
+/*
+ * The domains are replaced as a whole when their files change, and what is
+ * kept from them is copied, so each is read into an arena and is freed at
+ * once when it is replaced.
+ */
+static WMPropList *readUserDomain(const char *path)
+{
+	WMPropList *dict;
+
+	WMPLSetUseArenas(True);
+	dict = ReadDomainFile(path);
+	WMPLSetUseArenas(False);
+
+	return dict;
+}
+
 static WMPropList *readGlobalDomain(const char *domainName, Bool requireDictionary)
 {
 	WMPropList *globalDict = NULL;
@@ -1254,7 +1273,9 @@ static WMPropList *readGlobalDomain(const char *domainName, Bool requireDictiona
 
 	snprintf(path, sizeof(path), "%s/%s", DEFSDATADIR, domainName);
 	if (stat(path, &stbuf) >= 0) {
+		WMPLSetUseArenas(True);
 		globalDict = WMReadPropListFromFile(path);
+		WMPLSetUseArenas(False);
 		if (globalDict && requireDictionary && !WMIsPLDictionary(globalDict)) {
 			wwarning(_("Domain %s (%s) of global defaults database is corrupted!"), domainName, path);
 			WMReleasePropList(globalDict);
@@ -1343,7 +1364,7 @@ static WDDomain *wDefaultsInitDomain(const char *domain, Bool requireDictionary)
 	db->path = wdefaultspathfordomain(domain);
 
 	if (stat(db->path, &stbuf) >= 0) {
-		db->dictionary = WMReadPropListFromFile(db->path);
+		db->dictionary = readUserDomain(db->path);
 		if (db->dictionary) {
 			if (requireDictionary && !WMIsPLDictionary(db->dictionary)) {
 				WMReleasePropList(db->dictionary);
@@ -1386,6 +1407,8 @@ void wDefaultsCheckDomains(void *arg)
 	/* Parameter not used, but tell the compiler that it is ok */
 	(void) arg;
 
+	wProfileBegin(wDefaultsCheckDomains);
+
 	if (stat(w_global.domain.wmaker->path, &stbuf) >= 0 && w_global.domain.wmaker->timestamp < stbuf.st_mtime) {
 		w_global.domain.wmaker->timestamp = stbuf.st_mtime;
 
@@ -1393,7 +1416,7 @@ void wDefaultsCheckDomains(void *arg)
 		shared_dict = readGlobalDomain("WindowMaker", True);
 
 		/* User dictionary */
-		dict = WMReadPropListFromFile(w_global.domain.wmaker->path);
+		dict = readUserDomain(w_global.domain.wmaker->path);
 
 		if (dict) {
 			if (!WMIsPLDictionary(dict)) {
@@ -1433,7 +1456,7 @@ void wDefaultsCheckDomains(void *arg)
 		/* global dictionary */
 		shared_dict = readGlobalDomain("WMWindowAttributes", True);
 		/* user dictionary */
-		dict = WMReadPropListFromFile(w_global.domain.window_attr->path);
+		dict = readUserDomain(w_global.domain.window_attr->path);
 		if (dict) {
 			if (!WMIsPLDictionary(dict)) {
 				WMReleasePropList(dict);
@@ -1452,6 +1475,7 @@ void wDefaultsCheckDomains(void *arg)
 					WMReleasePropList(w_global.domain.window_attr->dictionary);
 
 				w_global.domain.window_attr->dictionary = dict;
+				wDefaultInvalidateAttributes();
 				for (i = 0; i < w_global.screen_count; i++) {
 					vscr = w_global.vscreens[i];
 					if (vscr->screen_ptr) {
@@ -1474,7 +1498,7 @@ void wDefaultsCheckDomains(void *arg)
 	}
 
 	if (stat(w_global.domain.root_menu->path, &stbuf) >= 0 && w_global.domain.root_menu->timestamp < stbuf.st_mtime) {
-		dict = WMReadPropListFromFile(w_global.domain.root_menu->path);
+		dict = readUserDomain(w_global.domain.root_menu->path);
 		if (dict) {
 			if (!WMIsPLArray(dict) && !WMIsPLString(dict)) {
 				WMReleasePropList(dict);
@@ -1493,6 +1517,9 @@ void wDefaultsCheckDomains(void *arg)
 		}
 		w_global.domain.root_menu->timestamp = stbuf.st_mtime;
 	}
+
+	wProfileEnd(wDefaultsCheckDomains);
+
 #ifndef HAVE_INOTIFY
 	if (!arg)
 		WMAddTimerHandler(DEFAULTS_CHECK_INTERVAL, wDefaultsCheckDomains, arg);
@@ -1929,9 +1956,8 @@ static int getPropList(WDefaultEntry *entry, WMPropList *value, void *addr)
 	(void) entry;
 	(void) addr;
 
-	WMRetainPropList(value);
-
-	*(WMPropList **) addr = value;
+	/* copied, not to keep the whole domain */
+	*(WMPropList **) addr = WMDeepCopyPropList(value);
 
 	return True;
 }
@@ -2090,9 +2116,8 @@ static int getWSBackground(WDefaultEntry *entry, WMPropList *value, void *addr)
 			return True;
 	}
 
-	WMRetainPropList(value);
-
-	*(WMPropList **) addr = value;
+	/* copied, not to keep the whole domain */
+	*(WMPropList **) addr = WMDeepCopyPropList(value);
 
 	return True;
 }
@@ -2133,9 +2158,8 @@ getWSSpecificBackground(WDefaultEntry *entry, WMPropList *value, void *addr)
 		}
 	}
 
-	WMRetainPropList(value);
-
-	*(WMPropList **) addr = value;
+	/* copied, not to keep the whole domain */
+	*(WMPropList **) addr = WMDeepCopyPropList(value);
 
 	return True;
 }
@@ -2548,6 +2572,7 @@ static int setIconTile(virtual_screen *vscr)
 
 	if (w_global.tile.icon) {
 		reset = 1;
+		wAtlasForget(w_global.tile.icon);
 		RReleaseImage(w_global.tile.icon);
 	}
 
@@ -2557,15 +2582,19 @@ static int setIconTile(virtual_screen *vscr)
 	PropSetIconTileHint(vscr, img);
 
 	if (!wPreferences.flags.noclip || wPreferences.flags.clip_merged_in_dock) {
-		if (w_global.tile.clip)
+		if (w_global.tile.clip) {
+			wAtlasForget(w_global.tile.clip);
 			RReleaseImage(w_global.tile.clip);
+		}
 
 		w_global.tile.clip = wClipMakeTile(img);
 	}
 
 	if (!wPreferences.flags.nodrawer) {
-		if (w_global.tile.drawer)
+		if (w_global.tile.drawer) {
+			wAtlasForget(w_global.tile.drawer);
 			RReleaseImage(w_global.tile.drawer);
+		}
 
 		w_global.tile.drawer= wDrawerMakeTile(vscr, img);
 	}
@@ -2597,7 +2626,7 @@ static int setWinTitleFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.wintitle);
 	if (!font) {
 		if (wPreferences.font.wintitle)
-			free(wPreferences.font.wintitle);
+			wfree(wPreferences.font.wintitle);
 
 		wPreferences.font.wintitle = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.wintitle, fixedlen, "fixed");
@@ -2631,7 +2660,7 @@ static int setMenuTitleFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.menutitle);
 	if (!font) {
 		if (wPreferences.font.menutitle)
-			free(wPreferences.font.menutitle);
+			wfree(wPreferences.font.menutitle);
 
 		wPreferences.font.menutitle = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.menutitle, fixedlen, "fixed");
@@ -2665,7 +2694,7 @@ static int setMenuTextFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.menutext);
 	if (!font) {
 		if (wPreferences.font.menutext)
-			free(wPreferences.font.menutext);
+			wfree(wPreferences.font.menutext);
 
 		wPreferences.font.menutext = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.menutext, fixedlen, "fixed");
@@ -2699,7 +2728,7 @@ static int setIconTitleFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.icontitle);
 	if (!font) {
 		if (wPreferences.font.icontitle)
-			free(wPreferences.font.icontitle);
+			wfree(wPreferences.font.icontitle);
 
 		wPreferences.font.icontitle = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.icontitle, fixedlen, "fixed");
@@ -2733,7 +2762,7 @@ static int setClipTitleFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.cliptitle);
 	if (!font) {
 		if (wPreferences.font.cliptitle)
-			free(wPreferences.font.cliptitle);
+			wfree(wPreferences.font.cliptitle);
 
 		wPreferences.font.cliptitle = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.cliptitle, fixedlen, "fixed");
@@ -2767,7 +2796,7 @@ static int setLargeDisplayFont(virtual_screen *vscr)
 	font = WMCreateFont(vscr->screen_ptr->wmscreen, wPreferences.font.largedisplay);
 	if (!font) {
 		if (wPreferences.font.largedisplay)
-			free(wPreferences.font.largedisplay);
+			wfree(wPreferences.font.largedisplay);
 
 		wPreferences.font.largedisplay = wmalloc(fixedlen + sizeof(char *));
 		snprintf(wPreferences.font.largedisplay, fixedlen, "fixed");
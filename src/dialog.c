@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <limits.h>
+#include <time.h>
 #include <errno.h>
 
 #ifdef HAVE_MALLOC_H
@@ -62,6 +63,7 @@
 #include "window.h"
 #include "actions.h"
 #include "xinerama.h"
+#include "thumbnail.h"
 
 #define COPYRIGHT_TEXT  \
 	"Copyright \xc2\xa9 1997-2006 Alfredo K. Kojima\n"\
@@ -98,7 +100,8 @@
 
 static int pstrcmp(const char **str1, const char **str2);
 static int strmatch(const void *str1, const void *str2);
-static void ScanFiles(const char *dir, const char *prefix, unsigned acceptmask, unsigned declinemask, WMArray *result);
+static void ScanFiles(const char *dir, const char *prefix, WMArray *result);
+static void ScanCommands(const char *dir, const char *prefix, WMHashTable *found);
 static void buttonCallback(void *self, void *clientData);
 static void drawIconProc(WMList *lPtr, int index, Drawable d, char *text, int state, WMRect *rect);
 static void handleHistoryKeyPress(XEvent *event, void *clientData);
@@ -287,14 +290,34 @@ static int pstrcmp(const char **str1, const char **str2)
 	return strcmp(*str1, *str2);
 }
 
-static void ScanFiles(const char *dir, const char *prefix,
-		      unsigned acceptmask, unsigned declinemask, WMArray *result)
+/* is the entry a directory, and does it exist at all */
+static Bool entryIsDirectory(const char *dir, struct dirent *de, Bool *exists)
+{
+	struct stat sb;
+	char *fullfilename;
+
+	*exists = True;
+#ifdef DT_UNKNOWN
+	if (de->d_type != DT_UNKNOWN && de->d_type != DT_LNK)
+		return de->d_type == DT_DIR;
+#endif
+
+	fullfilename = wstrconcat(dir, "/");
+	fullfilename = wstrappend(fullfilename, de->d_name);
+	if (stat(fullfilename, &sb) != 0)
+		*exists = False;
+	wfree(fullfilename);
+
+	return *exists && S_ISDIR(sb.st_mode);
+}
+
+static void ScanFiles(const char *dir, const char *prefix, WMArray *result)
 {
 	int prefixlen;
 	DIR *d;
 	struct dirent *de;
-	struct stat sb;
-	char *fullfilename, *suffix;
+	char *suffix;
+	Bool exists, isdir;
 
 	prefixlen = strlen(prefix);
 	d = opendir(dir);
@@ -305,27 +328,141 @@ static void ScanFiles(const char *dir, const char *prefix,
 		if (strlen(de->d_name) > prefixlen &&
 		    !strncmp(prefix, de->d_name, prefixlen) &&
 		    strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..")) {
-			fullfilename = wstrconcat((char *)dir, "/");
-			fullfilename = wstrappend(fullfilename, de->d_name);
-
-			if (stat(fullfilename, &sb) == 0 &&
-			    (sb.st_mode & acceptmask) &&
-			    !(sb.st_mode & declinemask) &&
-			    WMFindInArray(result, (WMMatchDataProc *) strmatch,
-					  de->d_name + prefixlen) == WANotFound) {
-				suffix = wstrdup(de->d_name + prefixlen);
-				if (sb.st_mode & S_IFDIR)
-					suffix = wstrappend(suffix, "/");
-
-				WMAddToArray(result, suffix);
-			}
-			wfree(fullfilename);
+			isdir = entryIsDirectory(dir, de, &exists);
+			if (!exists)
+				continue;
+
+			suffix = wstrdup(de->d_name + prefixlen);
+			if (isdir)
+				suffix = wstrappend(suffix, "/");
+
+			WMAddToArray(result, suffix);
 		}
 	}
 
 	closedir(d);
 }
 
+/*
+ * The executables found in each directory of the PATH, sorted, so the
+ * completion of a command is a binary search in each of them. A directory
+ * is read again only when its modification time changed.
+ */
+typedef struct CommandDir {
+	time_t mtime;
+	Bool stale;		/* changed in the second it was read */
+	char **names;
+	int count;
+} CommandDir;
+
+static WMHashTable *commandDirs = NULL;
+
+static int compareCommands(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void freeCommandNames(CommandDir *cdir)
+{
+	int i;
+
+	for (i = 0; i < cdir->count; i++)
+		wfree(cdir->names[i]);
+	if (cdir->names)
+		wfree(cdir->names);
+	cdir->names = NULL;
+	cdir->count = 0;
+}
+
+static void readCommandDir(const char *dir, CommandDir *cdir, time_t mtime)
+{
+	DIR *d;
+	struct dirent *de;
+	struct stat sb;
+	char *fullfilename;
+	int size = 0;
+
+	freeCommandNames(cdir);
+	cdir->mtime = mtime;
+	cdir->stale = (mtime >= time(NULL));
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+					     (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+			continue;
+
+#ifdef DT_UNKNOWN
+		/* only regular files and links to them can be commands */
+		if (de->d_type != DT_UNKNOWN && de->d_type != DT_LNK && de->d_type != DT_REG)
+			continue;
+#endif
+
+		fullfilename = wstrconcat(dir, "/");
+		fullfilename = wstrappend(fullfilename, de->d_name);
+		if (stat(fullfilename, &sb) != 0 || S_ISDIR(sb.st_mode) ||
+		    !(sb.st_mode & (S_IXOTH | S_IXGRP | S_IXUSR))) {
+			wfree(fullfilename);
+			continue;
+		}
+		wfree(fullfilename);
+
+		if (cdir->count == size) {
+			size = size ? size * 2 : 64;
+			cdir->names = wrealloc(cdir->names, size * sizeof(char *));
+		}
+		cdir->names[cdir->count++] = wstrdup(de->d_name);
+	}
+	closedir(d);
+
+	qsort(cdir->names, cdir->count, sizeof(char *), compareCommands);
+}
+
+/* add to `found' the commands of `dir' starting with `prefix' */
+static void ScanCommands(const char *dir, const char *prefix, WMHashTable *found)
+{
+	CommandDir *cdir;
+	struct stat sb;
+	int prefixlen, lo, hi, mid;
+
+	if (!commandDirs)
+		commandDirs = WMCreateHashTable(WMStringHashCallbacks);
+
+	cdir = WMHashGet(commandDirs, dir);
+	if (!cdir) {
+		cdir = wmalloc(sizeof(CommandDir));
+		cdir->stale = True;
+		WMHashInsert(commandDirs, dir, cdir);
+	}
+
+	if (stat(dir, &sb) != 0 || !S_ISDIR(sb.st_mode))
+		freeCommandNames(cdir);
+	else if (cdir->stale || sb.st_mtime != cdir->mtime)
+		readCommandDir(dir, cdir, sb.st_mtime);
+
+	/* first name not before the prefix */
+	lo = 0;
+	hi = cdir->count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(cdir->names[mid], prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	prefixlen = strlen(prefix);
+	for (; lo < cdir->count && strncmp(cdir->names[lo], prefix, prefixlen) == 0; lo++) {
+		const char *suffix = cdir->names[lo] + prefixlen;
+
+		if (*suffix && !WMHashGet(found, suffix))
+			WMHashInsert(found, suffix, found);
+	}
+}
+
 static WMArray *GenerateVariants(const char *complete)
 {
 	Bool firstWord = True;
@@ -355,12 +492,19 @@ static WMArray *GenerateVariants(const char *complete)
 		}
 
 		prefix = wstrdup(pos + 1);
-		ScanFiles(dir, prefix, (unsigned)-1, 0, variants);
+		ScanFiles(dir, prefix, variants);
 		wfree(dir);
 		wfree(prefix);
 	} else if (*complete == '~') {
 		WMAddToArray(variants, wstrdup("/"));
 	} else if (firstWord) {
+		WMHashTable *found;
+		WMHashEnumerator e;
+		const char *suffix;
+
+		/* the same command may be in several directories */
+		found = WMCreateHashTable(WMStringHashCallbacks);
+
 		path = getenv("PATH");
 		while (path) {
 			pos = strchr(path, ':');
@@ -372,9 +516,14 @@ static WMArray *GenerateVariants(const char *complete)
 				path = NULL;
 			} else
 				break;
-			ScanFiles(tmp, complete, S_IXOTH | S_IXGRP | S_IXUSR, S_IFDIR, variants);
+			ScanCommands(tmp, complete, found);
 			wfree(tmp);
 		}
+
+		e = WMEnumerateHashTable(found);
+		while ((suffix = WMNextHashEnumeratorKey(&e)))
+			WMAddToArray(variants, wstrdup(suffix));
+		WMFreeHashTable(found);
 	}
 
 	WMSortArray(variants, (WMCompareDataProc *) pstrcmp);
@@ -649,6 +798,7 @@ static void listCallback(void *self, void *data)
 		WMSetTextFieldText(panel->fileField, path);
 		WMSetLabelImage(panel->iconView, NULL);
 		WMSetButtonEnabled(panel->okButton, False);
+		wThumbnailCancel(panel);
 		WMClearList(panel->iconList);
 		listPixmaps(panel->vscr, panel->iconList, path);
 	} else {
@@ -697,6 +847,23 @@ static void listIconPaths(WMList *lPtr)
 	wfree(paths);
 }
 
+static void redrawIconList(void *data)
+{
+	IconPanel *panel = (IconPanel *) data;
+
+	panel->thumbnailRedraw = NULL;
+	WMRedisplayWidget(panel->iconList);
+}
+
+static void iconThumbnailReady(void *data)
+{
+	IconPanel *panel = (IconPanel *) data;
+
+	/* thumbnails usually come in bursts, redraw once for all of them */
+	if (!panel->thumbnailRedraw)
+		panel->thumbnailRedraw = WMAddTimerHandler(THUMBNAIL_REDRAW_DELAY, redrawIconList, panel);
+}
+
 static void drawIconProc(WMList *lPtr, int index, Drawable d, char *text, int state, WMRect *rect)
 {
 	IconPanel *panel = WMGetHangedData(lPtr);
@@ -709,6 +876,7 @@ static void drawIconProc(WMList *lPtr, int index, Drawable d, char *text, int st
 	WMSize size;
 	WMScreen *wmscr = WMWidgetScreen(panel->win);
 	RColor color;
+	RImage *thumbnail;
 	int x, y, width, height, len;
 
 	/* Parameter not used, but tell the compiler that it is ok */
@@ -733,21 +901,37 @@ static void drawIconProc(WMList *lPtr, int index, Drawable d, char *text, int st
 	color.blue = WMBlueComponentOfColor(back) >> 8;
 	color.alpha = WMGetColorAlpha(back) >> 8;
 
-	pixmap = WMCreateScaledBlendedPixmapFromFile(wmscr, file, &color, width - 2, height - 2);
+	/* the thumbnail may not be ready yet, only the name is shown until
+	 * iconThumbnailReady gets it redrawn */
+	thumbnail = wThumbnailGet(scr->rcontext, file, width - 2, height - 2, iconThumbnailReady, panel);
 	wfree(file);
 
-	if (!pixmap)
-		return;
+	pixmap = NULL;
+	if (thumbnail) {
+		RImage *image;
+
+		/* the cached thumbnail must stay untouched */
+		image = RCloneImage(thumbnail);
+		RReleaseImage(thumbnail);
+		if (image) {
+			RCombineImageWithColor(image, &color);
+			pixmap = WMCreatePixmapFromRImage(wmscr, image, 0);
+			RReleaseImage(image);
+		}
+	}
 
 	XFillRectangle(dpy, d, WMColorGC(back), x, y, width, height);
 	XSetClipMask(dpy, gc, None);
 	XDrawLine(dpy, d, WMColorGC(scr->white), x, y + height - 1, x + width, y + height - 1);
-	size = WMGetPixmapSize(pixmap);
-	XSetClipMask(dpy, copygc, WMGetPixmapMaskXID(pixmap));
-	XSetClipOrigin(dpy, copygc, x + (width - size.width) / 2, y + 2);
-	XCopyArea(dpy, WMGetPixmapXID(pixmap), d, copygc, 0, 0,
-		  size.width > 100 ? 100 : size.width, size.height > 64 ? 64 : size.height,
-		  x + (width - size.width) / 2, y + 2);
+	if (pixmap) {
+		size = WMGetPixmapSize(pixmap);
+		XSetClipMask(dpy, copygc, WMGetPixmapMaskXID(pixmap));
+		XSetClipOrigin(dpy, copygc, x + (width - size.width) / 2, y + 2);
+		XCopyArea(dpy, WMGetPixmapXID(pixmap), d, copygc, 0, 0,
+			  size.width > 100 ? 100 : size.width, size.height > 64 ? 64 : size.height,
+			  x + (width - size.width) / 2, y + 2);
+		XSetClipMask(dpy, copygc, None);
+	}
 
 	{
 		int i, j;
@@ -767,8 +951,8 @@ static void drawIconProc(WMList *lPtr, int index, Drawable d, char *text, int st
 		WMDrawString(wmscr, d, scr->black, panel->normalfont, ofx, ofy, text, tlen);
 	}
 
-	WMReleasePixmap(pixmap);
-	/* I hope it is better to do not use cache / on my box it is fast nuff */
+	if (pixmap)
+		WMReleasePixmap(pixmap);
 	XFlush(dpy);
 }
 
@@ -1000,6 +1184,9 @@ static char *create_dialog_iconchooser_title(const char *instance, const char *c
 
 static void destroy_dialog_iconchooser(IconPanel *panel, Window parent)
 {
+	wThumbnailCancel(panel);
+	if (panel->thumbnailRedraw)
+		WMDeleteTimerHandler(panel->thumbnailRedraw);
 	WMReleaseFont(panel->normalfont);
 	WMUnmapWidget(panel->win);
 	WMDestroyWidget(panel->win);
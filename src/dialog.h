@@ -61,6 +61,8 @@ struct IconPanel {
 	WMButton *okButton;
 	WMButton *cancelButton;
 
+	WMHandlerID thumbnailRedraw;
+
 	short done;
 	short result;
 	short preview;
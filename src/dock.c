@@ -551,8 +551,7 @@ void dock_map(WDock *dock, WMPropList *state)
 
 	map_icon_image(icon);
 
-	WMAddNotificationObserver(icon_appearanceObserver, icon, WNIconAppearanceSettingsChanged, icon);
-	WMAddNotificationObserver(icon_tileObserver, icon, WNIconTileSettingsChanged, icon);
+	icon_observe_settings(icon);
 
 #ifdef USE_DOCK_XDND
 	wXDNDMakeAwareness(wcore->window);
@@ -645,8 +644,7 @@ void dock_leave(WDock *dock)
 		return;
 
 	if (XCheckTypedEvent(dpy, EnterNotify, &event) != False) {
-		if (XFindContext(dpy, event.xcrossing.window, w_global.context.client_win,
-				 (XPointer *) & desc) != XCNOENT
+		if ((desc = WMWindowTableGet(w_global.windows, event.xcrossing.window, WT_DESCRIPTOR)) != NULL
 		    && desc && desc->parent_type == WCLASS_DOCK_ICON
 		    && ((WAppIcon *) desc->parent)->dock == dock) {
 			/* We haven't left the dock/clip/drawer yet */
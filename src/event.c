@@ -80,6 +80,8 @@
 #include "winmenu.h"
 #include "switchmenu.h"
 #include "wsmap.h"
+#include "profile.h"
+#include "redraw.h"
 
 /************ Local stuff ***********/
 static void saveTimestamp(XEvent *event);
@@ -170,6 +172,8 @@ void DispatchEvent(XEvent *event)
 	if (deathHandlers)
 		handleDeadProcess();
 
+	wProfileCheckDump();
+
 	if (WCHECK_STATE(WSTATE_NEED_EXIT)) {
 		WCHANGE_STATE(WSTATE_EXITING);
 		/* received SIGTERM */
@@ -197,6 +201,11 @@ void DispatchEvent(XEvent *event)
 		return;
 
 	saveTimestamp(event);
+
+	/* what the user acts on must look up to date */
+	if (event->type == ButtonPress || event->type == KeyPress)
+		wRedrawFlush();
+
 	switch (event->type) {
 	case MapRequest:
 		handleMapRequest(event);
@@ -610,7 +619,10 @@ static void handleMapRequest(XEvent *ev)
 	}
 
 	vscr = wScreenForRootWindow(ev->xmaprequest.parent);
+
+	wProfileBegin(wManageWindow);
 	wwin = wManageWindow(vscr, window);
+	wProfileEnd(wManageWindow);
 
 	/*
 	 * This is to let the Dock know that the application it launched
@@ -711,7 +723,7 @@ static void handleExpose(XEvent *event)
 
 	while (XCheckTypedWindowEvent(dpy, event->xexpose.window, Expose, &ev)) ;
 
-	if (XFindContext(dpy, event->xexpose.window, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, event->xexpose.window, WT_DESCRIPTOR)) == NULL)
 		return;
 
 	if (desc->handle_expose)
@@ -816,8 +828,8 @@ static void handleButtonPress(XEvent *event)
 	}
 
 	desc = NULL;
-	if (XFindContext(dpy, event->xbutton.subwindow, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
-		if (XFindContext(dpy, event->xbutton.window, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, event->xbutton.subwindow, WT_DESCRIPTOR)) == NULL)
+		if ((desc = WMWindowTableGet(w_global.windows, event->xbutton.window, WT_DESCRIPTOR)) == NULL)
 			return;
 
 	if (desc->parent_type == WCLASS_WINDOW) {
@@ -994,7 +1006,7 @@ static void handleClientMessage(XEvent *event)
 		if (strncmp(command, "Reconfigure", sizeof("Reconfigure")) == 0) {
 			wwarning(_("Got Reconfigure command"));
 			wDefaultsCheckDomains(NULL);
-		} else {
+		} else if (!wProfileCommand(command)) {
 			wwarning(_("Got unknown command %s"), command);
 		}
 
@@ -1075,7 +1087,7 @@ static void handleClientMessage(XEvent *event)
 		 * For when the icon frame gets a ClientMessage
 		 * that should have gone to the icon_window.
 		 */
-		if (XFindContext(dpy, event->xbutton.window, w_global.context.client_win, (XPointer *) & desc) != XCNOENT) {
+		if ((desc = WMWindowTableGet(w_global.windows, event->xbutton.window, WT_DESCRIPTOR)) != NULL) {
 			if (desc->parent_type == WCLASS_MINIWINDOW)
 				icon = (WIcon *) desc->parent;
 			else if (desc->parent_type == WCLASS_DOCK_ICON || desc->parent_type == WCLASS_APPICON)
@@ -1122,7 +1134,7 @@ static void handleEnterNotify(XEvent *event)
 			return;
 	}
 
-	if (XFindContext(dpy, event->xcrossing.window, w_global.context.client_win, (XPointer *) & desc) != XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, event->xcrossing.window, WT_DESCRIPTOR)) != NULL)
 		if (desc->handle_enternotify)
 			(*desc->handle_enternotify) (desc, event);
 
@@ -1185,7 +1197,7 @@ static void handleLeaveNotify(XEvent *event)
 {
 	WObjDescriptor *desc = NULL;
 
-	if (XFindContext(dpy, event->xcrossing.window, w_global.context.client_win, (XPointer *) & desc) != XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, event->xcrossing.window, WT_DESCRIPTOR)) != NULL)
 		if (desc->handle_leavenotify)
 			(*desc->handle_leavenotify) (desc, event);
 }
@@ -0,0 +1,542 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Recording and replay of the X events wmaker handles, to measure how long
+ * the handlers take on a real session instead of guessing.
+ *
+ * Record the session doing what is to be measured (mapping a lot of windows,
+ * moving them around, cycling the focus, switching workspaces...) with
+ *
+ *	wmaker --record-events session.trace
+ *
+ * then replay it on a server of its own, with the same screens:
+ *
+ *	Xvfb :5 -screen 0 1280x1024x24 &
+ *	DISPLAY=:5 wmaker --no-autolaunch --dont-restore --replay-events session.trace
+ *
+ * Replaying feeds the events to the handlers as fast as they take them and
+ * prints, per type of event, how many X requests they made and how long
+ * they took, the time being counted until wmaker asks for the next event,
+ * so what a handler leaves for the idle handlers is counted too.
+ *
+ * The trace holds the XEvents, in host byte order, with their windows
+ * rewritten as the root window of a screen, a window of wmaker (by its
+ * offset in the ids of the connection, which are the same as long as it
+ * starts the same way) or a window of a client. Clients are played by bare
+ * windows, made on a connection of their own, so what handlers read from
+ * them is not what it was. Windows in ClientMessage data, atoms and
+ * timestamps are kept as they were, events wmaker reads by itself with
+ * XCheckTypedEvent() and such are not recorded.
+ */
+
+#include "wconfig.h"
+
+#include <X11/Xlibint.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "WindowMaker.h"
+#include "screen.h"
+#include "main.h"
+#include "evtrace.h"
+
+
+#define TRACE_MAGIC	"WMTRACE1"
+
+/* the windows in a trace are tagged with what they are in the high bits */
+#define TAG_SHIFT	29
+#define TAG_MASK	(3UL << TAG_SHIFT)
+#define TAG_ROOT	(1UL << TAG_SHIFT)	/* value is the screen number */
+#define TAG_OWN		(2UL << TAG_SHIFT)	/* value is the offset in our ids */
+#define TAG_CLIENT	(3UL << TAG_SHIFT)	/* value is the client number */
+#define TAG_VALUE(w)	((w) & ~TAG_MASK)
+
+#define EVENT_TYPES	128
+#define LATENCY_BUCKETS	24
+
+
+typedef struct {
+	char magic[8];
+	uint32_t eventSize;	/* sizeof(XEvent) where it was recorded */
+	uint32_t reserved;
+} TraceHeader;
+
+typedef struct {
+	uint64_t time;		/* microseconds since the recording started */
+	uint16_t type;
+	uint16_t length;	/* of the XEvent that follows */
+	uint32_t reserved;
+} TraceRecord;
+
+typedef struct {
+	unsigned count;
+	unsigned long requests;
+	double total;
+	double worst;
+	unsigned histogram[LATENCY_BUCKETS];	/* bucket n is [2^(n-1), 2^n[ us */
+} EventStats;
+
+static struct {
+	FILE *file;
+	WMHashTable *clients;	/* window -> client number */
+	uintptr_t clientCount;
+	unsigned count;
+	double start;
+} record;
+
+static struct {
+	XEvent *events;
+	int count;
+	int next;
+	double duration;
+
+	Display *clientDpy;
+	Window *clients;
+	int clientCount;
+
+	double start;
+	double lastTime;
+	unsigned long lastRequest;
+	EventStats stats[EVENT_TYPES];
+} replay;
+
+static const char *const eventNames[] = {
+	NULL, NULL, "KeyPress", "KeyRelease", "ButtonPress", "ButtonRelease",
+	"MotionNotify", "EnterNotify", "LeaveNotify", "FocusIn", "FocusOut",
+	"KeymapNotify", "Expose", "GraphicsExpose", "NoExpose", "VisibilityNotify",
+	"CreateNotify", "DestroyNotify", "UnmapNotify", "MapNotify", "MapRequest",
+	"ReparentNotify", "ConfigureNotify", "ConfigureRequest", "GravityNotify",
+	"ResizeRequest", "CirculateNotify", "CirculateRequest", "PropertyNotify",
+	"SelectionClear", "SelectionRequest", "SelectionNotify", "ColormapNotify",
+	"ClientMessage", "MappingNotify", "GenericEvent"
+};
+
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* how much of the XEvent union is used by an event of this type */
+static size_t eventLength(int type)
+{
+	switch (type) {
+	case KeyPress:
+	case KeyRelease:
+		return sizeof(XKeyEvent);
+	case ButtonPress:
+	case ButtonRelease:
+		return sizeof(XButtonEvent);
+	case MotionNotify:
+		return sizeof(XMotionEvent);
+	case EnterNotify:
+	case LeaveNotify:
+		return sizeof(XCrossingEvent);
+	case FocusIn:
+	case FocusOut:
+		return sizeof(XFocusChangeEvent);
+	case Expose:
+		return sizeof(XExposeEvent);
+	case CreateNotify:
+		return sizeof(XCreateWindowEvent);
+	case DestroyNotify:
+		return sizeof(XDestroyWindowEvent);
+	case UnmapNotify:
+		return sizeof(XUnmapEvent);
+	case MapNotify:
+		return sizeof(XMapEvent);
+	case MapRequest:
+		return sizeof(XMapRequestEvent);
+	case ReparentNotify:
+		return sizeof(XReparentEvent);
+	case ConfigureNotify:
+		return sizeof(XConfigureEvent);
+	case ConfigureRequest:
+		return sizeof(XConfigureRequestEvent);
+	case PropertyNotify:
+		return sizeof(XPropertyEvent);
+	case ColormapNotify:
+		return sizeof(XColormapEvent);
+	default:
+		/* rare enough, or from extensions */
+		return sizeof(XEvent);
+	}
+}
+
+/* the window fields of an event */
+static int eventWindows(XEvent * event, Window * windows[3])
+{
+	int count = 0;
+
+	if (event->type == GenericEvent)
+		return 0;
+
+	windows[count++] = &event->xany.window;
+
+	switch (event->type) {
+	case KeyPress:
+	case KeyRelease:
+	case ButtonPress:
+	case ButtonRelease:
+	case MotionNotify:
+	case EnterNotify:
+	case LeaveNotify:
+		/* all of these are laid out like XKeyEvent */
+		windows[count++] = &event->xkey.root;
+		windows[count++] = &event->xkey.subwindow;
+		break;
+	case CreateNotify:
+		windows[count++] = &event->xcreatewindow.window;
+		break;
+	case DestroyNotify:
+		windows[count++] = &event->xdestroywindow.window;
+		break;
+	case UnmapNotify:
+		windows[count++] = &event->xunmap.window;
+		break;
+	case MapNotify:
+		windows[count++] = &event->xmap.window;
+		break;
+	case MapRequest:
+		windows[count++] = &event->xmaprequest.window;
+		break;
+	case ReparentNotify:
+		windows[count++] = &event->xreparent.window;
+		windows[count++] = &event->xreparent.parent;
+		break;
+	case ConfigureNotify:
+		windows[count++] = &event->xconfigure.window;
+		windows[count++] = &event->xconfigure.above;
+		break;
+	case ConfigureRequest:
+		windows[count++] = &event->xconfigurerequest.window;
+		windows[count++] = &event->xconfigurerequest.above;
+		break;
+	case GravityNotify:
+		windows[count++] = &event->xgravity.window;
+		break;
+	case CirculateNotify:
+		windows[count++] = &event->xcirculate.window;
+		break;
+	case CirculateRequest:
+		windows[count++] = &event->xcirculaterequest.window;
+		break;
+	case SelectionRequest:
+		windows[count++] = &event->xselectionrequest.requestor;
+		break;
+	}
+
+	return count;
+}
+
+static Window tagWindow(Window window)
+{
+	uintptr_t client;
+	int i;
+
+	if (window == None)
+		return None;
+
+	for (i = 0; i < ScreenCount(dpy); i++) {
+		if (window == RootWindow(dpy, i))
+			return TAG_ROOT | i;
+	}
+
+	if ((window & ~dpy->resource_mask) == dpy->resource_base)
+		return TAG_OWN | (window - dpy->resource_base);
+
+	client = (uintptr_t) WMHashGet(record.clients, (void *)window);
+	if (!client) {
+		client = ++record.clientCount;
+		WMHashInsert(record.clients, (void *)window, (void *)client);
+	}
+
+	return TAG_CLIENT | client;
+}
+
+static Window clientWindow(int client)
+{
+	if (client >= replay.clientCount) {
+		int i, count = client + 1;
+
+		replay.clients = wrealloc(replay.clients, count * sizeof(Window));
+		for (i = replay.clientCount; i < count; i++) {
+			replay.clients[i] = XCreateSimpleWindow(replay.clientDpy,
+								DefaultRootWindow(replay.clientDpy),
+								0, 0, 320, 240, 0, 0, 0);
+		}
+		replay.clientCount = count;
+	}
+
+	return replay.clients[client];
+}
+
+static Window untagWindow(Window window)
+{
+	unsigned long value = TAG_VALUE(window);
+
+	switch (window & TAG_MASK) {
+	case TAG_ROOT:
+		return RootWindow(dpy, value < ScreenCount(dpy) ? value : 0);
+	case TAG_OWN:
+		return dpy->resource_base + value;
+	case TAG_CLIENT:
+		return clientWindow(value - 1);
+	default:
+		return window;
+	}
+}
+
+static void recordEvent(XEvent * event)
+{
+	TraceRecord rec;
+	XEvent copy;
+	Window *windows[3];
+	int i, count;
+
+	copy = *event;
+	count = eventWindows(&copy, windows);
+	for (i = 0; i < count; i++)
+		*windows[i] = tagWindow(*windows[i]);
+
+	memset(&rec, 0, sizeof(rec));
+	rec.time = now() - record.start;
+	rec.type = event->type;
+	rec.length = eventLength(event->type);
+
+	if (fwrite(&rec, sizeof(rec), 1, record.file) != 1
+	    || fwrite(&copy, rec.length, 1, record.file) != 1) {
+		werror(_("could not write the event trace, recording stopped"));
+		WMHookEventRecorder(NULL);
+		return;
+	}
+
+	/* do not lose much of the trace if we get killed */
+	if (++record.count % 256 == 0)
+		fflush(record.file);
+}
+
+static void closeRecord(void)
+{
+	if (record.file) {
+		fclose(record.file);
+		record.file = NULL;
+	}
+}
+
+Bool wEventTraceRecord(const char *file)
+{
+	TraceHeader header;
+
+	record.file = fopen(file, "wb");
+	if (!record.file) {
+		werror(_("could not create event trace %s"), file);
+		return False;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.eventSize = sizeof(XEvent);
+	if (fwrite(&header, sizeof(header), 1, record.file) != 1) {
+		werror(_("could not write event trace %s"), file);
+		closeRecord();
+		return False;
+	}
+
+	record.clients = WMCreateHashTable(WMIntHashCallbacks);
+	record.start = now();
+	atexit(closeRecord);
+
+	WMHookEventRecorder(recordEvent);
+
+	return True;
+}
+
+static Bool loadTrace(const char *file)
+{
+	TraceHeader header;
+	TraceRecord rec;
+	XEvent event;
+	Window *windows[3];
+	FILE *f;
+	int i, count, size = 0;
+
+	f = fopen(file, "rb");
+	if (!f) {
+		werror(_("could not open event trace %s"), file);
+		return False;
+	}
+
+	if (fread(&header, sizeof(header), 1, f) != 1
+	    || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+	    || header.eventSize != sizeof(XEvent)) {
+		werror(_("%s is not an event trace recorded on this kind of system"), file);
+		fclose(f);
+		return False;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		if (rec.length > sizeof(XEvent)) {
+			werror(_("event trace %s is corrupted"), file);
+			break;
+		}
+
+		memset(&event, 0, sizeof(event));
+		if (fread(&event, rec.length, 1, f) != 1) {
+			wwarning(_("event trace %s is truncated"), file);
+			break;
+		}
+		event.type = rec.type;
+		event.xany.display = dpy;
+
+		count = eventWindows(&event, windows);
+		for (i = 0; i < count; i++)
+			*windows[i] = untagWindow(*windows[i]);
+
+		if (replay.count == size) {
+			size = size ? 2 * size : 4096;
+			replay.events = wrealloc(replay.events, size * sizeof(XEvent));
+		}
+		replay.events[replay.count++] = event;
+		replay.duration = rec.time;
+	}
+	fclose(f);
+
+	return replay.count > 0;
+}
+
+static void accountEvent(int type, double elapsed, unsigned long requests)
+{
+	EventStats *stats = &replay.stats[type & (EVENT_TYPES - 1)];
+	int bucket = 0;
+
+	while (bucket < LATENCY_BUCKETS - 1 && elapsed >= (double)(1 << bucket))
+		bucket++;
+
+	stats->count++;
+	stats->requests += requests;
+	stats->total += elapsed;
+	if (elapsed > stats->worst)
+		stats->worst = elapsed;
+	stats->histogram[bucket]++;
+}
+
+static void printReport(void)
+{
+	EventStats *stats;
+	unsigned long requests = 0;
+	double total = 0;
+	char name[32];
+	int type, i;
+
+	printf("%d events replayed in %.3f s, recorded in %.3f s\n",
+	       replay.count, (now() - replay.start) / 1e6, replay.duration / 1e6);
+	printf("%-18s %8s %10s %10s %9s  %s\n",
+	       "event", "count", "avg us", "max us", "requests", "events by latency (from us:count)");
+
+	for (type = 0; type < EVENT_TYPES; type++) {
+		stats = &replay.stats[type];
+		if (stats->count == 0)
+			continue;
+
+		if (type < wlengthof(eventNames) && eventNames[type])
+			snprintf(name, sizeof(name), "%s", eventNames[type]);
+		else
+			snprintf(name, sizeof(name), "extension %d", type);
+
+		printf("%-18s %8u %10.1f %10.1f %9.1f ", name, stats->count,
+		       stats->total / stats->count, stats->worst, (double)stats->requests / stats->count);
+		for (i = 0; i < LATENCY_BUCKETS; i++) {
+			if (stats->histogram[i] == 0)
+				continue;
+			if (i == 0)
+				printf(" 0:%u", stats->histogram[i]);
+			else
+				printf(" %d:%u", 1 << (i - 1), stats->histogram[i]);
+		}
+		putchar('\n');
+
+		total += stats->total;
+		requests += stats->requests;
+	}
+
+	printf("%-18s %8d %10.1f %10s %9.1f\n", "all", replay.count,
+	       total / replay.count, "", (double)requests / replay.count);
+	fflush(stdout);
+}
+
+static Bool nextReplayEvent(XEvent * event, void *clientData)
+{
+	unsigned long request = NextRequest(dpy);
+	double time = now();
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) clientData;
+
+	/* the previous event is done with, whoever handled it */
+	if (replay.next > 0)
+		accountEvent(replay.events[replay.next - 1].type, time - replay.lastTime,
+			     request - replay.lastRequest);
+
+	if (replay.next == replay.count) {
+		printReport();
+		Exit(0);
+	}
+
+	/* what the server sent back is already in the trace */
+	XSync(dpy, True);
+
+	*event = replay.events[replay.next++];
+	event->xany.serial = LastKnownRequestProcessed(dpy);
+
+	replay.lastRequest = NextRequest(dpy);
+	replay.lastTime = now();
+
+	return True;
+}
+
+Bool wEventTraceReplay(const char *file)
+{
+	replay.clientDpy = XOpenDisplay(DisplayString(dpy));
+	if (!replay.clientDpy) {
+		werror(_("could not open a connection for the clients of the event trace"));
+		return False;
+	}
+
+	if (!loadTrace(file))
+		return False;
+
+	/* make sure the clients exist before wmaker hears about them */
+	XSync(replay.clientDpy, False);
+
+	wmessage(_("replaying %d events from %s"), replay.count, file);
+
+	replay.start = now();
+	WMSetEventSource(nextReplayEvent, NULL);
+
+	return True;
+}
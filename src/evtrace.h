@@ -0,0 +1,33 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WMEVTRACE_H_
+#define WMEVTRACE_H_
+
+/* Logs the X events wmaker handles to `file', until it exits */
+Bool wEventTraceRecord(const char *file);
+
+/*
+ * Feeds the events logged in `file' to wmaker instead of the ones from the
+ * X server, then prints how long they took to handle and exits.
+ */
+Bool wEventTraceReplay(const char *file);
+
+#endif
@@ -41,6 +41,9 @@
 #include "stacking.h"
 #include "misc.h"
 #include "event.h"
+#include "profile.h"
+#include "redraw.h"
+#include "atlas.h"
 
 #define TS_NORMAL_PAD 3
 
@@ -237,14 +240,14 @@ void wframewindow_map(WFrameWindow *fwin, virtual_screen *vscr, int wlevel,
 
 static void destroy_framewin_button(WFrameWindow *fwin, int state)
 {
-	destroy_pixmap(fwin->title_back[state]);
-	if (wPreferences.new_style == TS_NEW) {
-		destroy_pixmap(fwin->lbutton_back[state]);
-		destroy_pixmap(fwin->rbutton_back[state]);
+	WScreen *scr = fwin->vscr->screen_ptr;
+
+	wAtlasRelease(scr, &fwin->title_back[state]);
+	wAtlasRelease(scr, &fwin->lbutton_back[state]);
+	wAtlasRelease(scr, &fwin->rbutton_back[state]);
 #ifdef XKB_BUTTON_HINT
-		destroy_pixmap(fwin->languagebutton_back[state]);
+	wAtlasRelease(scr, &fwin->languagebutton_back[state]);
 #endif
-	}
 }
 
 static void destroy_framewin_buttons(WFrameWindow *fwin)
@@ -842,6 +845,8 @@ void framewindow_unmap(WFrameWindow *fwin)
 
 void wFrameWindowDestroy(WFrameWindow *fwin)
 {
+	wRedrawCancel(fwin);
+
 	titlebar_destroy(fwin);
 	resizebar_destroy(fwin);
 
@@ -855,6 +860,13 @@ void wFrameWindowDestroy(WFrameWindow *fwin)
 	fwin->core = NULL;
 
 	destroy_framewin_buttons(fwin);
+	wAtlasRelease(fwin->vscr->screen_ptr, &fwin->resizebar_back[0]);
+
+	if (fwin->fitted_title) {
+		wfree(fwin->fitted_title);
+		wfree(fwin->fitted_text);
+		WMReleaseFont(fwin->fitted_font);
+	}
 
 	wfree(fwin);
 }
@@ -906,6 +918,80 @@ void wframewindow_refresh_titlebar(WFrameWindow *fwin)
 	}
 }
 
+/*
+ * Sets the key of the part of `texture' at x, rendered `width' wide, so
+ * that the frames of other widths share it when it does not depend on it.
+ */
+static void texture_part_key(WAtlasKey *key, WTexture *texture, int kind,
+			     int width, int x, int w, int h)
+{
+	key->source = texture;
+	key->kind = kind;
+	key->width = w;
+	key->height = h;
+	key->span = width;
+	key->variant = x;
+
+	switch (texture->any.type) {
+	case WTEX_VGRADIENT:
+	case WTEX_MVGRADIENT:
+	case WTEX_IGRADIENT:
+		/* the same all along */
+		key->span = 0;
+		key->variant = 0;
+		break;
+
+	case WTEX_TVGRADIENT:
+		/* tiled from the left */
+		key->span = 0;
+		break;
+
+	case WTEX_PIXMAP:
+		if (texture->pixmap.subtype == WTP_TILE)
+			key->span = 0;
+		break;
+	}
+}
+
+/* The part of `texture' at x, beveled, rendering `*img' if it is not in the atlas */
+static Pixmap render_texture_part(WScreen *scr, WTexture *texture, RImage **img,
+				  int kind, int width, int height, int x, int w, int h)
+{
+	WAtlasKey key;
+	RImage *part;
+	Pixmap pixmap;
+
+	texture_part_key(&key, texture, kind, width, x, w, h);
+	pixmap = wAtlasGet(scr, &key);
+	if (pixmap != None)
+		return pixmap;
+
+	if (!*img) {
+		*img = wTextureRenderImage(texture, width, height, WREL_FLAT);
+		if (!*img) {
+			wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
+			return None;
+		}
+	}
+
+	part = RGetSubImage(*img, x, 0, w, h);
+	if (!part)
+		return None;
+
+	RBevelImage(part, RBEV_RAISED2);
+
+	wProfileCount(pixmap_uploads);
+	if (!RConvertImage(scr->rcontext, part, &pixmap)) {
+		wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+		pixmap = None;
+	}
+	RReleaseImage(part);
+
+	wAtlasPut(scr, &key, pixmap);
+
+	return pixmap;
+}
+
 static void renderTexture(WScreen *scr, WTexture *texture,
 			 int width, int height,
 			 int bwidth, int bheight,
@@ -916,11 +1002,8 @@ static void renderTexture(WScreen *scr, WTexture *texture,
 #endif
 			 int right, Pixmap *rbutton)
 {
-	RImage *img, *limg = NULL, *rimg = NULL, *mimg;
-#ifdef XKB_BUTTON_HINT
-	RImage *timg = NULL;
-#endif
-	int x = 0, w;
+	RImage *img = NULL;
+	int x = 0, w = width;
 
 	*title = None;
 	*lbutton = None;
@@ -929,93 +1012,66 @@ static void renderTexture(WScreen *scr, WTexture *texture,
 	*languagebutton = None;
 #endif
 
-	img = wTextureRenderImage(texture, width, height, WREL_FLAT);
-	if (!img) {
-		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
-		return;
-	}
-
 	if (wPreferences.new_style != TS_NEW) {
-		RBevelImage(img, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, img, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		RReleaseImage(img);
-		return;
+		*title = render_texture_part(scr, texture, &img, WATLAS_TITLEBAR,
+					     width, height, 0, width, height);
+		goto out;
 	}
 
-	if (left)
-		limg = RGetSubImage(img, 0, 0, bwidth, bheight);
-
-	w = img->width;
-
-#ifdef XKB_BUTTON_HINT
-	if (language)
-		timg = RGetSubImage(img, bwidth * left, 0, bwidth, bheight);
-#endif
-
-	if (limg) {
-		RBevelImage(limg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, limg, lbutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+	/* the buttons are cut from the texture of the whole titlebar */
+	bwidth = WMIN(bwidth, width);
+	bheight = WMIN(bheight, height);
 
-		x += limg->width;
-		w -= limg->width;
-		RReleaseImage(limg);
+	if (left) {
+		*lbutton = render_texture_part(scr, texture, &img, WATLAS_BUTTON,
+					       width, height, x, bwidth, bheight);
+		x += bwidth;
+		w -= bwidth;
 	}
 
 #ifdef XKB_BUTTON_HINT
-	if (timg) {
-		RBevelImage(timg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, timg, languagebutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		x += timg->width;
-		w -= timg->width;
-		RReleaseImage(timg);
+	if (language && w >= bwidth) {
+		*languagebutton = render_texture_part(scr, texture, &img, WATLAS_BUTTON,
+						      width, height, x, bwidth, bheight);
+		x += bwidth;
+		w -= bwidth;
 	}
 #endif
 
-	if (right)
-		rimg = RGetSubImage(img, width - bwidth, 0, bwidth, bheight);
-
-	if (rimg) {
-		RBevelImage(rimg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, rimg, rbutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		w -= rimg->width;
-		RReleaseImage(rimg);
+	if (right && w >= bwidth) {
+		*rbutton = render_texture_part(scr, texture, &img, WATLAS_BUTTON,
+					       width, height, width - bwidth, bwidth, bheight);
+		w -= bwidth;
 	}
 
-	if (w != width) {
-		mimg = RGetSubImage(img, x, 0, w, img->height);
-		RBevelImage(mimg, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, mimg, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+	if (w > 0)
+		*title = render_texture_part(scr, texture, &img, WATLAS_TITLEBAR,
+					     width, height, x, w, height);
 
-		RReleaseImage(mimg);
-	} else {
-		RBevelImage(img, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, img, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-	}
-
-	RReleaseImage(img);
+ out:
+	if (img)
+		RReleaseImage(img);
 }
 
 static void renderResizebarTexture(WScreen *scr, WTexture *texture,
 				   int width, int height, int cwidth,
 				   Pixmap *pmap)
 {
+	WAtlasKey key;
 	RImage *img;
 	RColor light;
 	RColor dark;
 
-	*pmap = None;
+	key.source = texture;
+	key.kind = WATLAS_RESIZEBAR;
+	key.width = width;
+	key.height = height;
+	key.span = width;
+	key.variant = cwidth;
+
+	*pmap = wAtlasGet(scr, &key);
+	if (*pmap != None)
+		return;
 
 	img = wTextureRenderImage(texture, width, height, WREL_FLAT);
 	if (!img) {
@@ -1046,10 +1102,15 @@ static void renderResizebarTexture(WScreen *scr, WTexture *texture,
 	ROperateLine(img, RSubtractOperation, 0, height - 1, width - 1, height - 1, &dark);
 #endif				/* SHADOW_RESIZEBAR */
 
-	if (!RConvertImage(scr->rcontext, img, pmap))
+	wProfileCount(pixmap_uploads);
+	if (!RConvertImage(scr->rcontext, img, pmap)) {
 		wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+		*pmap = None;
+	}
 
 	RReleaseImage(img);
+
+	wAtlasPut(scr, &key, *pmap);
 }
 
 static void updateTexture_titlebar(WFrameWindow *fwin)
@@ -1134,9 +1195,10 @@ static void remakeTexture_titlebar(WFrameWindow *fwin, int state)
 	if (!fwin->title_texture[state] || !fwin->titlebar || !fwin->flags.titlebar)
 		return;
 
-	destroy_framewin_button(fwin, state);
-	if (fwin->title_texture[state]->any.type == WTEX_SOLID)
+	if (fwin->title_texture[state]->any.type == WTEX_SOLID) {
+		destroy_framewin_button(fwin, state);
 		return;
+	}
 
 	/* eventually surrounded by if new_style */
 	left = fwin->left_button && fwin->flags.map_left_button &&
@@ -1159,14 +1221,15 @@ static void remakeTexture_titlebar(WFrameWindow *fwin, int state)
 #endif
 		      right, &rpmap);
 
+	/* released after, so that what did not change is not made again */
+	destroy_framewin_button(fwin, state);
+
 	fwin->title_back[state] = pmap;
-	if (wPreferences.new_style == TS_NEW) {
-		fwin->lbutton_back[state] = lpmap;
-		fwin->rbutton_back[state] = rpmap;
+	fwin->lbutton_back[state] = lpmap;
+	fwin->rbutton_back[state] = rpmap;
 #ifdef XKB_BUTTON_HINT
-		fwin->languagebutton_back[state] = tpmap;
+	fwin->languagebutton_back[state] = tpmap;
 #endif
-	}
 }
 
 static void remakeTexture_resizebar(WFrameWindow *fwin, int state)
@@ -1177,15 +1240,17 @@ static void remakeTexture_resizebar(WFrameWindow *fwin, int state)
 	    !fwin->resizebar || !fwin->flags.resizebar || state != 0)
 		return;
 
-	destroy_pixmap(fwin->resizebar_back[0]);
-	if (fwin->resizebar_texture[0]->any.type == WTEX_SOLID)
+	if (fwin->resizebar_texture[0]->any.type == WTEX_SOLID) {
+		wAtlasRelease(fwin->vscr->screen_ptr, &fwin->resizebar_back[0]);
 		return;
+	}
 
 	renderResizebarTexture(fwin->vscr->screen_ptr,
 			       fwin->resizebar_texture[0],
 			       fwin->width,
 			       fwin->resizebar_height, fwin->resizebar_corner_width, &pmap);
 
+	wAtlasRelease(fwin->vscr->screen_ptr, &fwin->resizebar_back[0]);
 	fwin->resizebar_back[0] = pmap;
 }
 
@@ -1200,12 +1265,39 @@ static char *get_title(WFrameWindow *fwin)
 	return NULL;
 }
 
+/* Shortens the title to fit in `space', unless it was already done */
+static const char *fit_title(WFrameWindow *fwin, const char *title, int space, int *width)
+{
+	if (fwin->fitted_title && fwin->fitted_space == space &&
+	    fwin->fitted_font == *fwin->font && strcmp(fwin->fitted_title, title) == 0) {
+		wProfileHit(fitted_title, True);
+		*width = fwin->fitted_width;
+		return fwin->fitted_text;
+	}
+	wProfileHit(fitted_title, False);
+
+	if (fwin->fitted_title) {
+		wfree(fwin->fitted_title);
+		wfree(fwin->fitted_text);
+		WMReleaseFont(fwin->fitted_font);
+	}
+
+	fwin->fitted_title = wstrdup(title);
+	fwin->fitted_text = ShrinkStringWithWidth(*fwin->font, title, space, &fwin->fitted_width);
+	fwin->fitted_font = WMRetainFont(*fwin->font);
+	fwin->fitted_space = space;
+
+	*width = fwin->fitted_width;
+	return fwin->fitted_text;
+}
+
 static void paint_title(WFrameWindow *fwin, int lofs, int rofs, int state)
 {
 	Drawable buf;
 	virtual_screen *vscr = fwin->vscr;
 	WScreen *scr = vscr->screen_ptr;
-	char *title, *orig_title;
+	const char *title;
+	char *orig_title;
 	int w, h, x, y;
 	int titlelen;
 
@@ -1214,9 +1306,8 @@ static void paint_title(WFrameWindow *fwin, int lofs, int rofs, int state)
 	if (!orig_title)
 		return;
 
-	title = ShrinkString(*fwin->font, orig_title, fwin->titlebar_width - lofs - rofs);
+	title = fit_title(fwin, orig_title, fwin->titlebar_width - lofs - rofs, &w);
 	titlelen = strlen(title);
-	w = WMWidthOfString(*fwin->font, title, titlelen);
 
 	switch (fwin->flags.justification) {
 	case WTJ_LEFT:
@@ -1264,8 +1355,6 @@ static void paint_title(WFrameWindow *fwin, int lofs, int rofs, int state)
 
 	XCopyArea(dpy, buf, fwin->titlebar->window, scr->copy_gc, 0, 0, w + 2, h, x - 1, y);
 	XFreePixmap(dpy, buf);
-
-	wfree(title);
 }
 
 void wFrameWindowPaint(WFrameWindow *fwin)
@@ -1468,14 +1557,30 @@ void wFrameWindowResize(WFrameWindow *fwin, int width, int height)
 	reconfigure(fwin, width, height);
 }
 
+static void repaintTitle(void *data)
+{
+	WFrameWindow *fwin = data;
+
+	if (fwin->titlebar && fwin->flags.titlebar) {
+		XClearWindow(dpy, fwin->titlebar->window);
+		wFrameWindowPaint(fwin);
+	}
+}
+
 int wFrameWindowChangeTitle(WFrameWindow *fwin, const char *new_title)
 {
 	if (new_title == NULL)
 		return 0;
 
+	/*
+	 * Clients like terminals can change it many times in a row. Nobody is
+	 * looking at the titles of the other windows that closely.
+	 */
 	if (fwin->titlebar && fwin->flags.titlebar) {
-		XClearWindow(dpy, fwin->titlebar->window);
-		wFrameWindowPaint(fwin);
+		if (fwin->parent_wwin && fwin->flags.state != WS_FOCUSED)
+			wRedrawLazily(fwin, repaintTitle);
+		else
+			wRedrawLater(fwin, repaintTitle);
 	}
 
 	checkTitleSize(fwin);
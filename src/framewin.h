@@ -94,6 +94,13 @@ typedef struct WFrameWindow {
     WMColor **title_color;
     WMFont **font;
 
+    /* the title as last shortened to fit in the titlebar */
+    char *fitted_title;		       /* the title it was made from */
+    char *fitted_text;
+    WMFont *fitted_font;	       /* retained, so it is not reused */
+    int fitted_space;
+    int fitted_width;
+
 #ifdef KEEP_XKB_LOCK_STATUS
     int languagemode;
     int last_languagemode;
@@ -49,6 +49,9 @@
 #include "input.h"
 #include "framewin.h"
 #include "miniwindow.h"
+#include "profile.h"
+#include "redraw.h"
+#include "atlas.h"
 
 /**** Global varianebles ****/
 
@@ -65,7 +68,7 @@ static RImage *get_default_image(virtual_screen *vscr);
 static RImage *get_rimage_from_file(virtual_screen *vscr, const char *file_name, int max_size);
 
 /****** Notification Observers ******/
-void icon_appearanceObserver(void *self, WMNotification *notif)
+static void icon_appearanceObserver(void *self, WMNotification *notif)
 {
 	WIcon *icon = (WIcon *) self;
 	uintptr_t flags = (uintptr_t)WMGetNotificationClientData(notif);
@@ -84,7 +87,7 @@ void icon_appearanceObserver(void *self, WMNotification *notif)
 			   wPreferences.icon_size, wPreferences.icon_size, True);
 }
 
-void icon_tileObserver(void *self, WMNotification *notif)
+static void icon_tileObserver(void *self, WMNotification *notif)
 {
 	WIcon *icon = (WIcon *) self;
 
@@ -97,6 +100,18 @@ void icon_tileObserver(void *self, WMNotification *notif)
 	XClearArea(dpy, icon->core->window, 0, 0, 1, 1, True);
 }
 
+void icon_observe_settings(WIcon *icon)
+{
+	/* not twice when it is mapped again */
+	WMDeleteNotificationObserver(icon->appearance_observer);
+	WMDeleteNotificationObserver(icon->tile_observer);
+
+	icon->appearance_observer = WMAddNotificationObserver(icon_appearanceObserver, icon,
+							      WNIconAppearanceSettingsChanged, icon);
+	icon->tile_observer = WMAddNotificationObserver(icon_tileObserver, icon,
+							WNIconTileSettingsChanged, icon);
+}
+
 /************************************/
 
 static int getSize(Drawable d, unsigned int *w, unsigned int *h, unsigned int *dep)
@@ -140,7 +155,7 @@ static void icon_destroy_core(WIcon *icon)
 	if (icon->core->stacking)
 		wfree(icon->core->stacking);
 
-	XDeleteContext(dpy, icon->core->window, w_global.context.client_win);
+	WMWindowTableRemove(w_global.windows, icon->core->window, WT_DESCRIPTOR);
 	XDestroyWindow(dpy, icon->core->window);
 
 	wcore_destroy(icon->core);
@@ -152,7 +167,9 @@ void wIconDestroy(WIcon *icon)
 {
 	WScreen *scr = icon->vscr->screen_ptr;
 
-	WMRemoveNotificationObserver(icon);
+	WMDeleteNotificationObserver(icon->appearance_observer);
+	WMDeleteNotificationObserver(icon->tile_observer);
+	wRedrawCancel(icon);
 
 	if (icon->handlerID)
 		WMDeleteTimerHandler(icon->handlerID);
@@ -172,8 +189,7 @@ void wIconDestroy(WIcon *icon)
 	if (icon->title)
 		wfree(icon->title);
 
-	if (icon->pixmap)
-		XFreePixmap(dpy, icon->pixmap);
+	wAtlasRelease(scr, &icon->pixmap);
 
 	if (icon->mini_preview)
 		XFreePixmap(dpy, icon->mini_preview);
@@ -194,8 +210,10 @@ static void drawIconTitleBackground(WScreen *scr, Pixmap pixmap, int height)
 
 static void icon_update_pixmap(WIcon *icon, RImage *image)
 {
-	RImage *tile;
+	RImage *source, *tile;
 	Pixmap pixmap;
+	WAtlasKey key;
+	Bool shared;
 	int x, y, sx, sy;
 	unsigned w, h;
 	int theight = 0;
@@ -203,13 +221,13 @@ static void icon_update_pixmap(WIcon *icon, RImage *image)
 
 	switch (icon->tile_type) {
 	case TILE_NORMAL:
-		tile = RCloneImage(w_global.tile.icon);
+		source = w_global.tile.icon;
 		break;
 	case TILE_CLIP:
-		tile = RCloneImage(w_global.tile.clip);
+		source = w_global.tile.clip;
 		break;
 	case TILE_DRAWER:
-		tile = RCloneImage(w_global.tile.drawer);
+		source = w_global.tile.drawer;
 		break;
 	default:
 		/*
@@ -218,9 +236,27 @@ static void icon_update_pixmap(WIcon *icon, RImage *image)
 		 * "may be used uninitialized"
 		 */
 		wwarning("Unknown tile type: %d.\n", icon->tile_type);
-		tile = RCloneImage(w_global.tile.icon);
+		source = w_global.tile.icon;
 	}
 
+	/* the tiles with nothing drawn on them are the same for all the icons */
+	shared = !image && !icon->show_title;
+
+	key.source = shared ? (const void *) source : (const void *) icon;
+	key.kind = shared ? WATLAS_ICON_TILE : WATLAS_ICON;
+	key.width = wPreferences.icon_size;
+	key.height = wPreferences.icon_size;
+	key.span = 0;
+	key.variant = icon->shadowed | icon->highlighted << 1;
+
+	if (shared) {
+		icon->pixmap = wAtlasGet(scr, &key);
+		if (icon->pixmap != None)
+			return;
+	}
+
+	tile = RCloneImage(source);
+
 	if (image) {
 		w = (image->width > wPreferences.icon_size)
 		    ? wPreferences.icon_size : image->width;
@@ -256,16 +292,20 @@ static void icon_update_pixmap(WIcon *icon, RImage *image)
 		RLightImage(tile, &color);
 	}
 
-	if (!RConvertImage(scr->rcontext, tile, &pixmap))
+	wProfileCount(pixmap_uploads);
+	if (!RConvertImage(scr->rcontext, tile, &pixmap)) {
 		wwarning(_("error rendering image:%s"), RMessageForError(RErrorCode));
+		pixmap = None;
+	}
 
 	RReleaseImage(tile);
 
 	/* Draw the icon's title background (without text) */
-	if (icon->show_title)
+	if (icon->show_title && pixmap != None)
 		drawIconTitleBackground(scr, pixmap, theight);
 
 	icon->pixmap = pixmap;
+	wAtlasPut(scr, &key, pixmap);
 }
 
 void wIconChangeTitle(WIcon *icon, WWindow *wwin)
@@ -640,10 +680,7 @@ void wIconUpdate(WIcon *icon)
 
 void update_icon_pixmap(WIcon *icon)
 {
-	if (icon->pixmap != None)
-		XFreePixmap(dpy, icon->pixmap);
-
-	icon->pixmap = None;
+	wAtlasRelease(icon->vscr->screen_ptr, &icon->pixmap);
 
 	/* Create the pixmap */
 	if (icon->file_image)
@@ -652,6 +689,7 @@ void update_icon_pixmap(WIcon *icon)
 	/* If dockapp, put inside the icon */
 	if (icon->icon_win != None) {
 		/* file_image is NULL, because is docked app */
+		wAtlasRelease(icon->vscr->screen_ptr, &icon->pixmap);
 		icon_update_pixmap(icon, NULL);
 		set_dockapp_in_icon(icon);
 	}
@@ -800,8 +838,7 @@ void map_icon_image(WIcon *icon)
 
 void unmap_icon_image(WIcon *icon)
 {
-	if (icon->pixmap != None)
-		XFreePixmap(dpy, icon->pixmap);
+	wAtlasRelease(icon->vscr->screen_ptr, &icon->pixmap);
 
 	unset_icon_file_image(icon);
 }
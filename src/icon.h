@@ -56,6 +56,9 @@ typedef struct WIcon {
 
 	WMHandlerID	handlerID;	/* timer handler ID for cycling select
 					 * color */
+
+	WMHandlerID	appearance_observer;
+	WMHandlerID	tile_observer;
 } WIcon;
 
 WIcon *icon_create_core(virtual_screen *vscr);
@@ -82,8 +85,7 @@ void set_icon_image_from_image(WIcon *icon, RImage *image);
 void map_icon_image(WIcon *icon);
 void unmap_icon_image(WIcon *icon);
 
-void icon_appearanceObserver(void *self, WMNotification *notif);
-void icon_tileObserver(void *self, WMNotification *notif);
+void icon_observe_settings(WIcon *icon);
 
 void remove_cache_icon(char *filename);
 char *get_icon_filename(const char *winstance, const char *wclass, const char *command, Bool default_icon);
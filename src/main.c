@@ -47,6 +47,7 @@
 #include "window.h"
 #include "defaults.h"
 #include "event.h"
+#include "evtrace.h"
 #include "startup.h"
 #include "menu.h"
 #include "keybind.h"
@@ -57,6 +58,8 @@
 #include "main.h"
 #include "monitor.h"
 #include "shell.h"
+#include "profile.h"
+#include "atlas.h"
 
 #include <WINGs/WUtil.h>
 
@@ -99,6 +102,14 @@ static int ArgCount;
 
 static Bool multiHead = True;
 
+#ifdef USE_PROFILING
+static Bool profile = False;
+#endif
+
+/* --record-events and --replay-events */
+static char *eventTraceFile = NULL;
+static Bool replayEventTrace = False;
+
 static int *wVisualID = NULL;
 static int wVisualID_len = 0;
 
@@ -315,6 +326,12 @@ static void print_help(void)
 #ifndef HAVE_INOTIFY
 	puts(_(" --no-polling		do not periodically check for configuration updates"));
 #endif
+#ifdef USE_PROFILING
+	puts(_(" --profile		start with the profiling counters on"));
+	puts(_(" --no-shared-pixmaps	give each frame and icon pixmaps of its own, to compare"));
+#endif
+	puts(_(" --record-events file	log the X events handled to file"));
+	puts(_(" --replay-events file	replay the events logged in file, report how long they took and exit"));
 	puts(_(" --global_defaults_path	print the path for default config and exit"));
 	puts(_(" --version		print version and exit"));
 	puts(_(" --help			show this message"));
@@ -557,6 +574,21 @@ static int real_main(int argc, char **argv)
 #else
 				wmessage(_("your version of Window Maker was compiled with INotify support, so \"--no-polling\" has no effect"));
 #endif
+#ifdef USE_PROFILING
+			} else if (strcmp(argv[i], "--profile") == 0) {
+				profile = True;
+			} else if (strcmp(argv[i], "--no-shared-pixmaps") == 0) {
+				wAtlasSharing = False;
+#endif
+			} else if (strcmp(argv[i], "--record-events") == 0
+				   || strcmp(argv[i], "--replay-events") == 0) {
+				i++;
+				if (i >= argc) {
+					wwarning(_("too few arguments for %s"), argv[i - 1]);
+					exit(0);
+				}
+				eventTraceFile = argv[i];
+				replayEventTrace = (strcmp(argv[i - 1], "--replay-events") == 0);
 			} else if (strcmp(argv[i], "--help") == 0) {
 				print_help();
 				exit(0);
@@ -656,6 +688,8 @@ static int real_main(int argc, char **argv)
 
 	wXModifierInitialize();
 
+	wProfileInitialize(profile);
+
 	startup_virtual();
 	StartUp(!multiHead);
 
@@ -666,6 +700,12 @@ static int real_main(int argc, char **argv)
 #ifdef HAVE_INOTIFY
 	inotifyWatchConfig();
 #endif
+	if (eventTraceFile) {
+		if (!replayEventTrace)
+			wEventTraceRecord(eventTraceFile);
+		else if (!wEventTraceReplay(eventTraceFile))
+			Exit(1);
+	}
 	EventLoop();
 	return -1;
 }
@@ -44,6 +44,8 @@
 #include "dialog.h"
 #include "rootmenu.h"
 #include "switchmenu.h"
+#include "profile.h"
+#include "redraw.h"
 
 #define F_NORMAL	0
 #define F_TOP		1
@@ -116,6 +118,10 @@ static void menuTitleMouseDown(WCoreWindow * sender, void *data, XEvent * event)
 static void menuTitleMouseDown(WCoreWindow *sender, void *data, XEvent *event);
 static void move_menus(WMenu *menu, int x, int y);
 static void paintEntry(WMenu *menu, int index, int selected);
+static void drawEntry(WMenu *menu, Drawable d, int index, int selected);
+static void invalidateEntryCache(WMenu *menu);
+static Bool prepareEntryCache(WMenu *menu);
+static void updateEntryCache(WMenu *menu, int index);
 static void raiseMenus(WMenu *menu, int submenus);
 static void restore_rootmenu_map(virtual_screen *vscr);
 static void restore_rootmenu(virtual_screen *vscr, WMPropList *menus);
@@ -165,8 +171,10 @@ static void appearanceObserver(void *self, WMNotification *notif)
 		if (flags & WTextureSettings)
 			updateTexture(menu);
 
-		if (flags & (WTextureSettings | WColorSettings))
+		if (flags & (WTextureSettings | WColorSettings)) {
+			invalidateEntryCache(menu);
 			wMenuPaint(menu);
+		}
 
 	} else if (menu->flags.titled) {
 		if (flags & WFontSettings) {
@@ -257,9 +265,14 @@ WMenu *menu_create(virtual_screen *vscr, const char *title)
 
 void menu_unmap(WMenu *menu)
 {
+	/* menu_map() observes them again */
+	WMDeleteNotificationObserver(menu->appearance_observer);
+	WMDeleteNotificationObserver(menu->title_observer);
+
 	destroy_pixmap(menu->menu_texture_data);
+	invalidateEntryCache(menu);
 
-	XDeleteContext(dpy, menu->core->window, w_global.context.client_win);
+	WMWindowTableRemove(w_global.windows, menu->core->window, WT_DESCRIPTOR);
 	XDestroyWindow(dpy, menu->core->window);
 
 	framewindow_unmap(menu->frame);
@@ -334,8 +347,10 @@ void menu_map(WMenu *menu)
 
 	XFlush(dpy);
 
-	WMAddNotificationObserver(appearanceObserver, menu, WNMenuAppearanceSettingsChanged, menu);
-	WMAddNotificationObserver(appearanceObserver, menu, WNMenuTitleAppearanceSettingsChanged, menu);
+	menu->appearance_observer = WMAddNotificationObserver(appearanceObserver, menu,
+							      WNMenuAppearanceSettingsChanged, menu);
+	menu->title_observer = WMAddNotificationObserver(appearanceObserver, menu,
+							 WNMenuTitleAppearanceSettingsChanged, menu);
 }
 
 static void insertEntry(WMenu *menu, WMenuEntry *entry, int index)
@@ -497,6 +512,7 @@ static Pixmap renderTexture(WMenu *menu)
 		}
 	}
 
+	wProfileCount(pixmap_uploads);
 	if (!RConvertImage(scr->rcontext, img, &pix))
 		wwarning(_("error rendering image:%s"), RMessageForError(RErrorCode));
 
@@ -509,6 +525,9 @@ static void updateTexture(WMenu *menu)
 {
 	WScreen *scr = menu->vscr->screen_ptr;
 
+	/* the cached entries were drawn over the old background */
+	invalidateEntryCache(menu);
+
 	/* setup background texture */
 	if (scr->menu_item_texture->any.type != WTEX_SOLID) {
 		destroy_pixmap(menu->menu_texture_data);
@@ -622,7 +641,9 @@ void wMenuDestroy(WMenu *menu)
 {
 	int i;
 
-	WMRemoveNotificationObserver(menu);
+	WMDeleteNotificationObserver(menu->appearance_observer);
+	WMDeleteNotificationObserver(menu->title_observer);
+	wRedrawCancel(menu);
 
 	/* remove any pending timers */
 	if (menu->timer)
@@ -708,21 +729,139 @@ static void drawFrame(WMenu *menu, Drawable win, int y, int w, int h, int type)
 		XDrawLine(dpy, win, vscr->screen_ptr->menu_item_auxtexture->dark_gc, 0, y + h - 1, w - 1, y + h - 1);
 }
 
+static int getEntryFrameType(WMenu *menu, int index)
+{
+	if (wPreferences.menu_style != MS_FLAT || menu->entry_no <= 1)
+		return F_NORMAL;
+
+	if (index == 0)
+		return F_TOP;
+	else if (index == menu->entry_no - 1)
+		return F_BOTTOM;
+
+	return F_NONE;
+}
+
+/*
+ * The unselected look of every entry is kept in a pixmap the size of the
+ * menu, so exposing, scrolling and moving the selection around only need
+ * to copy rectangles from it. Each entry remembers a key of what it looked
+ * like when it was drawn there; the code changing entries does not have to
+ * tell us about it, the entry is redrawn when its key no longer matches.
+ */
+static void invalidateEntryCache(WMenu *menu)
+{
+	if (menu->entry_cache != None) {
+		XFreePixmap(dpy, menu->entry_cache);
+		menu->entry_cache = None;
+	}
+
+	menu->entry_cache_serial++;
+}
+
+static unsigned int hashEntryString(unsigned int hash, const char *text)
+{
+	if (text) {
+		while (*text)
+			hash = (hash ^ (unsigned char) *text++) * 16777619U;
+	}
+
+	return (hash ^ 0xff) * 16777619U;
+}
+
+static unsigned int getEntryCacheKey(WMenu *menu, int index)
+{
+	WMenuEntry *entry = menu->entries[index];
+	unsigned int hash = 2166136261U;
+
+	hash = (hash ^ menu->entry_cache_serial) * 16777619U;
+	hash = (hash ^ index) * 16777619U;
+	hash = (hash ^ getEntryFrameType(menu, index)) * 16777619U;
+	hash = (hash ^ (entry->cascade >= 0)) * 16777619U;
+	hash = (hash ^ (entry->flags.enabled | entry->flags.indicator << 1 |
+			entry->flags.indicator_on << 2 |
+			entry->flags.indicator_type << 3)) * 16777619U;
+	hash = hashEntryString(hash, entry->text);
+	hash = hashEntryString(hash, entry->rtext);
+
+	return hash ? hash : 1;
+}
+
+static Bool prepareEntryCache(WMenu *menu)
+{
+	WScreen *scr = menu->vscr->screen_ptr;
+	int height = menu->entry_no * menu->entry_height;
+
+	if (!menu->flags.realized || menu->entry_no <= 0)
+		return False;
+
+	/* textured backgrounds are copied from the rendered texture */
+	if (scr->menu_item_texture->any.type != WTEX_SOLID && menu->menu_texture_data == None)
+		return False;
+
+	/* too big for a pixmap, fallback to drawing on the window */
+	if (height > 32767)
+		return False;
+
+	if (menu->entry_cache != None &&
+	    menu->entry_cache_width == menu->width &&
+	    menu->entry_cache_height == height)
+		return True;
+
+	invalidateEntryCache(menu);
+	menu->entry_cache = XCreatePixmap(dpy, menu->core->window, menu->width, height, scr->w_depth);
+	menu->entry_cache_width = menu->width;
+	menu->entry_cache_height = height;
+
+	return True;
+}
+
+static void updateEntryCache(WMenu *menu, int index)
+{
+	WMenuEntry *entry = menu->entries[index];
+	unsigned int key;
+
+	key = getEntryCacheKey(menu, index);
+	wProfileHit(menu_entry_cache, entry->cache_key == key);
+	if (entry->cache_key == key)
+		return;
+
+	drawEntry(menu, menu->entry_cache, index, False);
+	entry->cache_key = key;
+}
+
 static void paintEntry(WMenu *menu, int index, int selected)
+{
+	WScreen *scr = menu->vscr->screen_ptr;
+	int y;
+
+	if (!menu->flags.realized)
+		return;
+
+	if (selected || !prepareEntryCache(menu)) {
+		drawEntry(menu, menu->core->window, index, selected);
+		return;
+	}
+
+	updateEntryCache(menu, index);
+
+	y = index * menu->entry_height;
+	XSetClipMask(dpy, scr->copy_gc, None);
+	XCopyArea(dpy, menu->entry_cache, menu->core->window, scr->copy_gc,
+		  0, y, menu->width, menu->entry_height, 0, y);
+}
+
+static void drawEntry(WMenu *menu, Drawable win, int index, int selected)
 {
 	virtual_screen *vscr = menu->vscr;
 	WScreen *scr = vscr->screen_ptr;
-	Window win = menu->core->window;
 	WMenuEntry *entry = menu->entries[index];
 	GC light, dim, dark;
 	WMColor *color;
 	int x, y, w, h, tw, iw, ih;
-	int type = F_NORMAL;
+	int type;
 	WPixmap *indicator;
 
-	if (!menu->flags.realized)
-		return;
-
 	h = menu->entry_height;
 	w = menu->width;
 	y = index * h;
@@ -731,20 +870,25 @@ static void paintEntry(WMenu *menu, int index, int selected)
 	dim = scr->menu_item_auxtexture->dim_gc;
 	dark = scr->menu_item_auxtexture->dark_gc;
 
-	if (wPreferences.menu_style == MS_FLAT && menu->entry_no > 1) {
-		if (index == 0)
-			type = F_TOP;
-		else if (index == menu->entry_no - 1)
-			type = F_BOTTOM;
-		else
-			type = F_NONE;
-	}
+	type = getEntryFrameType(menu, index);
 
 	/* paint background */
 	if (selected) {
 		XFillRectangle(dpy, win, WMColorGC(scr->select_color), 1, y + 1, w - 2, h - 3);
 		if (scr->menu_item_texture->any.type == WTEX_SOLID)
 			drawFrame(menu, win, y, w, h, type);
+	} else if (win == menu->entry_cache) {
+		/* paint what clearing the window would have shown */
+		XSetClipMask(dpy, scr->copy_gc, None);
+		if (scr->menu_item_texture->any.type == WTEX_SOLID) {
+			XSetForeground(dpy, scr->copy_gc, scr->menu_item_texture->any.color.pixel);
+			XFillRectangle(dpy, win, scr->copy_gc, 0, y, w, h);
+			drawFrame(menu, win, y, w, h, type);
+		} else if (wPreferences.menu_style == MS_NORMAL) {
+			XCopyArea(dpy, menu->menu_texture_data, win, scr->copy_gc, 0, 0, w, h, 0, y);
+		} else {
+			XCopyArea(dpy, menu->menu_texture_data, win, scr->copy_gc, 0, y, w, h, 0, y);
+		}
 	} else {
 		if (scr->menu_item_texture->any.type == WTEX_SOLID) {
 			XClearArea(dpy, win, 0, y + 1, w - 1, h - 3, False);
@@ -1143,9 +1287,29 @@ void wMenuPaint(WMenu *menu)
 	if (!menu->flags.mapped)
 		return;
 
-	/* paint entries */
+	wProfileBegin(wMenuPaint);
+
+	if (!prepareEntryCache(menu)) {
+		/* paint entries */
+		for (i = 0; i < menu->entry_no; i++)
+			paintEntry(menu, i, i == menu->selected_entry);
+
+		wProfileEnd(wMenuPaint);
+		return;
+	}
+
+	/* bring the cached entries up to date and show them all at once */
 	for (i = 0; i < menu->entry_no; i++)
-		paintEntry(menu, i, i == menu->selected_entry);
+		updateEntryCache(menu, i);
+
+	XSetClipMask(dpy, menu->vscr->screen_ptr->copy_gc, None);
+	XCopyArea(dpy, menu->entry_cache, menu->core->window, menu->vscr->screen_ptr->copy_gc,
+		  0, 0, menu->entry_cache_width, menu->entry_cache_height, 0, 0);
+
+	if (menu->selected_entry >= 0 && menu->selected_entry < menu->entry_no)
+		paintEntry(menu, menu->selected_entry, True);
+
+	wProfileEnd(wMenuPaint);
 }
 
 void menu_entry_set_enabled(WMenu *menu, int index, int enable)
@@ -1279,7 +1443,7 @@ static WMenu *findMenu(virtual_screen *vscr, int *x_ret, int *y_ret)
 	if (win == None)
 		return NULL;
 
-	if (XFindContext(dpy, win, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, win, WT_DESCRIPTOR)) == NULL)
 		return NULL;
 
 	if (desc->parent_type != WCLASS_MENU)
@@ -1384,7 +1548,7 @@ WMenu *wMenuUnderPointer(virtual_screen *vscr)
 	if (win == None)
 		return NULL;
 
-	if (XFindContext(dpy, win, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, win, WT_DESCRIPTOR)) == NULL)
 		return NULL;
 
 	if (desc->parent_type != WCLASS_MENU)
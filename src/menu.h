@@ -37,6 +37,8 @@ typedef struct WMenuEntry {
 	void (*free_cdata)(void *data);		/* proc to be used to free clientdata */
 	void *clientdata;			/* data to pass to callback */
 	int cascade;				/* cascade menu index */
+	unsigned int cache_key;			/* state drawn in the menu entry
+						 * cache, 0 if not drawn yet */
 #ifdef USER_MENU
 	WMPropList *instances;			/* allowed instances */
 #endif /* USER_MENU */
@@ -57,11 +59,16 @@ typedef struct WMenu {
 
 	time_t timestamp;			/* for the root menu. Last time
 						 * menu was reloaded */
+	unsigned int generation;		/* of the menu cache it was read from */
 
 	/* decorations */
 	struct WFrameWindow *frame;
 	WCoreWindow *core;			/* the window menu */
 	Pixmap menu_texture_data;
+	Pixmap entry_cache;			/* unselected entries, rendered */
+	int entry_cache_width;
+	int entry_cache_height;
+	unsigned int entry_cache_serial;	/* bumped on every invalidation */
 
 	WMenuEntry **entries;			/* array of entries */
 	short alloced_entries;			/* number of entries allocated in
@@ -77,6 +84,9 @@ typedef struct WMenu {
 
 	WMHandlerID timer;			/* timer for the autoscroll */
 
+	WMHandlerID appearance_observer;	/* for the menu appearance settings */
+	WMHandlerID title_observer;		/* for the title appearance settings */
+
 	void *jump_back;			/* jump back data */
 
 	/* to be called when some entry is edited */
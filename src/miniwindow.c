@@ -39,6 +39,7 @@
 #include "winmenu.h"
 #include "placement.h"
 #include "xinerama.h"
+#include "redraw.h"
 
 static void miniwindow_create_minipreview_showerror(WWindow *wwin);
 static void miniwindow_DblClick(WObjDescriptor *desc, XEvent *event);
@@ -136,8 +137,7 @@ static void miniwindow_icon_map(WIcon *icon)
 
 	map_icon_image(icon);
 
-	WMAddNotificationObserver(icon_appearanceObserver, icon, WNIconAppearanceSettingsChanged, icon);
-	WMAddNotificationObserver(icon_tileObserver, icon, WNIconTileSettingsChanged, icon);
+	icon_observe_settings(icon);
 }
 
 void miniwindow_destroy_icon(WWindow *wwin)
@@ -161,13 +161,18 @@ void miniwindow_removeIcon(WWindow *wwin)
 	}
 }
 
+static void repaintIcon(void *data)
+{
+	wIconPaint((WIcon *) data);
+}
+
 void miniwindow_updatetitle(WWindow *wwin)
 {
 	if (!wwin->miniwindow->icon)
 		return;
 
 	wIconChangeTitle(wwin->miniwindow->icon, wwin);
-	wIconPaint(wwin->miniwindow->icon);
+	wRedrawLazily(wwin->miniwindow->icon, repaintIcon);
 }
 
 void miniwindow_map(WWindow *wwin)
@@ -53,6 +53,7 @@
 #include "xmodifier.h"
 #include "main.h"
 #include "event.h"
+#include "profile.h"
 
 
 #define ICON_SIZE wPreferences.icon_size
@@ -243,68 +244,72 @@ void slide_windows(Window wins[], int n, int from_x, int from_y, int to_x, int t
 	eatExpose();
 }
 
-char *ShrinkString(WMFont *font, const char *string, int width)
+/*
+ * Keeps the first word of string if it fits, and as much of its end as
+ * fits after it with "..." in between. The widths of all the prefixes are
+ * measured in one pass, and the fitting is done with them.
+ */
+char *ShrinkStringWithWidth(WMFont *font, const char *string, int width, int *text_width)
 {
-	int p1, p2, t, p, w, w1 = 0;
-	char *pos, *text;
-
-	p = strlen(string);
-	w = WMWidthOfString(font, string, p);
-	text = wmalloc(strlen(string) + 8);
-	strcpy(text, string);
-	if (w <= width)
-		return text;
-
-	pos = strchr(text, ' ');
-	if (!pos)
-		pos = strchr(text, ':');
+	int buffer[256], *widths;
+	int length, first, start;
+	const char *pos;
+	char *text;
+
+	length = strlen(string);
+	if (length < (int)(sizeof(buffer) / sizeof(buffer[0])))
+		widths = buffer;
+	else
+		widths = wmalloc((length + 1) * sizeof(int));
 
-	if (pos) {
-		*pos = 0;
-		p = strlen(text);
-		w1 = WMWidthOfString(font, text, p);
+	WMGetStringPrefixWidths(font, string, length, widths);
 
-		if (w1 > width) {
-			p = 0;
-			*pos = ' ';
-			*text = 0;
-		} else {
-			*pos = 0;
-			width -= w1;
-			p++;
-		}
+	text = wmalloc(length + 8);
+	if (widths[length] <= width) {
+		strcpy(text, string);
+		if (text_width)
+			*text_width = widths[length];
+		goto out;
+	}
 
-		string += p;
-		p = strlen(string);
-	} else {
-		*text = 0;
+	pos = strchr(string, ' ');
+	if (!pos)
+		pos = strchr(string, ':');
+
+	first = 0;
+	start = 0;
+	if (pos && widths[pos - string] <= width) {
+		first = pos - string;
+		width -= widths[first];
+		start = first + 1;
 	}
 
-	strcat(text, "...");
+	memcpy(text, string, first);
+	strcpy(text + first, "...");
 	width -= WMWidthOfString(font, "...", 3);
 
-	p1 = 0;
-	p2 = p;
-	t = (p2 - p1) / 2;
-
-	while (p2 > p1 && p1 != t) {
-		w = WMWidthOfString(font, &string[p - t], t);
-		if (w > width) {
-			p2 = t;
-			t = p1 + (p2 - p1) / 2;
-		} else if (w < width) {
-			p1 = t;
-			t = p1 + (p2 - p1) / 2;
-		} else {
-			p2 = p1 = t;
-		}
-	}
+	/* the longest end that fits, not cutting a character */
+	while (start < length &&
+	       (widths[length] - widths[start] > width || (string[start] & 0xc0) == 0x80))
+		start++;
+
+	strcat(text, string + start);
 
-	strcat(text, &string[p - p1]);
+	if (text_width)
+		*text_width = widths[first] + WMWidthOfString(font, "...", 3) + widths[length] - widths[start];
+
+ out:
+	if (widths != buffer)
+		wfree(widths);
 
 	return text;
 }
 
+char *ShrinkString(WMFont *font, const char *string, int width)
+{
+	return ShrinkStringWithWidth(font, string, width, NULL);
+}
+
 char *FindImage(const char *paths, const char *file)
 {
 	char *tmp, *path = NULL;
@@ -1027,6 +1032,31 @@ void SendHelperMessage(virtual_screen *vscr, char type, int workspace, const cha
 	wfree(buffer);
 }
 
+/*
+ * Reads and writes the files of the user defaults domains, with their
+ * binary caches when built with them, which are written along with them.
+ */
+WMPropList *ReadDomainFile(const char *path)
+{
+#ifdef USE_DEFAULTS_CACHE
+	return WMReadPropListFromCachedFile(path);
+#else
+	return WMReadPropListFromFile(path);
+#endif
+}
+
+Bool WriteDomainFile(WMPropList *plist, const char *path)
+{
+	if (!WMWritePropListToFile(plist, path))
+		return False;
+
+#ifdef USE_DEFAULTS_CACHE
+	WMWritePropListCache(plist, path);
+#endif
+
+	return True;
+}
+
 Bool UpdateDomainFile(WDDomain *domain)
 {
 	struct stat stbuf;
@@ -1051,7 +1081,7 @@ Bool UpdateDomainFile(WDDomain *domain)
 		}
 	}
 
-	result = WMWritePropListToFile(dict, domain->path);
+	result = WriteDomainFile(dict, domain->path);
 
 	if (freeDict)
 		WMReleasePropList(dict);
@@ -1181,6 +1211,7 @@ int create_minipixmap_for_wwindow(virtual_screen *vscr, WWindow *wwin, Pixmap *p
 		wPreferences.minipreview_size - 2 * MINIPREVIEW_BORDER,
 		wPreferences.minipreview_size - 2 * MINIPREVIEW_BORDER);
 
+	wProfileCount(pixmap_uploads);
 	ret = RConvertImage(vscr->screen_ptr->rcontext, scaled_mini_preview, pixmap);
 	RReleaseImage(scaled_mini_preview);
 	RReleaseImage(mini_preview);
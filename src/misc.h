@@ -26,6 +26,8 @@
 #include "appicon.h"
 
 Bool wFetchName(Display *dpy, Window win, char **winname);
+WMPropList *ReadDomainFile(const char *path);
+Bool WriteDomainFile(WMPropList *plist, const char *path);
 Bool UpdateDomainFile(WDDomain *domain);
 
 void move_window(Window win, int from_x, int from_y, int to_x, int to_y);
@@ -42,6 +44,8 @@ Bool start_bg_helper(virtual_screen *vscr);
 void SendHelperMessage(virtual_screen *vscr, char type, int workspace, const char *msg);
 
 char *ShrinkString(WMFont *font, const char *string, int width);
+/* Same, also giving the width of what it returns */
+char *ShrinkStringWithWidth(WMFont *font, const char *string, int width, int *text_width);
 char *FindImage(const char *paths, const char *file);
 char *ExpandOptions(virtual_screen *vscr, const char *cmdline);
 char *GetShortcutString(const char *text);
@@ -29,6 +29,7 @@
 #include <string.h>
 #include "WindowMaker.h"
 #include "pixmap.h"
+#include "profile.h"
 
 /*
  *----------------------------------------------------------------------
@@ -54,6 +55,7 @@ WPixmap *wPixmapCreateFromXPMData(WScreen *scr, char **data)
 
 	pix = wmalloc(sizeof(WPixmap));
 
+	wProfileCount(pixmap_uploads);
 	RConvertImageMask(scr->rcontext, image, &pix->image, &pix->mask, 128);
 
 	pix->width = image->width;
@@ -0,0 +1,316 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Profiling counters, only built with --enable-profiling.
+ *
+ * Profiling is turned on with the --profile option or by sending
+ * wmaker the "ProfileStart" command (a _WINDOWMAKER_COMMAND client message
+ * to the root window), and off with "ProfileStop". "ProfileDump" or the
+ * SIGURG signal append what was measured since it was turned on to
+ * ~/GNUstep/Library/WindowMaker/Profile, followed by the server memory taken
+ * by the shared pixmaps, what the server itself counts for all the pixmaps
+ * of wmaker when it has the X-Resource extension, and the statistics of the
+ * memory pools when WUtil has them. Starting with --no-shared-pixmaps gives
+ * each frame and icon pixmaps of its own, to compare.
+ *
+ * The sections are listed the first time they are used, so nothing has to
+ * be declared in advance, and cost a test of wProfileEnabled when profiling
+ * is off.
+ */
+
+#include "wconfig.h"
+
+#include <X11/Xlibint.h>
+#include <X11/extensions/XResproto.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "WindowMaker.h"
+#include "profile.h"
+#include "atlas.h"
+
+
+Bool wProfileEnabled = False;
+
+static WProfileSection *sections = NULL;
+
+static struct {
+	double start;
+	unsigned long request;
+} session;
+
+static volatile sig_atomic_t dumpRequested = 0;
+
+
+double wProfileNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void listSection(WProfileSection *section)
+{
+	section->next = sections;
+	sections = section;
+	section->listed = True;
+}
+
+void wProfileStartTimer(WProfileTimer *timer)
+{
+	if (!wProfileEnabled) {
+		timer->start = 0;
+		return;
+	}
+
+	timer->request = NextRequest(dpy);
+	timer->start = wProfileNow();
+}
+
+void wProfileStopTimer(WProfileSection *section, WProfileTimer *timer)
+{
+	double elapsed;
+
+	if (timer->start == 0 || !wProfileEnabled)
+		return;
+
+	elapsed = wProfileNow() - timer->start;
+
+	if (!section->listed)
+		listSection(section);
+
+	section->count++;
+	section->time += elapsed;
+	if (elapsed > section->worst)
+		section->worst = elapsed;
+	section->requests += NextRequest(dpy) - timer->request;
+}
+
+void wProfileAddCount(WProfileSection *section, Bool hit)
+{
+	if (!section->listed)
+		listSection(section);
+
+	section->count++;
+	if (hit)
+		section->hits++;
+}
+
+static void resetSections(void)
+{
+	WProfileSection *section;
+
+	for (section = sections; section; section = section->next) {
+		section->count = 0;
+		section->hits = 0;
+		section->requests = 0;
+		section->time = 0;
+		section->worst = 0;
+	}
+
+	session.start = wProfileNow();
+	session.request = NextRequest(dpy);
+}
+
+static int compareNames(const void *a, const void *b)
+{
+	return strcmp(((const WProfileSection *)a)->name, ((const WProfileSection *)b)->name);
+}
+
+static int compareTimes(const void *a, const void *b)
+{
+	const WProfileSection *s1 = a;
+	const WProfileSection *s2 = b;
+
+	if (s1->time != s2->time)
+		return (s1->time < s2->time) ? 1 : -1;
+	if (s1->count != s2->count)
+		return (s1->count < s2->count) ? 1 : -1;
+
+	return strcmp(s1->name, s2->name);
+}
+
+/* what the server says the pixmaps of wmaker take, with X-Resource */
+static Bool getServerPixmapBytes(unsigned long long *bytes)
+{
+	xXResQueryClientPixmapBytesReq *req;
+	xXResQueryClientPixmapBytesReply rep;
+	int opcode, event, error;
+
+	if (!XQueryExtension(dpy, XRES_NAME, &opcode, &event, &error))
+		return False;
+
+	LockDisplay(dpy);
+	GetReq(XResQueryClientPixmapBytes, req);
+	req->reqType = opcode;
+	req->XResReqType = X_XResQueryClientPixmapBytes;
+	req->xid = dpy->resource_base;
+	if (!_XReply(dpy, (xReply *) &rep, 0, xTrue)) {
+		UnlockDisplay(dpy);
+		SyncHandle();
+		return False;
+	}
+	UnlockDisplay(dpy);
+	SyncHandle();
+
+	*bytes = ((unsigned long long)rep.bytes_overflow << 32) + rep.bytes;
+
+	return True;
+}
+
+static void writeDump(FILE *file)
+{
+	unsigned long long pixmapBytes;
+	WProfileSection *section, *merged;
+	int i, count = 0, total = 0;
+
+	for (section = sections; section; section = section->next)
+		total++;
+
+	/* a section can be used in several places, with a counter in each */
+	merged = wmalloc((total + 1) * sizeof(WProfileSection));
+	for (section = sections, i = 0; section; section = section->next)
+		merged[i++] = *section;
+	qsort(merged, total, sizeof(WProfileSection), compareNames);
+
+	for (i = 0; i < total; i++) {
+		if (count > 0 && strcmp(merged[count - 1].name, merged[i].name) == 0) {
+			section = &merged[count - 1];
+			section->count += merged[i].count;
+			section->hits += merged[i].hits;
+			section->requests += merged[i].requests;
+			section->time += merged[i].time;
+			if (merged[i].worst > section->worst)
+				section->worst = merged[i].worst;
+		} else {
+			merged[count++] = merged[i];
+		}
+	}
+	qsort(merged, count, sizeof(WProfileSection), compareTimes);
+
+	fprintf(file, "profile of %.1f s, %lu X requests\n",
+		(wProfileNow() - session.start) / 1e6, NextRequest(dpy) - session.request);
+	fprintf(file, "%-28s %10s %10s %10s %10s %9s %6s\n",
+		"section", "count", "total ms", "avg us", "max us", "requests", "hits");
+
+	for (i = 0; i < count; i++) {
+		section = &merged[i];
+		if (section->count == 0)
+			continue;
+
+		fprintf(file, "%-28s %10lu ", section->name, section->count);
+		if (section->time > 0) {
+			fprintf(file, "%10.2f %10.1f %10.1f %9.1f",
+				section->time / 1e3, section->time / section->count, section->worst,
+				(double)section->requests / section->count);
+		} else {
+			fprintf(file, "%10s %10s %10s %9s", "", "", "", "");
+		}
+		if (section->hits > 0)
+			fprintf(file, " %5.1f%%", 100.0 * section->hits / section->count);
+		fputc('\n', file);
+	}
+	fputc('\n', file);
+
+	for (i = 0; i < w_global.screen_count; i++) {
+		if (w_global.vscreens[i]->screen_ptr)
+			wAtlasWriteStats(w_global.vscreens[i]->screen_ptr, file);
+	}
+	if (getServerPixmapBytes(&pixmapBytes))
+		fprintf(file, "pixmaps of wmaker in the server: %llu KiB%s\n", pixmapBytes / 1024,
+			wAtlasSharing ? "" : " (not shared)");
+
+	wmemstats(file);
+
+	wfree(merged);
+}
+
+static void dumpProfile(void)
+{
+	char *path;
+	FILE *file;
+
+	path = wstrconcat(wusergnusteppath(), "/Library/WindowMaker/Profile");
+	file = fopen(path, "a");
+	if (!file) {
+		werror(_("could not open %s to write the profile"), path);
+		wfree(path);
+		return;
+	}
+
+	writeDump(file);
+	fclose(file);
+
+	wmessage(_("profile written to %s"), path);
+	wfree(path);
+}
+
+static void handleDumpSignal(int sig)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) sig;
+
+	dumpRequested = 1;
+}
+
+void wProfileInitialize(Bool enable)
+{
+	struct sigaction sig_action;
+
+	sig_action.sa_handler = handleDumpSignal;
+	sigemptyset(&sig_action.sa_mask);
+	sig_action.sa_flags = SA_RESTART;
+	sigaction(SIGURG, &sig_action, NULL);
+
+	if (enable) {
+		resetSections();
+		wProfileEnabled = True;
+	}
+}
+
+void wProfileCheckDump(void)
+{
+	if (dumpRequested) {
+		dumpRequested = 0;
+		dumpProfile();
+	}
+}
+
+Bool wProfileCommand(const char *command)
+{
+	if (strcmp(command, "ProfileStart") == 0) {
+		resetSections();
+		wProfileEnabled = True;
+	} else if (strcmp(command, "ProfileStop") == 0) {
+		wProfileEnabled = False;
+	} else if (strcmp(command, "ProfileDump") == 0) {
+		dumpProfile();
+	} else {
+		return False;
+	}
+
+	return True;
+}
@@ -0,0 +1,111 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WMPROFILE_H_
+#define WMPROFILE_H_
+
+/*
+ * Counters and timers for the hot paths, built with --enable-profiling.
+ * Otherwise all of this expands to nothing.
+ *
+ *	wProfileBegin(section);		start timing `section'
+ *	wProfileEnd(section);		stop it, in the same block
+ *	wProfileCount(section);		count an occurrence of `section'
+ *	wProfileHit(section, hit);	count a lookup in cache `section'
+ *
+ * `section' must be an identifier, and is what it is called in the dumps.
+ * Sections of the same name used in different places are added up. The
+ * arguments are not evaluated when profiling is not built in.
+ */
+
+#ifdef USE_PROFILING
+
+#include <X11/Xlib.h>
+
+typedef struct WProfileSection {
+	const char *name;
+	struct WProfileSection *next;	/* in the list of sections used */
+	Bool listed;
+
+	unsigned long count;
+	unsigned long hits;
+	unsigned long requests;		/* X requests made in the section */
+	double time;			/* microseconds */
+	double worst;
+} WProfileSection;
+
+typedef struct {
+	double start;			/* 0 when profiling was off */
+	unsigned long request;
+} WProfileTimer;
+
+extern Bool wProfileEnabled;
+
+double wProfileNow(void);
+
+void wProfileStartTimer(WProfileTimer *timer);
+
+void wProfileStopTimer(WProfileSection *section, WProfileTimer *timer);
+
+void wProfileAddCount(WProfileSection *section, Bool hit);
+
+/* Enables the profiling if `enable' and installs the dump signal handler */
+void wProfileInitialize(Bool enable);
+
+/* Handles the "Profile..." _WINDOWMAKER_COMMAND messages */
+Bool wProfileCommand(const char *command);
+
+/* Writes the dump asked for by a signal, if any */
+void wProfileCheckDump(void);
+
+#define wProfileBegin(section) \
+	static WProfileSection wprofile_##section = { .name = #section }; \
+	WProfileTimer wprofile_timer_##section; \
+	wProfileStartTimer(&wprofile_timer_##section)
+
+#define wProfileEnd(section) \
+	wProfileStopTimer(&wprofile_##section, &wprofile_timer_##section)
+
+#define wProfileCount(section) do { \
+	static WProfileSection wprofile_##section = { .name = #section }; \
+	if (wProfileEnabled) \
+		wProfileAddCount(&wprofile_##section, False); \
+	} while (0)
+
+#define wProfileHit(section, hit) do { \
+	static WProfileSection wprofile_##section = { .name = #section }; \
+	if (wProfileEnabled) \
+		wProfileAddCount(&wprofile_##section, (hit)); \
+	} while (0)
+
+#else
+
+#define wProfileBegin(name)
+#define wProfileEnd(name)
+#define wProfileCount(name)		do { } while (0)
+#define wProfileHit(name, hit)		do { } while (0)
+
+#define wProfileInitialize(enable)	do { } while (0)
+#define wProfileCommand(command)	False
+#define wProfileCheckDump()		do { } while (0)
+
+#endif
+
+#endif
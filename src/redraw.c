@@ -0,0 +1,235 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The redraws are done by an idle handler, which WINGs only runs once there
+ * are no X events left, and by a timer in case the events keep coming, but
+ * not more often than REDRAW_INTERVAL, so a client changing its title all
+ * the time gets it painted at the rate of the screen at most. The lazy ones
+ * wait for LAZY_INTERVAL, or for the others to be done by a key or button
+ * press.
+ *
+ * The redraws that were already pending when asked for are counted as
+ * redraw_skipped in the profile.
+ */
+
+#include "wconfig.h"
+
+#include <X11/Xlib.h>
+
+#include <time.h>
+
+#include "WindowMaker.h"
+#include "profile.h"
+#include "redraw.h"
+
+
+/* in milliseconds */
+#define REDRAW_INTERVAL	16
+#define LAZY_INTERVAL	250
+
+typedef struct PendingRedraw {
+	void *object;
+	WRedrawProc *proc;
+	Bool lazy;
+
+	struct PendingRedraw *prev;
+	struct PendingRedraw *next;
+} PendingRedraw;
+
+static struct {
+	WMHashTable *table;	/* object -> PendingRedraw */
+	PendingRedraw *first;	/* in the order they were asked for */
+	PendingRedraw *last;
+
+	WMHandlerID idler;
+	WMHandlerID timer;
+	WMHandlerID lazyTimer;
+
+	double lastDone;	/* when the redraws were done, in ms */
+} pending;
+
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void unlinkRedraw(PendingRedraw *redraw)
+{
+	if (redraw->prev)
+		redraw->prev->next = redraw->next;
+	else
+		pending.first = redraw->next;
+
+	if (redraw->next)
+		redraw->next->prev = redraw->prev;
+	else
+		pending.last = redraw->prev;
+
+	WMHashRemove(pending.table, redraw->object);
+}
+
+static void doRedraws(Bool lazy)
+{
+	PendingRedraw *redraw;
+
+	if (pending.idler) {
+		WMDeleteIdleHandler(pending.idler);
+		pending.idler = NULL;
+	}
+	if (pending.timer) {
+		WMDeleteTimerHandler(pending.timer);
+		pending.timer = NULL;
+	}
+	if (lazy && pending.lazyTimer) {
+		WMDeleteTimerHandler(pending.lazyTimer);
+		pending.lazyTimer = NULL;
+	}
+
+	pending.lastDone = now();
+
+	wProfileBegin(redraws);
+
+	/* a redraw may ask for others or cancel them, take them one by one */
+	for (;;) {
+		for (redraw = pending.first; redraw; redraw = redraw->next) {
+			if (lazy || !redraw->lazy)
+				break;
+		}
+		if (!redraw)
+			break;
+
+		unlinkRedraw(redraw);
+		(*redraw->proc) (redraw->object);
+		wfree(redraw);
+	}
+
+	wProfileEnd(redraws);
+}
+
+static void idleRedraws(void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	/* WINGs deletes it once this returns */
+	pending.idler = NULL;
+
+	/* else the timer will do them */
+	if (now() - pending.lastDone >= REDRAW_INTERVAL)
+		doRedraws(False);
+}
+
+static void timerRedraws(void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	pending.timer = NULL;
+	doRedraws(False);
+}
+
+static void lazyRedraws(void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	pending.lazyTimer = NULL;
+	doRedraws(True);
+}
+
+static void addRedraw(void *object, WRedrawProc *proc, Bool lazy)
+{
+	PendingRedraw *redraw;
+
+	if (!pending.table)
+		pending.table = WMCreateHashTable(WMIntHashCallbacks);
+
+	redraw = WMHashGet(pending.table, object);
+	if (redraw && redraw->proc == proc) {
+		wProfileCount(redraw_skipped);
+		if (lazy || !redraw->lazy)
+			return;
+
+		redraw->lazy = False;
+	} else {
+		if (redraw) {
+			/* another kind of redraw, do the one pending first */
+			unlinkRedraw(redraw);
+			(*redraw->proc) (redraw->object);
+			wfree(redraw);
+		}
+
+		redraw = wmalloc(sizeof(PendingRedraw));
+		redraw->object = object;
+		redraw->proc = proc;
+		redraw->lazy = lazy;
+		redraw->prev = pending.last;
+		if (pending.last)
+			pending.last->next = redraw;
+		else
+			pending.first = redraw;
+		pending.last = redraw;
+		WMHashInsert(pending.table, object, redraw);
+	}
+
+	if (lazy) {
+		if (!pending.lazyTimer)
+			pending.lazyTimer = WMAddTimerHandler(LAZY_INTERVAL, lazyRedraws, NULL);
+	} else {
+		if (!pending.idler)
+			pending.idler = WMAddIdleHandler(idleRedraws, NULL);
+		if (!pending.timer)
+			pending.timer = WMAddTimerHandler(REDRAW_INTERVAL, timerRedraws, NULL);
+	}
+}
+
+void wRedrawLater(void *object, WRedrawProc *proc)
+{
+	addRedraw(object, proc, False);
+}
+
+void wRedrawLazily(void *object, WRedrawProc *proc)
+{
+	addRedraw(object, proc, True);
+}
+
+void wRedrawCancel(void *object)
+{
+	PendingRedraw *redraw;
+
+	if (!pending.table)
+		return;
+
+	redraw = WMHashGet(pending.table, object);
+	if (redraw) {
+		unlinkRedraw(redraw);
+		wfree(redraw);
+	}
+}
+
+void wRedrawFlush(void)
+{
+	doRedraws(True);
+}
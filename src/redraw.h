@@ -0,0 +1,45 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WMREDRAW_H_
+#define WMREDRAW_H_
+
+/*
+ * Repaints put off until wmaker has handled the events it has, so that a
+ * client changing its title many times in a row gets it painted once, and
+ * not more often than the screen is refreshed.
+ */
+
+typedef void WRedrawProc(void *object);
+
+/* Has `proc' called with `object' once the pending events are handled.
+ * An object has one redraw pending at most, asking again does nothing */
+void wRedrawLater(void *object, WRedrawProc *proc);
+
+/* Same, for what the user is not looking at, which can wait longer */
+void wRedrawLazily(void *object, WRedrawProc *proc);
+
+/* Forgets the redraw of `object', which is going away */
+void wRedrawCancel(void *object);
+
+/* Does the pending redraws now */
+void wRedrawFlush(void);
+
+#endif
@@ -36,6 +36,8 @@
 #include <time.h>
 #include <dirent.h>
 #include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -60,15 +62,16 @@
 #include "switchmenu.h"
 #include "screen.h"
 #include "input.h"
+#include "event.h"
 
 #include <WINGs/WUtil.h>
 
 #define MAX_SHORTCUT_LENGTH 32
 
-static WMenu *readMenuPipe(virtual_screen *vscr, char **file_name);
-static WMenu *readPLMenuPipe(virtual_screen *vscr, char **file_name);
+static WMenu *readMenu(virtual_screen *vscr, const char *flat_file, FILE *file);
 static WMenu *readMenuFile(virtual_screen *vscr, const char *file_name);
-static WMenu *readMenuDirectory(virtual_screen *vscr, const char *title, char **file_name, const char *command);
+static WMPropList *scanMenuDirectory(const char *title, char **path, const char *command);
+static inline int generate_command_from_list(char *buffer, size_t buffer_size, char **command_elements);
 static WMenu *configureMenu(virtual_screen *vscr, WMPropList *definition);
 static void menu_parser_register_macros(WMenuParser parser);
 static void observer(void *self, WMNotification *notif);
@@ -122,18 +125,23 @@ static int initialized = 0;
  * OPEN_MENU /some/dir [/some/other/dir ...] [WITH command -options]
  *              - read menu data from directory(ies) and
  * 		  eventually precede each with a command.
+ * 		  The directories are scanned in the background, the menu
+ * 		  is rescanned when one of the directories changes.
  * OPEN_MENU | command
  *              - opens command and uses its stdout to construct and insert
  *                the resulting menu in current position. The output of
  *                command must be a valid menu description.
  *                The space between '|' and command is optional.
- *                || will do the same, but will not cache the contents.
+ *                The command is run in the background once per session,
+ *                || will run it again each time the menu is opened.
+ *                The last output is kept on disk and shown meanwhile.
  * OPEN_PLMENU | command
  *		- opens command and uses its stdout which must be in proplist
  *		  fromat to construct and insert the resulting menu in current
  *		  position.
  *		  The space between '|' and command is optional.
- *		  || will do the same, but will not cache the contents.
+ *		  The command is run in the background once per session,
+ *		  || will run it again each time the menu is opened.
  * SAVE_SESSION - saves the current state of the desktop, which include
  *		  all running applications, all their hints (geometry,
  *		  position on screen, workspace they live on, the dock
@@ -596,6 +604,345 @@ static void separateCommand(char *line, char ***file, char **command)
 	WMFreeArray(array);
 }
 
+/************    Background Menu Generation      *************/
+
+/*
+ * Pipe and directory menus are generated by a child process, so a slow
+ * command or a big directory tree won't block the window manager. The
+ * generator stores its result in the menu cache, a file named after the
+ * OPEN_MENU parameters, and the menu shown is always built from that file.
+ * This way the previous result can be shown right away while a new one
+ * is being generated.
+ */
+
+#define MENU_CACHE_PATH "/Library/WindowMaker/MenuCache/"
+
+enum {
+	MG_PIPE,		/* OPEN_MENU | command */
+	MG_PLPIPE,		/* OPEN_PLMENU | command */
+	MG_DIRECTORY		/* OPEN_MENU /some/dir [WITH command] */
+};
+
+typedef struct MenuGenerator {
+	int type;
+	char *spec;			/* parameters of the OPEN_MENU entry */
+	char *cache_file;
+	pid_t pid;			/* generator process, 0 if not running */
+	struct timeval started;
+	unsigned int runs;
+	unsigned int generation;	/* bumped every time the cache was rewritten */
+} MenuGenerator;
+
+static WMArray *menuGenerators = NULL;
+
+static char *getMenuCacheFile(int type, const char *spec)
+{
+	static const char *const prefix[] = { "pipe", "plpipe", "dir" };
+	unsigned long long hash = 14695981039346656037ULL;
+	char name[64], *dir, *path;
+	const char *p;
+
+	for (p = spec; *p; p++)
+		hash = (hash ^ (unsigned char) *p) * 1099511628211ULL;
+
+	snprintf(name, sizeof(name), "%s-%016llx", prefix[type], hash);
+
+	dir = wstrconcat(wusergnusteppath(), MENU_CACHE_PATH);
+	path = wstrconcat(dir, name);
+	wfree(dir);
+
+	return path;
+}
+
+static MenuGenerator *getMenuGenerator(int type, const char *spec)
+{
+	MenuGenerator *gen;
+	WMArrayIterator iter;
+
+	if (!menuGenerators)
+		menuGenerators = WMCreateArray(8);
+
+	WM_ITERATE_ARRAY(menuGenerators, gen, iter) {
+		if (gen->type == type && strcmp(gen->spec, spec) == 0)
+			return gen;
+	}
+
+	/* generators are kept for the whole session, they are shared by
+	 * all the menus reading the same command or directory */
+	gen = wmalloc(sizeof(MenuGenerator));
+	gen->type = type;
+	gen->spec = wstrdup(spec);
+	gen->cache_file = getMenuCacheFile(type, spec);
+	WMAddToArray(menuGenerators, gen);
+
+	return gen;
+}
+
+static Bool generatePipeMenu(MenuGenerator *gen, char **path)
+{
+	char flat_file[MAXLINE], buffer[4096];
+	char *command, *tmp;
+	FILE *in, *out;
+	size_t length;
+	Bool ok;
+	int fd;
+
+	if (generate_command_from_list(flat_file, sizeof(flat_file), path)) {
+		werror(_("could not open menu file \"%s\": %s"),
+		       path[0], _("pipe command is too long"));
+		return False;
+	}
+
+	command = flat_file + (flat_file[1] == '|' ? 2 : 1);
+
+	/* write to a temporary file so a partial output is never used */
+	tmp = wstrconcat(gen->cache_file, ".XXXXXX");
+	fd = mkstemp(tmp);
+	if (fd < 0 || !(out = fdopen(fd, "wb"))) {
+		werror(_("could not create menu cache file \"%s\": %s"), tmp, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp);
+		}
+		wfree(tmp);
+		return False;
+	}
+
+	errno = ENOMEM;
+	in = popen(command, "r");
+	if (!in) {
+		werror(_("could not open menu file \"%s\": %s"), command, strerror(errno));
+		fclose(out);
+		unlink(tmp);
+		wfree(tmp);
+		return False;
+	}
+
+	ok = True;
+	while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		if (fwrite(buffer, 1, length, out) != length) {
+			ok = False;
+			break;
+		}
+	}
+	pclose(in);
+
+	if (fclose(out) != 0)
+		ok = False;
+
+	if (ok && rename(tmp, gen->cache_file) != 0) {
+		werror(_("could not create menu cache file \"%s\": %s"), gen->cache_file, strerror(errno));
+		ok = False;
+	}
+
+	if (!ok)
+		unlink(tmp);
+
+	wfree(tmp);
+
+	return ok;
+}
+
+static Bool generateDirectoryMenu(MenuGenerator *gen, const char *title, char **path, const char *command)
+{
+	WMPropList *plist, *ptitle;
+	Bool ok;
+
+	plist = scanMenuDirectory(title, path, command);
+	if (!plist) {
+		/* cache the empty menu too, or it would be scanned again and again */
+		ptitle = WMCreatePLString(title);
+		plist = WMCreatePLArray(ptitle, NULL);
+		WMReleasePropList(ptitle);
+	}
+
+	ok = WMWritePropListToFile(plist, gen->cache_file);
+	WMReleasePropList(plist);
+
+	return ok;
+}
+
+static RETSIGTYPE menuGeneratorTimeout(int sig)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) sig;
+
+	/* take down the commands started by the generator as well, but
+	 * only if they are in a process group of their own */
+	if (getpgrp() == getpid())
+		kill(0, SIGKILL);
+
+	_exit(1);
+}
+
+static void menuGeneratorDone(pid_t pid, unsigned int status, void *cdata)
+{
+	MenuGenerator *gen = (MenuGenerator *) cdata;
+	struct timeval now;
+	long elapsed;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) pid;
+
+	gettimeofday(&now, NULL);
+	elapsed = (now.tv_sec - gen->started.tv_sec) * 1000L +
+		(now.tv_usec - gen->started.tv_usec) / 1000L;
+
+	gen->pid = 0;
+
+	if (elapsed >= MENU_GENERATOR_TIMEOUT)
+		wwarning(_("menu generator for \"%s\" timed out after %ld ms"), gen->spec, elapsed);
+	else if (status != 0)
+		wwarning(_("menu generator for \"%s\" failed"), gen->spec);
+	else if (elapsed >= MENU_GENERATOR_SLOW)
+		wwarning(_("menu generator for \"%s\" is slow, it took %ld ms"), gen->spec, elapsed);
+#ifdef DEBUG
+	else
+		wmessage("menu generator for \"%s\" took %ld ms", gen->spec, elapsed);
+#endif
+
+	if (status == 0 && elapsed < MENU_GENERATOR_TIMEOUT)
+		gen->generation++;
+}
+
+static void startMenuGenerator(MenuGenerator *gen, const char *title, char **path, const char *command)
+{
+	pid_t pid;
+	Bool ok;
+
+	if (!wmkdirhier(gen->cache_file)) {
+		werror(_("could not create menu cache directory for \"%s\""), gen->cache_file);
+		return;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		/* the child must not talk to the X server nor
+		 * behave like the window manager on signals */
+		close(ConnectionNumber(dpy));
+		signal(SIGCHLD, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGINT, SIG_DFL);
+		signal(SIGHUP, SIG_DFL);
+		signal(SIGUSR1, SIG_DFL);
+
+		setpgid(0, 0);
+		signal(SIGALRM, menuGeneratorTimeout);
+		alarm((MENU_GENERATOR_TIMEOUT + 999) / 1000);
+
+		if (gen->type == MG_DIRECTORY)
+			ok = generateDirectoryMenu(gen, title, path, command);
+		else
+			ok = generatePipeMenu(gen, path);
+
+		_exit(ok ? 0 : 1);
+	} else if (pid < 0) {
+		werror(_("cannot fork a new process"));
+		return;
+	}
+
+	gen->pid = pid;
+	gen->runs++;
+	gettimeofday(&gen->started, NULL);
+	wAddDeathHandler(pid, menuGeneratorDone, gen);
+}
+
+/*
+ * The menus copy what they need out of their property lists, which are
+ * released right after, so they can be read into an arena.
+ */
+static WMPropList *readMenuPropList(const char *path)
+{
+	WMPropList *plist;
+
+	WMPLSetUseArenas(True);
+	plist = WMReadPropListFromFile(path);
+	WMPLSetUseArenas(False);
+
+	return plist;
+}
+
+static WMenu *readMenuCache(virtual_screen *vscr, MenuGenerator *gen)
+{
+	WMPropList *plist;
+	WMenu *menu;
+	FILE *file;
+
+	if (gen->type == MG_PIPE) {
+		file = fopen(gen->cache_file, "rb");
+		if (!file)
+			return NULL;
+
+		menu = readMenu(vscr, gen->spec, file);
+		fclose(file);
+
+		return menu;
+	}
+
+	plist = readMenuPropList(gen->cache_file);
+	if (!plist)
+		return NULL;
+
+	menu = configureMenu(vscr, plist);
+	WMReleasePropList(plist);
+
+	if (!menu)
+		return NULL;
+
+	menu->on_destroy = removeShortcutsForMenu;
+	return menu;
+}
+
+static WMenu *makeLoadingMenu(virtual_screen *vscr, const char *title)
+{
+	WMenu *menu;
+	WMenuEntry *entry;
+
+	menu = menu_create(vscr, title);
+	menu_map(menu);
+	menu->on_destroy = removeShortcutsForMenu;
+
+	entry = wMenuAddCallback(menu, _("Loading..."), NULL, NULL);
+	entry->flags.enabled = 0;
+
+	return menu;
+}
+
+/*
+ * Returns the menu to place in the entry's cascade, or NULL if the current
+ * cascade is still up to date. A new generator is started when 'refresh'
+ * is set or when there is nothing in the cache yet. The cascade is read
+ * again whenever a generator completed since it was built, as the cache may
+ * be rewritten several times within the same second.
+ */
+static WMenu *constructGeneratedMenu(WMenu *menu, WMenuEntry *entry, MenuGenerator *gen,
+				     Bool refresh, char **path, const char *command)
+{
+	WMenu *cascade = menu->cascades[entry->cascade];
+	WMenu *submenu = NULL;
+	struct stat stat_buf;
+	time_t cached = 0;
+
+	if (stat(gen->cache_file, &stat_buf) == 0)
+		cached = stat_buf.st_mtime;
+
+	if (gen->pid == 0 && (refresh || cached == 0))
+		startMenuGenerator(gen, entry->text, path, command);
+
+	if (cached != 0 && (!cascade || cascade->generation != gen->generation || cascade->timestamp == 0)) {
+		submenu = readMenuCache(menu->vscr, gen);
+		if (submenu) {
+			submenu->timestamp = cached;
+			submenu->generation = gen->generation;
+		}
+	} else if (cached == 0 && gen->pid != 0 && (!cascade || cascade->entry_no == 0)) {
+		/* nothing to show yet, the next time it is opened it will be */
+		submenu = makeLoadingMenu(menu->vscr, entry->text);
+	}
+
+	return submenu;
+}
+
 static WMenu *constructPLMenu(virtual_screen *vscr, const char *path)
 {
 	WMPropList *pl = NULL;
@@ -604,7 +951,7 @@ static WMenu *constructPLMenu(virtual_screen *vscr, const char *path)
 	if (!path)
 		return NULL;
 
-	pl = WMReadPropListFromFile(path);
+	pl = readMenuPropList(path);
 	if (!pl)
 		return NULL;
 
@@ -623,6 +970,7 @@ static WMenu *constructPLMenu(virtual_screen *vscr, const char *path)
 
 static void constructMenu(WMenu *menu, WMenuEntry *entry)
 {
+	MenuGenerator *gen;
 	WMenu *submenu;
 	struct stat stat_buf;
 	char **path, *cmd, *lpath = NULL;
@@ -646,19 +994,8 @@ static void constructMenu(WMenu *menu, WMenuEntry *entry)
 
 	if (path[0][0] == '|') {
 		/* pipe menu */
-		if (!menu->cascades[entry->cascade] || menu->cascades[entry->cascade]->timestamp == 0) {
-			/* parse pipe */
-			submenu = readMenuPipe(menu->vscr, path);
-
-			if (submenu != NULL) {
-				if (path[0][1] == '|')
-					submenu->timestamp = 0;
-				else
-					submenu->timestamp = 1;	/* there's no automatic reloading */
-			}
-		} else {
-			submenu = NULL;
-		}
+		gen = getMenuGenerator(MG_PIPE, (char *)entry->clientdata);
+		submenu = constructGeneratedMenu(menu, entry, gen, path[0][1] == '|' || gen->runs == 0, path, NULL);
 	} else {
 		/* try interpreting path as a proplist file */
 		submenu = constructPLMenu(menu->vscr, path[0]);
@@ -716,14 +1053,16 @@ static void constructMenu(WMenu *menu, WMenuEntry *entry)
 			}
 
 			stat(path[first], &stat_buf);
-			if (!menu->cascades[entry->cascade] ||
-			    menu->cascades[entry->cascade]->timestamp < last) {
-				if (S_ISDIR(stat_buf.st_mode)) {
-					/* menu directory */
-					submenu = readMenuDirectory(menu->vscr, entry->text, path, cmd);
-					if (submenu)
-						submenu->timestamp = last;
-				} else if (S_ISREG(stat_buf.st_mode)) {
+			if (S_ISDIR(stat_buf.st_mode)) {
+				/* menu directory, rescanned when it is newer than the cache */
+				gen = getMenuGenerator(MG_DIRECTORY, (char *)entry->clientdata);
+				if (stat(gen->cache_file, &stat_buf) != 0)
+					stat_buf.st_mtime = 0;
+
+				submenu = constructGeneratedMenu(menu, entry, gen, stat_buf.st_mtime < last, path, cmd);
+			} else if (!menu->cascades[entry->cascade] ||
+				   menu->cascades[entry->cascade]->timestamp < last) {
+				if (S_ISREG(stat_buf.st_mode)) {
 					/* menu file */
 
 					if (cmd || path[1])
@@ -758,6 +1097,7 @@ static void constructMenu(WMenu *menu, WMenuEntry *entry)
 
 static void constructPLMenuFromPipe(WMenu * menu, WMenuEntry * entry)
 {
+	MenuGenerator *gen;
 	WMenu *submenu = NULL;
 	char **path;
 	char *cmd;
@@ -779,19 +1119,8 @@ static void constructPLMenuFromPipe(WMenu * menu, WMenuEntry * entry)
 
 	if (path[0][0] == '|') {
 		/* pipe menu */
-
-		if (!menu->cascades[entry->cascade]
-		|| menu->cascades[entry->cascade]->timestamp == 0) {
-			/* parse pipe */
-			submenu = readPLMenuPipe(menu->vscr, path);
-
-			if (submenu != NULL) {
-				if (path[0][1] == '|')
-					submenu->timestamp = 0;
-				else
-					submenu->timestamp = 1;	/* there's no automatic reloading */
-			}
-		}
+		gen = getMenuGenerator(MG_PLPIPE, (char *)entry->clientdata);
+		submenu = constructGeneratedMenu(menu, entry, gen, path[0][1] == '|' || gen->runs == 0, path, NULL);
 	}
 
 	if (submenu) {
@@ -1143,69 +1472,6 @@ static inline int generate_command_from_list(char *buffer, size_t buffer_size, c
 	return 0;
 }
 
-/************    Menu Configuration From Pipe      *************/
-static WMenu *readPLMenuPipe(virtual_screen *vscr, char **file_name)
-{
-	WMPropList *plist = NULL;
-	WMenu *menu = NULL;
-	char *filename;
-	char flat_file[MAXLINE];
-
-	if (generate_command_from_list(flat_file, sizeof(flat_file), file_name)) {
-		werror(_("could not open menu file \"%s\": %s"),
-		       file_name[0], _("pipe command for PropertyList is too long"));
-		return NULL;
-	}
-
-	filename = flat_file + (flat_file[1] == '|' ? 2 : 1);
-	plist = WMReadPropListFromPipe(filename);
-	if (!plist)
-		return NULL;
-
-	menu = configureMenu(vscr, plist);
-
-	WMReleasePropList(plist);
-
-	if (!menu)
-		return NULL;
-
-	menu->on_destroy = removeShortcutsForMenu;
-	return menu;
-}
-
-static WMenu *readMenuPipe(virtual_screen *vscr, char **file_name)
-{
-	WMenu *menu = NULL;
-	FILE *file = NULL;
-	char *filename;
-	char flat_file[MAXLINE];
-
-	if (generate_command_from_list(flat_file, sizeof(flat_file), file_name)) {
-		werror(_("could not open menu file \"%s\": %s"),
-		       file_name[0], _("pipe command is too long"));
-		return NULL;
-	}
-
-	filename = flat_file + (flat_file[1] == '|' ? 2 : 1);
-
-	/*
-	 * In case of memory problem, 'popen' will not set the errno, so we initialise it
-	 * to be able to display a meaningful message. For other problems, 'popen' will
-	 * properly set errno, so we'll still get a good message
-	 */
-	errno = ENOMEM;
-	file = popen(filename, "r");
-	if (!file) {
-		werror(_("could not open menu file \"%s\": %s"), filename, strerror(errno));
-		return NULL;
-	}
-
-	menu = readMenu(vscr, flat_file, file);
-	pclose(file);
-
-	return menu;
-}
-
 typedef struct {
 	char *name;
 	int index;
@@ -1264,12 +1530,32 @@ static Bool isFilePackage(const char *file)
 	return False;
 }
 
-static WMenu *readMenuDirectory(virtual_screen *vscr, const char *title, char **path, const char *command)
+static void addMenuEntryDescription(WMPropList *menu, const char *title, const char *command, const char *params)
+{
+	WMPropList *ptitle, *pcommand, *pparams, *entry;
+
+	ptitle = WMCreatePLString(title);
+	pcommand = WMCreatePLString(command);
+	pparams = WMCreatePLString(params);
+	entry = WMCreatePLArray(ptitle, pcommand, pparams, NULL);
+	WMReleasePropList(ptitle);
+	WMReleasePropList(pcommand);
+	WMReleasePropList(pparams);
+
+	WMAddToPLArray(menu, entry);
+	WMReleasePropList(entry);
+}
+
+/*
+ * Builds the description of a directory menu in the WMRootMenu format,
+ * so it can be written to the menu cache by a generator process.
+ */
+static WMPropList *scanMenuDirectory(const char *title, char **path, const char *command)
 {
 	DIR *dir;
 	struct dirent *dentry;
 	struct stat stat_buf;
-	WMenu *menu = NULL;
+	WMPropList *menu = NULL, *ptitle;
 	char *buffer;
 	WMArray *dirs = NULL, *files = NULL;
 	WMArrayIterator iter;
@@ -1363,9 +1649,9 @@ static WMenu *readMenuDirectory(virtual_screen *vscr, const char *title, char **
 	WMSortArray(dirs, myCompare);
 	WMSortArray(files, myCompare);
 
-	menu = menu_create(vscr, M_(title));
-	menu_map(menu);
-	menu->on_destroy = removeShortcutsForMenu;
+	ptitle = WMCreatePLString(title);
+	menu = WMCreatePLArray(ptitle, NULL);
+	WMReleasePropList(ptitle);
 
 	WM_ITERATE_ARRAY(dirs, data, iter) {
 		/* New directory. Use same OPEN_MENU command that was used
@@ -1400,7 +1686,7 @@ static WMenu *readMenuDirectory(virtual_screen *vscr, const char *title, char **
 			strcat(buffer, command);
 		}
 
-		addMenuEntry(menu, M_(data->name), NULL, "OPEN_MENU", buffer, path[data->index]);
+		addMenuEntryDescription(menu, data->name, "OPEN_MENU", buffer);
 
 		wfree(buffer);
 		wfree(data->name);
@@ -1445,7 +1731,7 @@ static WMenu *readMenuDirectory(virtual_screen *vscr, const char *title, char **
 			if (ptr && ptr != data->name)
 				*ptr = 0;
 		}
-		addMenuEntry(menu, M_(data->name), NULL, "SHEXEC", buffer, path[data->index]);
+		addMenuEntryDescription(menu, data->name, "SHEXEC", buffer);
 
 		wfree(buffer);
 		wfree(data->name);
@@ -1524,7 +1810,7 @@ static WMenu *configure_plstring_menu(virtual_screen *vscr, WMPropList *definiti
 				 path);
 		}
 
-		menu_from_file = WMReadPropListFromFile(path);
+		menu_from_file = readMenuPropList(path);
 		if (menu_from_file == NULL) { /* old style menu */
 			menu = readMenuFile(vscr, path);
 		} else {
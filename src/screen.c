@@ -56,6 +56,7 @@
 #include "balloon.h"
 #include "geomview.h"
 #include "wmspec.h"
+#include "misc.h"
 
 #include "xinerama.h"
 
@@ -970,7 +971,7 @@ void wScreenSaveState(virtual_screen *vscr)
 
 	str = get_wmstate_file(vscr);
 
-	if (!WMWritePropListToFile(w_global.session_state, str))
+	if (!WriteDomainFile(w_global.session_state, str))
 		werror(_("could not save session state in %s"), str);
 
 	wfree(str);
@@ -261,6 +261,7 @@ struct WScreen {
     GC mono_gc;			       /* gc for 1 bit drawables */
 
     struct WPixmap *b_pixmaps[PRED_BPIXMAPS]; /* internal pixmaps for buttons*/
+    struct WAtlas *atlas;	       /* pixmaps shared by frames and icons */
     struct WPixmap *menu_radio_indicator;/* left menu indicator */
     struct WPixmap *menu_check_indicator;/* left menu indicator for checkmark */
     struct WPixmap *menu_mini_indicator;   /* for miniwindow */
@@ -34,6 +34,7 @@
 #include "properties.h"
 #include "stacking.h"
 #include "workspace.h"
+#include "profile.h"
 
 
 static void notifyStackChange(WCoreWindow *frame, char *detail)
@@ -75,10 +76,7 @@ void RemakeStackList(virtual_screen *vscr)
 		/* verify list integrity */
 		c = 0;
 		for (i = 0; i < nwindows; i++) {
-			if (XFindContext(dpy, windows[i], w_global.context.stack, (XPointer *) & frame) == XCNOENT)
-				continue;
-
-			if (!frame)
+			if ((frame = WMWindowTableGet(w_global.windows, windows[i], WT_STACK)) == NULL)
 				continue;
 
 			c++;
@@ -117,6 +115,8 @@ void CommitStacking(virtual_screen *vscr)
 	Window *windows;
 	WMBagIterator iter;
 
+	wProfileBegin(CommitStacking);
+
 	nwindows = vscr->window_count;
 	windows = wmalloc(sizeof(Window) * nwindows);
 
@@ -131,6 +131,8 @@ void CommitStacking(virtual_screen *vscr)
 	XRestackWindows(dpy, windows, i);
 	wfree(windows);
 	WMPostNotificationName(WMNResetStacking, vscr->screen_ptr, NULL);
+
+	wProfileEnd(CommitStacking);
 }
 
 /*
@@ -408,7 +410,7 @@ void AddToStackList(virtual_screen *vscr, WCoreWindow *frame)
 	WCoreWindow *trans = NULL;
 
 	vscr->window_count++;
-	XSaveContext(dpy, frame->window, w_global.context.stack, (XPointer) frame);
+	WMWindowTableInsert(w_global.windows, frame->window, WT_STACK, frame);
 	curtop = WMGetFromBag(scr->stacking_list, index);
 
 	/* first window in this level */
@@ -502,7 +504,7 @@ void RemoveFromStackList(virtual_screen *vscr, WCoreWindow *frame)
 {
 	int index = frame->stacking->window_level;
 
-	if (XDeleteContext(dpy, frame->window, w_global.context.stack) == XCNOENT) {
+	if (WMWindowTableRemove(w_global.windows, frame->window, WT_STACK) == NULL) {
 		wwarning("RemoveFromStackingList(): window not in list ");
 		return;
 	}
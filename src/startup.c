@@ -65,6 +65,7 @@
 #include "session.h"
 #include "defaults.h"
 #include "properties.h"
+#include "misc.h"
 #include "dialog.h"
 #include "wmspec.h"
 #include "event.h"
@@ -75,6 +76,7 @@
 
 #include "xutil.h"
 #include "input.h"
+#include "profile.h"
 
 /* for SunOS */
 #ifndef SA_RESTART
@@ -276,9 +278,7 @@ static void startup_set_atoms(void)
 
 	memset(&wKeyBindings, 0, sizeof(wKeyBindings));
 
-	w_global.context.client_win = XUniqueContext();
-	w_global.context.app_win = XUniqueContext();
-	w_global.context.stack = XUniqueContext();
+	w_global.windows = WMCreateWindowTable(WT_ROLES);
 
 #ifndef HAVE_XINTERNATOMS
 	for (k = 0; k < wlengthof(atomNames); k++)
@@ -453,12 +453,12 @@ static void set_session_state(virtual_screen *vscr)
 	char *path;
 
 	path = get_wmstate_file(vscr);
-	w_global.session_state = WMReadPropListFromFile(path);
+	w_global.session_state = ReadDomainFile(path);
 	wfree(path);
 
 	if (!w_global.session_state && w_global.screen_count > 1) {
 		path = wdefaultspathfordomain("WMState");
-		w_global.session_state = WMReadPropListFromFile(path);
+		w_global.session_state = ReadDomainFile(path);
 		wfree(path);
 	}
 
@@ -705,7 +705,9 @@ static void manageAllWindows(virtual_screen *vscr, int crashRecovery)
 		if (children[i] == None)
 			continue;
 
+		wProfileBegin(wManageWindow);
 		wwin = wManageWindow(vscr, children[i]);
+		wProfileEnd(wManageWindow);
 		if (wwin) {
 			/* apply states got from WSavedState */
 			/* shaded + minimized is not restored correctly */
@@ -42,6 +42,7 @@
 #include "stacking.h"
 #include "misc.h"
 #include "animations.h"
+#include "profile.h"
 
 #define PIECES ((64/ICON_KABOOM_PIECE_SIZE)*(64/ICON_KABOOM_PIECE_SIZE))
 #define KAB_PRECISION		4
@@ -144,6 +145,7 @@ Pixmap MakeGhostIcon(virtual_screen *vscr, Drawable drawable)
 	color.alpha = 200;
 
 	RClearImage(back, &color);
+	wProfileCount(pixmap_uploads);
 	RConvertImage(scr->rcontext, back, &pixmap);
 
 	RReleaseImage(back);
@@ -38,6 +38,7 @@
 #include "workspace.h"
 #include "framewin.h"
 #include "switchmenu.h"
+#include "redraw.h"
 
 #define IS_GNUSTEP_MENU(w) ((w)->wm_gnustep_attr && \
 	((w)->wm_gnustep_attr->flags & GSWindowLevelAttr) && \
@@ -420,6 +421,17 @@ void switchmenu_handle_notification_wwin(WMenu *menu, WWindow *wwin, const char
 	}
 }
 
+static void redrawMenu(void *data)
+{
+	WMenu *menu = data;
+
+	/* it may have been unmapped since */
+	if (!menu->frame || !menu->frame->vscr)
+		return;
+
+	menu_move_visible(menu);
+}
+
 static void observer(void *self, WMNotification *notif)
 {
 	WWindow *wwin = (WWindow *) WMGetNotificationObject(notif);
@@ -441,7 +453,8 @@ static void observer(void *self, WMNotification *notif)
 	    !wwin->vscr->menu.switch_menu->frame->vscr)
 		return;
 
-	menu_move_visible(wwin->vscr->menu.switch_menu);
+	/* focus, stacking and title changes come in bursts */
+	wRedrawLater(wwin->vscr->menu.switch_menu, redrawMenu);
 }
 
 static void wsobserver(void *self, WMNotification *notif)
@@ -35,6 +35,7 @@
 #include "misc.h"
 #include "xinerama.h"
 #include "miniwindow.h"
+#include "profile.h"
 
 
 #ifdef USE_XSHAPE
@@ -175,6 +176,7 @@ static void changeImage(WSwitchPanel *panel, int idecks, int selected, Bool dim,
 					   (back->width - image->width) / 2, (back->height - image->height) / 2,
 					   opaq);
 
+		wProfileCount(pixmap_uploads);
 		RConvertImage(panel->vscr->screen_ptr->rcontext, back, &p);
 		XSetWindowBackgroundPixmap(dpy, WMWidgetXID(icon), p);
 		XClearWindow(dpy, WMWidgetXID(icon));
@@ -507,6 +509,7 @@ WSwitchPanel *wInitSwitchPanel(virtual_screen *vscr, WWindow *curwin, Bool class
 	if (panel->bg) {
 		Pixmap pixmap, mask;
 
+		wProfileCount(pixmap_uploads);
 		RConvertImageMask(vscr->screen_ptr->rcontext, panel->bg, &pixmap, &mask, 250);
 
 		XSetWindowBackgroundPixmap(dpy, WMWidgetXID(panel->win), pixmap);
@@ -33,6 +33,8 @@
 #include "texture.h"
 #include "window.h"
 #include "misc.h"
+#include "profile.h"
+#include "atlas.h"
 
 
 static void bevelImage(RImage *image, int relief);
@@ -126,6 +128,8 @@ void wTextureDestroy(virtual_screen *vscr, WTexture *texture)
 	int count = 0;
 	unsigned long colors[8];
 
+	wAtlasForget(texture);
+
 	/* some stupid servers don't like white or black being freed... */
 #define CANFREE(c) (c!=scr->black_pixel && c!=scr->white_pixel && c!=0)
 	switch (texture->any.type) {
@@ -367,6 +371,8 @@ RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief
 	int d;
 	int subtype;
 
+	wProfileBegin(wTextureRenderImage);
+
 	switch (texture->any.type) {
 	case WTEX_SOLID:
 		image = RCreateImage(width, height, False);
@@ -474,6 +480,7 @@ RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief
 		image = RCreateImage(width, height, False);
 		if (image == NULL) {
 			wwarning(_("could not allocate image buffer"));
+			wProfileEnd(wTextureRenderImage);
 			return NULL;
 		}
 
@@ -516,6 +523,8 @@ RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief
 	else if (d < 0)
 		bevelImage(image, -d);
 
+	wProfileEnd(wTextureRenderImage);
+
 	return image;
 }
 
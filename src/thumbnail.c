@@ -0,0 +1,572 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Thumbnails of image files, as shown by the icon chooser.
+ *
+ * Loading and scaling an image is slow, so thumbnails are kept in memory
+ * (the THUMBNAIL_CACHE_SIZE most recently used) and, unless disabled in
+ * wconfig.h, on disk in ~/GNUstep/Library/WindowMaker/CachedThumbnails,
+ * where the THUMBNAIL_DISK_CACHE_SIZE most recently used are kept. Both are
+ * keyed by the path, size and modification time of the image file.
+ * Missing thumbnails are made one at a time from an idle handler, so the
+ * event loop keeps running while they are produced, and the requester is
+ * called back when each of them is ready.
+ */
+
+#include "wconfig.h"
+
+#include <X11/Xlib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <wraster.h>
+
+#include "WindowMaker.h"
+#include "thumbnail.h"
+#include "profile.h"
+
+
+#define CACHE_THUMBNAIL_PATH "/Library/WindowMaker/CachedThumbnails"
+
+/* Maximum number of thumbnails waiting to be made, the oldest are dropped */
+#define MAX_PENDING_THUMBNAILS 64
+
+/* Thumbnails saved between two looks at the size of the disk cache */
+#define PRUNE_INTERVAL 64
+
+typedef struct WThumbnail {
+	char *file;
+	time_t mtime;
+	off_t size;
+	unsigned int width, height;	/* box the image was scaled into */
+	RImage *image;			/* NULL if the file could not be loaded */
+
+	struct WThumbnail *prev, *next;	/* most recently used first */
+} WThumbnail;
+
+typedef struct WThumbnailRequest {
+	RContext *rcontext;
+	char *file;
+	unsigned int width, height;
+	WThumbnailReadyProc *proc;
+	void *data;
+} WThumbnailRequest;
+
+static WMHashTable *thumbnailTable = NULL;
+static WThumbnail *thumbnailFirst = NULL;
+static WThumbnail *thumbnailLast = NULL;
+static int thumbnailCount = 0;
+
+static WMArray *pendingRequests = NULL;
+static WMHandlerID thumbnailIdler = NULL;
+
+
+static void unlinkThumbnail(WThumbnail *thumb)
+{
+	if (thumb->prev)
+		thumb->prev->next = thumb->next;
+	else
+		thumbnailFirst = thumb->next;
+
+	if (thumb->next)
+		thumb->next->prev = thumb->prev;
+	else
+		thumbnailLast = thumb->prev;
+
+	thumb->prev = thumb->next = NULL;
+}
+
+static void linkThumbnailFirst(WThumbnail *thumb)
+{
+	thumb->prev = NULL;
+	thumb->next = thumbnailFirst;
+	if (thumbnailFirst)
+		thumbnailFirst->prev = thumb;
+	thumbnailFirst = thumb;
+	if (!thumbnailLast)
+		thumbnailLast = thumb;
+}
+
+static void freeThumbnail(WThumbnail *thumb)
+{
+	WMHashRemove(thumbnailTable, thumb->file);
+	unlinkThumbnail(thumb);
+	thumbnailCount--;
+
+	if (thumb->image)
+		RReleaseImage(thumb->image);
+	wfree(thumb->file);
+	wfree(thumb);
+}
+
+static void storeThumbnail(const char *file, const struct stat *st, unsigned int width, unsigned int height,
+                           RImage *image)
+{
+	WThumbnail *thumb;
+
+	if (!thumbnailTable)
+		thumbnailTable = WMCreateHashTable(WMStringPointerHashCallbacks);
+
+	thumb = WMHashGet(thumbnailTable, file);
+	if (thumb)
+		freeThumbnail(thumb);
+
+	while (thumbnailCount >= THUMBNAIL_CACHE_SIZE && thumbnailLast)
+		freeThumbnail(thumbnailLast);
+
+	thumb = wmalloc(sizeof(WThumbnail));
+	thumb->file = wstrdup(file);
+	thumb->mtime = st->st_mtime;
+	thumb->size = st->st_size;
+	thumb->width = width;
+	thumb->height = height;
+	thumb->image = image;
+
+	WMHashInsert(thumbnailTable, thumb->file, thumb);
+	linkThumbnailFirst(thumb);
+	thumbnailCount++;
+}
+
+#ifdef THUMBNAIL_DISK_CACHE
+static char *getThumbnailCacheFile(const char *file, Bool create)
+{
+	const char *prefix;
+	uint64_t hash;
+	const unsigned char *p;
+	char *path;
+	int len;
+
+	/* FNV-1a, good enough to spread the files over the names */
+	hash = 14695981039346656037ULL;
+	for (p = (const unsigned char *)file; *p; p++) {
+		hash ^= *p;
+		hash *= 1099511628211ULL;
+	}
+
+	prefix = wusergnusteppath();
+	len = strlen(prefix) + strlen(CACHE_THUMBNAIL_PATH) + 24;
+	path = wmalloc(len);
+	snprintf(path, len, "%s%s/%016llx", prefix, CACHE_THUMBNAIL_PATH, (unsigned long long)hash);
+
+	if (create && !wmkdirhier(path)) {
+		wfree(path);
+		return NULL;
+	}
+
+	return path;
+}
+
+/*
+ * The files of the cache have a one line text header giving what the
+ * thumbnail was made from, the path of the image on a second line, and
+ * then the raw pixels.
+ */
+static RImage *loadCachedThumbnail(const char *file, const struct stat *st,
+                                   unsigned int width, unsigned int height, Bool *found)
+{
+	char *path, *line;
+	char buf[PATH_MAX + 2];
+	long long mtime, size;
+	unsigned int bwidth, bheight, iwidth, iheight, channels;
+	RImage *image = NULL;
+	FILE *fp;
+
+	*found = False;
+
+	path = getThumbnailCacheFile(file, False);
+	fp = fopen(path, "rb");
+	if (!fp) {
+		wfree(path);
+		return NULL;
+	}
+
+	if (!fgets(buf, sizeof(buf), fp) ||
+	    sscanf(buf, "WMTHUMB %lld %lld %u %u %u %u %u",
+	           &mtime, &size, &bwidth, &bheight, &iwidth, &iheight, &channels) != 7)
+		goto out;
+
+	/* make sure it is not another file with the same hash */
+	line = fgets(buf, sizeof(buf), fp);
+	if (!line)
+		goto out;
+	line[strcspn(line, "\n")] = '\0';
+	if (strcmp(line, file) != 0)
+		goto out;
+
+	if (mtime != (long long)st->st_mtime || size != (long long)st->st_size) {
+		/* the image changed, this one will not be used again */
+		unlink(path);
+		goto out;
+	}
+	if (bwidth != width || bheight != height)
+		goto out;
+
+	*found = True;
+
+	/* the least recently used are removed first */
+	utime(path, NULL);
+
+	/* the image could not be loaded when the thumbnail was made */
+	if (iwidth == 0 || iheight == 0)
+		goto out;
+
+	if (iwidth > width || iheight > height || (channels != 3 && channels != 4)) {
+		*found = False;
+		goto out;
+	}
+
+	image = RCreateImage(iwidth, iheight, channels == 4);
+	if (!image) {
+		*found = False;
+		goto out;
+	}
+
+	if (fread(image->data, channels, iwidth * iheight, fp) != iwidth * iheight) {
+		RReleaseImage(image);
+		image = NULL;
+		*found = False;
+	}
+
+ out:
+	fclose(fp);
+	wfree(path);
+	return image;
+}
+
+typedef struct CachedFile {
+	char *name;
+	time_t mtime;
+} CachedFile;
+
+static int compareCachedFiles(const void *a, const void *b)
+{
+	const CachedFile *f1 = a;
+	const CachedFile *f2 = b;
+
+	return (f1->mtime > f2->mtime) - (f1->mtime < f2->mtime);
+}
+
+/* Removes the least recently used thumbnails when there are too many */
+static void pruneCachedThumbnails(void)
+{
+	static int saved = 0;
+	CachedFile *files = NULL;
+	int count = 0, size = 0, i;
+	struct dirent *entry;
+	struct stat st;
+	char *dirpath, *path;
+	time_t now;
+	DIR *dir;
+
+	/* looking at all of them for each one saved would be too slow */
+	if (saved++ % PRUNE_INTERVAL != 0)
+		return;
+
+	dirpath = wstrconcat(wusergnusteppath(), CACHE_THUMBNAIL_PATH);
+	dir = opendir(dirpath);
+	if (!dir) {
+		wfree(dirpath);
+		return;
+	}
+
+	now = time(NULL);
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		path = wstrconcat(dirpath, "/");
+		path = wstrappend(path, entry->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+			wfree(path);
+			continue;
+		}
+
+		/* left by a save that did not finish */
+		if (strchr(entry->d_name, '.')) {
+			if (now - st.st_mtime > 3600)
+				unlink(path);
+			wfree(path);
+			continue;
+		}
+
+		if (count == size) {
+			size = size ? size * 2 : 256;
+			files = wrealloc(files, size * sizeof(CachedFile));
+		}
+		files[count].name = path;
+		files[count].mtime = st.st_mtime;
+		count++;
+	}
+	closedir(dir);
+	wfree(dirpath);
+
+	if (count > THUMBNAIL_DISK_CACHE_SIZE) {
+		/* some room, so that it is not done again for the next ones */
+		qsort(files, count, sizeof(CachedFile), compareCachedFiles);
+		for (i = 0; i < count - THUMBNAIL_DISK_CACHE_SIZE * 3 / 4; i++)
+			unlink(files[i].name);
+	}
+
+	for (i = 0; i < count; i++)
+		wfree(files[i].name);
+	if (files)
+		wfree(files);
+}
+
+static void saveCachedThumbnail(const char *file, const struct stat *st,
+                                unsigned int width, unsigned int height, RImage *image)
+{
+	char *path, *tmp;
+	unsigned int channels;
+	Bool ok;
+	FILE *fp;
+	int fd;
+
+	path = getThumbnailCacheFile(file, True);
+	if (!path)
+		return;
+
+	tmp = wstrconcat(path, ".XXXXXX");
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		wfree(tmp);
+		wfree(path);
+		return;
+	}
+
+	fp = fdopen(fd, "wb");
+	if (!fp) {
+		close(fd);
+		unlink(tmp);
+		wfree(tmp);
+		wfree(path);
+		return;
+	}
+
+	channels = (image && image->format == RRGBAFormat) ? 4 : 3;
+	ok = fprintf(fp, "WMTHUMB %lld %lld %u %u %u %u %u\n%s\n",
+	             (long long)st->st_mtime, (long long)st->st_size, width, height,
+	             image ? image->width : 0, image ? image->height : 0, channels, file) > 0;
+
+	if (ok && image)
+		ok = (fwrite(image->data, channels, image->width * image->height, fp) ==
+		      (size_t) image->width * image->height);
+
+	if (fclose(fp) != 0)
+		ok = False;
+
+	if (!ok || rename(tmp, path) != 0)
+		unlink(tmp);
+
+	wfree(tmp);
+	wfree(path);
+
+	pruneCachedThumbnails();
+}
+#endif
+
+/* Load the image and scale it to fit in the box, like the icon chooser
+ * always did */
+static RImage *makeThumbnail(RContext *rcontext, const char *file, unsigned int width, unsigned int height)
+{
+	RImage *image, *scaled;
+	unsigned int new_width, new_height;
+
+	image = RLoadImage(rcontext, file, 0);
+	if (!image)
+		return NULL;
+
+	if (image->width <= width && image->height <= height)
+		return image;
+
+	new_width = image->width;
+	new_height = image->height;
+	if (new_width > width) {
+		new_width = width;
+		new_height = width * image->height / image->width;
+	}
+	if (new_height > height) {
+		new_width = height * image->width / image->height;
+		new_height = height;
+	}
+	if (new_width == 0)
+		new_width = 1;
+	if (new_height == 0)
+		new_height = 1;
+
+	scaled = RScaleImage(image, new_width, new_height);
+	RReleaseImage(image);
+
+	return scaled;
+}
+
+static void freeRequest(WThumbnailRequest *request)
+{
+	wfree(request->file);
+	wfree(request);
+}
+
+static void processPendingThumbnail(void *data)
+{
+	WThumbnailRequest *request;
+	WThumbnailReadyProc *proc;
+	struct stat st;
+	RImage *image;
+	void *cdata;
+#ifdef THUMBNAIL_DISK_CACHE
+	Bool found;
+#endif
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	thumbnailIdler = NULL;
+
+	/* the most recent requests are for what is on screen now */
+	request = WMPopFromArray(pendingRequests);
+	if (!request)
+		return;
+
+	if (stat(request->file, &st) == 0) {
+#ifdef THUMBNAIL_DISK_CACHE
+		image = loadCachedThumbnail(request->file, &st, request->width, request->height, &found);
+		if (!found) {
+			image = makeThumbnail(request->rcontext, request->file, request->width, request->height);
+			saveCachedThumbnail(request->file, &st, request->width, request->height, image);
+		}
+#else
+		image = makeThumbnail(request->rcontext, request->file, request->width, request->height);
+#endif
+		storeThumbnail(request->file, &st, request->width, request->height, image);
+	} else {
+		memset(&st, 0, sizeof(st));
+		storeThumbnail(request->file, &st, request->width, request->height, NULL);
+	}
+
+	proc = request->proc;
+	cdata = request->data;
+	freeRequest(request);
+
+	if (WMGetArrayItemCount(pendingRequests) > 0)
+		thumbnailIdler = WMAddIdleHandler(processPendingThumbnail, NULL);
+
+	if (proc)
+		(*proc) (cdata);
+}
+
+static int matchRequestFile(const void *item, const void *cdata)
+{
+	return strcmp(((const WThumbnailRequest *)item)->file, (const char *)cdata) == 0;
+}
+
+static int matchRequestData(const void *item, const void *cdata)
+{
+	return ((const WThumbnailRequest *)item)->data == cdata;
+}
+
+RImage *wThumbnailGet(RContext *rcontext, const char *file, unsigned int width, unsigned int height,
+                      WThumbnailReadyProc *proc, void *data)
+{
+	WThumbnailRequest *request;
+	WThumbnail *thumb;
+	int index;
+
+	thumb = thumbnailTable ? WMHashGet(thumbnailTable, file) : NULL;
+	if (thumb) {
+		struct stat st;
+
+		/* made before the image changed */
+		if (stat(file, &st) != 0)
+			memset(&st, 0, sizeof(st));
+		if (st.st_mtime != thumb->mtime || st.st_size != thumb->size) {
+			freeThumbnail(thumb);
+			thumb = NULL;
+		}
+	}
+
+	wProfileHit(thumbnail_cache, thumb && thumb->width == width && thumb->height == height);
+	if (thumb && thumb->width == width && thumb->height == height) {
+		unlinkThumbnail(thumb);
+		linkThumbnailFirst(thumb);
+
+		return thumb->image ? RRetainImage(thumb->image) : NULL;
+	}
+
+	if (!pendingRequests)
+		pendingRequests = WMCreateArray(MAX_PENDING_THUMBNAILS);
+
+	/* already asked for, but make it the next one to be processed */
+	index = WMFindInArray(pendingRequests, matchRequestFile, (void *)file);
+	if (index != WANotFound) {
+		request = WMGetFromArray(pendingRequests, index);
+		WMDeleteFromArray(pendingRequests, index);
+		freeRequest(request);
+	}
+
+	if (WMGetArrayItemCount(pendingRequests) >= MAX_PENDING_THUMBNAILS) {
+		request = WMGetFromArray(pendingRequests, 0);
+		WMDeleteFromArray(pendingRequests, 0);
+		freeRequest(request);
+	}
+
+	request = wmalloc(sizeof(WThumbnailRequest));
+	request->rcontext = rcontext;
+	request->file = wstrdup(file);
+	request->width = width;
+	request->height = height;
+	request->proc = proc;
+	request->data = data;
+	WMAddToArray(pendingRequests, request);
+
+	if (!thumbnailIdler)
+		thumbnailIdler = WMAddIdleHandler(processPendingThumbnail, NULL);
+
+	return NULL;
+}
+
+void wThumbnailCancel(void *data)
+{
+	WThumbnailRequest *request;
+	int index;
+
+	if (!pendingRequests)
+		return;
+
+	while ((index = WMFindInArray(pendingRequests, matchRequestData, data)) != WANotFound) {
+		request = WMGetFromArray(pendingRequests, index);
+		WMDeleteFromArray(pendingRequests, index);
+		freeRequest(request);
+	}
+
+	if (WMGetArrayItemCount(pendingRequests) == 0 && thumbnailIdler) {
+		WMDeleteIdleHandler(thumbnailIdler);
+		thumbnailIdler = NULL;
+	}
+}
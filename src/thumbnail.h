@@ -0,0 +1,41 @@
+/*
+ *  Window Maker window manager
+ *
+ *  Copyright (c) 2014 Window Maker Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WMTHUMBNAIL_H_
+#define WMTHUMBNAIL_H_
+
+#include <wraster.h>
+
+/* Called each time a thumbnail requested with this `data' is ready */
+typedef void WThumbnailReadyProc(void *data);
+
+/*
+ * Returns the thumbnail of the image `file', scaled to fit in width x height,
+ * retained for the caller. If it is not known yet, it is scheduled to be made
+ * when wmaker is idle, `proc' will be called once it is ready, and NULL is
+ * returned. NULL is also returned for files that could not be loaded.
+ */
+RImage *wThumbnailGet(RContext *rcontext, const char *file, unsigned int width, unsigned int height,
+                      WThumbnailReadyProc *proc, void *data);
+
+/* Forget the pending requests made with this `data' */
+void wThumbnailCancel(void *data);
+
+#endif
@@ -68,7 +68,7 @@ void wcore_map_toplevel(WCoreWindow *core, virtual_screen *vscr, int x, int y,
 	core->descriptor.self = core;
 
 	XClearWindow(dpy, core->window);
-	XSaveContext(dpy, core->window, w_global.context.client_win, (XPointer) & core->descriptor);
+	WMWindowTableInsert(w_global.windows, core->window, WT_DESCRIPTOR, &core->descriptor);
 }
 
 void wcore_map(WCoreWindow *core, WCoreWindow *parent, virtual_screen *vscr,
@@ -91,13 +91,13 @@ void wcore_map(WCoreWindow *core, WCoreWindow *parent, virtual_screen *vscr,
 
 	core->descriptor.self = core;
 
-	XSaveContext(dpy, core->window, w_global.context.client_win, (XPointer) & core->descriptor);
+	WMWindowTableInsert(w_global.windows, core->window, WT_DESCRIPTOR, &core->descriptor);
 }
 
 void wcore_unmap(WCoreWindow *core)
 {
 	if (core) {
-		XDeleteContext(dpy, core->window, w_global.context.client_win);
+		WMWindowTableRemove(w_global.windows, core->window, WT_DESCRIPTOR);
 		XDestroyWindow(dpy, core->window);
 	}
 }
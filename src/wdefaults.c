@@ -39,6 +39,7 @@
 #include "wdefaults.h"
 #include "workspace.h"
 #include "misc.h"
+#include "profile.h"
 
 #define APPLY_VAL(value, flag, attrib)	\
     if (value) {attr->flag = getBool(attrib, value); \
@@ -84,6 +85,20 @@ static WMPropList *AIcon;
 static WMPropList *AnyWindow;
 static WMPropList *No;
 
+/*
+ * The attributes read for each instance/class, so that they are looked up
+ * in the WMWindowAttributes dictionaries only once. It is emptied whenever
+ * the dictionaries change.
+ */
+typedef struct {
+	WWindowAttributes attr;
+	WWindowAttributes mask;		/* attributes that are defined */
+} CachedAttributes;
+
+#define MAX_CACHED_ATTRIBUTES	256
+
+static WMHashTable *attributesCache = NULL;
+
 static void init_wdefaults(void)
 {
 	AIcon = WMCreatePLString("Icon");
@@ -184,18 +199,7 @@ static WMPropList *get_value_from_instanceclass(const char *value)
 	return val;
 }
 
-/*
- *----------------------------------------------------------------------
- * wDefaultFillAttributes--
- * 	Retrieves attributes for the specified instance/class and
- * fills attr with it. Values that are actually defined are also
- * set in mask. If useGlobalDefault is True, the default for
- * all windows ("*") will be used for when no values are found
- * for that instance/class.
- *
- *----------------------------------------------------------------------
- */
-void wDefaultFillAttributes(const char *instance, const char *class,
+static void read_attributes(const char *instance, const char *class,
 			    WWindowAttributes *attr, WWindowAttributes *mask,
 			    Bool useGlobalDefault)
 {
@@ -204,9 +208,6 @@ void wDefaultFillAttributes(const char *instance, const char *class,
 
 	dw = dc = dn = da = NULL;
 
-	if (!ANoTitlebar)
-		init_wdefaults();
-
 	if (class && instance) {
 		buffer = StrConcatDot(instance, class);
 		dw = get_value_from_instanceclass(buffer);
@@ -312,6 +313,102 @@ void wDefaultFillAttributes(const char *instance, const char *class,
 	WMPLSetCaseSensitive(False);
 }
 
+static char *attributes_cache_key(const char *instance, const char *class, Bool useGlobalDefault)
+{
+	char *key;
+	int ilen, clen;
+
+	/* the lengths keep a missing name apart from an empty one, and "a.b" "c" from "a" "b.c" */
+	ilen = instance ? strlen(instance) : -1;
+	clen = class ? strlen(class) : -1;
+
+	key = wmalloc(3 * 16 + (ilen > 0 ? ilen : 0) + (clen > 0 ? clen : 0));
+	sprintf(key, "%d %d %d %s%s", useGlobalDefault ? 1 : 0, ilen, clen,
+		instance ? instance : "", class ? class : "");
+
+	return key;
+}
+
+static void free_cached_attributes(void)
+{
+	WMHashEnumerator e;
+	CachedAttributes *cached;
+
+	e = WMEnumerateHashTable(attributesCache);
+	while ((cached = WMNextHashEnumeratorItem(&e)))
+		wfree(cached);
+
+	WMResetHashTable(attributesCache);
+}
+
+/*
+ *----------------------------------------------------------------------
+ * wDefaultFillAttributes--
+ * 	Retrieves attributes for the specified instance/class and
+ * fills attr with it. Values that are actually defined are also
+ * set in mask. If useGlobalDefault is True, the default for
+ * all windows ("*") will be used for when no values are found
+ * for that instance/class.
+ *
+ *----------------------------------------------------------------------
+ */
+void wDefaultFillAttributes(const char *instance, const char *class,
+			    WWindowAttributes *attr, WWindowAttributes *mask,
+			    Bool useGlobalDefault)
+{
+	CachedAttributes *cached;
+	unsigned char *dst, *dst_mask;
+	const unsigned char *src, *src_mask;
+	char *key;
+	size_t i;
+
+	if (!ANoTitlebar)
+		init_wdefaults();
+
+	if (!attributesCache)
+		attributesCache = WMCreateHashTable(WMStringHashCallbacks);
+
+	key = attributes_cache_key(instance, class, useGlobalDefault);
+	cached = WMHashGet(attributesCache, key);
+	wProfileHit(window_attributes_cache, cached != NULL);
+
+	if (!cached) {
+		/* windows with a new name each time must not make it grow forever */
+		if (WMCountHashTable(attributesCache) >= MAX_CACHED_ATTRIBUTES)
+			free_cached_attributes();
+
+		cached = wmalloc(sizeof(CachedAttributes));
+		read_attributes(instance, class, &cached->attr, &cached->mask, useGlobalDefault);
+		WMHashInsert(attributesCache, key, cached);
+	}
+	wfree(key);
+
+	/*
+	 * The attributes are all 1 bit fields, so the defined ones can be
+	 * copied over the ones in attr byte by byte through the mask.
+	 */
+	dst = (unsigned char *) attr;
+	dst_mask = (unsigned char *) mask;
+	src = (const unsigned char *) &cached->attr;
+	src_mask = (const unsigned char *) &cached->mask;
+
+	for (i = 0; i < sizeof(WWindowAttributes); i++) {
+		dst[i] = (dst[i] & ~src_mask[i]) | (src[i] & src_mask[i]);
+		if (mask)
+			dst_mask[i] |= src_mask[i];
+	}
+}
+
+/*
+ * Forgets the attributes read for the windows. Must be called after the
+ * WMWindowAttributes dictionaries are changed or reloaded.
+ */
+void wDefaultInvalidateAttributes(void)
+{
+	if (attributesCache)
+		free_cached_attributes();
+}
+
 static WMPropList *get_generic_value(const char *instance, const char *class,
 				     WMPropList *option, Bool default_icon)
 {
@@ -512,6 +609,7 @@ void wDefaultPurgeInfo(const char *instance, const char *class)
 			WMRemoveFromPLDictionary(dict, AIcon);
 		}
 		WMRemoveFromPLDictionary(w_global.domain.window_attr->dictionary, key);
+		wDefaultInvalidateAttributes();
 		UpdateDomainFile(w_global.domain.window_attr);
 	}
 
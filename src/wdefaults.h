@@ -46,5 +46,6 @@ void wDefaultChangeIcon(const char *instance, const char *class, const char *fil
 void wDefaultFillAttributes(const char *instance, const char *class,
 			    WWindowAttributes *attr, WWindowAttributes *mask,
 			    Bool useGlobalDefault);
+void wDefaultInvalidateAttributes(void);
 char *wDefaultGetIconFile(const char *instance, const char *class, Bool default_icon);
 #endif
@@ -169,7 +169,7 @@ WWindow *wWindowFor(Window window)
 	if (window == None)
 		return NULL;
 
-	if (XFindContext(dpy, window, w_global.context.client_win, (XPointer *) & desc) == XCNOENT)
+	if ((desc = WMWindowTableGet(w_global.windows, window, WT_DESCRIPTOR)) == NULL)
 		return NULL;
 
 	if (desc->parent_type == WCLASS_WINDOW)
@@ -208,7 +208,7 @@ void wWindowDestroy(WWindow *wwin)
 	if (wwin->vscr->screen_ptr->cmap_window == wwin)
 		wwin->vscr->screen_ptr->cmap_window = NULL;
 
-	WMRemoveNotificationObserver(wwin);
+	WMDeleteNotificationObserver(wwin->appearance_observer);
 
 	wwin->flags.destroyed = 1;
 
@@ -252,7 +252,7 @@ void wWindowDestroy(WWindow *wwin)
 	if (wwin->cmap_windows)
 		XFree(wwin->cmap_windows);
 
-	XDeleteContext(dpy, wwin->client_win, w_global.context.client_win);
+	WMWindowTableRemove(w_global.windows, wwin->client_win, WT_DESCRIPTOR);
 
 	if (wwin->frame) {
 		framewindow_unmap(wwin->frame);
@@ -1206,7 +1206,7 @@ WWindow *wManageWindow(virtual_screen *vscr, Window window)
 
 	wwin = wWindowCreate();
 
-	XSaveContext(dpy, window, w_global.context.client_win, (XPointer) & wwin->client_descriptor);
+	WMWindowTableInsert(w_global.windows, window, WT_DESCRIPTOR, &wwin->client_descriptor);
 
 #ifndef USE_XSHAPE
 	wwindow_set_xshape(dpy, window, wwin);
@@ -1506,7 +1506,8 @@ WWindow *wManageWindow(virtual_screen *vscr, Window window)
 	wColormapInstallForWindow(vscr, vscr->screen_ptr->cmap_window);
 
 	/* Setup Notification Observers */
-	WMAddNotificationObserver(appearanceObserver, wwin, WNWindowAppearanceSettingsChanged, wwin);
+	wwin->appearance_observer = WMAddNotificationObserver(appearanceObserver, wwin,
+							      WNWindowAppearanceSettingsChanged, wwin);
 
 	/*  Cleanup temporary stuff */
 	if (win_state)
@@ -1531,7 +1532,8 @@ WWindow *wManageInternalWindow(virtual_screen *vscr, Window window, Window owner
 
 	wwin = wWindowCreate();
 
-	WMAddNotificationObserver(appearanceObserver, wwin, WNWindowAppearanceSettingsChanged, wwin);
+	wwin->appearance_observer = WMAddNotificationObserver(appearanceObserver, wwin,
+							      WNWindowAppearanceSettingsChanged, wwin);
 
 	wwin->flags.internal_window = 1;
 
@@ -1565,7 +1567,7 @@ WWindow *wManageInternalWindow(virtual_screen *vscr, Window window, Window owner
 			 vscr->screen_ptr->w_visual,
 			 vscr->screen_ptr->w_colormap);
 
-	XSaveContext(dpy, window, w_global.context.client_win, (XPointer) & wwin->client_descriptor);
+	WMWindowTableInsert(w_global.windows, window, WT_DESCRIPTOR, &wwin->client_descriptor);
 
 	wwin->frame->flags.is_client_window_frame = 1;
 	wwin->frame->flags.justification = wPreferences.title_justification;
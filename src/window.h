@@ -245,6 +245,8 @@ typedef struct WWindow {
 
 	long event_mask;			/* the event mask thats selected */
 
+	WMHandlerID appearance_observer;	/* for the appearance settings */
+
 	/* state flags */
 	struct {
 		unsigned int mapped:1;
@@ -674,6 +674,7 @@ static void saveSettings(WMWidget *button, void *client_data)
 	WMReleasePropList(key);
 	WMReleasePropList(winDic);
 
+	wDefaultInvalidateAttributes();
 	UpdateDomainFile(db);
 
 	/* clean up */
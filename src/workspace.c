@@ -54,6 +54,7 @@
 #include "wsmap.h"
 #include "dialog.h"
 #include "miniwindow.h"
+#include "profile.h"
 
 #define MC_DESTROY_LAST 1
 #define MC_LAST_USED    2
@@ -318,6 +319,7 @@ static void hideWorkspaceName(void *data)
 		RCombineImagesWithOpaqueness(img, scr->workspace_name_data->text,
 					     scr->workspace_name_data->count * 255 / 10);
 
+		wProfileCount(pixmap_uploads);
 		RConvertImage(scr->rcontext, img, &pix);
 
 		RReleaseImage(img);
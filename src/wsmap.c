@@ -34,6 +34,7 @@
 #include "workspace.h"
 #include "wsmap.h"
 #include "texture.h"
+#include "profile.h"
 
 #include "WINGs/WINGsP.h"
 
@@ -162,6 +163,7 @@ static void set_workspace_map_background_image(WWorkspaceMap *wsmap)
 		if (!tmp)
 			return;
 
+		wProfileCount(pixmap_uploads);
 		RConvertImageMask(wsmap->vscr->screen_ptr->rcontext, tmp, &pixmap, &mask, 250);
 		RReleaseImage(tmp);
 
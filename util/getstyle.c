@@ -240,7 +240,7 @@ static void makeThemePack(WMPropList * style, const char *themeName)
 
 					WMDeleteFromPLArray(value, 1);
 					WMInsertInPLArray(value, 1, WMCreatePLString(newPath));
-					free(newPath);
+					wfree(newPath);
 				} else {
 					findCopyFile(themeDir, WMGetFromPLString(file));
 				}
@@ -260,7 +260,7 @@ static void makeThemePack(WMPropList * style, const char *themeName)
 
 					WMDeleteFromPLArray(value, 1);
 					WMInsertInPLArray(value, 1, WMCreatePLString(newPath));
-					free(newPath);
+					wfree(newPath);
 				} else {
 					findCopyFile(themeDir, WMGetFromPLString(file));
 				}
@@ -275,7 +275,7 @@ static void makeThemePack(WMPropList * style, const char *themeName)
 
 					WMDeleteFromPLArray(value, 2);
 					WMInsertInPLArray(value, 2, WMCreatePLString(newPath));
-					free(newPath);
+					wfree(newPath);
 				} else {
 					findCopyFile(themeDir, WMGetFromPLString(file));
 				}
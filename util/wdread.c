@@ -52,6 +52,7 @@ static noreturn void print_help(int print_usage, int exitval)
 	if (print_usage) {
 		puts("Read <key> from <domain>'s database");
 		puts("");
+		puts("  -c, --cache             read it from the binary cache of the domain");
 		puts("  -h, --help              display this help message");
 		puts("  -v, --version           output version information and exit");
 	}
@@ -62,17 +63,21 @@ int main(int argc, char **argv)
 {
 	char path[PATH_MAX];
 	WMPropList *key, *value, *dict;
-	int ch;
+	int ch, cache = 0;
 
 	struct option longopts[] = {
+		{ "cache",	no_argument,		NULL,			'c' },
 		{ "version",	no_argument,		NULL,			'v' },
 		{ "help",	no_argument,		NULL,			'h' },
 		{ NULL,		0,			NULL,			0 }
 	};
 
 	prog_name = argv[0];
-	while ((ch = getopt_long(argc, argv, "hv", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "chv", longopts, NULL)) != -1)
 		switch(ch) {
+			case 'c':
+				cache = 1;
+				break;
 			case 'v':
 				printf("%s (Window Maker %s)\n", prog_name, VERSION);
 				return 0;
@@ -97,9 +102,12 @@ int main(int argc, char **argv)
 
 	snprintf(path, sizeof(path), "%s", wdefaultspathfordomain(argv[0]));
 
-	dict = WMReadPropListFromFile(path);
+	if (cache)
+		dict = WMReadPropListCache(path);
+	else
+		dict = WMReadPropListFromFile(path);
 	if (dict == NULL)
-		return 1;	/* bad domain */
+		return 1;	/* bad domain, or no cache up to date */
 
 	value = WMGetFromPLDictionary(dict, key);
 	if (value == NULL)
@@ -51,6 +51,7 @@ static noreturn void print_help(int print_usage, int exitval)
 	if (print_usage) {
 		puts("Write <value> for <key> in <domain>'s database");
 		puts("");
+		puts("  -c, --cache       also write the binary cache of the domain");
 		puts("  -h, --help        display this help message");
 		puts("  -v, --version     output version information and exit");
 	}
@@ -61,17 +62,21 @@ int main(int argc, char **argv)
 {
 	char path[PATH_MAX];
 	WMPropList *key, *value, *dict;
-	int ch;
+	int ch, cache = 0;
 
 	struct option longopts[] = {
+		{ "cache",	no_argument,		NULL,			'c' },
 		{ "version",	no_argument,		NULL,			'v' },
 		{ "help",	no_argument,		NULL,			'h' },
 		{ NULL,		0,			NULL,			0 }
 	};
 
 	prog_name = argv[0];
-	while ((ch = getopt_long(argc, argv, "hv", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "chv", longopts, NULL)) != -1)
 		switch(ch) {
+			case 'c':
+				cache = 1;
+				break;
 			case 'v':
 				printf("%s (Window Maker %s)\n", prog_name, VERSION);
 				return 0;
@@ -108,7 +113,11 @@ int main(int argc, char **argv)
 		WMPutInPLDictionary(dict, key, value);
 	}
 
-	WMWritePropListToFile(dict, path);
+	if (!WMWritePropListToFile(dict, path))
+		return 1;
+
+	if (cache && !WMWritePropListCache(dict, path))
+		printf("%s: could not write the cache of \"%s\"\n", prog_name, argv[0]);
 
 	return 0;
 }
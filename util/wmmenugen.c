@@ -32,7 +32,15 @@
 
 #include "wmmenugen.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* maximum number of threads used to parse the menu files */
+#define MAX_PARSE_THREADS	16
+
 static void addWMMenuEntryCallback(WMMenuEntry *aEntry);
+static void collectMenuEntryCallback(WMMenuEntry *aEntry);
 static void assemblePLMenuFunc(WMTreeNode *aNode, void *data);
 static int dirParseFunc(const char *filename, const struct stat *st, int tflags, struct FTW *ftw);
 static int menuSortFunc(const void *left, const void *right);
@@ -43,12 +51,36 @@ static WMTreeNode *findPositionInMenu(const char *submenu);
 typedef void fct_parse_menufile(const char *file, cb_add_menu_entry *addWMMenuEntryCallback);
 typedef Bool fct_validate_filename(const char *filename, const struct stat *st, int tflags, struct FTW *ftw);
 
+/* a file found on the command line or in a directory, along with the menu
+ * entries it gave. files are parsed first, possibly in parallel, and their
+ * entries are added to the menu afterwards in the order the files were found
+ */
+typedef struct {
+	char			*path;
+	struct stat		 st;
+	fct_parse_menufile	*parse;
+	WMArray			*entries;	/* of WMMenuEntry */
+	Bool			 cached;	/* entries come from the cache */
+} WMMenuFile;
+
 
 static WMArray *plMenuNodes;
 static const char *terminal;
 static fct_parse_menufile *parse;
 static fct_validate_filename *validateFilename;
 
+static WMArray *menuFiles;
+static const char *cache_file;
+static const char *output_file;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t parseLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t currentFileKey;
+static int nextFileToParse;
+#else
+static WMMenuFile *currentFile;
+#endif
+
 static const char *prog_name;
 
 /* Global Variables from wmmenugen.h */
@@ -60,7 +92,9 @@ static void print_help(void)
 	printf("Usage: %s -parser:<parser> fspec [fspec...]\n", prog_name);
 	puts("Dynamically generate a menu in Property List format for Window Maker");
 	puts("");
+	puts("  --cache=<file>\tremember the entries of the parsed files in this file");
 	puts("  -h, --help\t\tdisplay this help and exit");
+	puts("  --output=<file>\twrite the menu to this file, only if it changed");
 	puts("  -parser=<name>\tspecify the format of the input, see below");
 	puts("  --version\t\toutput version information and exit");
 	puts("");
@@ -71,19 +105,218 @@ static void print_help(void)
 	puts("  wmconfig\tfrom the menu generation tool by the same name");
 }
 
-#ifdef DEBUG
-static const char *get_parser_name(void)
+static const char *get_parser_name(fct_parse_menufile *parser)
 {
-	if (parse == &parse_xdg)
+	if (parser == &parse_xdg)
 		return "xdg";
-	if (parse == &parse_wmconfig)
+	if (parser == &parse_wmconfig)
 		return "wmconfig";
 
 	/* This case is not supposed to happen, but if it does it means that someone to update this list */
 	return "<unknown>";
 }
+
+static void addMenuFile(const char *path, const struct stat *st)
+{
+	WMMenuFile *file;
+
+	file = (WMMenuFile *)wmalloc(sizeof(WMMenuFile));
+	file->path = wstrdup(path);
+	file->st = *st;
+	file->parse = parse;
+	file->entries = NULL;
+	file->cached = False;
+
+	WMAddToArray(menuFiles, file);
+}
+
+static void setCurrentFile(WMMenuFile *file)
+{
+#ifdef HAVE_PTHREAD
+	pthread_setspecific(currentFileKey, file);
+#else
+	currentFile = file;
+#endif
+}
+
+static WMMenuFile *getCurrentFile(void)
+{
+#ifdef HAVE_PTHREAD
+	return (WMMenuFile *)pthread_getspecific(currentFileKey);
+#else
+	return currentFile;
+#endif
+}
+
+static void parseMenuFile(WMMenuFile *file)
+{
+	file->entries = WMCreateArray(4);
+
+	setCurrentFile(file);
+	file->parse(file->path, collectMenuEntryCallback);
+	setCurrentFile(NULL);
+}
+
+/* only the xdg parser is self-contained enough to be cached and run in
+ * parallel, the result of the wmconfig one depends on the PATH
+ */
+static Bool isCacheableFile(WMMenuFile *file)
+{
+	return file->parse == &parse_xdg;
+}
+
+#ifdef HAVE_PTHREAD
+static void *parseMenuFilesThread(void *data)
+{
+	WMMenuFile *file;
+	int count;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	count = WMGetArrayItemCount(menuFiles);
+	for (;;) {
+		file = NULL;
+
+		pthread_mutex_lock(&parseLock);
+		while (nextFileToParse < count) {
+			file = WMGetFromArray(menuFiles, nextFileToParse++);
+			if (!file->entries && isCacheableFile(file))
+				break;
+			file = NULL;
+		}
+		pthread_mutex_unlock(&parseLock);
+
+		if (!file)
+			break;
+
+		parseMenuFile(file);
+	}
+
+	return NULL;
+}
+
+/* spread the parsing of the files which were not found in the cache over
+ * the available processors
+ */
+static void parseMenuFilesInParallel(int count)
+{
+	pthread_t threads[MAX_PARSE_THREADS];
+	long ncpu;
+	int i, nthreads;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	nthreads = ncpu;
+	if (nthreads > MAX_PARSE_THREADS)
+		nthreads = MAX_PARSE_THREADS;
+	if (nthreads > count)
+		nthreads = count;
+
+	nextFileToParse = 0;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, parseMenuFilesThread, NULL) != 0)
+			break;
+	}
+	nthreads = i;
+
+	/* if no thread could be started, do the job ourself */
+	if (nthreads == 0)
+		parseMenuFilesThread(NULL);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+}
+#endif
+
+/* parse all the files found, or take their entries from the cache when they
+ * did not change since last time, then add everything to the menu
+ */
+static void processMenuFiles(void)
+{
+	WMArrayIterator iter, eiter;
+	WMMenuFile *file;
+	WMMenuEntry *wm;
+	int toParse;
+
+#ifdef HAVE_PTHREAD
+	pthread_key_create(&currentFileKey, NULL);
 #endif
 
+	if (cache_file)
+		menu_cache_load(cache_file);
+
+	toParse = 0;
+	WM_ITERATE_ARRAY(menuFiles, file, iter) {
+		if (!isCacheableFile(file))
+			continue;
+
+		if (cache_file) {
+			file->entries = menu_cache_get(get_parser_name(file->parse), file->path, &file->st);
+			if (file->entries) {
+				file->cached = True;
+				continue;
+			}
+		}
+		toParse++;
+	}
+
+#ifdef HAVE_PTHREAD
+	if (toParse > 1)
+		parseMenuFilesInParallel(toParse);
+#endif
+
+	WM_ITERATE_ARRAY(menuFiles, file, iter) {
+		if (!file->entries)
+			parseMenuFile(file);
+
+		WM_ITERATE_ARRAY(file->entries, wm, eiter)
+			addWMMenuEntryCallback(wm);
+
+		if (cache_file && isCacheableFile(file))
+			menu_cache_put(get_parser_name(file->parse), file->path, &file->st,
+			               file->entries, !file->cached);
+
+		WM_ITERATE_ARRAY(file->entries, wm, eiter) {
+			wfree(wm->Name);
+			wfree(wm->CmdLine);
+			if (wm->SubMenu)
+				wfree(wm->SubMenu);
+			wfree(wm);
+		}
+		WMFreeArray(file->entries);
+		file->entries = NULL;
+	}
+
+	if (cache_file && !menu_cache_save(cache_file))
+		fprintf(stderr, "%s: could not save the cache to \"%s\"\n", prog_name, cache_file);
+}
+
+/* write the menu to the output file, unless it already contains this menu
+ */
+static int writeMenuFile(WMPropList *pl)
+{
+	WMPropList *old;
+	Bool same;
+
+	old = WMReadPropListFromFile(output_file);
+	if (old) {
+		same = WMIsPropListEqualTo(old, pl);
+		WMReleasePropList(old);
+		if (same)
+			return 0;
+	}
+
+	if (!write_proplist_file(pl, output_file)) {
+		fprintf(stderr, "%s: could not write the menu to \"%s\"\n", prog_name, output_file);
+		return 1;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	struct stat st;
@@ -92,6 +325,7 @@ int main(int argc, char **argv)
 
 	prog_name = argv[0];
 	plMenuNodes = WMCreateArray(8); /* grows on demand */
+	menuFiles = WMCreateArray(32);
 	menu = (WMTreeNode *)NULL;
 	parse = NULL;
 	validateFilename = NULL;
@@ -136,6 +370,16 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (strncmp(argv[i], "--cache=", 8) == 0) {
+			cache_file = argv[i] + 8;
+			continue;
+		}
+
+		if (strncmp(argv[i], "--output=", 9) == 0) {
+			output_file = argv[i] + 9;
+			continue;
+		}
+
 		if (strcmp(argv[i], "--version") == 0) {
 			printf("%s (Window Maker %s)\n", prog_name, VERSION);
 			return 0;
@@ -155,7 +399,7 @@ int main(int argc, char **argv)
 
 #if DEBUG
 		fprintf(stderr, "%s: Using parser \"%s\" to process \"%s\"\n",
-		        prog_name, get_parser_name(), argv[i]);
+		        prog_name, get_parser_name(parse), argv[i]);
 #endif
 
 		if (stat(argv[i], &st) == -1) {
@@ -163,7 +407,7 @@ int main(int argc, char **argv)
 			        prog_name, argv[i], strerror(errno));
 			return 1;
 		} else if (S_ISREG(st.st_mode)) {
-			parse(argv[i], addWMMenuEntryCallback);
+			addMenuFile(argv[i], &st);
 		} else if (S_ISDIR(st.st_mode)) {
 			nftw(argv[i], dirParseFunc, 16, FTW_PHYS);
 		} else {
@@ -172,6 +416,8 @@ int main(int argc, char **argv)
 		}
 	}
 
+	processMenuFiles();
+
 	if (!menu) {
 		fprintf(stderr, "%s: parsers failed to create a valid menu\n", prog_name);
 		return 1;
@@ -193,6 +439,9 @@ int main(int argc, char **argv)
 		WMAddToArray(plMenuNodes, first);
 	}
 
+	if (output_file)
+		return writeMenuFile((WMPropList *)WMGetFromArray(plMenuNodes, 0));
+
 	puts(WMGetPropListDescription((WMPropList *)WMGetFromArray(plMenuNodes, 0), True));
 
 	return 0;
@@ -200,18 +449,45 @@ int main(int argc, char **argv)
 
 static int dirParseFunc(const char *filename, const struct stat *st, int tflags, struct FTW *ftw)
 {
-	(void)st;
-	(void)tflags;
-	(void)ftw;
+	struct stat target;
 
 	if (validateFilename &&
 	    !validateFilename(filename, st, tflags, ftw))
 		return 0;
 
-	parse(filename, addWMMenuEntryCallback);
+	if (tflags == FTW_F) {
+		addMenuFile(filename, st);
+	} else if (tflags == FTW_SL) {
+		/* nftw does not follow them, but the parsers used to */
+		if (stat(filename, &target) == 0 && S_ISREG(target.st_mode))
+			addMenuFile(filename, &target);
+	}
+
 	return 0;
 }
 
+/* parsers call back to this function for each menu entry found in a file,
+ * keep a copy of the entry with the file so it can be added to the menu
+ * later on, and possibly saved to the cache
+ */
+static void collectMenuEntryCallback(WMMenuEntry *aEntry)
+{
+	WMMenuFile *file;
+	WMMenuEntry *wm;
+
+	file = getCurrentFile();
+	if (!file)
+		return;
+
+	wm = (WMMenuEntry *)wmalloc(sizeof(WMMenuEntry));
+	wm->Name = wstrdup(aEntry->Name);
+	wm->CmdLine = wstrdup(aEntry->CmdLine);
+	wm->SubMenu = aEntry->SubMenu ? wstrdup(aEntry->SubMenu) : NULL;
+	wm->Flags = aEntry->Flags & ~F_FREE_CMD_LINE;
+
+	WMAddToArray(file->entries, wm);
+}
+
 /* upon fully deducing one particular menu entry, parsers call back to this
  * function to have said menu entry added to the wm menu. initializes wm menu
  * with a root element if needed.
@@ -59,6 +59,7 @@ typedef void cb_add_menu_entry(WMMenuEntry *entry);
 void  parse_locale(const char *what, char **env_lang, char **env_ctry, char **env_enc, char **env_mod);
 char *find_terminal_emulator(void);
 Bool fileInPath(const char *file);
+Bool write_proplist_file(WMPropList *pl, const char *path);
 
 /* implemented parsers
  */
@@ -66,4 +67,12 @@ void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback);
 void parse_wmconfig(const char *file, cb_add_menu_entry *addWMMenuEntryCallback);
 Bool wmconfig_validate_file(const char *filename, const struct stat *st, int tflags, struct FTW *ftw);
 
+/* wmmenugen_cache.c
+ */
+void     menu_cache_load(const char *cache_file);
+WMArray *menu_cache_get(const char *parser, const char *path, const struct stat *st);
+void     menu_cache_put(const char *parser, const char *path, const struct stat *st,
+                        WMArray *entries, Bool changed);
+Bool     menu_cache_save(const char *cache_file);
+
 #endif  /* WMMENUGEN_H */
@@ -0,0 +1,265 @@
+/*
+ * wmmenugen - Window Maker PropList menu generator
+ *
+ * Cache of the menu entries found in the parsed files
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The cache is a property list remembering, for each file parsed, its size
+ * and modification time along with the menu entries the parser found in it:
+ *
+ * {
+ *   Locale = "fr_FR.UTF-8";
+ *   Files = {
+ *     "/usr/share/applications/xterm.desktop" = {
+ *       Parser = xdg;
+ *       Size = 1234;
+ *       MTime = 1431782400;
+ *       Entries = ( (Name, CmdLine, SubMenu, Flags), ... );
+ *     };
+ *   };
+ * }
+ *
+ * Entry names depend on the locale, so the whole cache is dropped when it
+ * does not match the current one. Files not seen during a run are dropped
+ * from the cache when it is saved.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wmmenugen.h"
+
+
+static WMPropList *oldFiles = NULL;
+static WMPropList *newFiles = NULL;
+static Bool cacheChanged = False;
+
+static WMPropList *pl_locale, *pl_files, *pl_parser, *pl_size, *pl_mtime, *pl_entries;
+
+
+static char *get_locale_name(void)
+{
+	char buf[256];
+
+	snprintf(buf, sizeof(buf), "%s_%s.%s@%s",
+	         env_lang ? env_lang : "", env_ctry ? env_ctry : "",
+	         env_enc ? env_enc : "", env_mod ? env_mod : "");
+
+	return wstrdup(buf);
+}
+
+static WMPropList *make_number(unsigned long long value)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%llu", value);
+	return WMCreatePLString(buf);
+}
+
+static Bool number_matches(WMPropList *pl, unsigned long long value)
+{
+	if (!pl || !WMIsPLString(pl))
+		return False;
+
+	return strtoull(WMGetFromPLString(pl), NULL, 10) == value;
+}
+
+/* load the cache saved by a previous run, if any and if still usable
+ */
+void menu_cache_load(const char *cache_file)
+{
+	WMPropList *cache, *locale;
+	char *name;
+
+	pl_locale = WMCreatePLString("Locale");
+	pl_files = WMCreatePLString("Files");
+	pl_parser = WMCreatePLString("Parser");
+	pl_size = WMCreatePLString("Size");
+	pl_mtime = WMCreatePLString("MTime");
+	pl_entries = WMCreatePLString("Entries");
+
+	newFiles = WMCreatePLDictionary(NULL, NULL);
+
+	cache = WMReadPropListFromFile(cache_file);
+	if (!cache || !WMIsPLDictionary(cache)) {
+		cacheChanged = True;
+		goto out;
+	}
+
+	name = get_locale_name();
+	locale = WMGetFromPLDictionary(cache, pl_locale);
+	if (!locale || !WMIsPLString(locale) || strcmp(WMGetFromPLString(locale), name) != 0) {
+		cacheChanged = True;
+	} else {
+		oldFiles = WMGetFromPLDictionary(cache, pl_files);
+		if (oldFiles && WMIsPLDictionary(oldFiles))
+			WMRetainPropList(oldFiles);
+		else
+			oldFiles = NULL;
+	}
+	wfree(name);
+
+out:
+	if (cache)
+		WMReleasePropList(cache);
+}
+
+/* returns the entries found in `path' by `parser' during a previous run
+ * if the file did not change since, NULL otherwise. the returned array and
+ * its entries are newly allocated.
+ */
+WMArray *menu_cache_get(const char *parser, const char *path, const struct stat *st)
+{
+	WMPropList *key, *file, *pl, *list, *entry;
+	WMMenuEntry *wm;
+	WMArray *entries;
+	int i, count;
+
+	if (!oldFiles)
+		return NULL;
+
+	key = WMCreatePLString(path);
+	file = WMGetFromPLDictionary(oldFiles, key);
+	WMReleasePropList(key);
+
+	if (!file || !WMIsPLDictionary(file))
+		return NULL;
+
+	pl = WMGetFromPLDictionary(file, pl_parser);
+	if (!pl || !WMIsPLString(pl) || strcmp(WMGetFromPLString(pl), parser) != 0)
+		return NULL;
+
+	if (!number_matches(WMGetFromPLDictionary(file, pl_size), st->st_size) ||
+	    !number_matches(WMGetFromPLDictionary(file, pl_mtime), st->st_mtime))
+		return NULL;
+
+	list = WMGetFromPLDictionary(file, pl_entries);
+	if (!list || !WMIsPLArray(list))
+		return NULL;
+
+	count = WMGetPropListItemCount(list);
+	entries = WMCreateArray(count);
+	for (i = 0; i < count; i++) {
+		entry = WMGetFromPLArray(list, i);
+		if (!WMIsPLArray(entry) || WMGetPropListItemCount(entry) != 4 ||
+		    !WMIsPLString(WMGetFromPLArray(entry, 0)) ||
+		    !WMIsPLString(WMGetFromPLArray(entry, 1)) ||
+		    !WMIsPLString(WMGetFromPLArray(entry, 3)))
+			continue;
+
+		wm = (WMMenuEntry *)wmalloc(sizeof(WMMenuEntry));
+		wm->Name = wstrdup(WMGetFromPLString(WMGetFromPLArray(entry, 0)));
+		wm->CmdLine = wstrdup(WMGetFromPLString(WMGetFromPLArray(entry, 1)));
+		pl = WMGetFromPLArray(entry, 2);
+		if (WMIsPLString(pl) && *WMGetFromPLString(pl))
+			wm->SubMenu = wstrdup(WMGetFromPLString(pl));
+		else
+			wm->SubMenu = NULL;
+		wm->Flags = atoi(WMGetFromPLString(WMGetFromPLArray(entry, 3)));
+		WMAddToArray(entries, wm);
+	}
+
+	return entries;
+}
+
+/* remember the entries found in `path', they will be written to the cache
+ * when it is saved. `changed' tells whether the file was actually parsed.
+ */
+void menu_cache_put(const char *parser, const char *path, const struct stat *st,
+                    WMArray *entries, Bool changed)
+{
+	WMPropList *list, *entry, *file, *key;
+	WMPropList *name, *cmdline, *submenu, *flags, *size, *mtime;
+	WMArrayIterator iter;
+	WMMenuEntry *wm;
+
+	if (!newFiles)
+		return;
+
+	list = WMCreatePLArray(NULL);
+	WM_ITERATE_ARRAY(entries, wm, iter) {
+		name = WMCreatePLString(wm->Name);
+		cmdline = WMCreatePLString(wm->CmdLine);
+		submenu = WMCreatePLString(wm->SubMenu ? wm->SubMenu : "");
+		flags = make_number(wm->Flags & ~F_FREE_CMD_LINE);
+
+		entry = WMCreatePLArray(name, cmdline, submenu, flags, NULL);
+		WMAddToPLArray(list, entry);
+
+		WMReleasePropList(entry);
+		WMReleasePropList(name);
+		WMReleasePropList(cmdline);
+		WMReleasePropList(submenu);
+		WMReleasePropList(flags);
+	}
+
+	name = WMCreatePLString(parser);
+	size = make_number(st->st_size);
+	mtime = make_number(st->st_mtime);
+	file = WMCreatePLDictionary(pl_parser, name, pl_size, size, pl_mtime, mtime,
+	                            pl_entries, list, NULL);
+	WMReleasePropList(name);
+	WMReleasePropList(size);
+	WMReleasePropList(mtime);
+	WMReleasePropList(list);
+
+	key = WMCreatePLString(path);
+	WMPutInPLDictionary(newFiles, key, file);
+
+	WMReleasePropList(key);
+	WMReleasePropList(file);
+
+	if (changed)
+		cacheChanged = True;
+}
+
+/* write the cache back, if anything changed since it was loaded
+ */
+Bool menu_cache_save(const char *cache_file)
+{
+	WMPropList *cache, *locale;
+	char *name;
+	Bool ok;
+
+	if (!newFiles)
+		return False;
+
+	/* files may have been removed */
+	if (!oldFiles || WMGetPropListItemCount(oldFiles) != WMGetPropListItemCount(newFiles))
+		cacheChanged = True;
+
+	if (!cacheChanged)
+		return True;
+
+	name = get_locale_name();
+	locale = WMCreatePLString(name);
+	wfree(name);
+
+	cache = WMCreatePLDictionary(pl_locale, locale, pl_files, newFiles, NULL);
+	ok = write_proplist_file(cache, cache_file);
+
+	WMReleasePropList(cache);
+	WMReleasePropList(locale);
+
+	return ok;
+}
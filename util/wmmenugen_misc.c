@@ -20,9 +20,14 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 #include <libgen.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <WINGs/WUtil.h>
 
@@ -121,7 +126,7 @@ void parse_locale(const char *what, char **language, char **country, char **enco
 		*language = wstrdup(e);
 
 out:
-	free(e);
+	wfree(e);
 	return;
 
 }
@@ -170,3 +175,47 @@ Bool fileInPath(const char *file)
 
 	return False;
 }
+
+/* write a property list to a file, through a temporary file so that readers
+ * never see a partially written one. unlike WMWritePropListToFile, this is
+ * not restricted to the user's GNUstep directory
+ */
+Bool write_proplist_file(WMPropList *pl, const char *path)
+{
+	char *tmp, *desc;
+	FILE *fp;
+	int fd;
+	Bool ok;
+
+	tmp = wstrconcat(path, ".XXXXXX");
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		wfree(tmp);
+		return False;
+	}
+	fchmod(fd, 0644);
+
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		unlink(tmp);
+		wfree(tmp);
+		return False;
+	}
+
+	desc = WMGetPropListDescription(pl, True);
+	ok = (fprintf(fp, "%s\n", desc) > 0);
+	wfree(desc);
+
+	if (fclose(fp) != 0)
+		ok = False;
+
+	if (ok && rename(tmp, path) != 0)
+		ok = False;
+
+	if (!ok)
+		unlink(tmp);
+	wfree(tmp);
+
+	return ok;
+}
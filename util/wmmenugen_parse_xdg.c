@@ -577,7 +577,7 @@ static Bool compare_matchlevel(int *current_level, const char *found_locale)
  */
 static void  getMenuHierarchyFor(char **xdgmenuspec)
 {
-	char *category, *p;
+	char *category, *p, *last;
 	char buf[1024];
 
 	if (!*xdgmenuspec || !**xdgmenuspec)
@@ -587,7 +587,7 @@ static void  getMenuHierarchyFor(char **xdgmenuspec)
 	wfree(*xdgmenuspec);
 	memset(buf, 0, sizeof(buf));
 
-	p = strtok(category, ";");
+	p = strtok_r(category, ";", &last);
 	while (p) {		/* get a known category */
 		if (strcmp(p, "AudioVideo") == 0) {
 			snprintf(buf, sizeof(buf), "%s", _("Audio & Video"));
@@ -642,7 +642,7 @@ static void  getMenuHierarchyFor(char **xdgmenuspec)
 			snprintf(buf, sizeof(buf), "%s", _("Shell"));
 			break;
 		}
-		p = strtok(NULL, ";");
+		p = strtok_r(NULL, ";", &last);
 	}
 
 